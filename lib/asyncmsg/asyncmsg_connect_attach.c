@@ -19,6 +19,7 @@
 
 
 #include <errno.h>
+#include <atomic.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <sys/mman.h>
@@ -50,7 +51,7 @@ static void * _async_event_thread(void *arg)
 			if (acc->acd.num_curmsg) {
 				MsgSendAsync(coid);
 			}
-			acc->flags |= _ASYNCMSG_CONNECT_TIMEROFF;
+			atomic_set(&acc->flags, _ASYNCMSG_CONNECT_TIMEROFF);
 			_mutex_unlock(&acd->mu);
 			continue;
 		}
@@ -85,7 +86,7 @@ int asyncmsg_connect_attach(uint32_t nd, pid_t pid, int chid, unsigned index, un
 {
 	struct _asyncmsg_connect_context *acc;
 	struct _asyncmsg_connection_descriptor *acd;
-	int id, size;
+	int id, size, spsc;
 	static pthread_mutex_t _async_init_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 	_mutex_lock(&_async_init_mutex);
@@ -129,6 +130,9 @@ int asyncmsg_connect_attach(uint32_t nd, pid_t pid, int chid, unsigned index, un
 	}
 	_mutex_unlock(&_async_init_mutex);
 
+	spsc = flags & ASYNCMSG_CONNECT_SPSC;
+	flags &= ~ASYNCMSG_CONNECT_SPSC;
+
 	size = sizeof(*acc) + sizeof(struct _asyncmsg_put_header) * attr->max_num_buffer;
 	acc = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_PHYS, NOFD, 0);
 	if (acc == (struct _asyncmsg_connect_context *)MAP_FAILED) {
@@ -156,6 +160,8 @@ int asyncmsg_connect_attach(uint32_t nd, pid_t pid, int chid, unsigned index, un
 		return -1;
 	}
 	acc->flags = _ASYNCMSG_CONNECT_TIMEROFF;
+	if (spsc)
+	  acc->flags |= _ASYNCMSG_CONNECT_SPSC;
 	
 	acd->ev.sigev_code = 'P';
 	if ((errno = pthread_mutex_init(&acd->mu, 0)) != EOK)
@@ -41,9 +41,11 @@ struct _asyncmsg_channel_context {
 
 struct _asyncmsg_connect_context {
 	unsigned flags;
-	struct _asyncmsg_connection_descriptor acd;
+	unsigned num_batch;		/* puts since the last trigger, single producer only */
+	struct _asyncmsg_connection_descriptor acd;	/* sendq follows, must be last */
 };
 #define _ASYNCMSG_CONNECT_TIMEROFF 1
+#define _ASYNCMSG_CONNECT_SPSC     2
 
 /* by default, every get will try to receive 5 message */
 #define _ASYNCMSG_DEFAULT_GET    5
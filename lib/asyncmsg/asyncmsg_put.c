@@ -19,13 +19,16 @@
 
 
 #include <errno.h>
+#include <atomic.h>
 #include "asyncmsg_priv.h"
 
 static int _asyncmsg_put_trigger(int coid, struct _asyncmsg_connect_context *acc)
 {
-	/* figure out if we need to trigger kernel */
-	acc->acd.num_curmsg++;
-	if (acc->acd.attr.trigger_num_msg && acc->acd.num_curmsg >= acc->acd.attr.trigger_num_msg)
+	unsigned num;
+	
+	/* figure out if we need to trigger kernel, it decrements num_curmsg without our mutex */
+	num = atomic_add_value(&acc->acd.num_curmsg, 1) + 1;
+	if (acc->acd.attr.trigger_num_msg && num >= acc->acd.attr.trigger_num_msg)
 	{
 		return MsgSendAsync(coid);
 	}
@@ -33,7 +36,63 @@ static int _asyncmsg_put_trigger(int coid, struct _asyncmsg_connect_context *acc
 	/* if this is the first message, trigger & tick the ttimer */
 	if (acc->flags & _ASYNCMSG_CONNECT_TIMEROFF) {
 		TimerSettime(acc->acd.ttimer, 0, &acc->acd.attr.trigger_time, NULL);
-		acc->flags &= ~_ASYNCMSG_CONNECT_TIMEROFF;
+		atomic_clr(&acc->flags, _ASYNCMSG_CONNECT_TIMEROFF);
+	}
+	return 0;
+}
+
+/*
+ * A single producer connection (ASYNCMSG_CONNECT_SPSC) doesn't take
+ * acd->mu unless the queue is full.  Only the putting thread moves
+ * sendq_tail, only the kernel moves sendq_head and only the event
+ * thread moves sendq_free, so each index has one writer.  The kernel
+ * is kicked once every trigger_num_msg puts, or when the trigger
+ * timer started by the first put of a batch expires.
+ */
+static int _asyncmsg_putv_spsc(int coid, struct _asyncmsg_connect_context *acc, const iov_t* iov, int parts, unsigned handle, int (*call_back)(int err, void* buf, unsigned handle))
+{
+	struct _asyncmsg_connection_descriptor *acd = &acc->acd;
+	volatile struct _asyncmsg_put_header *aph;
+	unsigned tail, new_tail;
+	
+	tail = acd->sendq_tail;
+	new_tail = tail + 1;
+	if (new_tail >= acd->sendq_size)
+	  new_tail = 0;
+	
+	if (new_tail == *(volatile unsigned *)&acd->sendq_free) {
+		/* put list is full, the event thread frees under the mutex */
+		if (acd->flags & _NTO_COF_NONBLOCK) {
+			errno = EAGAIN;
+			return -1;
+		}
+		_mutex_lock(&acd->mu);
+		while (new_tail == acd->sendq_free) {
+			pthread_cond_wait(&acd->block_con, &acd->mu);
+		}
+		_mutex_unlock(&acd->mu);
+	}
+	
+	aph = &acd->sendq[tail];
+	aph->err = 0;
+	aph->iov = (iov_t *)iov;
+	aph->parts = parts;
+	aph->handle = handle;
+	aph->cb = call_back;
+	
+	/* the entry has to be there before the kernel can see it */
+	__cpu_membarrier();
+	*(volatile unsigned *)&acd->sendq_tail = new_tail;
+	atomic_add(&acd->num_curmsg, 1);
+	
+	if (acd->attr.trigger_num_msg && ++acc->num_batch >= acd->attr.trigger_num_msg) {
+		acc->num_batch = 0;
+		return MsgSendAsync(coid);
+	}
+	
+	if (acc->flags & _ASYNCMSG_CONNECT_TIMEROFF) {
+		atomic_clr(&acc->flags, _ASYNCMSG_CONNECT_TIMEROFF);
+		TimerSettime(acd->ttimer, 0, &acd->attr.trigger_time, NULL);
 	}
 	return 0;
 }
@@ -50,6 +109,9 @@ int asyncmsg_putv(int coid, const iov_t* iov, int parts, unsigned handle, int (*
 	  return -1;
 	acd = &acc->acd;
 	
+	if (acc->flags & _ASYNCMSG_CONNECT_SPSC)
+	  return _asyncmsg_putv_spsc(coid, acc, iov, parts, handle, call_back);
+	
 	_mutex_lock(&acd->mu);
 	for (;;) {
 		new_tail = acd->sendq_tail + 1;
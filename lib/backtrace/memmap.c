@@ -58,33 +58,80 @@ bt_sprn_memmap (bt_memmap_t *memmap, char *out, size_t outlen)
 }
 
 
+/*
+ * Consecutive frames are usually in the same object, so the region
+ * found last is tried first.  Otherwise bisect, if the regions are in
+ * address order (as bt_load_memmap leaves them).
+ */
+static bt_mem_region_t *
+find_region (bt_memmap_t *memmap, bt_addr_t addr,
+			 bt_mem_region_t *last, int sorted)
+{
+	bt_mem_region_t *reg;
+	int lo, hi, mid;
+
+	if (last && addr >= last->vaddr && (addr - last->vaddr) < last->size)
+		return last;
+
+	if (!sorted) {
+		for (lo=0; lo < memmap->count; lo++) {
+			reg=&(memmap->region[lo]);
+			if (addr >= reg->vaddr && (addr - reg->vaddr) < reg->size)
+				return reg;
+		}
+		return 0;
+	}
+
+	/* last region starting at or below addr */
+	lo=0;
+	hi=memmap->count;
+	while (lo < hi) {
+		mid=lo+(hi-lo)/2;
+		if (memmap->region[mid].vaddr <= addr)
+			lo=mid+1;
+		else
+			hi=mid;
+	}
+	if (lo == 0)
+		return 0;
+	reg=&(memmap->region[lo-1]);
+	if ((addr - reg->vaddr) < reg->size)
+		return reg;
+	return 0;
+}
+
+
 void
 bt_translate_addrs (bt_memmap_t *memmap, bt_addr_t *addrs, int arylen,
 					bt_addr_t *reladdrs, bt_addr_t *offsets,
 					int *indexes, char **filenames)
 {
 	bt_addr_t addr, reladdr, offset;
-	bt_mem_region_t *reg=0;
+	bt_mem_region_t *reg=0, *last=0;
 	int i,j;
 	int index;
+	int sorted=1;
 	char *name=0;
 
+	for (j=1; j < memmap->count; j++) {
+		if (memmap->region[j].vaddr < memmap->region[j-1].vaddr) {
+			sorted=0;
+			break;
+		}
+	}
+
 	for (i=0; i < arylen; i++) {
 		addr=addrs[i];
 		reladdr=addr;
 		offset=0;
 		index=-1;
-		for (j=0; j < memmap->count; j++) {
-			reg=&(memmap->region[j]);
-			if (addr >= reg->vaddr) {
-				if ((addr - (reg->vaddr)) < reg->size) {
-					offset = reg->reloc;
-					reladdr -= offset;
-					index=reg->index;
-					name=reg->name;
-					break;
-				}
-			}
+		reg=find_region(memmap, addr, last, sorted);
+		if (reg) {
+			offset = reg->reloc;
+			reladdr -= offset;
+			index=reg->index;
+			name=reg->name;
+			last=reg;
 		}
 		if (reladdrs)
 			reladdrs[i]=reladdr;
@@ -217,7 +217,7 @@ BT(get_backtrace) (bt_accessor_t *acc, bt_addr_t *pc, int pc_ary_sz)
 										0,
 										_bt_read_mem_indirect,
 										fd,
-										alloca(MEM_RDR_CACHE_SZ)/*cache*/
+										alloca(MEM_RDR_CACHE_SZ*MEM_RDR_CACHE_PAGES)/*cache*/
 										);
 				}
 				if (sigsetjmp(rdr.env, 1) == 0) {
@@ -251,3 +251,152 @@ BT(get_backtrace) (bt_accessor_t *acc, bt_addr_t *pc, int pc_ary_sz)
 
 	return count;
 }
+
+#ifndef _BT_LIGHT
+
+/*
+ * One thread's backtrace through a reader already set up on its
+ * process.  As in bt_get_backtrace, a memory fault ends the
+ * backtrace rather than failing it.
+ */
+static int
+gather_thread (bt_accessor_t *acc, mem_reader_t *rdr,
+			   bt_addr_t *pc, int pc_ary_sz)
+{
+	int count = 0;
+	volatile int err=EOK;		/* volatile needed due to the sigsetjmp() */
+
+	rdr->err=EOK;
+	if (sigsetjmp(rdr->env, 1) == 0) {
+		if (_bt_mem_reader_install_sig_trap(rdr) == -1)
+			return -1;
+
+		if (_bt_gather_other(acc, rdr, pc, pc_ary_sz, &count) == -1) {
+			err=errno;
+		}
+	} else {
+		rdr->err=EFAULT;
+	}
+	_bt_mem_reader_uninstall_sig_trap(rdr);
+
+	if (err != EOK && !(err == EFAULT && rdr->err == EFAULT)) {
+		errno=err;
+		return -1;
+	}
+	return count;
+}
+
+
+int
+bt_get_backtraces (bt_accessor_t *acc, pthread_t *tids, int ntids,
+				   bt_addr_t *pc, int pc_ary_sz, int *counts)
+{
+	bt_accessor_t tacc;
+	mem_reader_t rdr;
+	char path[64];
+	char *held;
+	char *cache=0;
+	int fd, i, self, done=0;
+	int proc_held=0;
+	int flags;
+
+	if (acc==0 || tids==0 || pc==0 || counts==0 ||
+		ntids<0 || pc_ary_sz<0 || acc->stack_limit) {
+		errno=EINVAL;
+		return -1;
+	}
+	switch (acc->type) {
+		case BT_THREAD:
+		case BT_PROCESS:
+			break;
+		default:
+			errno=EINVAL;
+			return -1;
+	}
+	for (i=0; i < ntids; i++)
+		counts[i]=-1;
+	if (ntids == 0)
+		return 0;
+
+	self = (acc->pid == getpid());
+	flags = O_CLOEXEC|((acc->flags&BTF_LIVE_BACKTRACE)?O_RDWR:O_RDONLY);
+	sprintf(path, "/proc/%d/as", acc->pid);
+	if ((fd = open(path, flags)) == -1)
+		return -1;
+
+	if (self) {
+		_bt_mem_reader_init(&rdr, 0, _bt_read_mem_direct, fd, 0 /*cache*/);
+	} else {
+		/* The code most threads are in is read once for all of them
+		 * if the cache is big enough */
+		cache = malloc(MEM_RDR_CACHE_SZ*MEM_RDR_CACHE_MAX_PAGES);
+		if (cache == 0) {
+			close(fd);
+			errno=ENOMEM;
+			return -1;
+		}
+		_bt_mem_reader_init(&rdr, 0, _bt_read_mem_indirect, fd, cache);
+		rdr.cache_pages = MEM_RDR_CACHE_MAX_PAGES;
+	}
+
+	/*
+	 * Hold all the threads before unwinding any of them, so the
+	 * backtraces are from the same moment and the pages cached by
+	 * the reader stay valid for the whole pass.
+	 */
+	tacc = *acc;
+	held = alloca(ntids);
+	memset(held, 0, ntids);
+#ifdef _BT_SINGLE_THREAD_CTRL
+	for (i=0; i < ntids; i++) {
+		if (self && tids[i] == gettid())
+			continue;
+		tacc.tid = tids[i];
+		held[i] = (hold_thread(fd, &tacc) == 0);
+	}
+#else
+	if (hold_thread(fd, &tacc) == 0) {
+		proc_held=1;
+		for (i=0; i < ntids; i++)
+			held[i] = !(self && tids[i] == gettid());
+	}
+#endif
+
+	for (i=0; i < ntids; i++) {
+		if (!held[i])
+			continue;
+		tacc.tid = tids[i];
+		counts[i] = gather_thread(&tacc, &rdr,
+								  pc + i*pc_ary_sz, pc_ary_sz);
+		if (counts[i] >= 0)
+			done++;
+	}
+
+#ifdef _BT_SINGLE_THREAD_CTRL
+	for (i=0; i < ntids; i++) {
+		if (held[i]) {
+			tacc.tid = tids[i];
+			cont_thread(fd, &tacc);
+		}
+	}
+#else
+	if (proc_held)
+		cont_thread(fd, &tacc);
+#endif
+	close(fd);
+	free(cache);
+
+	/* The calling thread can't hold itself */
+	for (i=0; i < ntids; i++) {
+		if (self && tids[i] == gettid()) {
+			counts[i] = BT(get_backtrace)(&BT(acc_self),
+										  pc + i*pc_ary_sz, pc_ary_sz);
+			if (counts[i] >= 0)
+				done++;
+		}
+	}
+
+	return done;
+}
+
+#endif
@@ -36,9 +36,143 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include "backtrace.h"
 #include "mem_reader.h"
 
+/*
+ * Memory maps of the last few processes loaded.  Building a map
+ * takes a DCMD_PROC_MAPDEBUG and a read of the ELF headers for each
+ * shared object, while a tool that takes backtraces over and over
+ * only needs to check that the process is the same one and that its
+ * text mappings have not changed since last time.
+ */
+int bt_memmap_no_cache = 0;
+
+#define MEMMAP_CACHE_NUM 8
+
+static struct {
+	pid_t           pid;
+	_Uint64t        start_time;
+	procfs_mapinfo  *maps;		/* text maps the regions came from */
+	int             nmaps;
+	bt_memmap_t     memmap;
+	unsigned        used;
+} memmap_cache[MEMMAP_CACHE_NUM];
+static unsigned memmap_cache_clock;
+static pthread_mutex_t memmap_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* The page flags in procfs_mapinfo change as the memory is used */
+#define MAP_CMP_FLAGS (MAP_TYPE|MAP_ELF|PROT_READ|PROT_WRITE|PROT_EXEC)
+
+static int
+same_maps (procfs_mapinfo *a, procfs_mapinfo *b, int n)
+{
+	int i;
+	for (i=0; i < n; i++) {
+		if (a[i].vaddr != b[i].vaddr ||
+			a[i].size != b[i].size ||
+			a[i].offset != b[i].offset ||
+			a[i].dev != b[i].dev ||
+			a[i].ino != b[i].ino ||
+			(a[i].flags&MAP_CMP_FLAGS) != (b[i].flags&MAP_CMP_FLAGS)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int
+copy_memmap (bt_memmap_t *dst, bt_memmap_t *src)
+{
+	int i;
+
+	dst->count=0;
+	dst->region=0;
+	if (src->count == 0)
+		return 0;
+	dst->region=malloc(src->count * sizeof(bt_mem_region_t));
+	if (dst->region == 0)
+		return -1;
+	for (i=0; i < src->count; i++) {
+		dst->region[i]=src->region[i];
+		dst->region[i].name=strdup(src->region[i].name);
+		if (dst->region[i].name == 0) {
+			while (--i >= 0)
+				free(dst->region[i].name);
+			free(dst->region);
+			dst->region=0;
+			return -1;
+		}
+	}
+	dst->count=src->count;
+	return 0;
+}
+
+/*
+ * Returns 1 and fills memmap if the cache has a map for this process
+ * built from the same text maps, 0 if not, -1 if out of memory.
+ */
+static int
+memmap_cache_get (pid_t pid, _Uint64t start_time,
+				  procfs_mapinfo *maps, int nmaps, bt_memmap_t *memmap)
+{
+	int i, ret=0;
+
+	pthread_mutex_lock(&memmap_cache_mutex);
+	for (i=0; i < MEMMAP_CACHE_NUM; i++) {
+		if (memmap_cache[i].used &&
+			memmap_cache[i].pid == pid &&
+			memmap_cache[i].start_time == start_time &&
+			memmap_cache[i].nmaps == nmaps &&
+			same_maps(memmap_cache[i].maps, maps, nmaps)) {
+			memmap_cache[i].used=++memmap_cache_clock;
+			ret = copy_memmap(memmap, &memmap_cache[i].memmap) ? -1 : 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&memmap_cache_mutex);
+	return ret;
+}
+
+/* Failing to cache a map is not an error, it will just be built again */
+static void
+memmap_cache_put (pid_t pid, _Uint64t start_time,
+				  procfs_mapinfo *maps, int nmaps, bt_memmap_t *memmap)
+{
+	int i, slot=0;
+	procfs_mapinfo *m;
+
+	if ((m = malloc(nmaps * sizeof(*maps) + 1)) == 0)
+		return;
+	memcpy(m, maps, nmaps * sizeof(*maps));
+
+	pthread_mutex_lock(&memmap_cache_mutex);
+	for (i=0; i < MEMMAP_CACHE_NUM; i++) {
+		if (memmap_cache[i].used && memmap_cache[i].pid == pid) {
+			slot=i;
+			break;
+		}
+		if (memmap_cache[i].used < memmap_cache[slot].used)
+			slot=i;
+	}
+	if (memmap_cache[slot].used) {
+		bt_unload_memmap(&memmap_cache[slot].memmap);
+		free(memmap_cache[slot].maps);
+		memmap_cache[slot].used=0;
+	}
+	if (copy_memmap(&memmap_cache[slot].memmap, memmap) == 0) {
+		memmap_cache[slot].pid=pid;
+		memmap_cache[slot].start_time=start_time;
+		memmap_cache[slot].maps=m;
+		memmap_cache[slot].nmaps=nmaps;
+		memmap_cache[slot].used=++memmap_cache_clock;
+		m=0;
+	}
+	pthread_mutex_unlock(&memmap_cache_mutex);
+	free(m);
+}
+
 /* 
  * - Returns: 
  *   -1 on error
@@ -138,6 +272,33 @@ bt_load_memmap (bt_accessor_t *acc, bt_memmap_t *memmap)
 	}
 
 	nmaps = min(query_nmaps, nmaps);
+
+	/*
+	 * shared libs are mapped twice: once for the text segments,
+	 * and once for the data segments.  So, the only maps that are
+	 * interesting for backtrace are the shared elf (i.e. text segments).
+	 * Skip anything else.
+	 */
+	for (i = 0, ret = 0; i < nmaps; i++) {
+		if ((maps[i].flags & MAP_ELF) && (maps[i].flags & MAP_SHARED)) {
+			maps[ret++] = maps[i];
+		}
+	}
+	nmaps = ret;
+
+	if (!bt_memmap_no_cache) {
+		ret = memmap_cache_get(pid, info.start_time, maps, nmaps, memmap);
+		if (ret == -1) {
+			err = ENOMEM;
+			goto load_memmap_err;
+		}
+		if (ret == 1) {
+			close(fd);
+			free(maps);
+			return 0;
+		}
+	}
+
 	memmap->region = calloc(nmaps, sizeof(bt_mem_region_t));
 	if (memmap->region == 0) {
 		err = ENOMEM;
@@ -156,23 +317,13 @@ bt_load_memmap (bt_accessor_t *acc, bt_memmap_t *memmap)
 							_bt_read_mem_indirect_safe,
 							_bt_read_mem_indirect,
 							fd,
-							alloca(MEM_RDR_CACHE_SZ)/*cache*/
+							alloca(MEM_RDR_CACHE_SZ*MEM_RDR_CACHE_PAGES)/*cache*/
 							);
 	}
 
 	for (i = 0; i < nmaps; i++) {
 		reg = &(memmap->region[memmap->count]);
 
-		/*
-		 * shared libs are mapped twice: once for the text segments,
-		 * and once for the data segments.  So, the only maps that are
-		 * interesting for backtrace are the shared elf (i.e. text segments).
-		 * Skip anything else.
-		 */
-		if (!((maps[i].flags & MAP_ELF) && (maps[i].flags & MAP_SHARED))) {
-			continue;
-		}
-
 		debug_info.i.vaddr = maps[i].vaddr;
 		debug_info.i.path[0]=0;
 		err = devctl(fd, DCMD_PROC_MAPDEBUG, &debug_info,
@@ -198,6 +349,7 @@ bt_load_memmap (bt_accessor_t *acc, bt_memmap_t *memmap)
 
 	if (memmap->count == 0) {
 		free(memmap->region);
+		memmap->region = 0;
 	} else {
 		// Resize the memory containing the regions, since not all map
 		// will be elf
@@ -205,6 +357,10 @@ bt_load_memmap (bt_accessor_t *acc, bt_memmap_t *memmap)
 							   sizeof(bt_mem_region_t)*memmap->count);
 	}
 
+	if (!bt_memmap_no_cache) {
+		memmap_cache_put(pid, info.start_time, maps, nmaps, memmap);
+	}
+
 	close(fd);
 	free(maps);
 	return 0;
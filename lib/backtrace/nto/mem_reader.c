@@ -55,6 +55,14 @@ _BT(mem_reader_init) (mem_reader_t *rdr,
 	}
 	rdr->cache = cache;
 	rdr->cache_offset=BT_ADDR_INVALID;
+#ifndef _BT_LIGHT
+	{
+		int i;
+		rdr->cache_pages=MEM_RDR_CACHE_PAGES;
+		for (i=0; i < MEM_RDR_CACHE_MAX_PAGES; i++)
+			rdr->cache_page[i]=BT_ADDR_INVALID;
+	}
+#endif
 	rdr->err = EOK;
 }
 
@@ -172,7 +180,7 @@ read_mem_procfs (mem_reader_t *rdr,
 			return -1;
 		}
 		cnt+=ret;
-		to_read-=cnt;
+		to_read-=ret;
 	}
 	return size;
 }
@@ -227,17 +235,19 @@ _bt_read_mem_direct_safe (mem_reader_t *rdr,
 
 
 /*
- * Note: the cache is the smallest page size on nto, and the cache
- * offset is always chosen to be on a page boundary.
- * This method of handling the cache avoids accidentally accessing
- * an invalid address.
+ * Note: each cache page is the smallest page size on nto, and is
+ * always read from a page boundary.  This method of handling the
+ * cache avoids accidentally accessing an invalid address.  Pages
+ * are direct mapped on their address, so the stack and the code
+ * being unwound do not keep evicting each other.
  */ 
 int
 _bt_read_mem_indirect_safe (mem_reader_t *rdr,
 							void *mem, bt_addr_t position, size_t size)
 {
 	bt_addr_t read_addr;
-	void *p;
+	char *page;
+	int slot;
 	int ret;
 
 	if (bt_mem_reader_no_cache ||
@@ -250,23 +260,22 @@ _bt_read_mem_indirect_safe (mem_reader_t *rdr,
 		return read_mem_procfs(rdr, mem, position, size);
 	}
 
-	if (rdr->cache_offset == BT_ADDR_INVALID ||
-		position < rdr->cache_offset ||
-		(position+size) > (rdr->cache_offset+MEM_RDR_CACHE_SZ)) {
-		read_addr=position-position%MEM_RDR_CACHE_SZ;
-		rdr->cache_offset=BT_ADDR_INVALID;
-		ret = read_mem_procfs(rdr, rdr->cache, read_addr, MEM_RDR_CACHE_SZ);
+	read_addr=position-position%MEM_RDR_CACHE_SZ;
+	slot=(read_addr/MEM_RDR_CACHE_SZ)%rdr->cache_pages;
+	page=rdr->cache+slot*MEM_RDR_CACHE_SZ;
+	if (rdr->cache_page[slot] != read_addr) {
+		rdr->cache_page[slot]=BT_ADDR_INVALID;
+		ret = read_mem_procfs(rdr, page, read_addr, MEM_RDR_CACHE_SZ);
 		if (ret == -1)
 			return -1;
 		if (ret != MEM_RDR_CACHE_SZ) {
 			errno=EINVAL;
 			return -1;
 		}
-		rdr->cache_offset=read_addr;
+		rdr->cache_page[slot]=read_addr;
 	}
 
-	p=&(rdr->cache[position-(rdr->cache_offset)]);
-	(void)_bt_memcpy(mem, p, size);
+	(void)_bt_memcpy(mem, page+(position-read_addr), size);
 
 	return size;
 }
@@ -29,8 +29,19 @@ typedef struct mem_reader_t {
 	int fd;
 	/* 4096 is the smallest page size on nto... */
 #define MEM_RDR_CACHE_SZ 4096
+	/* Pages cached by the indirect reader.  An unwind alternates
+	 * between the stack and the code at each return address, so one
+	 * page is not enough.  The cache passed to mem_reader_init holds
+	 * MEM_RDR_CACHE_PAGES pages, callers with a bigger one can raise
+	 * cache_pages up to MEM_RDR_CACHE_MAX_PAGES */
+#define MEM_RDR_CACHE_PAGES 4
+#define MEM_RDR_CACHE_MAX_PAGES 32
 	char *cache;
 	bt_addr_t cache_offset;
+#ifndef _BT_LIGHT
+	int cache_pages;
+	bt_addr_t cache_page[MEM_RDR_CACHE_MAX_PAGES];
+#endif
 	int err;
 	int tid;
 	int cnt;
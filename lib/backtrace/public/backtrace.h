@@ -78,6 +78,19 @@ int bt_set_flags(bt_accessor_t *acc, unsigned flags, int onoff);
 int bt_get_backtrace(bt_accessor_t *acc, bt_addr_t *addrs, int len);
 int btl_get_backtrace(bt_accessor_t *acc, bt_addr_t *addrs, int len);
 
+#ifndef _BT_LIGHT
+/* Note:
+ * - backtraces of ntids threads of the process of acc (BT_THREAD or
+ *   BT_PROCESS) in one pass.  Thread i's backtrace goes in
+ *   addrs[i*len .. i*len+len-1] and its length in counts[i], -1 if
+ *   it couldn't be taken.  Returns the number of threads done, or -1.
+ * - unless BTF_LIVE_BACKTRACE is set, all the threads are held while
+ *   the backtraces are taken.
+ */
+int bt_get_backtraces(bt_accessor_t *acc, pthread_t *tids, int ntids,
+					  bt_addr_t *addrs, int len, int *counts);
+#endif
+
 #ifndef _BT_LIGHT
 int bt_release_accessor(bt_accessor_t *acc);
 #endif
@@ -93,6 +106,9 @@ int bt_load_memmap(bt_accessor_t *acc, bt_memmap_t *memmap);
  *   if those specific info are not wanted.
  *   If filenames are requested, those are not strdup'ed.  The filenames
  *   will only be valid as long as the memmap is not unloaded.
+ * - bt_load_memmap remembers the maps of the last few processes
+ *   loaded, and only builds one again if the process' shared objects
+ *   have been mapped or unmapped since.
  */
 void bt_translate_addrs(bt_memmap_t *memmap, bt_addr_t *addrs, int arylen,
 						bt_addr_t *reladdrs, bt_addr_t *offsets,
@@ -39,7 +39,11 @@ _STD_BEGIN
    So, undefine it. */
 #undef MAXSIG
 #endif
+#ifdef __QNX__
+#define MAXSIG	(_DECWORDS * NDIG)	/* maximum significant digits to keep */
+#else
 #define MAXSIG	(5 * NDIG)	/* maximum significant digits to keep */
+#endif
 
 int _Stoflt(const char *s0, const char *s, char **endptr, long lo[],
 	int maxsig)
@@ -48,6 +52,9 @@ int _Stoflt(const char *s0, const char *s, char **endptr, long lo[],
 	int nsig;	/* number of significant digits seen */
 	int seen;	/* any valid field characters seen */
 	int word = 0;	/* current long word to fill */
+#ifdef __QNX__
+	int more = 0;	/* nonzero digits dropped after the rounding digit */
+#endif
 
 	maxsig *= NDIG;	/* convert word count to digit count */
 	if (MAXSIG < maxsig)
@@ -62,7 +69,14 @@ int _Stoflt(const char *s0, const char *s, char **endptr, long lo[],
 		if (nsig <= maxsig)
 			buf[nsig++] = (char)(*s - '0');	/* accumulate a digit */
 		else
+#ifdef __QNX__
+			{	/* too many digits, just scale exponent */
+			++lo[0];
+			more |= *s != '0';
+			}
+#else
 			++lo[0];	/* too many digits, just scale exponent */
+#endif
 
 	if (*s == localeconv()->decimal_point[0])
 		++s;
@@ -75,11 +89,26 @@ int _Stoflt(const char *s0, const char *s, char **endptr, long lo[],
 			buf[nsig++] = (char)(*s - '0');
 			--lo[0];
 			}
+#ifdef __QNX__
+		else
+			more |= *s != '0';
+#endif
 
 	if (maxsig < nsig)
 		{	/* discard excess digit after rounding up */
 		unsigned int ms = maxsig;	/* to quiet warnings */
 
+#ifdef __QNX__
+		if (MAXSIG <= maxsig)
+			{	/* for _Dectod only zero or not matters: no halfway point
+				   between two doubles has more than 767 digits, so a
+				   nonzero last digit keeps the value on the same side of
+				   all of them */
+			if ((buf[ms] != 0 || more) && buf[ms - 1] == 0)
+				buf[ms - 1] = 1;
+			}
+		else
+#endif
 		if (BASE / 2 <= buf[ms])
 			++buf[ms - 1];	/* okay if digit becomes BASE */
 		nsig = maxsig;
@@ -44,31 +44,58 @@ struct _iofunc_mmap_list {
 	iofunc_ocb_t					*ocb;
 };
 
-struct _iofunc_lock_blocked {
-	struct _iofunc_lock_blocked		*next;
-	int								rcvid;
+/*
+ *  Byte range locks on an attr.  attr->lock_list points at one
+ *  _iofunc_lock_list, which is freed when the last lock goes.  Locks
+ *  and blocked requests are kept in treaps ordered by start, each node
+ *  also carries the largest end in its subtree, so everything that
+ *  overlaps a range is found without looking at the rest.
+ */
+struct _iofunc_lock_node {
+	struct _iofunc_lock_node		*left;
+	struct _iofunc_lock_node		*right;
+	unsigned						prio;
 	off64_t							start;
 	off64_t							end;
-	flock_t							*pflock;
+	off64_t							maxend;		// largest end in this subtree
 };
 
-struct _iofunc_lock_list {
-	struct _iofunc_lock_list		*next;
-	//struct _iofunc_lock_list		**prev;		//UNUSED
-	int								zero2;
+struct _iofunc_lock_blocked {
+	struct _iofunc_lock_node		node;		// in list->blocked
+	struct _iofunc_lock_blocked		*next;		// arrival order
+	struct _iofunc_lock_blocked		*prev;
+	unsigned						seq;
+	int								rcvid;
+	flock_t							*pflock;	// l_sysid is the scoid
+};
+
+struct _iofunc_lock {
+	struct _iofunc_lock_node		all;		// in list->locks
+	struct _iofunc_lock_node		own;		// in its owner's locks
+	int								scoid;
 	short							type;		// F_RDLCK or F_WRLCK
-	unsigned short					zero[3];
-	//int							rcvid;		//UNUSED
-	struct _iofunc_lock_blocked		*blocked;	// blocked list
+};
+
+struct _iofunc_lock_owner {
+	struct _iofunc_lock_owner		*next;
 	int								scoid;
-	off64_t							start;		// start of locked area
-	off64_t							end;		// end of locked area
+	struct _iofunc_lock_node		*locks;		// don't overlap each other
+};
+
+struct _iofunc_lock_list {
+	struct _iofunc_lock_node		*locks;		// all locks, any owner
+	struct _iofunc_lock_owner		*owners;
+	struct _iofunc_lock_node		*blocked;	// F_SETLKW requests waiting
+	struct _iofunc_lock_blocked		*first;
+	struct _iofunc_lock_blocked		*last;
+	unsigned						seq;
 };
 
 int _iofunc_lock(resmgr_context_t *ctp, iofunc_lock_list_t **list, int type, off64_t start, off64_t end);
 int _iofunc_unlock_scoid(iofunc_lock_list_t **list, int scoid, off64_t start, off64_t end);
-void _iofunc_lock_free(iofunc_lock_list_t *lock);
-iofunc_lock_list_t *_iofunc_lock_find(iofunc_lock_list_t *list, int scoid, int type, off64_t start, off64_t end);
+int _iofunc_lock_block(iofunc_lock_list_t *list, resmgr_context_t *ctp, const flock_t *pflock, off64_t start, off64_t end);
+int _iofunc_lock_cancel(iofunc_lock_list_t *list, int rcvid);
+struct _iofunc_lock *_iofunc_lock_find(iofunc_lock_list_t *list, int scoid, int type, off64_t start, off64_t end);
 int _iofunc_isnonblock(int ioflag, int xtype);
 int _iofunc_create(resmgr_context_t *ctp, iofunc_attr_t *attr, mode_t *mode, iofunc_mount_t *mount, struct _client_info *info);
 int _iofunc_open(resmgr_context_t *ctp, io_open_t *msg, iofunc_attr_t *attr, iofunc_attr_t *dattr, struct _client_info *info);
@@ -146,6 +146,11 @@ _C_STD_BEGIN
 #define FL_NAN	4
 #define FL_NEG	8
 
+#ifdef __QNX__
+		/* words of digits _Stoflt keeps for _Dectod, 774 digits */
+#define _DECWORDS	86
+#endif
+
 _C_LIB_DECL
 int _Stopfx(const char **, char **);
 int _Stoflt(const char *, const char *, char **,
@@ -164,6 +169,10 @@ short _Dint(double *, short);
 short _Dnorm(unsigned short *);
 short _Dscale(double *, long);
 short _Dunscale(short *, double *);
+#ifdef __QNX__
+double _Dectod(const long *, int, int *);
+int _Fltnearest(void);
+#endif
 double _Hypot(double, double, int *);
 double _Poly(double, const double *, int);
 #ifdef _FLOAT_DATA_IS_CONST
@@ -192,6 +201,9 @@ short _FDint(float *, short);
 short _FDnorm(unsigned short *);
 short _FDscale(float *, long);
 short _FDunscale(short *, float *);
+#ifdef __QNX__
+float _FDectod(const long *, int, int *);
+#endif
 float _FHypot(float, float, int *);
 float _FPoly(float, const float *, int);
 #ifdef _FLOAT_DATA_IS_CONST
@@ -220,6 +232,9 @@ short _LDint(long double *, short);
 short _LDnorm(unsigned short *);
 short _LDscale(long double *, long);
 short _LDunscale(short *, long double *);
+#ifdef __QNX__
+long double _LDectod(const long *, int, int *);
+#endif
 long double _LHypot(long double, long double, int *);
 long double _LPoly(long double, const long double *, int);
 #ifdef _FLOAT_DATA_IS_CONST
@@ -27,7 +27,15 @@ extern int _Flocale(FILE *, const char *, int);
 extern void _Fsetlocale(FILE *, int);
 extern int _Fspos(FILE *, const fpos_t *, off64_t, int);
 extern int _Fbuf(FILE *str);
+extern int _Frprepv(FILE *str, unsigned char *buf, size_t *pn);
 #define _Closreg()
+
+		/* largest buffer _Fbuf allocates for a file's st_blksize */
+#define _FBUFMAX	(64 * 1024)
+
+		/* most significant digits _Dtodig generates */
+#define _DTODIG		40
+extern short _Dtodig(double x, int ndig, int fixed, char *buf, short *pxexp);
 #endif
 
 		/* bits for _Mode in FILE */
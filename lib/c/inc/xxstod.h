@@ -19,6 +19,24 @@ FTYPE _Stodx(const CTYPE *s, CTYPE **endptr, long pten, int *perr)
 	if (perr != 0)
 		*perr = 0;
 	if ((code &= ~FL_NEG) == FL_DEC)
+#if defined(__QNX__) && FBITS <= DBL_MANT_DIG
+		if (_Fltnearest())
+			{	/* parse decimal format, correctly rounded */
+			long dlo[_DECWORDS + 1];
+			const int nlo = CNAME(Stoflt)(s0, s, endptr, dlo, _DECWORDS);
+
+			if (nlo == 0 || dlo[1] == 0)
+				x = FLIT(0.0);
+			else
+				{	/* zero stays positive, it is signed below */
+				dlo[0] += pten;
+				x = FNAME(Dectod)(dlo, nlo, perr);
+				if (neg && x != FLIT(0.0))
+					x = -x;
+				}
+			}
+		else
+#endif
 		{	/* parse decimal format */
 		const int nlo = CNAME(Stoflt)(s0, s, endptr, lo, NLONG);
 		int i;
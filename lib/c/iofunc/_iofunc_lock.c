@@ -19,10 +19,10 @@
 
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
-#include <stdlib.h>
 #include <string.h>
 #include <sys/iofunc.h>
 #include "iofunc.h"
@@ -32,96 +32,341 @@
  For a good reference on file locking see:
  Stevens, Advanced Programming in the Unix Environment, 12.3 - Record Locking
  Posix standard 6.5.2
+
+ Each owner's (scoid's) locks never overlap each other: setting a lock
+ first takes whatever the owner had in that range out, merging with
+ locks of the same type and trimming or splitting the others.  A
+ request that has to wait goes in list->blocked; whenever a range is
+ unlocked or downgraded to a read lock, only the requests overlapping
+ it are looked at again, in the order they arrived.
 */
-#define CONTAINS(s1, e1, x)     (((s1) <= (x)) && ((x) <= (e1)))
-#define OVERLAP(s1, e1, s2, e2) (CONTAINS(s1, e1, s2) || CONTAINS(s2, e2, s1))
-#include <stdio.h>
+#define CONFLICT(t1, t2)		((t1) == F_WRLCK || (t2) == F_WRLCK)
+#define LOCK_ALL(_n)			((struct _iofunc_lock *)(_n))
+#define LOCK_OWN(_n)			((struct _iofunc_lock *)((char *)(_n) - offsetof(struct _iofunc_lock, own)))
+#define BLOCKED(_n)				((struct _iofunc_lock_blocked *)(_n))
+
+/*
+ *  Treap of ranges ordered by start (ties by address), each node also
+ *  knowing the largest end below it.  Priorities are the list's
+ *  sequence number scrambled, which is as good as random here.
+ */
+static unsigned node_prio(iofunc_lock_list_t *list) {
+	unsigned		x = ++list->seq;
+
+	x *= 0x9e3779b1;
+	x ^= x >> 16;
+	x *= 0x85ebca6b;
+	return x ^ (x >> 13);
+}
+
+static void node_fix(struct _iofunc_lock_node *n) {
+	n->maxend = n->end;
+	if (n->left && n->left->maxend > n->maxend) {
+		n->maxend = n->left->maxend;
+	}
+	if (n->right && n->right->maxend > n->maxend) {
+		n->maxend = n->right->maxend;
+	}
+}
+
+static int node_before(struct _iofunc_lock_node *a, struct _iofunc_lock_node *b) {
+	return a->start < b->start || (a->start == b->start && (uintptr_t)a < (uintptr_t)b);
+}
+
+static void node_split(struct _iofunc_lock_node *root, struct _iofunc_lock_node *key, 
+						struct _iofunc_lock_node **l, struct _iofunc_lock_node **r) {
+	if (!root) {
+		*l = *r = NULL;
+		return;
+	}
+	if (node_before(root, key)) {
+		*l = root;
+		node_split(root->right, key, &root->right, r);
+	}
+	else {
+		*r = root;
+		node_split(root->left, key, l, &root->left);
+	}
+	node_fix(root);
+}
+
+static struct _iofunc_lock_node *node_join(struct _iofunc_lock_node *a, struct _iofunc_lock_node *b) {
+	if (!a) {
+		return b;
+	}
+	if (!b) {
+		return a;
+	}
+	if (a->prio > b->prio) {
+		a->right = node_join(a->right, b);
+		node_fix(a);
+		return a;
+	}
+	b->left = node_join(a, b->left);
+	node_fix(b);
+	return b;
+}
 
-static int _iofunc_lock_scoid(iofunc_lock_list_t **plist, int scoid, int type, off64_t start, off64_t end);
+static struct _iofunc_lock_node *node_insert(struct _iofunc_lock_node *root, struct _iofunc_lock_node *n) {
+	if (!root || n->prio > root->prio) {
+		node_split(root, n, &n->left, &n->right);
+		node_fix(n);
+		return n;
+	}
+	if (node_before(n, root)) {
+		root->left = node_insert(root->left, n);
+	}
+	else {
+		root->right = node_insert(root->right, n);
+	}
+	node_fix(root);
+	return root;
+}
+
+static struct _iofunc_lock_node *node_remove(struct _iofunc_lock_node *root, struct _iofunc_lock_node *n) {
+	if (root == n) {
+		return node_join(n->left, n->right);
+	}
+	if (node_before(n, root)) {
+		root->left = node_remove(root->left, n);
+	}
+	else {
+		root->right = node_remove(root->right, n);
+	}
+	node_fix(root);
+	return root;
+}
 
 /*
- *  _iofunc_lock_alloc -- allocates free lock list item
+ *  First lock in start order overlapping start-end that conflicts
+ *  with a lock of type by scoid.
  */
-static iofunc_lock_list_t *_iofunc_lock_alloc() {
-	iofunc_lock_list_t *lockp;
+static struct _iofunc_lock *node_conflict(struct _iofunc_lock_node *n, int scoid, int type, off64_t start, off64_t end) {
+	struct _iofunc_lock		*l;
 
-	if ((lockp = (iofunc_lock_list_t *)malloc(sizeof(*lockp)))) {
-		memset(lockp, 0, sizeof(*lockp));
+	while (n && n->maxend >= start) {
+		if ((l = node_conflict(n->left, scoid, type, start, end))) {
+			return l;
+		}
+		if (n->start > end) {
+			break;
+		}
+		l = LOCK_ALL(n);
+		if (n->end >= start && l->scoid != scoid && CONFLICT(l->type, type)) {
+			return l;
+		}
+		n = n->right;
 	}
-	return lockp;
+	return NULL;
 }
 
 /*
- *  _iofunc_blocked_free - returns a blocked item to the free list 
- *  _iofunc_lock_free - returns a lock item to the free list 
- *                    - If there are any pending items, they are
- *                      send an ENOENT (?EINTR?) to tell them that
- *                      they have been stranded!
+ *  Blocked requests overlapping start-end; counts them if v is NULL.
  */
-static void _iofunc_blocked_free(struct _iofunc_lock_blocked *block) {
-	if (block) {
-		if (block->pflock) {
-			free(block->pflock);
+static int node_overlap(struct _iofunc_lock_node *n, off64_t start, off64_t end, struct _iofunc_lock_blocked **v, int nv) {
+	while (n && n->maxend >= start) {
+		nv = node_overlap(n->left, start, end, v, nv);
+		if (n->start > end) {
+			break;
 		}
-		free(block);
+		if (n->end >= start) {
+			if (v) {
+				v[nv] = BLOCKED(n);
+			}
+			nv++;
+		}
+		n = n->right;
 	}
+	return nv;
 }
 
-void _iofunc_lock_free(iofunc_lock_list_t *lockp) {
-	if (lockp) {
-		while (lockp->blocked) {
-			struct _iofunc_lock_blocked *tmp;
-			MsgError(lockp->blocked->rcvid, ENOENT);
-			tmp = lockp->blocked;
-			lockp->blocked = lockp->blocked->next;
-			_iofunc_blocked_free(tmp);
+/*
+ *  Owners, most recently used first
+ */
+static struct _iofunc_lock_owner *owner_find(iofunc_lock_list_t *list, int scoid, int create) {
+	struct _iofunc_lock_owner	*o, **po;
+
+	for (po = &list->owners; (o = *po); po = &o->next) {
+		if (o->scoid == scoid) {
+			*po = o->next;
+			break;
+		}
+	}
+	if (!o) {
+		if (!create || !(o = malloc(sizeof(*o)))) {
+			return NULL;
 		}
-		free(lockp);
+		o->scoid = scoid;
+		o->locks = NULL;
 	}
+	o->next = list->owners;
+	list->owners = o;
+	return o;
 }
 
 /*
- *  _iofunc_lock_add - routine to add item to the lock list.  Always add the 
- *  lock after the pointer, unless the pointer points to NULL?
+ *  The owner's lock with the lowest start among those ending at or
+ *  after start; they don't overlap, so ends are in start order too.
  */
-static int _iofunc_lock_add (iofunc_lock_list_t **cl, int scoid, int type, off64_t start, off64_t end) {
-    iofunc_lock_list_t  *nl;
+static struct _iofunc_lock *owner_first(struct _iofunc_lock_owner *o, off64_t start) {
+	struct _iofunc_lock_node	*n, *best;
 
-    /*
-     *  get a lock, return if none available
-     */
-    if((nl = _iofunc_lock_alloc()) == NULL) {
-        errno = ENOMEM;
-        return errno;
+	for (best = NULL, n = o->locks; n; ) {
+		if (n->end >= start) {
+			best = n;
+			n = n->left;
+		}
+		else {
+			n = n->right;
+		}
 	}
+	return best ? LOCK_OWN(best) : NULL;
+}
+
+static void lock_insert(iofunc_lock_list_t *list, struct _iofunc_lock_owner *o, struct _iofunc_lock *l) {
+	l->own.start = l->all.start;
+	l->own.end = l->all.end;
+	l->own.prio = l->all.prio = node_prio(list);
+	list->locks = node_insert(list->locks, &l->all);
+	o->locks = node_insert(o->locks, &l->own);
+}
 
-    /*
-     *  link the new entry into list at current spot
-     *  fill in the data from the args
-     */
-	if (*cl) {
-	    nl->next = (*cl)->next;
-		(*cl)->next = nl;
+static void lock_remove(iofunc_lock_list_t *list, struct _iofunc_lock_owner *o, struct _iofunc_lock *l) {
+	list->locks = node_remove(list->locks, &l->all);
+	o->locks = node_remove(o->locks, &l->own);
+}
+
+
+/*
+ *  Set the scoid's locks in start-end to type (F_UNLCK removes them).
+ *  Anything that stops being write locked, or stops being locked at
+ *  all, is added to the range *prs - *pre.
+ */
+static int lock_set(iofunc_lock_list_t *list, int scoid, int type, off64_t start, off64_t end, off64_t *prs, off64_t *pre) {
+	struct _iofunc_lock_owner	*o;
+	struct _iofunc_lock			*l, *nl, *spare[2];
+	off64_t						s, e;
+	int							nspare, need;
+
+	if (!(o = owner_find(list, scoid, type != F_UNLCK))) {
+		return type == F_UNLCK ? EOK : ENOMEM;
 	}
-	else {
-		*cl = nl;
-		nl->next = NULL;
+
+	/*
+	 *  Only a lock of another type reaching past both ends of the range
+	 *  is split in two, and then it is the only one in the range.  Get
+	 *  that and the new lock now, so that nothing has changed if we
+	 *  can't; an unlock that splits nothing can't fail.
+	 */
+	need = type != F_UNLCK;
+	if ((l = owner_first(o, start)) && l->type != type && l->all.start < start && l->all.end > end) {
+		need++;
 	}
+	for (nspare = 0; nspare < need; nspare++) {
+		if (!(spare[nspare] = malloc(sizeof(*spare[nspare])))) {
+			while (nspare) {
+				free(spare[--nspare]);
+			}
+			if (!o->locks) {
+				list->owners = o->next;
+				free(o);
+			}
+			return ENOMEM;
+		}
+	}
+
+	while ((l = owner_first(o, start)) && l->all.start <= end) {
+		lock_remove(list, o, l);
+		s = l->all.start;
+		e = l->all.end;
+
+		/* same type, the new lock takes it over */
+		if (l->type == type) {
+			start = __min(start, s);
+			end = __max(end, e);
+			free(l);
+			continue;
+		}
+
+		if (type == F_UNLCK || l->type == F_WRLCK) {
+			*prs = __min(*prs, __max(s, start));
+			*pre = __max(*pre, __min(e, end));
+		}
 
-	//Having the rcvid in here is totally useless so we don't
-	//nl->rcvid = rcvid;
-    nl->scoid  = scoid;
-    nl->start = start;
-    nl->end   = end;
-    nl->type  = type;
-    return EOK;
+		/* keep what lies outside the range */
+		if (s < start && e > end) {
+			nl = spare[--nspare];
+			nl->scoid = scoid;
+			nl->type = l->type;
+			nl->all.start = end + 1;
+			nl->all.end = e;
+			lock_insert(list, o, nl);
+			l->all.end = start - 1;
+			lock_insert(list, o, l);
+		}
+		else if (s < start) {
+			l->all.end = start - 1;
+			lock_insert(list, o, l);
+		}
+		else if (e > end) {
+			l->all.start = end + 1;
+			lock_insert(list, o, l);
+		}
+		else {
+			free(l);
+		}
+	}
+
+	if (type != F_UNLCK) {
+		nl = spare[--nspare];
+		nl->scoid = scoid;
+		nl->type = type;
+		nl->all.start = start;
+		nl->all.end = end;
+		lock_insert(list, o, nl);
+	}
+	while (nspare) {
+		free(spare[--nspare]);
+	}
+
+	/* owner_find() left it at the front */
+	if (!o->locks) {
+		list->owners = o->next;
+		free(o);
+	}
+	return EOK;
+}
+
+static void _iofunc_blocked_free(struct _iofunc_lock_blocked *block) {
+	if (block) {
+		if (block->pflock) {
+			free(block->pflock);
+		}
+		free(block);
+	}
+}
+
+static void _iofunc_blocked_remove(iofunc_lock_list_t *list, struct _iofunc_lock_blocked *block) {
+	list->blocked = node_remove(list->blocked, &block->node);
+	if (block->prev) {
+		block->prev->next = block->next;
+	}
+	else {
+		list->first = block->next;
+	}
+	if (block->next) {
+		block->next->prev = block->prev;
+	}
+	else {
+		list->last = block->prev;
+	}
 }
 
 /*
  * Actually do the reply to the client described by the blocked pointer, and 
  * then afterward we have replied free the blocked strucuture.
  */
-static void _iofunc_lock_unblock(iofunc_lock_list_t *list, struct _iofunc_lock_blocked *blocked) {
+static void _iofunc_lock_unblock(struct _iofunc_lock_blocked *blocked) {
 	struct _msg_info			info;
 	struct _io_lock_reply		reply;
 	struct iovec				iov[2];
@@ -140,141 +385,78 @@ static void _iofunc_lock_unblock(iofunc_lock_list_t *list, struct _iofunc_lock_b
 }
 
 /*
- * Join two list of blocked entries
+ *  Give a blocked request its lock if nothing is in the way any more
  */
-static void add_blocked_to_end(struct _iofunc_lock_blocked **list, struct _iofunc_lock_blocked *toadd) {
-	struct _iofunc_lock_blocked *tmp;
+static void lock_retry(iofunc_lock_list_t *list, struct _iofunc_lock_blocked *b, off64_t *prs, off64_t *pre) {
+	int							type, scoid, status;
+
+	type = b->pflock->l_type;
+	scoid = b->pflock->l_sysid;
+	if (node_conflict(list->locks, scoid, type, b->node.start, b->node.end)) {
+		return;
+	}
 
-	if (!(tmp = *list)) {
-		*list = toadd;
+	_iofunc_blocked_remove(list, b);
+	if ((status = lock_set(list, scoid, type, b->node.start, b->node.end, prs, pre)) != EOK) {
+		MsgError(b->rcvid, status);
+		_iofunc_blocked_free(b);
 	}
-	else  {
-		while (tmp->next) { tmp = tmp->next; }
-		tmp->next = toadd;
+	else {
+		_iofunc_lock_unblock(b);
 	}
 }
 
-static void reblock_pending_locks(struct _iofunc_lock_blocked **blocked_list, iofunc_lock_list_t **plist_head) {
-	struct _iofunc_lock_blocked *bitem, *tbitem;
-	iofunc_lock_list_t         *litem;
-	int							type, scoid;
-
-	bitem = *blocked_list;
-
-	while (bitem) {
-		tbitem = bitem;
-		bitem = bitem->next;
+static int blocked_cmp(const void *a, const void *b) {
+	return (int)((*(struct _iofunc_lock_blocked **)a)->seq - (*(struct _iofunc_lock_blocked **)b)->seq);
+}
 
-		if (!tbitem->pflock) {
-			MsgError(tbitem->rcvid, EINVAL);
-			_iofunc_blocked_free(tbitem);
-			continue;
+/*
+ *  start-end has been unlocked or downgraded, retry the requests
+ *  waiting on any of it, oldest first.  Granting one can downgrade
+ *  another range, so go round until nothing more is released.
+ */
+static void lock_wake(iofunc_lock_list_t *list, off64_t start, off64_t end) {
+	struct _iofunc_lock_blocked	**v, *b, *next;
+	off64_t						rs, re;
+	int							i, n;
+
+	while (start <= end && list->blocked) {
+		rs = LONGLONG_MAX, re = -1;
+		if ((n = node_overlap(list->blocked, start, end, NULL, 0)) == 0) {
+			break;
 		}
-
-		type = tbitem->pflock->l_type;
-		scoid = tbitem->pflock->l_sysid;
-
-		//TODO: A faster lookup?
-		litem = _iofunc_lock_find(*plist_head, scoid, type, tbitem->start, tbitem->end);
-
-		if (litem) {
-			if (!(tbitem->next = litem->blocked)) {
-				litem->blocked = tbitem;
-			}
-			else {
-				while (tbitem->next->next) { tbitem->next = tbitem->next->next; }
-				tbitem->next->next = tbitem;
+		if ((v = malloc(n * sizeof(*v)))) {
+			(void)node_overlap(list->blocked, start, end, v, 0);
+			qsort(v, n, sizeof(*v), blocked_cmp);
+			for (i = 0; i < n; i++) {
+				lock_retry(list, v[i], &rs, &re);
 			}
-			tbitem->next = NULL;
+			free(v);
 		}
 		else {
-			type = _iofunc_lock_scoid(plist_head, scoid, type, tbitem->start, tbitem->end);
-			if (type != EOK) {
-				MsgError(tbitem->rcvid, type);
-				_iofunc_blocked_free(tbitem);
-			}
-			else {
-				_iofunc_lock_unblock(*plist_head, tbitem);
+			/* the slow way, the queue is in arrival order anyway */
+			for (b = list->first; b; b = next) {
+				next = b->next;
+				if (b->node.start <= end && b->node.end >= start) {
+					lock_retry(list, b, &rs, &re);
+				}
 			}
 		}
+		start = rs, end = re;
 	}
 }
 
-
 /*
- *  locksplit - routine to split a lock into 2 or 3 pieces
- *              and return a pointer to the new piece
- *
- *  Split the lock referenced by cl into 2 pieces
- *  if the request overlaps the beginning or end of the lock.
- *  Split the lock referenced by cl into 3 pieces
- *  if the request overlaps the middle of the lock.
- *
- *  This routine would only be called if the request type
- *  differs from the lock type, so don't bother checking for this.
- *  Otherwise the request could just be merged with the lock.
+ *  Free the list once the last lock is gone (there can't be anyone
+ *  waiting then).
  */
-static iofunc_lock_list_t *locksplit(iofunc_lock_list_t **head, iofunc_lock_list_t *cl, 
-										int scoid, int type, off64_t start, off64_t end) {
-	struct _iofunc_lock_blocked *pending;
+static void lock_list_check(iofunc_lock_list_t **plist) {
+	iofunc_lock_list_t			*list = *plist;
 
-	//There must be an overlap and a type difference for us to get going on this
-	if (!OVERLAP(cl->start, cl->end, start, end) || type == cl->type) {
-		return cl;
+	if (list && !list->locks && !list->first) {
+		free(list);
+		*plist = NULL;
 	}
-
-	/*
-	 Same strategy as before, if we are re-arranging
-	 then we will re-examine the blocked entries
-	 after we are done with our fiddling.
-	*/
-	pending = NULL;
-	add_blocked_to_end(&pending, cl->blocked);
-	cl->blocked = NULL;
-
-
-	/* New block is bigger than existing block */
-	if (start <= cl->start && end >= cl->end) {
-		cl->start = start;
-		cl->end = end;
-		cl->type = type;
-	}
-	/* New block is smaller than existing block */
-	else if (cl->start < start && cl->end > end) {
-
-        if(_iofunc_lock_add(&cl, cl->scoid, type, start, end) != EOK) {
-            return(NULL);
-		}
-
-        if(_iofunc_lock_add(&cl->next, cl->scoid, cl->type, end+1, cl->end) != EOK) {
-            return(NULL);
-		}
-
-		cl->end   = start -1;
-	}
-	/* New block overlaps on one side of the existing block
-	   grow to one side or the other (FRONT, then BACK) */
-	else if (cl->start >= start) {
-		if (_iofunc_lock_add(&cl, cl->scoid, cl->type, end + 1, cl->end) != EOK) {
-			return NULL;
-		}
-
-		cl->type = type;
-		cl->start = start;
-		cl->end = end;
-	}
-	else {
-		if (_iofunc_lock_add(&cl, cl->scoid, type, start, end) != EOK) {
-			return NULL;
-		}	
-		cl->end = start -1;
-	}
-
-	if (pending) {
-		reblock_pending_locks(&pending, head);
-	}
-
-	return cl;
 }
 
 
@@ -282,86 +464,18 @@ static iofunc_lock_list_t *locksplit(iofunc_lock_list_t **head, iofunc_lock_list
  *  unlock - handle unlock request (called from lock hander)
  */
 int _iofunc_unlock_scoid (iofunc_lock_list_t **plist, int scoid, off64_t start, off64_t end) {
-	struct _iofunc_lock_blocked *pending;
-    iofunc_lock_list_t  *cl,    /*  current list item   */
-						**pl;   /*  prev list item  */
-
-    /*
-     *  Starting at list head scan for locks in the range by this process.
-     */
-    if (!(pl = plist) || !*pl) {
-		return EOK;
-	}
-
-	pending = NULL;
-    for(cl = *pl; cl; cl = *pl) {
-        /*
-         *  If not by this process skip to next lock.
-		 *  Check for locks in the proper range.
-         */
-        if(cl->scoid != scoid || !OVERLAP(start, end, cl->start, cl->end)) {
-			pl = &cl->next;
-            continue;
-        }
-
-		/*
-		 The strategy here is that we will strip all 
-		 of the pending locks off of anything that
-		 is changing size, and then after we have
-		 iterated through the list we will go back and
-		 attach these locks to the appropriate blocks,
-		 or create entirely new blocks and tell the pending
-		 people.
-		*/
-		add_blocked_to_end(&pending, cl->blocked);
-		cl->blocked = NULL;
-
-        /*
-         *  For locks fully contained within requested range,
-         *  just delete the item.
-         */
-        if(start <= cl->start  &&  cl->end <= end) {
-			*pl = cl->next;
-            _iofunc_lock_free(cl);
-            continue;
-        }
-
-		pl = &cl->next;
-
-        /*
-         *  Middle section is being removed.
-         *  Add new lock for last section,
-         *  modify existing lock for first section.
-         *  If no locks, return in error.
-         */
-        if(cl->start < start  &&  end < cl->end) {
-            if(_iofunc_lock_add(&cl, cl->scoid, cl->type, end + 1, cl->end) != EOK) {
-                return EINVAL;
-			}
-            cl->end = start - 1;
-		}
-        /*
-         *  First section is being deleted,
-         *  just move starting point up.
-         */
-        else if(start <= cl->start  &&  end < cl->end) {
-            cl->start = end + 1;
-		}
-        /*
-         *  Must be deleting last part of this section.
-         *  Move ending point down.
-         *  Continue looking for locks covered by upper limit of unlock range.
-         */
-        else { 
-			cl->end = start - 1;
-		}
-	}
+	iofunc_lock_list_t			*list;
+	off64_t						rs = LONGLONG_MAX, re = -1;
+	int							status;
 
-	if (pending) {
-		reblock_pending_locks(&pending, plist);
+	if (!plist || !(list = *plist)) {
+		return EOK;
 	}
 
-    return EOK;
+	status = lock_set(list, scoid, F_UNLCK, start, end, &rs, &re);
+	lock_wake(list, rs, re);
+	lock_list_check(plist);
+	return status;
 }
 
 int _iofunc_unlock (resmgr_context_t *ctp, iofunc_lock_list_t **plist, off64_t start, off64_t end) {
@@ -373,140 +487,21 @@ int _iofunc_unlock (resmgr_context_t *ctp, iofunc_lock_list_t **plist, off64_t s
  *  lock - handle lock requests return errno to reply to client w/
  */
 static int _iofunc_lock_scoid(iofunc_lock_list_t **plist, int scoid, int type, off64_t start, off64_t end) {
-    iofunc_lock_list_t  *cl,    /*  current list item   */
-						*pl,	/*  previous list item */
-						*ol;
-	int					ret;
-
-	ol = cl = pl = NULL;
-
-    /*
-     *  Simple case, no existing locks, simply add new lock.
-     */
-    if((cl = *plist) == NULL) {
-        return _iofunc_lock_add(plist, scoid, type, start, end);
-	}
-
-    /*
-     *  Simple case, lock is before existing locks.
-     *  Just insert at head of list (no possible overlap).
-     */
-    if(end < cl->start) {
-		pl = *plist, *plist= NULL;
-        if ((ret = _iofunc_lock_add(plist, scoid, type, start, end)) != EOK) {
-			*plist = pl;
-		}
-		else {
-			(*plist)->next = pl;
-		}
-		return ret;
-	}
-
-    /*
-     *  Scan thru remaining locklist to find location for new request.
-     */
-    for(pl = NULL;cl != NULL; pl = cl, cl = cl->next) {
-        /*
-         *  If lock is owned by same process and overlaps, stop scan.
-         *  If more locks in range, skip to next.
-         *  Otherwise stop scan.
-         */
-        if(cl->scoid == scoid  &&  
-		   OVERLAP(start, end, cl->start, cl->end)) {
-			break;
-        }
-        else if(cl->start > start) {
-			cl = pl;
-            break;
-		}
-	}
-	/*
-	 *  Request is at end of list, so we can add the lock here.
-	 */
-	if(cl == NULL){
-		return _iofunc_lock_add(&pl,scoid,type,start,end);
-	}
-
-    /*
-     *  If we overlap & id's match
-	 *   -And the types match, create a superblock
-	 *   -And the types differ, split the block
-     *  Otherwise add new entry
-     */
-    if(cl->scoid == scoid && OVERLAP(start, end, cl->start, cl->end)) {
-        if(cl->type == type) {
-			cl->end = __max(cl->end, end);
-			cl->start = __min(cl->start, start);
-			return EOK;
-		}
-        else if (!(cl = locksplit(plist, cl, scoid, type, start, end))) {
-			return EINVAL;
-		}
-		//Otherwise go on an compact w/ cl
-	}
-    else {
-		if((ret = _iofunc_lock_add(&cl, scoid, type, start, end))) {
-			return ret;
-		}
-        cl = cl->next;
-	}
+	iofunc_lock_list_t			*list;
+	off64_t						rs = LONGLONG_MAX, re = -1;
+	int							status;
 
-/* 
- This compaction is not required, though it might optimize things 
- slightly if we were to join blocks together. (Check boundary
- conditions as well as overlap)
-*/
-#if 0
-    /*
-     *  Remember the new lock region for later
-     */
-    ol = cl;
-
-    /*
-     *  End point set above may overlap later entries.
-     *  If so delete or modify them to perform the compaction.
-     */
-    while(nl = cl->next; cl && nl; cl = nl, nl = cl->next) {
-        /*
-         *  If the new range overlaps the first part of the next lock,
-         *  if its the same type,
-         *      take its end point and delete the next lock
-         *  else
-         *      move the start point (unlocking anyone waiting).
-         *  We should be done.
-         */
-        if(cl->scoid == scoid) {
-            if(end <= nl->end) {
-                if(nl->type == type) {
-                    ol->end = nl->end;
-                    cl->next = nl->next;
-                    _iofunc_lock_free(nl);
-                }
-                else {
-                    nl->start = start;
-                    if(nl->blocked) {
-						printf("TODO: Wakup people! \n");
-                        //wakeup(nl);
-                    }
-				}
-                return EOK;
-            }
-            else {
-                /*
-                 *  the next lock is fully included in the new range
-                 *  so it may be deleted
-                 */
-                cl->next = nl->next;
-                _iofunc_lock_free(nl);
-            }
-		} 
-		else {
-            cl = nl;
+	if (!(list = *plist)) {
+		if (!(list = calloc(1, sizeof(*list)))) {
+			return ENOMEM;
 		}
-    }
-#endif
+		*plist = list;
+	}
 
-    return EOK;
+	status = lock_set(list, scoid, type, start, end, &rs, &re);
+	lock_wake(list, rs, re);
+	lock_list_check(plist);
+	return status;
 }
 
 int _iofunc_lock(resmgr_context_t *ctp, iofunc_lock_list_t **plist, int type, off64_t start, off64_t end) {
@@ -520,39 +515,64 @@ int _iofunc_lock(resmgr_context_t *ctp, iofunc_lock_list_t **plist, int type, of
 
 
 /*
- *  find - routine to scan locks and check for a locked condition that
- *         would interfere with the lock requested by scoid of type from start-end
+ *  block - queue an F_SETLKW request that has to wait, the client is
+ *          replied to when it gets the lock
  */
-iofunc_lock_list_t *_iofunc_lock_find(iofunc_lock_list_t *list, int scoid, int type, off64_t start, off64_t end) {
-   	iofunc_lock_list_t *tmp;
-	
-	if (type == F_UNLCK) {
-		return NULL;
+int _iofunc_lock_block(iofunc_lock_list_t *list, resmgr_context_t *ctp, const flock_t *pflock, off64_t start, off64_t end) {
+	struct _iofunc_lock_blocked	*b;
+
+	if (!(b = malloc(sizeof(*b))) || !(b->pflock = malloc(sizeof(*pflock)))) {
+		free(b);
+		return ENOMEM;
+	}
+	memcpy(b->pflock, pflock, sizeof(*pflock));
+	b->pflock->l_sysid = ctp->info.scoid;
+	b->rcvid = ctp->rcvid;
+	b->node.start = start;
+	b->node.end = end;
+	b->node.prio = node_prio(list);
+	b->seq = list->seq;
+	list->blocked = node_insert(list->blocked, &b->node);
+
+	//Insert at the end of the list
+	b->next = NULL;
+	if ((b->prev = list->last)) {
+		list->last->next = b;
 	}
+	else {
+		list->first = b;
+	}
+	list->last = b;
+	return EOK;
+}
 
-	tmp = list;
-	while (tmp) {
-		if ((scoid != tmp->scoid) && 
-		    OVERLAP(start, end, tmp->start, tmp->end)) {
-			//!(tmp->type == type && type == F_RDLCK)
-			if (tmp->type != type || type != F_RDLCK) {
-				return tmp;
-			}
+/*
+ *  cancel - forget a blocked request (the client is unblocking),
+ *           returns 1 if there was one
+ */
+int _iofunc_lock_cancel(iofunc_lock_list_t *list, int rcvid) {
+	struct _iofunc_lock_blocked	*b;
+
+	for (b = list ? list->first : NULL; b; b = b->next) {
+		if (b->rcvid == rcvid) {
+			_iofunc_blocked_remove(list, b);
+			_iofunc_blocked_free(b);
+			return 1;
 		}
-		tmp = tmp->next;
 	}
-
-    return NULL;
+	return 0;
 }
 
-#if 0
+
 /*
- *  deadlock - routine to follow chain of locks and tasks
- *              to find deadlocks on file locks.
+ *  find - routine to scan locks and check for a locked condition that
+ *         would interfere with the lock requested by scoid of type from start-end
  */
-static int deadlock (iofunc_lock_list_t *llist, int scoid, int type, off64_t start, off64_t end) {
-	return EOK;
+struct _iofunc_lock *_iofunc_lock_find(iofunc_lock_list_t *list, int scoid, int type, off64_t start, off64_t end) {
+	if (type == F_UNLCK || !list) {
+		return NULL;
+	}
+	return node_conflict(list->locks, scoid, type, start, end);
 }
-#endif
 
 __SRCVERSION("_iofunc_lock.c $Rev: 200568 $");
@@ -28,7 +28,7 @@
 
 int iofunc_close_dup(resmgr_context_t *ctp, io_close_t *msg, iofunc_ocb_t *ocb, iofunc_attr_t *attr) {
 	if((ocb->ioflag & (_IO_FLAG_RD | _IO_FLAG_WR)) && (ocb->flags & IOFUNC_OCB_MMAP) == 0) {
-		iofunc_lock_list_t			*head, *p, **pp;
+		iofunc_lock_list_t			*head;
 		int							(*attr_lock)(iofunc_attr_t *), (*attr_unlock)(iofunc_attr_t *);
 		iofunc_funcs_t				*funcs;
 
@@ -40,32 +40,8 @@ int iofunc_close_dup(resmgr_context_t *ctp, io_close_t *msg, iofunc_ocb_t *ocb,
 		(void)_iofunc_llist_lock(attr);
 		head = attr->lock_list, PTR_UNLOCK(head);
 		
-		pp = &head;
-		while((p = *pp)) {
-			if(p->scoid == ctp->info.scoid) {
-				/* Remove any pending block on this scoid
-				   TODO: Push this code into a purge scoid section
-				struct _iofunc_lock_blocked *tb, **pb;
-				for (tb=p->blocked, pb=&p->blocked; 
-					 tb; 
-					 tb=tb->next, pb = &tb->next) {
-					if (tblocked->pflock && 
-						tblocked->pflock->l_sysid == p->scoid) {
-						*pb = tb->next;
-						_iofunc_blocked_free(tb);
-						tb = *pb;
-					}
-				}
-				*/
-
-				(void)_iofunc_unlock_scoid(&head, p->scoid, p->start, p->end);
-				/* Don't adjust the pointer, since it will now
-				   be filled in assuming that unblock did it's 
-				   job properly and removed/unblocked items. */
-			} else {
-				pp = &p->next;
-			}
-		}
+		/* Pending requests from this scoid stay where they are (TODO) */
+		(void)_iofunc_unlock_scoid(&head, ctp->info.scoid, 0, LONGLONG_MAX);
 
 		PTR_LOCK(head), attr->lock_list = head;
 		_iofunc_llist_unlock(attr);
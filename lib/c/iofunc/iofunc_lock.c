@@ -137,7 +137,7 @@ setlk:
 	head = attr->lock_list, PTR_UNLOCK(head);
 
 	if(cmd == F_GETLK64) {
-		iofunc_lock_list_t			*l;
+		struct _iofunc_lock			*l;
 
 		if(lockp->l_type == F_UNLCK) {
 			status = EINVAL;
@@ -146,12 +146,12 @@ setlk:
 
 			lockp->l_type = l->type;
 			lockp->l_whence = SEEK_SET;
-			lockp->l_start = l->start & 0xffffffff;
-			lockp->l_start_hi = l->start >> 32;
-			if(l->end == LONGLONG_MAX) {
+			lockp->l_start = l->all.start & 0xffffffff;
+			lockp->l_start_hi = l->all.start >> 32;
+			if(l->all.end == LONGLONG_MAX) {
 				lockp->l_len = lockp->l_len_hi = 0;
 			} else {
-				off64_t			len = (l->end - l->start) + 1;
+				off64_t			len = (l->all.end - l->all.start) + 1;
 
 				lockp->l_len = len & 0xffffffff;
 				lockp->l_len_hi = len >> 32;
@@ -164,39 +164,15 @@ setlk:
 			lockp->l_type = F_UNLCK;
 		}
 	} else {
-		iofunc_lock_list_t			*l;
+		struct _iofunc_lock			*l;
 
 		if((l = _iofunc_lock_find(head, ctp->info.scoid, lockp->l_type, start, end))) {
 			if(cmd == F_SETLKW64) {
-				struct _iofunc_lock_blocked		*b;
-
 				//TODO: Do more than this, actually look at the entire locked list
 				if (ctp->info.scoid == l->scoid) {
 					status = EDEADLK;
 				}
-				else if(!(b = malloc(sizeof *b)) ||
-				   !(b->pflock = malloc(sizeof *lockp))) {
-					if (b) {
-						free(b);
-					}
-					status = ENOMEM;
-				} else {
-					memcpy(b->pflock, lockp, sizeof(*lockp));
-					b->pflock->l_sysid = ctp->info.scoid;
-					b->rcvid = ctp->rcvid;
-					b->start = start;
-					b->end = end;
-
-					//Insert at the end of the list
-					if (!(b->next = l->blocked)) {
-						l->blocked = b;
-					}
-					else {
-						while (b->next->next) { b->next = b->next->next; }
-						b->next->next = b;
-					}
-					b->next = NULL;
-
+				else if((status = _iofunc_lock_block(head, ctp, lockp, start, end)) == EOK) {
 					status = _RESMGR_NOREPLY;
 				}
 			} else {
@@ -27,24 +27,15 @@
 #include "iofunc.h"
 
 int iofunc_unblock(resmgr_context_t *ctp, iofunc_attr_t *attr) {
-	iofunc_lock_list_t				*l;
+	struct _msg_info				info;
 
 	(void)_iofunc_llist_lock(attr);
-	for(l = PTR_VALUE(attr->lock_list, iofunc_lock_list_t); l; l = l->next) {
-		struct _iofunc_lock_blocked		*p, **pp;
-		struct _msg_info				info;
-
-		for(pp = &l->blocked; (p = *pp); pp = &p->next) {
-			if(p->rcvid == ctp->rcvid &&
-				MsgInfo_r(p->rcvid, &info) == EOK &&
-				(info.flags & _NTO_MI_UNBLOCK_REQ)) {
-				*pp = p->next;
-				MsgError(p->rcvid, EINTR);
-				free(p);
-				_iofunc_llist_unlock(attr);
-				return _RESMGR_NOREPLY;
-			}
-		}
+	if(MsgInfo_r(ctp->rcvid, &info) == EOK &&
+		(info.flags & _NTO_MI_UNBLOCK_REQ) &&
+		_iofunc_lock_cancel(PTR_VALUE(attr->lock_list, iofunc_lock_list_t), ctp->rcvid)) {
+		MsgError(ctp->rcvid, EINTR);
+		_iofunc_llist_unlock(attr);
+		return _RESMGR_NOREPLY;
 	}
 	_iofunc_llist_unlock(attr);
 	return _RESMGR_DEFAULT;
@@ -62,6 +62,37 @@
 
 #define _SLOG_MAXSIZE                ((0xff+3-1)*sizeof(int))    /* Maximum event size in bytes */
 
+/*
+** slogger also exports its buffer as a shared memory ring that the slog
+** functions append events to without sending it a message.  Producers
+** claim room by advancing reserve, write a control word with
+** _SLOG_RING_BUSY and the event's length in ints, then the event, then
+** the control word again with _SLOG_RING_DONE.  slogger copies done
+** events out in order, zeroes them and advances consume.  When wakeup
+** is set the producer that clears it sends slogger a pulse.
+** This is private to libc and slogger.
+*/
+#define _SLOG_RING_NAME             "/slogger"
+#define _SLOG_RING_MAGIC            0x52474f4c
+#define _SLOG_RING_BUSY             0x40000000
+#define _SLOG_RING_DONE             0x80000000
+#define _SLOG_RING_LEN(ctl)         ((ctl) & 0xffff)
+
+struct _slog_ring {
+	_Uint32t			magic;
+	_Uint32t			size;		/* ints in data[], a power of 2 */
+	_Int32t				pid;		/* where to send the pulse */
+	_Int32t				chid;
+	_Int32t				code;
+	volatile unsigned	wakeup;
+	_Uint32t			spare1[10];
+	volatile unsigned	reserve;	/* producers, free running */
+	_Uint32t			spare2[15];
+	volatile unsigned	consume;	/* slogger, free running */
+	_Uint32t			spare3[15];
+	volatile _Uint32t	data[1];
+};
+
 __BEGIN_DECLS
 
 int slogb(int code, int severity, void *data, int size);
@@ -20,12 +20,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <alloca.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#include <atomic.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/iomsg.h>
 #include <sys/sysmsg.h>
 #include <sys/neutrino.h>
@@ -55,6 +61,150 @@
 
 extern	pthread_mutex_t	__slog_mux;
 
+//
+// slogger also exports its buffer as a shared memory ring. Events are
+// appended to it lock free by every thread in every process, and slogger
+// only hears about them (with a pulse) when it has readers waiting, so
+// logging costs a few memory writes instead of a message to slogger. When
+// the ring is full, or there is no ring, events go as messages as before.
+// Setting _slogfd to an fd of your own also bypasses the ring.
+//
+// Anyone can write the ring, so its size and pulse code are checked
+// once when it is mapped and kept here; they are never read from it again.
+//
+struct _slog_ringmap {
+	struct _slog_ring	*ring;
+	unsigned			size;		// ints in ring->data[]
+	int					code;		// pulse code
+};
+
+extern	struct _slog_ringmap	*__slog_ring;
+extern	int					__slog_ring_coid;
+extern	unsigned			__slog_ring_tries;
+
+// Messages sent between looks for a ring we haven't got
+#define SLOG_RING_RETRY		256
+
+//
+// Map slogger's ring. Called with __slog_mux locked.
+//
+static void slogring_map(void)
+{
+	struct _slog_ringmap	*map;
+	struct _slog_ring		*ring;
+	struct stat				st;
+	unsigned				size;
+	int						fd, coid;
+
+	if((fd = shm_open(_SLOG_RING_NAME, O_RDWR, 0)) == -1)
+		return;
+	ring = MAP_FAILED;
+	if(fstat(fd, &st) == 0 && st.st_size > offsetof(struct _slog_ring, data))
+		ring = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(ring == MAP_FAILED)
+		return;
+
+	size = ring->size;
+	if(ring->magic != _SLOG_RING_MAGIC ||
+	   size <= _SLOG_MAXSIZE / sizeof(int) || (size & (size - 1)) ||
+	   size > (st.st_size - offsetof(struct _slog_ring, data)) / sizeof(ring->data[0]) ||
+	   (map = malloc(sizeof *map)) == NULL) {
+		munmap(ring, st.st_size);
+		return;
+	}
+	if((coid = ConnectAttach(0, ring->pid, ring->chid, _NTO_SIDE_CHANNEL, 0)) == -1) {
+		free(map);
+		munmap(ring, st.st_size);
+		return;
+	}
+	map->ring = ring;
+	map->size = size;
+	map->code = ring->code;
+	__slog_ring_coid = coid;
+	__cpu_membarrier();
+	__slog_ring = map;
+}
+
+//
+// We couldn't pulse slogger; it has gone away or we are a forked child.
+// Stop using the ring (it will be looked for again). It stays mapped
+// since other threads may still be appending to it.
+//
+static void slogring_lost(struct _slog_ringmap *map)
+{
+	if(pthread_mutex_lock(&__slog_mux) != EOK)
+		return;
+	if(__slog_ring == map) {
+		__slog_ring = NULL;
+		ConnectDetach(__slog_ring_coid);
+		__slog_ring_coid = -1;
+		__slog_ring_tries = 0;
+	}
+	pthread_mutex_unlock(&__slog_mux);
+}
+
+//
+// Append an event of nbytes from iov[0..nparts-1] to the ring. Returns
+// -1 if there is no room; the caller sends it as a message instead,
+// and slogger keeps it behind the events already reserved in the ring.
+//
+static int slogring_put(struct _slog_ringmap *map, iov_t iov[], int nparts, int nbytes)
+{
+	struct _slog_ring	*ring = map->ring;
+	volatile _Uint32t	*data = ring->data;
+	unsigned			mask = map->size - 1;
+	unsigned			room = map->size * sizeof(int);
+	unsigned			pos, n, off, len, k;
+	char				*src;
+	int					i;
+	struct timespec		ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	// Claim room for the control word and the event
+	n = (nbytes + sizeof(int) - 1) / sizeof(int);
+	do {
+		pos = ring->reserve;
+		if(pos + n + 1 - ring->consume > map->size) {
+			// Make sure it is a live slogger we are waiting for
+			if(MsgSendPulse(__slog_ring_coid, -1, map->code, 0) == -1)
+				slogring_lost(map);
+			return -1;
+		}
+	} while(_smp_cmpxchg(&ring->reserve, pos, pos + n + 1) != pos);
+	data[pos & mask] = _SLOG_RING_BUSY | n;
+
+	// Copy the event in, it may wrap round the end of the ring
+	off = ((pos + 1) & mask) * sizeof(int);
+	for(i = 0; i < nparts; i++) {
+		src = GETIOVBASE(&iov[i]);
+		for(len = GETIOVLEN(&iov[i]); len; len -= k) {
+			k = min(len, room - off);
+			memcpy((char *)data + off, src, k);
+			src += k;
+			if((off += k) == room)
+				off = 0;
+		}
+	}
+
+	// Patch in the time; slogger fills in the size
+	k = data[(pos + 1) & mask];
+	data[(pos + 1) & mask] = (k & ~0x00fffff0) | ((ts.tv_nsec / 1000000) << 4);
+	data[(pos + 3) & mask] = ts.tv_sec;
+
+	__cpu_membarrier();
+	data[pos & mask] = _SLOG_RING_DONE | n;
+
+	// Only the first to see a reader waiting sends the pulse
+	__cpu_membarrier();
+	if(ring->wakeup && atomic_clr_value(&ring->wakeup, 1)) {
+		if(MsgSendPulse(__slog_ring_coid, -1, map->code, 0) == -1)
+			slogring_lost(map);
+	}
+	return 0;
+}
+
 //
 // This function sends the message. It assumes that iov[0] is free
 // for its own use and that nparts starts at iov[1]. It saves copying
@@ -69,6 +219,19 @@ static ssize_t slogsend(iov_t iov[], int nparts, int nbytes)
 	} 						msg;
 	ssize_t					len;
 	int						tried_proc, ret;
+	struct _slog_ringmap	*ring;
+
+	if(_slogfd == SYSMGR_COID && nbytes >= _SLOG_HDRINTS * sizeof(int) && nbytes <= _SLOG_MAXSIZE) {
+		if((ring = __slog_ring) == NULL && (__slog_ring_tries++ % SLOG_RING_RETRY) == 0 &&
+		   pthread_mutex_lock(&__slog_mux) == EOK) {
+			if(__slog_ring == NULL)
+				slogring_map();
+			ring = __slog_ring;
+			pthread_mutex_unlock(&__slog_mux);
+		}
+		if(ring != NULL && slogring_put(ring, iov + 1, nparts, nbytes) == 0)
+			return (nbytes + sizeof(int) - 1) & ~(sizeof(int) - 1);
+	}
 
 	msg.wr.i.combine_len = sizeof msg.wr.i;
 	msg.wr.i.xtype = _IO_XTYPE_NONE;
@@ -50,3 +50,14 @@
 //
 int _slogfd = SYSMGR_COID;
 pthread_mutex_t	__slog_mux = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// slogger's shared memory ring (see slog.c) and the connection used to
+// pulse it. While it isn't mapped __slog_ring_tries counts the messages
+// sent so that it is looked for again now and then. The mappings (and
+// what slog.c keeps about each) are never freed, as another thread may
+// still be appending to one when it is given up.
+//
+struct _slog_ringmap	*__slog_ring;
+int					__slog_ring_coid = -1;
+unsigned			__slog_ring_tries;
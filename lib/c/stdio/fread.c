@@ -21,6 +21,17 @@ size_t (fread)(void *_Restrict ptr, size_t size, size_t nelem,
 			str->_Rend = str->_Rsave, str->_Rsave = 0;
 		if (str->_Next < str->_Rend)
 			;
+#ifdef __QNX__
+		else if (str->_Bend - str->_Buf <= ns)
+			{	/* at least a buffer full, read it in place */
+			size_t m = ns;
+
+			if (_Frprepv(str, s, &m) <= 0)
+				break;
+			s += m, ns -= m;
+			continue;
+			}
+#endif
 		else if (_Frprep(str) <= 0)
 			break;
 		 {	/* deliver as many as possible */
@@ -1,8 +1,42 @@
 /* fwrite function */
 #include <string.h>
+#ifdef __QNX__
+#include <sys/uio.h>
+#endif
 #include "xstdio.h"
+#include "yfuns.h"
 _STD_BEGIN
 
+#ifdef __QNX__
+static int _Fwritev(FILE *str, const char *s, size_t *pn)
+	{	/* write out the buffer and s[0 .. *pn-1] together */
+	struct iovec iov[2], *v = iov;
+	size_t ns = *pn;
+	int cnt = 2, n;
+
+	iov[0].iov_base = str->_Buf, iov[0].iov_len = str->_Next - str->_Buf;
+	iov[1].iov_base = (void *)s, iov[1].iov_len = ns;
+	if (iov[0].iov_len == 0)
+		++v, --cnt;
+	while (0 < cnt)
+		{	/* try to write the rest */
+		if ((n = writev(_FD_NO(str), v, cnt)) <= 0)
+			{	/* report error and fail, dropping the buffer as fflush does */
+			str->_Next = str->_Buf;
+			str->_Mode |= _MERR;
+			*pn = ns - iov[1].iov_len;
+			return (-1);
+			}
+		while (0 < cnt && v->iov_len <= (size_t)n)
+			n -= v->iov_len, v->iov_len = 0, ++v, --cnt;
+		if (0 < cnt)
+			v->iov_base = (char *)v->iov_base + n, v->iov_len -= n;
+		}
+	str->_Next = str->_Buf;
+	return (0);
+	}
+#endif
+
 size_t (fwrite)(const void *_Restrict ptr, size_t size,
 	size_t nelem, FILE *_Restrict str)
 	{	/* write to stream from array */
@@ -22,6 +56,18 @@ size_t (fwrite)(const void *_Restrict ptr, size_t size,
 			;
 		else if (_Fwprep(str) < 0)
 			break;
+#ifdef __QNX__
+		if ((str->_Mode & _MLBF) == 0 && str->_Bend - str->_Buf <= ns)
+			{	/* at least a buffer full, don't copy it */
+			size_t m = ns;
+			int err = _Fwritev(str, s, &m);
+
+			s += m, ns -= m;
+			if (err)
+				break;
+			continue;
+			}
+#endif
 		 {	/* copy in as many as possible */
 		char *s1 = str->_Mode & _MLBF
 			? (char *)memchr((void *)s, '\n', ns) : 0;
@@ -0,0 +1,203 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+
+/*
+ * Correctly rounded decimal digits of a double, for _Ldtob.
+ *
+ * x is m * 2^e with m < 2^53, so its integer part and fraction can
+ * be converted exactly: the integer part by repeated division by
+ * 10^9, the fraction by repeated multiplication by 10^9, taking the
+ * digits out of the top.  Values from about 2^-8 to 2^64 fit in a
+ * 64-bit word and never touch the long forms, which need at most
+ * NWORDS words.  The digits are rounded half to even, knowing whether
+ * anything after the rounding digit is non-zero, so the result is
+ * right for any precision up to _DTODIG significant digits.
+ */
+
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#include "xmath.h"
+#include "xstdio.h"
+_STD_BEGIN
+
+#define NDIG	9			/* decimal digits per word */
+#define TEN9	1000000000	/* 10^NDIG */
+#define FBITS	60			/* longest fraction done in 64 bits */
+#define NWORDS	((DBL_MAX_EXP - DBL_MIN_EXP + 2 * DBL_MANT_DIG + 31) / 32)
+#define NBUF	(DBL_MAX_10_EXP + _DTODIG + 3 * NDIG)
+
+static void put9(char *p, uint32_t v)
+	{	/* NDIG digits, leading zeros included */
+	int i;
+
+	for (i = NDIG; 0 <= --i; v /= 10)
+		p[i] = (char)('0' + v % 10);
+	}
+
+/*
+ * x > 0 and finite.  Round it to ndig places after the point if fixed
+ * is set, else to ndig significant digits, but to no more than _DTODIG
+ * significant digits.  The digits go in buf, without trailing zeros,
+ * their count is returned and *pxexp is the power of ten of the first.
+ */
+short _Dtodig(double x, int ndig, int fixed, char *buf, short *pxexp)
+	{
+	unsigned short *ps = (unsigned short *)(char *)&x;
+	uint32_t w[NWORDS];
+	char d[NBUF], c9[NDIG], *p;
+	uint64_t m, f = 0, mask = 0, c;
+	int e, s = 0, n = 0, lo = 0, nd = 0, nz = 0, need = 0, xexp = 0;
+	int i, j, sticky;
+
+	m = (uint64_t)(ps[_D0] & _DFRAC) << 48 | (uint64_t)ps[_D1] << 32
+		| (uint64_t)ps[_D2] << 16 | ps[_D3];
+	if ((e = (ps[_D0] & _DMASK) >> _DOFF) == 0)
+		e = 1;	/* subnormal */
+	else
+		m |= (uint64_t)1 << (DBL_MANT_DIG - 1);
+	for (e -= DBL_MAX_EXP + DBL_MANT_DIG - 2; (m & 1) == 0; m >>= 1)
+		++e;
+
+	if (0 <= e && e < 64 && (m >> (63 - e)) >> 1 == 0)
+		m <<= e, e = 0;	/* a small integer */
+	else if (0 <= e)
+		{	/* a large integer, m << e in w[] */
+		w[0] = (uint32_t)m, w[1] = (uint32_t)(m >> 32);
+		for (n = 2; w[n - 1] == 0; --n)
+			;
+		for (; 0 < e; e -= j)
+			{	/* shift up, at most 31 bits at a time */
+			j = e < 32 ? e : 31;
+			for (i = n, w[n] = 0; 0 < i; --i)
+				w[i] |= w[i - 1] >> (32 - j), w[i - 1] <<= j;
+			if (w[n] != 0)
+				++n;
+			}
+		for (p = &d[NBUF]; 0 < n; )
+			{	/* peel off NDIG digits at a time */
+			for (c = 0, i = n; 0 <= --i; c %= TEN9)
+				c = c << 32 | w[i], w[i] = (uint32_t)(c / TEN9);
+			for (; 0 < n && w[n - 1] == 0; --n)
+				;
+			put9(p -= NDIG, (uint32_t)c);
+			}
+		for (; *p == '0'; ++p)
+			;
+		memmove(d, p, nd = &d[NBUF] - p);
+		m = 0;
+		}
+	else if ((s = -e) <= FBITS)
+		{	/* integer part in m, fraction in f */
+		mask = ((uint64_t)1 << s) - 1;
+		f = m & mask;
+		m >>= s;
+		}
+	else
+		{	/* no integer part, fraction in w[], point at the top */
+		n = (s + 31) / 32;
+		memset(w, 0, n * sizeof w[0]);
+		if ((j = n * 32 - s) == 0)
+			w[0] = (uint32_t)m, w[1] = (uint32_t)(m >> 32);
+		else
+			w[0] = (uint32_t)(m << j), w[1] = (uint32_t)(m >> (32 - j)),
+				w[2] = (uint32_t)(m >> (64 - j));
+		m = 0;
+		for (lo = 0; w[lo] == 0; ++lo)
+			;
+		}
+
+	if (m != 0)
+		{	/* integer part fits in 64 bits */
+		for (p = &d[NBUF]; TEN9 <= m; m /= TEN9)
+			put9(p -= NDIG, (uint32_t)(m % TEN9));
+		for (i = (uint32_t)m; 0 < i; i /= 10)
+			*--p = (char)('0' + i % 10);
+		memmove(d, p, nd = &d[NBUF] - p);
+		}
+	if (0 < nd)
+		xexp = nd - 1;
+
+	for (;;)
+		{	/* fraction digits until there is one past the last */
+		if (0 < nd && (need = fixed ? ndig + xexp + 1 : ndig) > _DTODIG)
+			need = _DTODIG;
+		if (0 < nd && need < nd)
+			break;
+		if (s <= FBITS)
+			{	/* one digit from f */
+			if (f == 0)
+				break;
+			f *= 10;
+			c9[0] = (char)('0' + (f >> s));
+			f &= mask;
+			j = 1;
+			}
+		else
+			{	/* NDIG digits from w[] */
+			if (lo == n)
+				break;
+			for (c = 0, i = lo; i < n; ++i)
+				c += (uint64_t)w[i] * TEN9, w[i] = (uint32_t)c, c >>= 32;
+			for (; lo < n && w[lo] == 0; ++lo)
+				;
+			put9(c9, (uint32_t)c);
+			j = NDIG;
+			}
+		for (i = 0; i < j; ++i)
+			if (0 < nd || c9[i] != '0')
+				{	/* a significant digit */
+				if (nd == 0)
+					xexp = -nz - 1;
+				d[nd++] = c9[i];
+				}
+			else if (ndig < ++nz && fixed)
+				{	/* less than 10^-(ndig+1), rounds to zero */
+				*pxexp = (short)-nz;
+				return (0);
+				}
+		}
+
+	sticky = s <= FBITS ? f != 0 : lo < n;
+	for (i = need + 1; i < nd; ++i)
+		if (d[i] != '0')
+			sticky = 1;
+	for (; nd <= need; )
+		d[nd++] = '0';
+	if ('5' < d[need] || (d[need] == '5'
+		&& (sticky || (0 < need && ((d[need - 1] - '0') & 1) != 0))))
+		{	/* round up */
+		for (i = need; 0 < i && d[i - 1] == '9'; --i)
+			;
+		if (i == 0)
+			d[0] = '1', n = 1, ++xexp;
+		else
+			++d[i - 1], n = i;
+		}
+	else
+		for (n = need; 0 < n && d[n - 1] == '0'; --n)
+			;
+	memcpy(buf, d, n);
+	*pxexp = (short)xexp;
+	return ((short)n);
+	}
+_STD_END
+
+__SRCVERSION("xdtodig.c $Rev: 153052 $");
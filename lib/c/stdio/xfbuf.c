@@ -1,16 +1,23 @@
 /* _Fbuf function */
 #include <stdlib.h>
 #include <errno.h>
+#include <sys/stat.h>
 #include "xstdio.h"
 _STD_BEGIN
 
 int _Fbuf(FILE *str)
 	{	/* allocate buffer */
 	int			save_errno = errno;
+	size_t		size = BUFSIZ;
+	struct stat	st;
 
 	if (isatty(fileno(str)))
 		str->_Mode |= _MISTTY | _MLBF;
-	if ((str->_Buf = (unsigned char *)malloc(BUFSIZ)) == 0)
+	else if (fstat(fileno(str), &st) == 0 && size < st.st_blksize)
+		{	/* a block of the file at a time */
+		size = st.st_blksize < _FBUFMAX ? st.st_blksize : _FBUFMAX;
+		}
+	if ((str->_Buf = (unsigned char *)malloc(size)) == 0)
 		{	/* use 1-char _Cbuf */
 		str->_Buf = &str->_Cbuf;
 		str->_Bend = str->_Buf + 1;
@@ -18,7 +25,7 @@ int _Fbuf(FILE *str)
 	else
 		{	/* use allocated buffer */
 		str->_Mode |= _MALBUF;
-		str->_Bend = str->_Buf + BUFSIZ;
+		str->_Bend = str->_Buf + size;
 		}
 	str->_Next = str->_Buf;
 	str->_Rend = str->_Buf;
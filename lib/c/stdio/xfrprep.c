@@ -3,14 +3,25 @@
 
 #ifdef __QNX__
 #include <errno.h>
+#include <sys/uio.h>
 #endif
 
 #include "xstdio.h"
 #include "yfuns.h"
 _STD_BEGIN
 
+#ifdef __QNX__
 int _Frprep(FILE *str)
 	{	/* prepare stream for reading */
+	return (_Frprepv(str, 0, 0));
+	}
+
+int _Frprepv(FILE *str, unsigned char *buf, size_t *pn)
+	{	/* prepare stream for reading, first *pn bytes into buf */
+#else
+int _Frprep(FILE *str)
+	{	/* prepare stream for reading */
+#endif
 
  #ifdef _WIN32_WCE
 	if (str->_Handle == 0
@@ -66,7 +77,31 @@ int _Frprep(FILE *str)
 		}
 #endif
 	 {	/* try to read into buffer */
+#ifdef __QNX__
+	int n;
+
+	if (pn == 0 || *pn == 0)
+		n = _Fread(str, str->_Buf, str->_Bend - str->_Buf);
+	else
+		{	/* caller's array, then whatever fits in the buffer */
+		struct iovec iov[2];
+		int niov = (str->_Mode & _MNBF) != 0 ? 1 : 2;	/* unbuffered, no read ahead */
+
+		iov[0].iov_base = buf, iov[0].iov_len = *pn;
+		iov[1].iov_base = str->_Buf, iov[1].iov_len = str->_Bend - str->_Buf;
+		if (0 < (n = readv(_FD_NO(str), iov, niov)))
+			{	/* the caller's share doesn't stay in the buffer */
+			if ((size_t)n < *pn)
+				*pn = n;
+			n -= *pn;
+			str->_Mode |= _MREAD | _MBYTE;
+			str->_Rend += n;
+			return (1);
+			}
+		}
+#else
 	int n = _Fread(str, str->_Buf, str->_Bend - str->_Buf);
+#endif
 
 	if (n < 0)
 		{	/* report error and fail */
@@ -7,11 +7,20 @@
 #include "xstdio.h"
 _STD_BEGIN
 
+#ifdef __QNX__
+#define MAXDIG	(_DECWORDS * 9 + 1)	/* all that _Stoflt keeps, and one more */
+#else
+#define MAXDIG	_MAX_SIG_DIG
+#endif
+
 int _Getfloat(_Sft *px, void *pans)
 	{	/* get a floating point value for _Scanf */
-	char ac[_MAX_EXP_DIG + _MAX_SIG_DIG + 16], *p, seen;
+	char ac[_MAX_EXP_DIG + MAXDIG + 16], *p, seen;
 	int ch, nsig;
 	int dlen, pten;
+#ifdef __QNX__
+	int more = 0;
+#endif
 	static const char digits[] = "0123456789abcdefABCDEF";
 
 	px->nget = 0 < px->width ? px->width : INT_MAX;
@@ -106,10 +115,14 @@ int _Getfloat(_Sft *px, void *pans)
 			*p++ = '0';	/* put one back */
 		for (nsig = 0; ch != EOF && memchr(&digits[0], ch, dlen);
 			ch = GETN(px), seen = 1)
-			if (nsig < _MAX_SIG_DIG)
+			if (nsig < MAXDIG)
 				*p++ = ch, ++nsig;
 			else
+#ifdef __QNX__
+				more |= ch != '0', ++pten;
+#else
 				++pten;
+#endif
 		if (ch == localeconv()->decimal_point[0])
 			*p++ = ch, ch = GETN(px);
 		if (nsig == 0)
@@ -121,8 +134,20 @@ int _Getfloat(_Sft *px, void *pans)
 			}
 		for (; ch != EOF && memchr(&digits[0], ch, dlen);
 			ch = GETN(px), seen = 1)
-			if (nsig < _MAX_SIG_DIG)
+			if (nsig < MAXDIG)
 				*p++ = ch, ++nsig;
+#ifdef __QNX__
+			else
+				more |= ch != '0';
+		if (more && dlen == 10)
+			{	/* keep the last digit nonzero, see _Stoflt */
+			char *q = p[-1] == localeconv()->decimal_point[0]
+				? p - 2 : p - 1;
+
+			if (*q == '0')
+				*q = '1';
+			}
+#endif
 		if (seen && (dlen == 10 && (ch == 'e' || ch == 'E')
 			|| dlen != 10 && (ch == 'p' || ch == 'P')))
 			{	/* parse exponent */
@@ -146,6 +171,30 @@ int _Getfloat(_Sft *px, void *pans)
 		{	/* convert and store */
 		long double ldval;
 
+ #ifdef __QNX__
+		if (dlen == 10 && px->qual == 'l')
+			{	/* straight to double, rounding once */
+			double dval = _Stod(ac, 0, pten);
+
+			px->stored = 1;
+			if (pans != 0)
+				*(double *)pans = dval;
+			else
+				*va_arg(px->ap, double *) = dval;
+			return (1);
+			}
+		else if (dlen == 10 && px->qual != 'L')
+			{	/* straight to float, rounding once */
+			float fval = _Stof(ac, 0, pten);
+
+			px->stored = 1;
+			if (pans != 0)
+				*(float *)pans = fval;
+			else
+				*va_arg(px->ap, float *) = fval;
+			return (1);
+			}
+ #endif /* __QNX__ */
 		if (dlen <= 10)
 			ldval = _Stold(ac, 0, pten);
 		else
@@ -127,6 +127,15 @@ void _Ldtob(_Pft *px, char code)
 		if (px->prec < 0)
 			px->prec = nsig - 1;
 		}
+ #ifdef __QNX__
+	else if (px->qual != 'L' || LDBL_MANT_DIG == DBL_MANT_DIG)
+		{	/* 0 < |x|, a double, correctly rounded digits */
+		const int fixed = code == 'f' || code == 'F';
+
+		nsig = _Dtodig(ldval < 0 ? -ldval : ldval, fixed || code == 'g'
+			|| code == 'G' ? px->prec : px->prec + 1, fixed, ac, &xexp);
+		}
+ #endif /* __QNX__ */
 	else
 		{	/* 0 < |x|, generate decimal fraction and exponent */
 		 {	/* scale ldval to ~~10^(NDIG/2) */
@@ -4,13 +4,22 @@
 #include "xwstdio.h"
 _STD_BEGIN
 
+#ifdef __QNX__
+#define MAXDIG	(_DECWORDS * 9 + 1)	/* all that _Stoflt keeps, and one more */
+#else
+#define MAXDIG	_MAX_SIG_DIG
+#endif
+
 int _WGetfloat(_WSft *px, void *pans)
 	{	/* get a floating point value for _WScanf */
-	wchar_t ac[_MAX_EXP_DIG + _MAX_SIG_DIG + 16], *p;
+	wchar_t ac[_MAX_EXP_DIG + MAXDIG + 16], *p;
 	wint_t ch;
 	char seen;
 	int nsig;
 	int dlen, pten;
+#ifdef __QNX__
+	int more = 0;
+#endif
 	static const wchar_t digits[] = {
 		L'0', L'1', L'2', L'3',
 		L'4', L'5', L'6', L'7',
@@ -111,10 +120,14 @@ int _WGetfloat(_WSft *px, void *pans)
 			*p++ = L'0';	/* put one back */
 		for (nsig = 0; ch != WEOF && wmemchr(&digits[0], ch, dlen);
 			ch = WGETN(px), seen = 1)
-			if (nsig < _MAX_SIG_DIG)
+			if (nsig < MAXDIG)
 				*p++ = ch, ++nsig;
 			else
+#ifdef __QNX__
+				more |= ch != L'0', ++pten;
+#else
 				++pten;
+#endif
 		if (_Wctob(ch) == localeconv()->decimal_point[0])
 			*p++ = ch, ch = WGETN(px);
 		if (nsig == 0)
@@ -126,8 +139,20 @@ int _WGetfloat(_WSft *px, void *pans)
 			}
 		for (; ch != WEOF && wmemchr(&digits[0], ch, dlen);
 			ch = WGETN(px), seen = 1)
-			if (nsig < _MAX_SIG_DIG)
+			if (nsig < MAXDIG)
 				*p++ = ch, ++nsig;
+#ifdef __QNX__
+			else
+				more |= ch != L'0';
+		if (more && dlen == 10)
+			{	/* keep the last digit nonzero, see _Stoflt */
+			wchar_t *q = _Wctob(p[-1]) == localeconv()->decimal_point[0]
+				? p - 2 : p - 1;
+
+			if (*q == L'0')
+				*q = L'1';
+			}
+#endif
 		if (seen && (dlen == 10 && (ch == L'e' || ch == L'E')
 			|| dlen != 10 && (ch == L'p' || ch == L'P')))
 			{	/* parse exponent */
@@ -151,6 +176,30 @@ int _WGetfloat(_WSft *px, void *pans)
 		{	/* convert and store */
 		long double ldval;
 
+ #ifdef __QNX__
+		if (dlen == 10 && px->qual == L'l')
+			{	/* straight to double, rounding once */
+			double dval = _WStod(ac, 0, pten);
+
+			px->stored = 1;
+			if (pans != 0)
+				*(double *)pans = dval;
+			else
+				*va_arg(px->ap, double *) = dval;
+			return (1);
+			}
+		else if (dlen == 10 && px->qual != L'L')
+			{	/* straight to float, rounding once */
+			float fval = _WStof(ac, 0, pten);
+
+			px->stored = 1;
+			if (pans != 0)
+				*(float *)pans = fval;
+			else
+				*va_arg(px->ap, float *) = fval;
+			return (1);
+			}
+ #endif /* __QNX__ */
 		if (dlen <= 10)
 			ldval = _WStold(ac, 0, pten);
 		else
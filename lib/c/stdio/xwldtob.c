@@ -127,6 +127,19 @@ void _WLdtob(_WPft *px, wchar_t code)
 		if (px->prec < 0)
 			px->prec = nsig - 1;
 		}
+ #ifdef __QNX__
+	else if (px->qual != L'L' || LDBL_MANT_DIG == DBL_MANT_DIG)
+		{	/* 0 < |x|, a double, correctly rounded digits */
+		const int fixed = code == L'f' || code == L'F';
+		char digs[_DTODIG];
+		int n;
+
+		nsig = _Dtodig(ldval < 0 ? -ldval : ldval, fixed || code == L'g'
+			|| code == L'G' ? px->prec : px->prec + 1, fixed, digs, &xexp);
+		for (n = 0; n < nsig; ++n)
+			ac[n] = (wchar_t)(digs[n] - '0' + L'0');
+		}
+ #endif /* __QNX__ */
 	else
 		{	/* 0 < |x|, generate decimal fraction and exponent */
 		 {	/* scale ldval to ~~10^(NDIG/2) */
@@ -34,7 +34,11 @@ _STD_BEGIN
 
 #define BASE	10	/* decimal */
 #define NDIG	9	/* decimal digits per long element */
+#ifdef __QNX__
+#define MAXSIG	(_DECWORDS * NDIG)	/* maximum significant digits to keep */
+#else
 #define MAXSIG	(5 * NDIG)	/* maximum significant digits to keep */
+#endif
 
 int _WStoflt(const wchar_t *s0, const wchar_t *s, wchar_t **endptr,
 	long lo[], int maxsig)
@@ -43,6 +47,9 @@ int _WStoflt(const wchar_t *s0, const wchar_t *s, wchar_t **endptr,
 	int nsig;	/* number of significant digits seen */
 	int seen;	/* any valid field characters seen */
 	int word = 0;	/* current long word to fill */
+#ifdef __QNX__
+	int more = 0;	/* nonzero digits dropped after the rounding digit */
+#endif
 
 	maxsig *= NDIG;	/* convert word count to digit count */
 	if (MAXSIG < maxsig)
@@ -62,7 +69,14 @@ int _WStoflt(const wchar_t *s0, const wchar_t *s, wchar_t **endptr,
 #endif			
 			buf[nsig++] = (char)(*s - L'0');	/* accumulate a digit */
 		else
+#ifdef __QNX__
+			{	/* too many digits, just scale exponent */
+			++lo[0];
+			more |= *s != L'0';
+			}
+#else
 			++lo[0];	/* too many digits, just scale exponent */
+#endif
 
 	if (*s == btowc(localeconv()->decimal_point[0]))
 		++s;
@@ -80,11 +94,26 @@ int _WStoflt(const wchar_t *s0, const wchar_t *s, wchar_t **endptr,
 			buf[nsig++] = (char)(*s - L'0');
 			--lo[0];
 			}
+#ifdef __QNX__
+		else
+			more |= *s != L'0';
+#endif
 
 	if (maxsig < nsig)
 		{	/* discard excess digit after rounding up */
 		unsigned int ms = maxsig;	/* to quiet warnings */
 		
+#ifdef __QNX__
+		if (MAXSIG <= maxsig)
+			{	/* for _Dectod only zero or not matters: no halfway point
+				   between two doubles has more than 767 digits, so a
+				   nonzero last digit keeps the value on the same side of
+				   all of them */
+			if ((buf[ms] != 0 || more) && buf[ms - 1] == 0)
+				buf[ms - 1] = 1;
+			}
+		else
+#endif
 		if (BASE / 2 <= buf[ms])
 			++buf[ms - 1];	/* okay if digit becomes BASE */
 		nsig = maxsig;
@@ -31,6 +31,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#if !defined(__MINGW32__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define HAVE_MMAP
+#endif
 #include <libelf_int.h>
 
 //
@@ -51,6 +56,19 @@ static int _elf_read(Elf *elf, void *buf, off_t offset, size_t bytes) {
 		return 0;
 	}
 
+	if(elf->e_map) {
+		off_t		pos = elf->e_offset + offset;
+
+		if(pos < 0 || pos >= elf->e_mapsize) {
+			return 0;
+		}
+		if(bytes > elf->e_mapsize - pos) {
+			bytes = elf->e_mapsize - pos;
+		}
+		memcpy(buf, elf->e_map + pos, bytes);
+		return bytes;
+	}
+
 	if(elf->e_curroffset != (elf->e_offset + offset)) {
 		if(lseek(elf->e_fd, elf->e_offset + offset, SEEK_SET) < 0) {
 			return -1;
@@ -271,11 +289,35 @@ static Elf *_elf_create(int fd) {
 	return elf;
 }
 
+/*
+ * Files opened ELF_C_READ are mapped whole, privately so that the
+ * byte swapping elf_getdata() does in place stays in this process.
+ * Section data then points into the map instead of being read into
+ * a malloc'd copy.  If the map fails we fall back to read().
+ */
+static void _elf_map(Elf *elf) {
+#ifdef HAVE_MMAP
+	struct stat		st;
+	void			*map;
+
+	if(fstat(elf->e_fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+		return;
+	}
+	if((map = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, elf->e_fd, 0)) == MAP_FAILED) {
+		return;
+	}
+	elf->e_map = map;
+	elf->e_mapsize = st.st_size;
+#endif
+}
+
 static int _elf_destroy(Elf *elf) {
 	if(!elf || elf->e_refcnt > 0) {
 		return -1;
 	}
 
+	_elf_index_free(elf);
+
 	if(elf->e_rawfile) {
 		free(elf->e_rawfile);
 	}
@@ -296,6 +338,12 @@ static int _elf_destroy(Elf *elf) {
 		if (elf->e_arlntp) {
 			free (elf->e_arlntp);
 		}
+#ifdef HAVE_MMAP
+		// archive members share the archive's map
+		if(elf->e_map) {
+			munmap(elf->e_map, elf->e_mapsize);
+		}
+#endif
 	}
 
 	if(elf->e_arsymp) {
@@ -423,6 +471,9 @@ Elf *elf_begin(int fd, Elf_Cmd cmd, Elf *ref) {
 			if(!(elf = _elf_create(fd))) {
 				return 0;
 			}
+			if(cmd == ELF_C_READ) {
+				_elf_map(elf);
+			}
 
 			if(!_elf_is_archive(elf)) {
 				char		*e_ident;
@@ -441,6 +492,8 @@ Elf *elf_begin(int fd, Elf_Cmd cmd, Elf *ref) {
 
 				elf->e_archive = ref;
 				elf->e_offset = ref->e_offset;
+				elf->e_map = ref->e_map;
+				elf->e_mapsize = ref->e_mapsize;
 
 				if(!(arhdr = elf_getarhdr(elf))) {
 					elf_end(elf);
@@ -1156,6 +1209,7 @@ Elf_Data *elf_getdata(Elf_Scn *scn, Elf_Data *data) {
 		if(scn->s_fragments == 0) {
 			Elf32_Ehdr				*ehdr;
 			Elf32_Shdr				shdr;
+			char					*mapped;
 
 			if ((ehdr = elf->e_ehdrp) == NULL) {
 				ehdr = elf->e_ehdrp = elf32_getehdr (elf);
@@ -1171,8 +1225,29 @@ Elf_Data *elf_getdata(Elf_Scn *scn, Elf_Data *data) {
 					if(dp = _elf32_newdata(scn, shdr.sh_size)) {
 						_elf_read(scn->s_elf, dp->d_buf, shdr.sh_offset, shdr.sh_size);
 #else
-					if(dp = _elf32_newdata(scn, shdr.sh_type == SHT_NOBITS ? 0 : shdr.sh_size)) {
-						if(shdr.sh_type == SHT_NOBITS) {
+					mapped = 0;
+
+					/*
+					 * Use the map directly when the section is in it and
+					 * aligned well enough to be accessed as words.  Archive
+					 * members may be opened more than once, so they only
+					 * share the map when nothing is swapped in place.
+					 */
+					if(elf->e_map && shdr.sh_type != SHT_NOBITS &&
+							(elf->e_archive == NULL || !elf->xlat) &&
+							elf->e_offset + shdr.sh_offset <= elf->e_mapsize &&
+							shdr.sh_size <= elf->e_mapsize - (elf->e_offset + shdr.sh_offset)) {
+						mapped = elf->e_map + elf->e_offset + shdr.sh_offset;
+						if((unsigned long)mapped & (sizeof(Elf32_Word) - 1)) {
+							mapped = 0;
+						}
+					}
+
+					if(dp = _elf32_newdata(scn, (shdr.sh_type == SHT_NOBITS || mapped) ? 0 : shdr.sh_size)) {
+						if(mapped) {
+							dp->d_buf = mapped;
+							dp->d_size = shdr.sh_size;
+						} else if(shdr.sh_type == SHT_NOBITS) {
 							dp->d_size = shdr.sh_size;
 						} else {
 							_elf_read(scn->s_elf, dp->d_buf, shdr.sh_offset, shdr.sh_size);
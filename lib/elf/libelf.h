@@ -146,6 +146,10 @@ unsigned elf_flagscn(Elf_Scn *scn, Elf_Cmd cmd, unsigned flags);
 unsigned elf_flagshdr(Elf_Scn *scn, Elf_Cmd cmd, unsigned flags);
 unsigned long elf_hash(const char *name);
 char *elf_strptr(Elf *elf, size_t section, size_t offset);
+Elf_Scn *elf_findscn(Elf *elf, const char *name);
+Elf32_Sym *elf32_findsym(Elf *elf, const char *name);
+Elf32_Sym *elf32_addrsym(Elf *elf, Elf32_Addr addr, Elf32_Addr *offset);
+char *elf32_symname(Elf *elf, const Elf32_Sym *sym);
 Elf_Data *elf32_xlatetof(Elf_Data *dat, const Elf_Data *src, unsigned encode);
 Elf_Data *elf32_xlatetom(Elf_Data *dat, const Elf_Data *src, unsigned encode);
 
@@ -0,0 +1,500 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+
+/*
+ * Section and symbol lookup.
+ *
+ * The tables are built the first time they are needed and kept until
+ * elf_end(), so looking up many names or addresses in one object costs
+ * a hash probe or a binary search each instead of a walk of the whole
+ * section header or symbol table.
+ *
+ * Symbols come from .symtab, or .dynsym if the object is stripped.
+ * Names are looked up through the object's own SHT_HASH or SHT_GNU_HASH
+ * section when there is one for that table (and the object is in the
+ * host's byte order, since hash sections are not swapped), otherwise
+ * through a table built here.
+ */
+
+#include <lib/compat.h>
+
+#ifdef _NTO_HDR_DIR_
+#define _PLATFORM(x)	x
+#define PLATFORM(x)		<_PLATFORM(x)/sys/platform.h>
+#include PLATFORM(_NTO_HDR_DIR_)
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <libelf_int.h>
+
+#ifndef SHT_GNU_HASH
+#define SHT_GNU_HASH	0x6ffffff6
+#endif
+#ifndef STN_UNDEF
+#define STN_UNDEF		0
+#endif
+
+typedef struct {
+	Elf32_Addr		value;
+	Elf32_Word		ndx;
+} Elf_Addr_Ent;
+
+struct Elf_Index {
+	/* sections: open addressed on elf_hash(name), holds index + 1 */
+	unsigned		i_scnmask;
+	Elf32_Word		*i_scntab;
+
+	/* symbols */
+	int				i_symdone;
+	Elf32_Sym		*i_syms;
+	unsigned		i_nsyms;
+	char			*i_strs;
+	size_t			i_strsize;
+
+	Elf32_Word		*i_hash;		/* SHT_HASH of i_syms */
+	Elf32_Word		*i_gnuhash;		/* SHT_GNU_HASH of i_syms */
+	size_t			i_gnuhashsize;
+
+	unsigned		i_namemask;		/* own name table, holds symbol index */
+	Elf32_Word		*i_nametab;
+
+	int				i_addrdone;
+	Elf_Addr_Ent	*i_addrtab;		/* sorted by value */
+	unsigned		i_naddr;
+};
+
+static struct Elf_Index *_elf_index(Elf *elf) {
+	if(!elf) {
+		return 0;
+	}
+	if(!elf->e_index) {
+		elf->e_index = calloc(1, sizeof *elf->e_index);
+	}
+	return elf->e_index;
+}
+
+void _elf_index_free(Elf *elf) {
+	struct Elf_Index	*idx = elf->e_index;
+
+	if(idx) {
+		free(idx->i_scntab);
+		free(idx->i_nametab);
+		free(idx->i_addrtab);
+		free(idx);
+		elf->e_index = 0;
+	}
+}
+
+static unsigned _elf_tabsize(unsigned n) {
+	unsigned		size = 16;
+
+	while(size < 2 * n) {
+		size <<= 1;
+	}
+	return size;
+}
+
+static Elf32_Shdr *_elf_shdr(Elf *elf, size_t ndx) {
+	Elf_Scn				*scn;
+
+	return (scn = elf_getscn(elf, ndx)) ? elf32_getshdr(scn) : 0;
+}
+
+static const char *_elf_scnname(Elf *elf, Elf32_Ehdr *ehdr, size_t ndx) {
+	Elf32_Shdr			*shdr;
+
+	if(!(shdr = _elf_shdr(elf, ndx))) {
+		return 0;
+	}
+	return elf_strptr(elf, ehdr->e_shstrndx, shdr->sh_name);
+}
+
+static int _elf_build_scntab(Elf *elf, struct Elf_Index *idx) {
+	Elf32_Ehdr			*ehdr;
+	const char			*name, *other;
+	unsigned			i, h;
+
+	if(!(ehdr = elf32_getehdr(elf)) || ehdr->e_shstrndx == SHN_UNDEF ||
+			ehdr->e_shstrndx >= ehdr->e_shnum) {
+		return -1;
+	}
+	idx->i_scnmask = _elf_tabsize(ehdr->e_shnum) - 1;
+	if(!(idx->i_scntab = calloc(idx->i_scnmask + 1, sizeof *idx->i_scntab))) {
+		return -1;
+	}
+	for(i = 1; i < ehdr->e_shnum; i++) {
+		if(!(name = _elf_scnname(elf, ehdr, i))) {
+			continue;
+		}
+		for(h = elf_hash(name) & idx->i_scnmask; idx->i_scntab[h]; h = (h + 1) & idx->i_scnmask) {
+			other = _elf_scnname(elf, ehdr, idx->i_scntab[h] - 1);
+			if(other && !strcmp(name, other)) {
+				break;
+			}
+		}
+		if(!idx->i_scntab[h]) {
+			idx->i_scntab[h] = i + 1;
+		}
+	}
+	return 0;
+}
+
+Elf_Scn *elf_findscn(Elf *elf, const char *name) {
+	struct Elf_Index	*idx;
+	Elf32_Ehdr			*ehdr;
+	const char			*other;
+	unsigned			h;
+
+	if(!name || !(idx = _elf_index(elf))) {
+		return 0;
+	}
+	if(!idx->i_scntab && _elf_build_scntab(elf, idx) == -1) {
+		return 0;
+	}
+	ehdr = elf32_getehdr(elf);
+	for(h = elf_hash(name) & idx->i_scnmask; idx->i_scntab[h]; h = (h + 1) & idx->i_scnmask) {
+		other = _elf_scnname(elf, ehdr, idx->i_scntab[h] - 1);
+		if(other && !strcmp(name, other)) {
+			return elf_getscn(elf, idx->i_scntab[h] - 1);
+		}
+	}
+	return 0;
+}
+
+static char *_elf_symname(struct Elf_Index *idx, const Elf32_Sym *sym) {
+	if(sym->st_name == 0 || sym->st_name >= idx->i_strsize) {
+		return 0;
+	}
+	return idx->i_strs + sym->st_name;
+}
+
+/*
+ * How good a match a symbol is when several have the same name or
+ * value: defined global, then weak, then local, then undefined.
+ */
+static int _elf_symrank(const Elf32_Sym *sym) {
+	if(sym->st_shndx == SHN_UNDEF) {
+		return 0;
+	}
+	switch(ELF32_ST_BIND(sym->st_info)) {
+	case STB_GLOBAL:
+		return 3;
+	case STB_WEAK:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+static Elf_Data *_elf_scndata(Elf *elf, size_t ndx, Elf32_Shdr **shdrp) {
+	Elf_Scn				*scn;
+
+	if(!(scn = elf_getscn(elf, ndx)) || !(*shdrp = elf32_getshdr(scn))) {
+		return 0;
+	}
+	return elf_getdata(scn, 0);
+}
+
+static int _elf_build_syms(Elf *elf, struct Elf_Index *idx) {
+	Elf32_Ehdr			*ehdr;
+	Elf32_Shdr			*shdr;
+	Elf_Data			*data;
+	unsigned			i, symndx = 0;
+
+	idx->i_symdone = 1;
+	if(!(ehdr = elf32_getehdr(elf))) {
+		return -1;
+	}
+	for(i = 1; i < ehdr->e_shnum; i++) {
+		if((shdr = _elf_shdr(elf, i))) {
+			if(shdr->sh_type == SHT_SYMTAB) {
+				symndx = i;
+				break;
+			}
+			if(shdr->sh_type == SHT_DYNSYM && !symndx) {
+				symndx = i;
+			}
+		}
+	}
+	if(!symndx || !(data = _elf_scndata(elf, symndx, &shdr)) || !data->d_buf) {
+		return -1;
+	}
+	idx->i_syms = data->d_buf;
+	idx->i_nsyms = data->d_size / sizeof(Elf32_Sym);
+	if(!(data = _elf_scndata(elf, shdr->sh_link, &shdr)) || !data->d_buf ||
+			shdr->sh_type != SHT_STRTAB) {
+		idx->i_nsyms = 0;
+		return -1;
+	}
+	idx->i_strs = data->d_buf;
+	idx->i_strsize = data->d_size;
+
+	if(elf->xlat) {
+		return 0;
+	}
+	for(i = 1; i < ehdr->e_shnum; i++) {
+		if((shdr = _elf_shdr(elf, i)) && shdr->sh_link == symndx &&
+				(shdr->sh_type == SHT_HASH || shdr->sh_type == SHT_GNU_HASH)) {
+			if(!(data = _elf_scndata(elf, i, &shdr)) || !data->d_buf) {
+				continue;
+			}
+			if(shdr->sh_type == SHT_HASH && data->d_size >= 2 * sizeof(Elf32_Word)) {
+				Elf32_Word		*h = data->d_buf;
+
+				if(h[0] && (2 + h[0] + h[1]) * sizeof(Elf32_Word) <= data->d_size) {
+					idx->i_hash = h;
+				}
+			} else if(shdr->sh_type == SHT_GNU_HASH && data->d_size >= 4 * sizeof(Elf32_Word)) {
+				Elf32_Word		*h = data->d_buf;
+
+				if(h[0] && h[2] && (4 + h[2] + h[0]) * sizeof(Elf32_Word) <= data->d_size) {
+					idx->i_gnuhash = h;
+					idx->i_gnuhashsize = data->d_size / sizeof(Elf32_Word);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static int _elf_build_nametab(struct Elf_Index *idx) {
+	const char			*name, *other;
+	unsigned			i, h;
+
+	idx->i_namemask = _elf_tabsize(idx->i_nsyms) - 1;
+	if(!(idx->i_nametab = calloc(idx->i_namemask + 1, sizeof *idx->i_nametab))) {
+		return -1;
+	}
+	for(i = 1; i < idx->i_nsyms; i++) {
+		if(!(name = _elf_symname(idx, idx->i_syms + i))) {
+			continue;
+		}
+		for(h = elf_hash(name) & idx->i_namemask; idx->i_nametab[h]; h = (h + 1) & idx->i_namemask) {
+			other = _elf_symname(idx, idx->i_syms + idx->i_nametab[h]);
+			if(!strcmp(name, other)) {
+				break;
+			}
+		}
+		if(!idx->i_nametab[h] ||
+				_elf_symrank(idx->i_syms + i) > _elf_symrank(idx->i_syms + idx->i_nametab[h])) {
+			idx->i_nametab[h] = i;
+		}
+	}
+	return 0;
+}
+
+static Elf32_Sym *_elf_hash_lookup(struct Elf_Index *idx, const char *name) {
+	Elf32_Word			*h = idx->i_hash;
+	Elf32_Word			nbucket = h[0], nchain = h[1];
+	Elf32_Word			*chain = h + 2 + nbucket;
+	Elf32_Sym			*best = 0;
+	const char			*other;
+	unsigned			i, n;
+
+	for(i = h[2 + elf_hash(name) % nbucket], n = 0; i != STN_UNDEF && i < nchain && i < idx->i_nsyms && n < nchain; i = chain[i], n++) {
+		if((other = _elf_symname(idx, idx->i_syms + i)) && !strcmp(name, other) &&
+				(!best || _elf_symrank(idx->i_syms + i) > _elf_symrank(best))) {
+			best = idx->i_syms + i;
+		}
+	}
+	return best;
+}
+
+static Elf32_Sym *_elf_gnuhash_lookup(struct Elf_Index *idx, const char *name) {
+	Elf32_Word			*h = idx->i_gnuhash;
+	Elf32_Word			nbucket = h[0], symoffset = h[1], nbloom = h[2], shift = h[3];
+	Elf32_Word			*bloom = h + 4, *bucket = bloom + nbloom, *chain = bucket + nbucket;
+	Elf32_Word			hash = 5381, word, hv;
+	Elf32_Sym			*best = 0;
+	const unsigned char	*p;
+	const char			*other;
+	unsigned			i;
+
+	for(p = (const unsigned char *)name; *p; p++) {
+		hash = hash * 33 + *p;
+	}
+	word = bloom[(hash / 32) % nbloom];
+	if(!((word >> (hash % 32)) & (word >> ((hash >> shift) % 32)) & 1)) {
+		return 0;
+	}
+	if((i = bucket[hash % nbucket]) < symoffset) {
+		return 0;
+	}
+	for(; i < idx->i_nsyms && (chain + i - symoffset) < h + idx->i_gnuhashsize; i++) {
+		hv = chain[i - symoffset];
+		if((hv | 1) == (hash | 1) && (other = _elf_symname(idx, idx->i_syms + i)) &&
+				!strcmp(name, other) && (!best || _elf_symrank(idx->i_syms + i) > _elf_symrank(best))) {
+			best = idx->i_syms + i;
+		}
+		if(hv & 1) {
+			break;
+		}
+	}
+	return best;
+}
+
+Elf32_Sym *elf32_findsym(Elf *elf, const char *name) {
+	struct Elf_Index	*idx;
+	Elf32_Sym			*sym;
+	const char			*other;
+	unsigned			h;
+
+	if(!name || !*name || !(idx = _elf_index(elf))) {
+		return 0;
+	}
+	if(!idx->i_symdone) {
+		_elf_build_syms(elf, idx);
+	}
+	if(!idx->i_nsyms) {
+		return 0;
+	}
+
+	/* the GNU table only has defined symbols, fall back for the others */
+	if(idx->i_gnuhash && (sym = _elf_gnuhash_lookup(idx, name))) {
+		return sym;
+	}
+	if(idx->i_hash) {
+		return _elf_hash_lookup(idx, name);
+	}
+
+	if(!idx->i_nametab && _elf_build_nametab(idx) == -1) {
+		return 0;
+	}
+	for(h = elf_hash(name) & idx->i_namemask; idx->i_nametab[h]; h = (h + 1) & idx->i_namemask) {
+		sym = idx->i_syms + idx->i_nametab[h];
+		if((other = _elf_symname(idx, sym)) && !strcmp(name, other)) {
+			return sym;
+		}
+	}
+	return 0;
+}
+
+static int _elf_addr_cmp(const void *a, const void *b) {
+	const Elf_Addr_Ent	*ea = a, *eb = b;
+
+	if(ea->value != eb->value) {
+		return (ea->value < eb->value) ? -1 : 1;
+	}
+	return (ea->ndx < eb->ndx) ? -1 : (ea->ndx > eb->ndx);
+}
+
+/*
+ * Is sym a better name for its address than other?  Higher rank wins,
+ * then a symbol with a size over one without.
+ */
+static int _elf_addr_better(const Elf32_Sym *sym, const Elf32_Sym *other) {
+	int					r1 = _elf_symrank(sym), r2 = _elf_symrank(other);
+
+	if(r1 != r2) {
+		return r1 > r2;
+	}
+	return sym->st_size != 0 && other->st_size == 0;
+}
+
+static int _elf_build_addrtab(struct Elf_Index *idx) {
+	Elf32_Sym			*sym;
+	const char			*name;
+	unsigned			i, n;
+
+	idx->i_addrdone = 1;
+	if(!(idx->i_addrtab = malloc(idx->i_nsyms * sizeof *idx->i_addrtab))) {
+		return -1;
+	}
+	for(i = 1, n = 0; i < idx->i_nsyms; i++) {
+		sym = idx->i_syms + i;
+		if(sym->st_shndx == SHN_UNDEF || sym->st_shndx == SHN_ABS || sym->st_shndx == SHN_COMMON) {
+			continue;
+		}
+		switch(ELF32_ST_TYPE(sym->st_info)) {
+		case STT_NOTYPE:
+		case STT_OBJECT:
+		case STT_FUNC:
+			break;
+		default:
+			continue;
+		}
+		/* skip unnamed symbols and ARM mapping symbols ($a, $d, $t) */
+		if(!(name = _elf_symname(idx, sym)) || name[0] == '$') {
+			continue;
+		}
+		idx->i_addrtab[n].value = sym->st_value;
+		idx->i_addrtab[n].ndx = i;
+		n++;
+	}
+	qsort(idx->i_addrtab, n, sizeof *idx->i_addrtab, _elf_addr_cmp);
+
+	/* keep one symbol per address */
+	for(i = 0, idx->i_naddr = 0; i < n; i++) {
+		Elf_Addr_Ent		*last = idx->i_addrtab + idx->i_naddr - 1;
+
+		if(idx->i_naddr && last->value == idx->i_addrtab[i].value) {
+			if(_elf_addr_better(idx->i_syms + idx->i_addrtab[i].ndx, idx->i_syms + last->ndx)) {
+				last->ndx = idx->i_addrtab[i].ndx;
+			}
+		} else {
+			idx->i_addrtab[idx->i_naddr++] = idx->i_addrtab[i];
+		}
+	}
+	return 0;
+}
+
+Elf32_Sym *elf32_addrsym(Elf *elf, Elf32_Addr addr, Elf32_Addr *offset) {
+	struct Elf_Index	*idx;
+	unsigned			lo, hi, mid;
+
+	if(!(idx = _elf_index(elf))) {
+		return 0;
+	}
+	if(!idx->i_symdone) {
+		_elf_build_syms(elf, idx);
+	}
+	if(!idx->i_nsyms) {
+		return 0;
+	}
+	if(!idx->i_addrdone && _elf_build_addrtab(idx) == -1) {
+		return 0;
+	}
+
+	/* last entry with value <= addr */
+	for(lo = 0, hi = idx->i_naddr; lo < hi; ) {
+		mid = lo + (hi - lo) / 2;
+		if(idx->i_addrtab[mid].value <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if(lo == 0) {
+		return 0;
+	}
+	if(offset) {
+		*offset = addr - idx->i_addrtab[lo - 1].value;
+	}
+	return idx->i_syms + idx->i_addrtab[lo - 1].ndx;
+}
+
+char *elf32_symname(Elf *elf, const Elf32_Sym *sym) {
+	struct Elf_Index	*idx;
+
+	if(!elf || !sym || !(idx = elf->e_index) || sym < idx->i_syms || sym >= idx->i_syms + idx->i_nsyms) {
+		return 0;
+	}
+	return _elf_symname(idx, sym);
+}
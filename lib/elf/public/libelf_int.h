@@ -93,6 +93,11 @@ struct Elf {
 	Elf_Scn			**e_scnp;
 
 	Elf_Cmd			e_cmd;
+
+	char			*e_map;		/* whole file mapped (ELF_C_READ), or NULL */
+	size_t			e_mapsize;
+
+	struct Elf_Index	*e_index;	/* name and address lookup, libelfidx.c */
 };
 
 int Elf32_swapEhdr( Elf *elf, Elf32_Ehdr *ehdr );
@@ -101,6 +106,7 @@ int Elf32_swapPhdr( Elf *elf );
 int Elf32_swapSym( Elf *elf, Elf32_Sym *sym, long size );
 int Elf32_swapRela( Elf *elf, char *buf, long size, int use_rela );
 int Elf32_swapDyn( Elf *elf, Elf32_Dyn *dyn );
+void _elf_index_free( Elf *elf );
 void swap_16( void *ptr );
 void swap_32( void *ptr );
 
@@ -49,6 +49,7 @@ enum Elf_qnx_note_types {
 	QNT_CORE_STATUS,
 	QNT_CORE_GREG,
 	QNT_CORE_FPREG,
+	QNT_CORE_MAPREF,
 	QNT_NUM
 };
 
@@ -67,6 +68,26 @@ enum {
 	QNXELF_FLAG_PRIVATES	= 0x0002
 };
 
+/*
+ * QNT_CORE_MAPREF: a PT_LOAD segment of a core file with no contents
+ * (p_filesz 0) because it is unmodified text of an object on disk.
+ * Read the bytes from the object instead: vaddr corresponds to offset
+ * in the file.  The descriptor is followed by idsz bytes of build id
+ * (the NT_GNU_BUILD_ID of the object, if it has one) and pathsz bytes
+ * of NUL terminated path.  mtime and fsize are those of the path when
+ * the core was written, 0 if it couldn't be checked.
+ */
+typedef struct {
+	_Uint64t		vaddr;
+	_Uint64t		size;
+	_Uint64t		offset;
+	_Uint64t		link_vaddr;		/* address vaddr was linked at */
+	_Uint64t		fsize;
+	_Uint32t		mtime;
+	_Uint16t		idsz;
+	_Uint16t		pathsz;
+} core_mapref;
+
 __END_DECLS
 
 #endif
@@ -56,6 +56,7 @@
  it will always be grabbed from the local structure first.
 */
 #include <sys/traceparser.h>
+#include <lzo1x.h>
 
 #if defined(__NT__) || defined(__MINGW32__)
 #if defined(__NT__)
@@ -123,6 +124,25 @@ static const char* const g_head_keywords[] = {
 #define _TP_EMIT         (1U)
 #define _TP_BLOCK        (0U)
 
+/* per-cpu event queue used to merge per-cpu buffers by time */
+#define _TP_MERGE_CPUS    64           /* _NTO_TRACE_GETCPU() range   */
+#define _TP_MERGE_WINDOW  (64*1024)    /* max. events held back       */
+
+typedef struct tp_merge_event {
+	traceevent_t event;
+	uint64_t     time;
+} tp_merge_event_t;
+
+typedef struct tp_merge_queue {
+	tp_merge_event_t* events;
+	unsigned          size;
+	unsigned          head;
+	unsigned          num;
+	unsigned          seen;
+	uint32_t          msb;
+	uint32_t          lsb;          /* of the last event read */
+} tp_merge_queue_t;
+
 /* structure mapping attributes */
 typedef struct traceparser_attribute {
 	struct traceparser_attribute *next;
@@ -149,6 +169,20 @@ typedef struct traceparser_state {
 	int                 last_callback_return;
 	int                 file_des;
 	traceparser_error_t error;
+	/* compressed (block) input */
+	unsigned            compressed;
+	unsigned char*      zin;
+	unsigned            zin_size;
+	unsigned char*      zout;
+	unsigned            zout_size;
+	unsigned            zout_len;
+	unsigned            zout_pos;
+	/* per-cpu buffers, merged by time */
+	unsigned            merge;          /* number of cpus, 0 if not per-cpu */
+	unsigned            merge_eof;
+	unsigned            merge_num;
+	unsigned            merge_last_cpu;
+	tp_merge_queue_t*   merge_queues;
 } traceparser_state_t;
 
 /* prn error  used only inside local scope functions */
@@ -240,6 +274,16 @@ void traceparser_destroy(traceparser_state_t** tps_pp)
 	if(tps_pp&&*tps_pp)
 	{
 		_TP_CLOSE_FILE(*tps_pp);
+		free((void*) (*tps_pp)->zin);
+		free((void*) (*tps_pp)->zout);
+		if ((*tps_pp)->merge_queues) {
+			unsigned i;
+
+			for (i=0; i<_TP_MERGE_CPUS; ++i) {
+				free((void*) (*tps_pp)->merge_queues[i].events);
+			}
+			free((void*) (*tps_pp)->merge_queues);
+		}
 		free((void*) *tps_pp);
 		*tps_pp = NULL;
 	}
@@ -1241,6 +1285,195 @@ static int get_header(traceparser_state_t* tps_p, int fd)
 	return (0);
 }
 
+/*
+ * Reads and unpacks the next block of a compressed trace file.
+ * Returns 1 if a block was read, 0 at the end of the blocks and
+ * -1 on a damaged block.
+ */
+static int read_block(traceparser_state_t* tps_p)
+{
+	traceblock_t blk;
+	lzo_uint     l;
+
+	if (read(tps_p->file_des, &blk, sizeof(blk))!=sizeof(blk)) {
+		return (0);
+	}
+	blk.usize = CS32(tps_p->endian_conv, blk.usize);
+	blk.csize = CS32(tps_p->endian_conv, blk.csize);
+	if (blk.usize==0) {
+		/* block index and trailer follow, they're of no use here */
+		return (0);
+	}
+	if (blk.csize>blk.usize) {
+		_TP_ERROR("damaged compressed block in input trace file");
+		return (-1);
+	}
+	if (blk.usize>tps_p->zout_size) {
+		unsigned char* p;
+
+		if ((p=realloc(tps_p->zout, blk.usize))==NULL) {
+			return (nomem(tps_p));
+		}
+		tps_p->zout      = p;
+		tps_p->zout_size = blk.usize;
+	}
+	if (blk.csize==blk.usize) {
+		/* stored */
+		if (read(tps_p->file_des, tps_p->zout, blk.usize)!=blk.usize) {
+			return (0);
+		}
+	} else {
+		if (blk.csize>tps_p->zin_size) {
+			unsigned char* p;
+
+			if ((p=realloc(tps_p->zin, blk.csize))==NULL) {
+				return (nomem(tps_p));
+			}
+			tps_p->zin      = p;
+			tps_p->zin_size = blk.csize;
+		}
+		if (read(tps_p->file_des, tps_p->zin, blk.csize)!=blk.csize) {
+			return (0);
+		}
+		l = blk.usize;
+		if (lzo1x_decompress_safe(tps_p->zin, blk.csize, tps_p->zout, &l, NULL)!=LZO_E_OK ||
+		    l!=blk.usize) {
+			_TP_ERROR("damaged compressed block in input trace file");
+			return (-1);
+		}
+	}
+	tps_p->zout_len = blk.usize;
+	tps_p->zout_pos = 0;
+
+	return (1);
+}
+
+/*
+ * Reads the next event, from the file directly or from the
+ * current decompressed block
+ */
+static int read_event(traceparser_state_t* tps_p, traceevent_t* t_e_p)
+{
+	if (!tps_p->compressed) {
+		return (read(tps_p->file_des, t_e_p, sizeof(*t_e_p))==sizeof(*t_e_p));
+	}
+	while (tps_p->zout_len-tps_p->zout_pos<sizeof(*t_e_p)) {
+		int r;
+
+		if ((r=read_block(tps_p))<=0) {
+			return (r);
+		}
+	}
+	(void) memcpy(t_e_p, tps_p->zout+tps_p->zout_pos, sizeof(*t_e_p));
+	tps_p->zout_pos += sizeof(*t_e_p);
+
+	return (1);
+}
+
+/*
+ * Queues a (raw) event read from a per-cpu buffer file, stamping it
+ * with its 64 bit time on the cpu that emitted it
+ */
+static int merge_add(traceparser_state_t* tps_p, const traceevent_t* t_e_p)
+{
+	unsigned          c=tps_p->endian_conv;
+	uint32_t          h=CS32(c, t_e_p->header);
+	uint32_t          lsb=CS32(c, t_e_p->data[0]);
+	tp_merge_queue_t* q=&tps_p->merge_queues[_NTO_TRACE_GETCPU(h)];
+	tp_merge_event_t* m_p;
+
+	if (q->num==q->size) {
+		unsigned          n=q->size?q->size*2:1024;
+		tp_merge_event_t* p;
+		unsigned          i;
+
+		if ((p=malloc(n*sizeof(*p)))==NULL) {
+			return (nomem(tps_p));
+		}
+		for (i=0; i<q->num; ++i) {
+			p[i] = q->events[(q->head+i)%q->size];
+		}
+		free((void*) q->events);
+		q->events = p;
+		q->size   = n;
+		q->head   = 0;
+	}
+	if (_NTO_TRACE_GETEVENT_C(h)==_TRACE_CONTROL_C && _NTO_TRACE_GETEVENT(h)==_TRACE_CONTROL_TIME &&
+	    _TRACE_GET_STRUCT(h)==_TRACE_STRUCT_S) {
+		q->msb = CS32(c, t_e_p->data[1]);
+	} else if (q->seen && lsb<q->lsb && q->lsb-lsb>0x80000000U) {
+		/* wrapped without a time event (control class not logged) */
+		q->msb++;
+	}
+	q->seen = 1;
+	q->lsb  = lsb;
+
+	m_p        = &q->events[(q->head+q->num)%q->size];
+	m_p->event = *t_e_p;
+	m_p->time  = ((uint64_t)q->msb<<32)|lsb;
+	q->num++;
+	tps_p->merge_num++;
+
+	return (0);
+}
+
+/*
+ * Reads the next event of a per-cpu buffer file in time order.  Each
+ * cpu's events are in order, so the oldest queued event can go once no
+ * cpu may still have an older one in the file, i.e. every cpu has been
+ * read past it (tps_p->merge is the number of cpus).  A cpu that stays quiet for too long is not waited for
+ * beyond _TP_MERGE_WINDOW queued events.
+ */
+static int merge_event(traceparser_state_t* tps_p, traceevent_t* t_e_p)
+{
+	for (;;) {
+		tp_merge_queue_t* best=NULL;
+		tp_merge_queue_t* q;
+		unsigned          i;
+		int               r;
+
+		/* oldest head, ties stay on the same cpu to keep combine events whole */
+		q = &tps_p->merge_queues[tps_p->merge_last_cpu];
+		if (q->num) {
+			best = q;
+		}
+		for (i=0; i<_TP_MERGE_CPUS; ++i) {
+			q = &tps_p->merge_queues[i];
+			if (q->num && (best==NULL || q->events[q->head].time<best->events[best->head].time)) {
+				best = q;
+			}
+		}
+		if (best) {
+			uint64_t t=best->events[best->head].time;
+			int      ready=tps_p->merge_eof || tps_p->merge_num>=_TP_MERGE_WINDOW;
+
+			for (i=0; !ready && i<_TP_MERGE_CPUS; ++i) {
+				q = &tps_p->merge_queues[i];
+				if (q->seen ? (((uint64_t)q->msb<<32)|q->lsb)<t : i<tps_p->merge) break;
+			}
+			if (ready || i==_TP_MERGE_CPUS) {
+				*t_e_p     = best->events[best->head].event;
+				best->head = (best->head+1)%best->size;
+				best->num--;
+				tps_p->merge_num--;
+				tps_p->merge_last_cpu = best-tps_p->merge_queues;
+
+				return (1);
+			}
+		} else if (tps_p->merge_eof) {
+			return (0);
+		}
+		if ((r=read_event(tps_p, t_e_p))<0) {
+			return (r);
+		}
+		if (r==0) {
+			tps_p->merge_eof = 1;
+		} else if (merge_add(tps_p, t_e_p)) {
+			return (-1);
+		}
+	}
+}
+
 /*
  * The main entry point of the library
  */
@@ -1248,6 +1481,9 @@ int traceparser(traceparser_state_t* tps_p, void* u_d, const char *tracefile)
 {
 	union  {long l; char c[sizeof(long)];} u={1};
 	traceevent_t t_e;
+	int r;
+	unsigned i;
+	char* v;
 
 	/* check if state structure is ok */
 	if(tps_p==NULL) {
@@ -1327,6 +1563,51 @@ int traceparser(traceparser_state_t* tps_p, void* u_d, const char *tracefile)
 		return (-1);
 	}
 
+	/* compressed event stream */
+	{
+		unsigned l;
+
+		tps_p->compressed = 0;
+		tps_p->zout_len   = tps_p->zout_pos = 0;
+		if ((v=get_attribute_value(tps_p, _TRACE_COMPRESSION_KEY, 1, &l))!=NULL) {
+			if (l!=sizeof(_TRACE_COMPRESSION_LZO1X)-1 ||
+			    memcmp(v, _TRACE_COMPRESSION_LZO1X, l) ||
+			    lzo_init()!=LZO_E_OK) {
+				_TP_ERROR("unsupported input trace file compression");
+				_TP_CLOSE_FILE(tps_p);
+				errno           = EINVAL;
+				tps_p->error    = _TRACEPARSER_CANNOT_READ_IN_FILE;
+
+				return (-1);
+			}
+			tps_p->compressed = 1;
+		}
+	}
+
+	/* per-cpu buffers */
+	tps_p->merge = 0;
+	if ((v=get_attribute_value(tps_p, _TRACE_PERCPU_KEY, 1, &i))!=NULL) {
+		char n[16];
+
+		(void) memcpy(n, v, i<sizeof(n)?i:sizeof(n)-1);
+		n[i<sizeof(n)?i:sizeof(n)-1] = '\0';
+		if (tps_p->merge_queues==NULL &&
+		    (tps_p->merge_queues=calloc(_TP_MERGE_CPUS, sizeof(tp_merge_queue_t)))==NULL) {
+			return (nomem(tps_p));
+		}
+		for (i=0; i<_TP_MERGE_CPUS; ++i) {
+			tps_p->merge_queues[i].head = tps_p->merge_queues[i].num  = 0;
+			tps_p->merge_queues[i].seen = tps_p->merge_queues[i].msb  = 0;
+		}
+		tps_p->merge          = strtoul(n, NULL, 10);
+		if (tps_p->merge==0 || tps_p->merge>_TP_MERGE_CPUS) {
+			tps_p->merge = _TP_MERGE_CPUS;
+		}
+		tps_p->merge_eof      = 0;
+		tps_p->merge_num      = 0;
+		tps_p->merge_last_cpu = 0;
+	}
+
 	/* reading syspage */
 	if (get_header_value(tps_p, _TRACEPARSER_INFO_SYSPAGE_LEN, NULL)) {
 		size_t l=(size_t)strtoul(get_header_value(tps_p, _TRACEPARSER_INFO_SYSPAGE_LEN, NULL), NULL, 10);
@@ -1365,7 +1646,7 @@ int traceparser(traceparser_state_t* tps_p, void* u_d, const char *tracefile)
 	if (tps_p->debug_flags&_TRACEPARSER_DEBUG_HEADER&&tps_p->debug_stream) {
 		(void) fprintf(tps_p->debug_stream, " -- KERNEL EVENTS -- \n");
 	}
-	while(read(tps_p->file_des, &t_e, sizeof(t_e))==sizeof(t_e)) {
+	while((r=(tps_p->merge?merge_event(tps_p, &t_e):read_event(tps_p, &t_e)))>0) {
 		if (tps_p->endian_conv) arr_swap32((long*)(&t_e), 2);
 		if ((tps_p->debug_flags&_TRACEPARSER_DEBUG_ALL)==_TRACEPARSER_DEBUG_ALL&&tps_p->debug_stream) {
 			(void) fprintf
@@ -1384,6 +1665,13 @@ int traceparser(traceparser_state_t* tps_p, void* u_d, const char *tracefile)
 			if (combine(tps_p, &t_e)) return (-1);
 		}
 	}
+	if (r<0) {
+		_TP_CLOSE_FILE(tps_p);
+		errno        = EINVAL;
+		tps_p->error = _TRACEPARSER_CANNOT_READ_IN_FILE;
+
+		return (-1);
+	}
 	_TP_CLOSE_FILE(tps_p);
 	finish(tps_p);
 
@@ -18,6 +18,14 @@ CCFLAGS += -DELF_TARGET_ALL -Du_int32_t=uint32_t -Du_int16_t=uint16_t -Du_int8_t
 # The md5 functionality should be moved from lib lib/misc to lib/util.
 
 EXTRA_INCVPATH+=$(PROJECT_ROOT)/h $(PROJECT_ROOT)/public/util
+
+# The x86 crc kernels are only run when the cpu has these.  Compilers
+# before gcc 4.4 don't know -mpclmul, crc_x86.c then builds without them.
+ifneq ($(filter-out 2.% 3.% 4.0% 4.1% 4.2% 4.3%, $(GCC_VERSION)),)
+CCFLAGS_crc_x86_x86 = -mpclmul -mssse3
+endif
+CCFLAGS += $(CCFLAGS_$(basename $@)_$(CPU))
+
 include $(MKFILES_ROOT)/qtargets.mk
 include $(MKFILES_ROOT)/ntoxdev.mk
 
@@ -0,0 +1,282 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+#include <string.h>
+#include <util/crc.h>
+
+/*
+ * The table driven code folds in CRC_SLICE bytes a step, with a table
+ * for each byte ("slicing-by-8", Kounavis and Berry).  Sixteen tables
+ * (16K per polynomial) only pay off with a large level 1 cache, so the
+ * embedded targets use eight.
+ */
+#if defined(__X86__) || defined(__i386__) || defined(__x86_64__)
+#define CRC_X86		1
+#define CRC_SLICE	16
+#else
+#define CRC_SLICE	8
+#endif
+
+/* Shorter buffers aren't worth setting up the vector kernels for */
+#define CRC_VEC_MIN	256
+
+#define ADLER_BASE	65521
+#define ADLER_NMAX	5552		/* most bytes before s2 can overflow */
+
+#if defined(__LITTLEENDIAN__) || defined(__i386__) || defined(__x86_64__) || defined(__ARMEL__)
+#define CRC_LITTLE	1
+#elif defined(__BIGENDIAN__) || defined(__sparc) || defined(__ARMEB__) || defined(__PPC__)
+#define CRC_BIG		1
+#endif
+
+#define SWAP32(w)	(((w) >> 24) | (((w) >> 8) & 0xff00) | (((w) & 0xff00) << 8) | ((w) << 24))
+
+static uint32_t		crc_tab_posix[CRC_SLICE][256];
+static uint32_t		crc_tab_ieee[CRC_SLICE][256];
+static volatile int	crc_ready;
+
+#ifdef CRC_X86
+/* crc_x86.c; the kernels take whole 16 byte (32 for Adler) blocks */
+extern int crc_x86_probe(void);
+extern uint32_t crc_posix_clmul(uint32_t crc, const unsigned char *p, size_t len);
+extern uint32_t crc_ieee_clmul(uint32_t crc, const unsigned char *p, size_t len);
+extern uint32_t crc_adler32_ssse3(uint32_t adler, const unsigned char *p, size_t len);
+
+static int			crc_vec;
+#endif
+
+static __inline__ uint32_t load_le(const unsigned char *p)
+{
+#if defined(CRC_LITTLE) || defined(CRC_BIG)
+	uint32_t	w;
+
+	memcpy(&w, p, sizeof w);
+#ifdef CRC_BIG
+	w = SWAP32(w);
+#endif
+	return w;
+#else
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+#endif
+}
+
+static __inline__ uint32_t load_be(const unsigned char *p)
+{
+#if defined(CRC_LITTLE) || defined(CRC_BIG)
+	uint32_t	w;
+
+	memcpy(&w, p, sizeof w);
+#ifdef CRC_LITTLE
+	w = SWAP32(w);
+#endif
+	return w;
+#else
+	return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+#endif
+}
+
+/*
+ * Table k gives the CRC of a byte followed by k zero bytes.  Two threads
+ * getting here at once just build the same tables.
+ */
+static void crc_setup(void)
+{
+	uint32_t	c;
+	int			i, j, k;
+
+	for(i = 0; i < 256; i++) {
+		for(c = (uint32_t)i << 24, j = 0; j < 8; j++)
+			c = (c & 0x80000000) ? (c << 1) ^ 0x04c11db7 : c << 1;
+		crc_tab_posix[0][i] = c;
+		for(c = i, j = 0; j < 8; j++)
+			c = (c & 1) ? (c >> 1) ^ 0xedb88320 : c >> 1;
+		crc_tab_ieee[0][i] = c;
+	}
+	for(k = 1; k < CRC_SLICE; k++) {
+		for(i = 0; i < 256; i++) {
+			c = crc_tab_posix[k - 1][i];
+			crc_tab_posix[k][i] = (c << 8) ^ crc_tab_posix[0][c >> 24];
+			c = crc_tab_ieee[k - 1][i];
+			crc_tab_ieee[k][i] = (c >> 8) ^ crc_tab_ieee[0][c & 0xff];
+		}
+	}
+#ifdef CRC_X86
+	crc_vec = crc_x86_probe();
+#endif
+	crc_ready = 1;
+}
+
+static uint32_t posix_slice(uint32_t c, const unsigned char *p, size_t len)
+{
+	uint32_t		(*t)[256] = crc_tab_posix;
+	uint32_t		a, b;
+#if CRC_SLICE == 16
+	uint32_t		d, e;
+#endif
+
+	for(; len >= CRC_SLICE; len -= CRC_SLICE, p += CRC_SLICE) {
+		a = c ^ load_be(p);
+		b = load_be(p + 4);
+#if CRC_SLICE == 16
+		d = load_be(p + 8);
+		e = load_be(p + 12);
+		c = t[15][a >> 24] ^ t[14][(a >> 16) & 0xff] ^ t[13][(a >> 8) & 0xff] ^ t[12][a & 0xff] ^
+			t[11][b >> 24] ^ t[10][(b >> 16) & 0xff] ^ t[9][(b >> 8) & 0xff] ^ t[8][b & 0xff] ^
+			t[7][d >> 24] ^ t[6][(d >> 16) & 0xff] ^ t[5][(d >> 8) & 0xff] ^ t[4][d & 0xff] ^
+			t[3][e >> 24] ^ t[2][(e >> 16) & 0xff] ^ t[1][(e >> 8) & 0xff] ^ t[0][e & 0xff];
+#else
+		c = t[7][a >> 24] ^ t[6][(a >> 16) & 0xff] ^ t[5][(a >> 8) & 0xff] ^ t[4][a & 0xff] ^
+			t[3][b >> 24] ^ t[2][(b >> 16) & 0xff] ^ t[1][(b >> 8) & 0xff] ^ t[0][b & 0xff];
+#endif
+	}
+	while(len--)
+		c = (c << 8) ^ t[0][(c >> 24) ^ *p++];
+	return c;
+}
+
+static uint32_t ieee_slice(uint32_t c, const unsigned char *p, size_t len)
+{
+	uint32_t		(*t)[256] = crc_tab_ieee;
+	uint32_t		a, b;
+#if CRC_SLICE == 16
+	uint32_t		d, e;
+#endif
+
+	for(; len >= CRC_SLICE; len -= CRC_SLICE, p += CRC_SLICE) {
+		a = c ^ load_le(p);
+		b = load_le(p + 4);
+#if CRC_SLICE == 16
+		d = load_le(p + 8);
+		e = load_le(p + 12);
+		c = t[15][a & 0xff] ^ t[14][(a >> 8) & 0xff] ^ t[13][(a >> 16) & 0xff] ^ t[12][a >> 24] ^
+			t[11][b & 0xff] ^ t[10][(b >> 8) & 0xff] ^ t[9][(b >> 16) & 0xff] ^ t[8][b >> 24] ^
+			t[7][d & 0xff] ^ t[6][(d >> 8) & 0xff] ^ t[5][(d >> 16) & 0xff] ^ t[4][d >> 24] ^
+			t[3][e & 0xff] ^ t[2][(e >> 8) & 0xff] ^ t[1][(e >> 16) & 0xff] ^ t[0][e >> 24];
+#else
+		c = t[7][a & 0xff] ^ t[6][(a >> 8) & 0xff] ^ t[5][(a >> 16) & 0xff] ^ t[4][a >> 24] ^
+			t[3][b & 0xff] ^ t[2][(b >> 8) & 0xff] ^ t[1][(b >> 16) & 0xff] ^ t[0][b >> 24];
+#endif
+	}
+	while(len--)
+		c = (c >> 8) ^ t[0][(c ^ *p++) & 0xff];
+	return c;
+}
+
+uint32_t crc_posix(uint32_t crc, const void *buf, size_t len)
+{
+	const unsigned char	*p = buf;
+
+	if(!crc_ready)
+		crc_setup();
+#ifdef CRC_X86
+	if(crc_vec && len >= CRC_VEC_MIN) {
+		size_t	n = len & ~(size_t)15;
+
+		crc = crc_posix_clmul(crc, p, n);
+		p += n;
+		len -= n;
+	}
+#endif
+	return posix_slice(crc, p, len);
+}
+
+/*
+ * cksum follows the data with its length, least significant byte first
+ * and without leading zeros.
+ */
+uint32_t crc_posix_end(uint32_t crc, uint64_t len)
+{
+	unsigned char	b[8];
+	int				n;
+
+	for(n = 0; len != 0; len >>= 8)
+		b[n++] = len & 0xff;
+	return ~crc_posix(crc, b, n);
+}
+
+uint32_t crc_ieee(uint32_t crc, const void *buf, size_t len)
+{
+	const unsigned char	*p = buf;
+
+	if(!crc_ready)
+		crc_setup();
+	crc = ~crc;
+#ifdef CRC_X86
+	if(crc_vec && len >= CRC_VEC_MIN) {
+		size_t	n = len & ~(size_t)15;
+
+		crc = crc_ieee_clmul(crc, p, n);
+		p += n;
+		len -= n;
+	}
+#endif
+	return ~ieee_slice(crc, p, len);
+}
+
+uint32_t crc_adler32(uint32_t adler, const void *buf, size_t len)
+{
+	const unsigned char	*p = buf;
+	uint32_t			s1, s2;
+	size_t				n;
+
+#ifdef CRC_X86
+	if(!crc_ready)
+		crc_setup();
+	if(crc_vec && len >= CRC_VEC_MIN) {
+		n = len & ~(size_t)31;
+		adler = crc_adler32_ssse3(adler, p, n);
+		p += n;
+		len -= n;
+	}
+#endif
+	s1 = adler & 0xffff;
+	s2 = adler >> 16;
+	while(len != 0) {
+		n = len < ADLER_NMAX ? len : ADLER_NMAX;
+		len -= n;
+		for(; n >= 8; n -= 8, p += 8) {
+			s1 += p[0]; s2 += s1;
+			s1 += p[1]; s2 += s1;
+			s1 += p[2]; s2 += s1;
+			s1 += p[3]; s2 += s1;
+			s1 += p[4]; s2 += s1;
+			s1 += p[5]; s2 += s1;
+			s1 += p[6]; s2 += s1;
+			s1 += p[7]; s2 += s1;
+		}
+		while(n--) {
+			s1 += *p++;
+			s2 += s1;
+		}
+		s1 %= ADLER_BASE;
+		s2 %= ADLER_BASE;
+	}
+	return (s2 << 16) | s1;
+}
+
+const char *crc_engine(void)
+{
+	if(!crc_ready)
+		crc_setup();
+#ifdef CRC_X86
+	if(crc_vec)
+		return "pclmul";
+#endif
+	return CRC_SLICE == 16 ? "slice-by-16" : "slice-by-8";
+}
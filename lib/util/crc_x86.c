@@ -0,0 +1,285 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+/*
+ * x86 kernels for crc.c: carry-less multiply (PCLMULQDQ) folding for the
+ * two CRCs, after "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction" (Gopal et al, Intel 2009), and an SSSE3 Adler-32.
+ * This file is built with those instructions enabled, so nothing in it
+ * may run before crc_x86_probe() says the cpu has them.
+ */
+#if defined(__X86__) || defined(__i386__) || defined(__x86_64__)
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#if defined(__PCLMUL__) && defined(__SSSE3__)
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#define LOAD(p)		_mm_loadu_si128((const __m128i *)(p))
+
+/*
+ * POSIX cksum, P = 0x104c11db7 most significant bit first.  A 128 bit
+ * block x moved d bits further on is x.hi * (x^(d+64) mod P) ^
+ * x.lo * (x^d mod P).
+ */
+#define P_K576		0x8833794c
+#define P_K512		0xe6228b11
+#define P_K192		0xc5b9cd4c
+#define P_K128		0xe8a45605
+#define P_K96		0xf200aa66
+#define P_K64		0x490d678d
+#define P_MU		0x104d101dfLL	/* x^64 / P */
+#define P_POLY		0x104c11db7LL
+
+/*
+ * CRC-32, 0xedb88320 reflected.  The constants are the same x^d mod P
+ * in the bit reflected domain, where a block moves the other way.
+ */
+#define I_K1		0x154442bd4LL
+#define I_K2		0x1c6e41596LL
+#define I_K3		0x1751997d0LL
+#define I_K4		0x0ccaa009eLL
+#define I_K5		0x163cd6124LL
+#define I_POLY		0x1db710641LL
+#define I_MU		0x1f7011641LL
+
+#define ADLER_BASE	65521
+#define ADLER_NMAX	5552
+
+/* cpuid 1 feature bits */
+#define ECX_PCLMUL	(1 << 1)
+#define ECX_SSSE3	(1 << 9)
+#define EDX_SSE2	(1 << 26)
+
+/*
+ * Done here rather than with <cpuid.h>, which not every compiler the
+ * tree is built with has.  On 32 bit %ebx may be the PIC register.
+ */
+static __inline__ void cpuid(unsigned leaf, unsigned *a, unsigned *b, unsigned *c, unsigned *d)
+{
+#if defined(__x86_64__)
+	__asm__ __volatile__("cpuid"
+		: "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+		: "0" (leaf), "2" (0));
+#else
+	__asm__ __volatile__("xchgl %%ebx, %1\n\tcpuid\n\txchgl %%ebx, %1"
+		: "=a" (*a), "=r" (*b), "=c" (*c), "=d" (*d)
+		: "0" (leaf), "2" (0));
+#endif
+}
+
+int crc_x86_probe(void)
+{
+	unsigned	a, b, c, d;
+
+#if !defined(__x86_64__)
+	/* no cpuid unless the ID flag can be toggled */
+	__asm__ __volatile__("pushfl\n\tpushfl\n\tpopl %0\n\tmovl %0, %1\n\t"
+		"xorl $0x00200000, %0\n\tpushl %0\n\tpopfl\n\t"
+		"pushfl\n\tpopl %0\n\tpopfl"
+		: "=&r" (a), "=&r" (b));
+	if(!((a ^ b) & 0x00200000))
+		return 0;
+#endif
+	cpuid(0, &a, &b, &c, &d);
+	if(a < 1)
+		return 0;
+	cpuid(1, &a, &b, &c, &d);
+	return (c & ECX_PCLMUL) && (c & ECX_SSSE3) && (d & EDX_SSE2);
+}
+
+static __inline__ __m128i fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+/*
+ * len is a multiple of 16.  Blocks are byte reversed so the first byte
+ * is the top of the polynomial.  Four blocks at a time are carried 64
+ * bytes on, then folded into one which is carried 16 bytes at a time.
+ */
+uint32_t crc_posix_clmul(uint32_t crc, const unsigned char *p, size_t len)
+{
+	const __m128i	swap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	__m128i			x0, x1, x2, x3, k, k4, t;
+
+	k = _mm_set_epi64x(P_K192, P_K128);
+	x0 = _mm_shuffle_epi8(LOAD(p), swap);
+	x0 = _mm_xor_si128(x0, _mm_slli_si128(_mm_cvtsi32_si128(crc), 12));
+	p += 16;
+	len -= 16;
+
+	if(len >= 48) {
+		x1 = _mm_shuffle_epi8(LOAD(p), swap);
+		x2 = _mm_shuffle_epi8(LOAD(p + 16), swap);
+		x3 = _mm_shuffle_epi8(LOAD(p + 32), swap);
+		p += 48;
+		len -= 48;
+
+		k4 = _mm_set_epi64x(P_K576, P_K512);
+		for(; len >= 64; len -= 64, p += 64) {
+			x0 = _mm_xor_si128(fold(x0, k4), _mm_shuffle_epi8(LOAD(p), swap));
+			x1 = _mm_xor_si128(fold(x1, k4), _mm_shuffle_epi8(LOAD(p + 16), swap));
+			x2 = _mm_xor_si128(fold(x2, k4), _mm_shuffle_epi8(LOAD(p + 32), swap));
+			x3 = _mm_xor_si128(fold(x3, k4), _mm_shuffle_epi8(LOAD(p + 48), swap));
+		}
+		x1 = _mm_xor_si128(x1, fold(x0, k));
+		x2 = _mm_xor_si128(x2, fold(x1, k));
+		x0 = _mm_xor_si128(x3, fold(x2, k));
+	}
+	for(; len >= 16; len -= 16, p += 16)
+		x0 = _mm_xor_si128(fold(x0, k), _mm_shuffle_epi8(LOAD(p), swap));
+
+	/* The CRC is x0 * x^32 mod P.  Take it to 96 bits, then 64... */
+	k = _mm_set_epi64x(P_K64, P_K96);
+	t = _mm_clmulepi64_si128(x0, k, 0x01);
+	x0 = _mm_xor_si128(t, _mm_slli_si128(_mm_move_epi64(x0), 4));
+	t = _mm_clmulepi64_si128(_mm_srli_si128(x0, 8), k, 0x10);
+	x0 = _mm_xor_si128(_mm_move_epi64(x0), t);
+
+	/* ...and Barrett reduce: q = (x0 >> 32) * mu >> 32, crc = x0 ^ q * P */
+	k = _mm_set_epi64x(P_POLY, P_MU);
+	t = _mm_clmulepi64_si128(_mm_srli_epi64(x0, 32), k, 0x00);
+	t = _mm_clmulepi64_si128(_mm_srli_epi64(t, 32), k, 0x10);
+	return _mm_cvtsi128_si32(_mm_xor_si128(x0, t));
+}
+
+/*
+ * len is a multiple of 16; crc is not inverted here.
+ */
+uint32_t crc_ieee_clmul(uint32_t crc, const unsigned char *p, size_t len)
+{
+	const __m128i	mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i			x0, x1, x2, x3, k, k4, t;
+
+	k = _mm_set_epi64x(I_K4, I_K3);
+	x0 = _mm_xor_si128(LOAD(p), _mm_cvtsi32_si128(crc));
+	p += 16;
+	len -= 16;
+
+	if(len >= 48) {
+		x1 = LOAD(p);
+		x2 = LOAD(p + 16);
+		x3 = LOAD(p + 32);
+		p += 48;
+		len -= 48;
+
+		k4 = _mm_set_epi64x(I_K2, I_K1);
+		for(; len >= 64; len -= 64, p += 64) {
+			x0 = _mm_xor_si128(fold(x0, k4), LOAD(p));
+			x1 = _mm_xor_si128(fold(x1, k4), LOAD(p + 16));
+			x2 = _mm_xor_si128(fold(x2, k4), LOAD(p + 32));
+			x3 = _mm_xor_si128(fold(x3, k4), LOAD(p + 48));
+		}
+		x1 = _mm_xor_si128(x1, fold(x0, k));
+		x2 = _mm_xor_si128(x2, fold(x1, k));
+		x0 = _mm_xor_si128(x3, fold(x2, k));
+	}
+	for(; len >= 16; len -= 16, p += 16)
+		x0 = _mm_xor_si128(fold(x0, k), LOAD(p));
+
+	/* 128 bits to 64, appending the 32 zero bits, then to 32 */
+	t = _mm_clmulepi64_si128(x0, k, 0x10);
+	x0 = _mm_xor_si128(_mm_srli_si128(x0, 8), t);
+	t = _mm_srli_si128(x0, 4);
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask), _mm_set_epi64x(0, I_K5), 0x00);
+	x0 = _mm_xor_si128(x0, t);
+
+	/* Barrett reduction, reflected */
+	k = _mm_set_epi64x(I_MU, I_POLY);
+	t = _mm_clmulepi64_si128(_mm_and_si128(x0, mask), k, 0x10);
+	t = _mm_clmulepi64_si128(_mm_and_si128(t, mask), k, 0x00);
+	return _mm_cvtsi128_si32(_mm_srli_si128(_mm_xor_si128(x0, t), 4));
+}
+
+/*
+ * len is a multiple of 32.  For each 32 byte block s2 gains 32 * s1 plus
+ * the bytes weighted 32 down to 1, and s1 gains their sum.
+ */
+uint32_t crc_adler32_ssse3(uint32_t adler, const unsigned char *p, size_t len)
+{
+	const __m128i	tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i	tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i	zero = _mm_setzero_si128();
+	const __m128i	ones = _mm_set1_epi16(1);
+	__m128i			v_ps, v_s1, v_s2, b1, b2;
+	uint32_t		s1 = adler & 0xffff, s2 = adler >> 16;
+	size_t			blocks = len / 32, n;
+
+	while(blocks != 0) {
+		n = blocks < ADLER_NMAX / 32 ? blocks : ADLER_NMAX / 32;
+		blocks -= n;
+
+		v_ps = _mm_cvtsi32_si128(s1 * n);
+		v_s2 = _mm_cvtsi32_si128(s2);
+		v_s1 = zero;
+		do {
+			b1 = LOAD(p);
+			b2 = LOAD(p + 16);
+			v_ps = _mm_add_epi32(v_ps, v_s1);
+			v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b1, zero));
+			v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b1, tap1), ones));
+			v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b2, zero));
+			v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b2, tap2), ones));
+			p += 32;
+		} while(--n);
+		v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+		v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+		v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 += _mm_cvtsi128_si32(v_s1);
+		v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+		v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+		s2 = _mm_cvtsi128_si32(v_s2);
+
+		s1 %= ADLER_BASE;
+		s2 %= ADLER_BASE;
+	}
+	return (s2 << 16) | s1;
+}
+
+#else
+
+/* The compiler can't generate the instructions */
+int crc_x86_probe(void)
+{
+	return 0;
+}
+
+uint32_t crc_posix_clmul(uint32_t crc, const unsigned char *p, size_t len)
+{
+	return crc;
+}
+
+uint32_t crc_ieee_clmul(uint32_t crc, const unsigned char *p, size_t len)
+{
+	return crc;
+}
+
+uint32_t crc_adler32_ssse3(uint32_t adler, const unsigned char *p, size_t len)
+{
+	return adler;
+}
+
+#endif
+#endif
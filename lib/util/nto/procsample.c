@@ -0,0 +1,460 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ *
+ * You must obtain a written license from and pay applicable license fees to QNX
+ * Software Systems before you may reproduce, modify or distribute this software,
+ * or any work that includes all or part of this software.   Free development
+ * licenses are available for evaluation and non-commercial purposes.  For more
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *
+ * This file may contain contributions from others.  Please review this entire
+ * file for other proprietary rights or license notices, as well as the QNX
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/
+ * for other information.
+ * $
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <devctl.h>
+#include <sys/mman.h>
+#include <sys/neutrino.h>
+#include <sys/procfs.h>
+#include <util/procsample.h>
+
+#define HASH_SIZE		256
+#define MAX_ATTEMPTS	10
+
+struct procsample {
+	unsigned			flags;
+	unsigned			stamp;
+	DIR					*dir;
+	char				path[_POSIX_PATH_MAX];	/* "/proc" or "/net/<node>/proc" */
+	pid_t				*watch;
+	int					nwatch;
+	int					n_processes;
+	int					n_threads;
+	uint64_t			last_time;
+	uint64_t			interval;
+	procsample_proc_t	*list;
+	procsample_proc_t	*hash[HASH_SIZE];
+};
+
+static unsigned hash_pid(pid_t pid) {
+	return ((unsigned)pid * 2654435761u) >> 24;
+}
+
+static procsample_proc_t *lookup(procsample_t *ps, pid_t pid) {
+	procsample_proc_t	*p;
+
+	for(p = ps->hash[hash_pid(pid)]; p; p = p->hash) {
+		if(p->info.pid == pid) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+static void unhash(procsample_t *ps, procsample_proc_t *p) {
+	procsample_proc_t	**pp;
+
+	for(pp = &ps->hash[hash_pid(p->info.pid)]; *pp; pp = &(*pp)->hash) {
+		if(*pp == p) {
+			*pp = p->hash;
+			break;
+		}
+	}
+}
+
+static void free_threads(procsample_proc_t *p) {
+	procsample_thread_t	*t;
+
+	while((t = p->thread_list)) {
+		p->thread_list = t->next;
+		free(t);
+	}
+	p->n_threads = 0;
+}
+
+static void free_proc(procsample_t *ps, procsample_proc_t *p) {
+	unhash(ps, p);
+	free_threads(p);
+	if(p->fd != -1) {
+		close(p->fd);
+	}
+	free(p);
+}
+
+/*
+ * Forget everything cached about a process, used when its pid
+ * shows up with a different start time (i.e. the pid was reused).
+ */
+static void reset_proc(procsample_proc_t *p) {
+	free_threads(p);
+	p->name[0] = '\0';
+	p->total_memory = -1;
+	memset(&p->info, 0, sizeof p->info);
+}
+
+static int open_proc(procsample_t *ps, pid_t pid) {
+	char		buff[_POSIX_PATH_MAX];
+
+	snprintf(buff, sizeof buff, "%s/%d", ps->path, pid);
+	return open(buff, O_RDONLY);
+}
+
+static int32_t memory_usage(int fd) {
+	procfs_mapinfo		*mem;
+	int					i, num, new_num, iterations;
+	int32_t				total;
+
+	if(devctl(fd, DCMD_PROC_MAPINFO, NULL, 0, &num) != EOK || num <= 0) {
+		return -1;
+	}
+	num += 5;
+	if(!(mem = malloc(num * sizeof *mem))) {
+		return -1;
+	}
+	for(new_num = num + 1, iterations = 0; new_num > num; iterations++) {
+		procfs_mapinfo		*tmp;
+
+		if(iterations == MAX_ATTEMPTS ||
+		   devctl(fd, DCMD_PROC_MAPINFO, mem, num * sizeof *mem, &new_num) != EOK) {
+			free(mem);
+			return -1;
+		}
+		if(new_num > num) {
+			num = new_num + 5;
+			if(!(tmp = realloc(mem, num * sizeof *mem))) {
+				free(mem);
+				return -1;
+			}
+			mem = tmp;
+		}
+	}
+
+	total = 0;
+	for(i = 0; i < new_num; i++) {
+		if((mem[i].flags & MAP_TYPE) == MAP_SHARED) {
+			continue;
+		}
+		switch(mem[i].dev) {
+		case 1:
+			/* Executable text/data */
+			if(mem[i].flags & MAP_ELF) {
+				total += mem[i].size;
+			}
+			break;
+		case 2:
+			/* Mapped memory; device memory (MAP_FIXED) is ignored */
+			if(!(mem[i].flags & MAP_FIXED) && (mem[i].flags & PG_HWMAPPED)) {
+				total += mem[i].size;
+			}
+			break;
+		default:
+			/* Shared memory, DLL text */
+			break;
+		}
+	}
+	free(mem);
+	return total;
+}
+
+/*
+ * Walk the threads of the process, merging the new status into the
+ * cached (tid ordered) list and computing the per thread time deltas.
+ */
+static int sample_threads(procsample_t *ps, procsample_proc_t *p) {
+	procsample_thread_t	**tp, *t;
+	procfs_status		status;
+	int					lasttid, tid;
+
+	tp = &p->thread_list;
+	for(lasttid = tid = 1; ; lasttid = ++tid) {
+		memset(&status, 0, sizeof status);
+		status.tid = tid;
+		if(devctl(p->fd, DCMD_PROC_TIDSTATUS, &status, sizeof status, 0) != EOK) {
+			break;
+		}
+		if((tid = status.tid) < lasttid) {
+			break;
+		}
+
+		/* Drop cached threads which have gone away */
+		while((t = *tp) && t->status.tid < tid) {
+			*tp = t->next;
+			free(t);
+			p->n_threads--;
+		}
+
+		if(!(t = *tp) || t->status.tid != tid) {
+			if(!(t = calloc(1, sizeof *t))) {
+				return -1;
+			}
+			t->up = p;
+			t->next = *tp;
+			*tp = t;
+			p->n_threads++;
+			t->time_used = status.sutime;
+		} else if(status.sutime < t->status.sutime) {
+			t->time_used = status.sutime;
+		} else {
+			t->time_used = status.sutime - t->status.sutime;
+		}
+		t->status = status;
+		t->stamp = ps->stamp;
+		tp = &t->next;
+	}
+
+	while((t = *tp)) {
+		*tp = t->next;
+		free(t);
+		p->n_threads--;
+	}
+	return 0;
+}
+
+static int sample_proc(procsample_t *ps, pid_t pid, procsample_proc_t ***tailp) {
+	procsample_proc_t	*p;
+	procfs_info			info;
+	uint64_t			cpu;
+	int					isnew, requery, retry;
+
+	if((p = lookup(ps, pid)) && p->stamp == ps->stamp) {
+		/* Already sampled (pid listed twice) */
+		return 0;
+	}
+
+	isnew = 0;
+	if(!p) {
+		if(!(p = calloc(1, sizeof *p))) {
+			return -1;
+		}
+		p->fd = -1;
+		p->total_memory = -1;
+		p->info.pid = pid;
+		p->hash = ps->hash[hash_pid(pid)];
+		ps->hash[hash_pid(pid)] = p;
+		isnew = 1;
+	}
+
+	/* A cached fd may refer to a process that has since exited;
+	   retry once with a fresh open in case the pid was reused. */
+	for(retry = (p->fd != -1); ; retry = 0) {
+		if(p->fd == -1 && (p->fd = open_proc(ps, pid)) == -1) {
+			break;
+		}
+		if(devctl(p->fd, DCMD_PROC_INFO, &info, sizeof info, 0) == EOK) {
+			break;
+		}
+		close(p->fd);
+		p->fd = -1;
+		if(!retry) {
+			break;
+		}
+	}
+
+	if(p->fd == -1 || (info.flags & _NTO_PF_ZOMBIE)) {
+		/* Not stamped, so the sweep in procsample_update() drops it */
+		if(isnew) {
+			free_proc(ps, p);
+		}
+		return 0;
+	}
+
+	if(!isnew && info.start_time != p->info.start_time) {
+		reset_proc(p);
+		isnew = 1;
+	}
+
+	cpu = info.utime + info.stime;
+	if(isnew || cpu < p->info.utime + p->info.stime) {
+		p->time_used = cpu;
+	} else {
+		p->time_used = cpu - (p->info.utime + p->info.stime);
+	}
+
+	requery = isnew || info.num_threads != p->info.num_threads;
+	p->flags = (isnew ? PROCSAMPLE_PF_NEW : 0) | (requery ? PROCSAMPLE_PF_REQUERY : 0);
+	p->info = info;
+
+	if((ps->flags & PROCSAMPLE_NAMES) && isnew) {
+		struct {
+			procfs_debuginfo	info;
+			char				buff[_POSIX_PATH_MAX];
+		} name;
+
+		if(pid == 1) {
+			strcpy(p->name, "kernel");
+		} else if(devctl(p->fd, DCMD_PROC_MAPDEBUG_BASE, &name, sizeof name, 0) == EOK) {
+			strncpy(p->name, name.info.path, sizeof p->name);
+			p->name[sizeof p->name - 1] = '\0';
+		}
+	}
+
+	if((ps->flags & PROCSAMPLE_MEMORY) && requery) {
+		p->total_memory = memory_usage(p->fd);
+	}
+
+	if(ps->flags & PROCSAMPLE_THREADS) {
+		if(requery || p->time_used != 0) {
+			if(sample_threads(ps, p) == -1) {
+				return -1;
+			}
+		} else {
+			procsample_thread_t		*t;
+
+			/* No cpu consumed by any thread, the cached status is current */
+			for(t = p->thread_list; t; t = t->next) {
+				t->time_used = 0;
+				t->stamp = ps->stamp;
+			}
+		}
+	}
+
+	if(ps->flags & PROCSAMPLE_NOFDCACHE) {
+		close(p->fd);
+		p->fd = -1;
+	}
+
+	p->stamp = ps->stamp;
+	**tailp = p;
+	*tailp = &p->next;
+	ps->n_processes++;
+	ps->n_threads += (ps->flags & PROCSAMPLE_THREADS) ? p->n_threads : info.num_threads;
+	return 0;
+}
+
+procsample_t *procsample_create(const char *node, unsigned flags) {
+	procsample_t		*ps;
+
+	if(!(ps = calloc(1, sizeof *ps))) {
+		return NULL;
+	}
+	ps->flags = flags;
+	if(node == NULL || node[0] == '\0') {
+		strcpy(ps->path, "/proc");
+	} else {
+		snprintf(ps->path, sizeof ps->path, "/net/%s/proc", node);
+	}
+	return ps;
+}
+
+void procsample_destroy(procsample_t *ps) {
+	int					i;
+
+	for(i = 0; i < HASH_SIZE; i++) {
+		while(ps->hash[i]) {
+			free_proc(ps, ps->hash[i]);
+		}
+	}
+	if(ps->dir) {
+		closedir(ps->dir);
+	}
+	free(ps->watch);
+	free(ps);
+}
+
+int procsample_watch(procsample_t *ps, pid_t pid) {
+	pid_t				*watch;
+
+	if(!(watch = realloc(ps->watch, (ps->nwatch + 1) * sizeof *watch))) {
+		errno = ENOMEM;
+		return -1;
+	}
+	ps->watch = watch;
+	ps->watch[ps->nwatch++] = pid;
+	return 0;
+}
+
+/*
+ * Drop the processes which weren't seen by the latest sample.  The scan
+ * relinks the survivors, so go through the hash rather than the old list.
+ */
+static void sweep(procsample_t *ps) {
+	procsample_proc_t	*p, *next;
+	int					i;
+
+	for(i = 0; i < HASH_SIZE; i++) {
+		for(p = ps->hash[i]; p; p = next) {
+			next = p->hash;
+			if(p->stamp != ps->stamp) {
+				free_proc(ps, p);
+			}
+		}
+	}
+}
+
+int procsample_update(procsample_t *ps) {
+	procsample_proc_t	**tail;
+	struct timespec		ts;
+	uint64_t			now;
+	int					i;
+
+	if(ps->nwatch == 0 && ps->dir == NULL && !(ps->dir = opendir(ps->path))) {
+		return -1;
+	}
+
+	ps->stamp++;
+	ps->n_processes = ps->n_threads = 0;
+	tail = &ps->list;
+
+	if(ps->nwatch) {
+		for(i = 0; i < ps->nwatch; i++) {
+			if(sample_proc(ps, ps->watch[i], &tail) == -1) {
+				goto fail;
+			}
+		}
+	} else {
+		struct dirent		*dirent;
+
+		rewinddir(ps->dir);
+		while((dirent = readdir(ps->dir))) {
+			if(isdigit(dirent->d_name[0]) &&
+			   sample_proc(ps, atoi(dirent->d_name), &tail) == -1) {
+				goto fail;
+			}
+		}
+	}
+	*tail = NULL;
+	sweep(ps);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = timespec2nsec(&ts);
+	ps->interval = ps->last_time ? now - ps->last_time : 0;
+	ps->last_time = now;
+
+	return ps->n_processes;
+
+fail:
+	*tail = NULL;
+	sweep(ps);
+	errno = ENOMEM;
+	return -1;
+}
+
+procsample_proc_t *procsample_first(procsample_t *ps) {
+	return ps->list;
+}
+
+int procsample_nprocesses(procsample_t *ps) {
+	return ps->n_processes;
+}
+
+int procsample_nthreads(procsample_t *ps) {
+	return ps->n_threads;
+}
+
+uint64_t procsample_interval(procsample_t *ps) {
+	return ps->interval;
+}
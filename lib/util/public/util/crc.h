@@ -0,0 +1,57 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+#ifndef __CRC_H_INCLUDED
+#define __CRC_H_INCLUDED
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/*
+ * CRC and checksum engine.
+ *
+ * crc_posix()		CRC of POSIX cksum: polynomial 0x04c11db7, most
+ *					significant bit first, no inversion.  Start with 0,
+ *					feed the data through, then crc_posix_end() folds in
+ *					the total length and inverts, giving what cksum prints.
+ * crc_ieee()		CRC-32 of gzip, zip and zlib's crc32(): 0xedb88320
+ *					reflected, inverted on entry and exit, so start with 0
+ *					and the result of one call is the seed for the next.
+ * crc_adler32()	Adler-32 as zlib's adler32(); start with 1.
+ *
+ * Table driven code (8 or 16 bytes a step) runs everywhere.  On x86 the
+ * carry-less multiply (PCLMULQDQ) and SSSE3 kernels are used instead for
+ * long buffers when the cpu has them; crc_engine() names what was chosen.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint32_t crc_posix(uint32_t crc, const void *buf, size_t len);
+extern uint32_t crc_posix_end(uint32_t crc, uint64_t len);
+extern uint32_t crc_ieee(uint32_t crc, const void *buf, size_t len);
+extern uint32_t crc_adler32(uint32_t adler, const void *buf, size_t len);
+extern const char *crc_engine(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
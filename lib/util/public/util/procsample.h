@@ -0,0 +1,96 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ *
+ * You must obtain a written license from and pay applicable license fees to QNX
+ * Software Systems before you may reproduce, modify or distribute this software,
+ * or any work that includes all or part of this software.   Free development
+ * licenses are available for evaluation and non-commercial purposes.  For more
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *
+ * This file may contain contributions from others.  Please review this entire
+ * file for other proprietary rights or license notices, as well as the QNX
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/
+ * for other information.
+ * $
+ */
+
+
+
+#ifndef __PROCSAMPLE_H_INCLUDED
+#define __PROCSAMPLE_H_INCLUDED
+
+#include <limits.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/procfs.h>
+
+__BEGIN_DECLS
+
+/*
+ * Incremental process sampler.
+ *
+ * A procsample_t keeps one procsample_proc_t per live pid across calls
+ * to procsample_update().  Only the DCMD_PROC_INFO devctl is issued for
+ * every process on every sample; names, memory maps and thread lists
+ * are re-read only when a process is new (or its pid was reused), when
+ * its thread count changed, or (for threads) when it consumed cpu since
+ * the previous sample.  CPU usage is reported as deltas against the
+ * counters cached from the previous sample.
+ */
+
+typedef struct procsample			procsample_t;
+typedef struct procsample_proc		procsample_proc_t;
+typedef struct procsample_thread	procsample_thread_t;
+
+struct procsample_thread {
+	procsample_thread_t	*next;			/* ascending tid order */
+	procsample_proc_t	*up;
+	procfs_status		status;
+	uint64_t			time_used;		/* sutime consumed since previous sample (nsec) */
+	unsigned			stamp;
+};
+
+struct procsample_proc {
+	procsample_proc_t	*next;			/* next process in /proc scan order */
+	procsample_proc_t	*hash;
+	procfs_info			info;
+	uint64_t			time_used;		/* utime+stime consumed since previous sample (nsec) */
+	int32_t				total_memory;	/* -1 unless PROCSAMPLE_MEMORY */
+	int					n_threads;		/* entries on thread_list */
+	procsample_thread_t	*thread_list;
+	unsigned			flags;			/* PROCSAMPLE_PF_* */
+	unsigned			stamp;
+	int					fd;
+	char				name[_POSIX_PATH_MAX];
+};
+
+/* procsample_create() flags */
+#define PROCSAMPLE_NAMES		0x00000001	/* fill in procsample_proc_t.name */
+#define PROCSAMPLE_THREADS		0x00000002	/* maintain the per thread lists */
+#define PROCSAMPLE_MEMORY		0x00000004	/* fill in procsample_proc_t.total_memory */
+#define PROCSAMPLE_NOFDCACHE	0x00000008	/* don't keep /proc fds open between samples */
+
+/* procsample_proc_t.flags */
+#define PROCSAMPLE_PF_NEW		0x00000001	/* first seen by the latest sample */
+#define PROCSAMPLE_PF_REQUERY	0x00000002	/* name/map/threads re-read by the latest sample */
+
+extern procsample_t *procsample_create(const char *node, unsigned flags);
+extern void procsample_destroy(procsample_t *ps);
+
+/* Restrict sampling to the given pid instead of scanning /proc */
+extern int procsample_watch(procsample_t *ps, pid_t pid);
+
+/* Take a new sample; returns the number of processes or -1 (errno set) */
+extern int procsample_update(procsample_t *ps);
+
+extern procsample_proc_t *procsample_first(procsample_t *ps);
+extern int procsample_nprocesses(procsample_t *ps);
+extern int procsample_nthreads(procsample_t *ps);
+
+/* Wall clock time between the last two samples (nsec) */
+extern uint64_t procsample_interval(procsample_t *ps);
+
+__END_DECLS
+
+#endif
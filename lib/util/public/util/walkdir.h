@@ -0,0 +1,88 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+#ifndef __WALKDIR_H_INCLUDED
+#define __WALKDIR_H_INCLUDED
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/*
+ * Directory reader for the tools that walk trees (find, du, grep -r,
+ * cp -R).  It replaces opendir()/readdir()/closedir() and hands back
+ * each entry with its lstat() (or, with WALKDIR_FOLLOW, stat()) data.
+ *
+ * walkdir_open()	opens a directory; NULL with errno set as opendir().
+ * walkdir_read()	the next entry, in the order readdir() returned them.
+ *					NULL at the end, with errno set if readdir() failed
+ *					and unchanged otherwise.  The entry stays valid until
+ *					the next walkdir_read() or walkdir_close() of the
+ *					same directory; if err is not 0 the stat failed with
+ *					that errno and st is meaningless.
+ * walkdir_close()	closes it, returns as closedir().
+ * walkdir_threads()	how many threads may stat entries (default 4);
+ *					0 does everything in the caller.  Set it before the
+ *					first walkdir_open().
+ * walkdir_skip()	directories for which skip(path) is nonzero are never
+ *					read ahead (see WALKDIR_PREFETCH).
+ *
+ * Entries are read from the directory a batch at a time.  Those whose
+ * stat data came with them (D_FLAG_STAT) need nothing more, the rest are
+ * stat'ed by the threads, the caller doing the work itself rather than
+ * waiting for a request nobody has picked up yet.  The next batch is
+ * read while the caller goes through this one.
+ *
+ * With WALKDIR_PREFETCH the subdirectories coming up (ones on the same
+ * device as their parent) are opened and their first batch read ahead,
+ * so the caller finds them ready when it recurses into them with
+ * walkdir_open() on "parent/name" while the parent is still open.  The
+ * caller decides the order everything is visited in, so the tools' output
+ * is the same as with readdir(), but what is read ahead can be stale by
+ * the time it is returned; leave it off if the caller changes the tree.
+ *
+ * All the calls must come from one thread.
+ */
+
+#define WALKDIR_FOLLOW		0x0001	/* stat() the entries instead of lstat() */
+#define WALKDIR_DOTS		0x0002	/* return "." and ".." as well */
+#define WALKDIR_PREFETCH	0x0004	/* read subdirectories ahead */
+
+typedef struct walkdir walkdir_t;
+
+struct walkdir_ent {
+	char		*name;
+	int			err;
+	struct stat	st;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern walkdir_t *walkdir_open(const char *path, unsigned flags);
+extern struct walkdir_ent *walkdir_read(walkdir_t *wd);
+extern int walkdir_close(walkdir_t *wd);
+extern void walkdir_threads(int nthreads);
+extern void walkdir_skip(int (*skip)(const char *path));
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,645 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+#ifdef __MINGW32__
+#  include <lib/compat.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <util/stat_optimiz.h>
+#include <util/walkdir.h>
+
+#if defined(__QNXNTO__) || defined(__linux__) || defined(__sun)
+#define WALK_THREADS	1
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#define WALK_BATCH		128		/* entries read from a directory at a time */
+#define WALK_CHUNK		16		/* entries stat'ed by one request */
+#define WALK_AHEAD		16		/* most directories read ahead at once */
+#define WALK_NTHREADS	4
+
+#define T_IDLE		0
+#define T_QUEUED	1
+#define T_RUNNING	2
+#define T_DONE		3
+
+/*
+ * A piece of work: reading a batch, stat'ing a chunk of one, or opening
+ * a directory that is being read ahead.  fn runs without the lock, post
+ * (if any) with it, before the task is marked done.
+ */
+struct task {
+	struct task		*next, *prev;
+	struct queue	*q;
+	int				state;
+	void			(*fn)(struct task *);
+	void			(*post)(struct task *);
+	struct walkdir	*wd;
+	struct batch	*b;
+	int				first;
+};
+
+struct queue {
+	struct task		*head, *tail;
+};
+
+struct batch {
+	struct batch		*next;
+	int					n;			/* entries in it */
+	int					pos;		/* next one walkdir_read() returns */
+	char				*names;
+	struct task			fill;
+	struct task			chunk[WALK_BATCH / WALK_CHUNK];
+	unsigned char		have[WALK_BATCH];	/* stat came with the dirent */
+	struct walkdir_ent	ent[WALK_BATCH];
+};
+
+struct walkdir {
+	struct walkdir	*up;			/* the one opened before it */
+	struct walkdir	*kids;			/* subdirectories read ahead, in order */
+	struct walkdir	*sibling;
+	DIR				*dirp;
+	char			*path;
+	unsigned		flags;
+	int				eof;
+	int				err;
+	struct batch	*cur;
+	int				scan;			/* next entry of cur to look at for read ahead */
+	int				have_dev;
+	dev_t			dev;
+	struct task		open;			/* opening it, while it is read ahead */
+};
+
+static struct queue		urgent, background;
+static struct walkdir	*top;
+static int				nahead;
+static int				nthreads = WALK_NTHREADS;
+static int				(*skipfn)(const char *path);
+
+#ifdef WALK_THREADS
+static pthread_mutex_t	walk_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	walk_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	walk_done = PTHREAD_COND_INITIALIZER;
+static int				nstarted;
+
+#define LOCK()		pthread_mutex_lock(&walk_mutex)
+#define UNLOCK()	pthread_mutex_unlock(&walk_mutex)
+#define WAIT_DONE()	pthread_cond_wait(&walk_done, &walk_mutex)
+#define DONE()		pthread_cond_broadcast(&walk_done)
+#else
+#define LOCK()
+#define UNLOCK()
+#define WAIT_DONE()
+#define DONE()
+#endif
+
+static void enqueue(struct queue *q, struct task *t);
+
+static void unqueue(struct task *t)
+{
+	struct queue	*q = t->q;
+
+	if (t->prev) t->prev->next = t->next;
+	else q->head = t->next;
+	if (t->next) t->next->prev = t->prev;
+	else q->tail = t->prev;
+	t->next = t->prev = NULL;
+	t->q = NULL;
+}
+
+/* Called with the lock held, which is dropped while fn runs */
+static void run(struct task *t)
+{
+	t->state = T_RUNNING;
+	UNLOCK();
+	t->fn(t);
+	LOCK();
+	if (t->post) t->post(t);
+	t->state = T_DONE;
+	DONE();
+}
+
+/* Wait for a task, doing it here if no thread has started on it */
+static void finish(struct task *t)
+{
+	while (t->state != T_DONE && t->state != T_IDLE) {
+		if (t->state == T_QUEUED) {
+			unqueue(t);
+			run(t);
+		} else {
+			WAIT_DONE();
+		}
+	}
+}
+
+/* Make sure a task is not running and won't be, before it is freed */
+static void cancel(struct task *t)
+{
+	while (t->state == T_RUNNING) {
+		WAIT_DONE();
+	}
+	if (t->state == T_QUEUED) {
+		unqueue(t);
+		t->state = T_IDLE;
+	}
+}
+
+#ifdef WALK_THREADS
+static struct task *dequeue(struct queue *q)
+{
+	struct task	*t;
+
+	if ((t = q->head) != NULL) unqueue(t);
+	return t;
+}
+
+static void *worker(void *arg)
+{
+	struct task	*t;
+
+	LOCK();
+	for (;;) {
+		if ((t = dequeue(&urgent)) == NULL && (t = dequeue(&background)) == NULL) {
+			pthread_cond_wait(&walk_work, &walk_mutex);
+			continue;
+		}
+		run(t);
+	}
+	return NULL;
+}
+
+static void start_worker(void)
+{
+	pthread_attr_t	attr;
+	pthread_t		tid;
+	sigset_t		set, old;
+
+	/* Signals are for the thread that is doing what the tool asked */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &old);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&tid, &attr, worker, NULL) == 0) {
+		nstarted++;
+	} else {
+		nthreads = nstarted;
+	}
+	pthread_attr_destroy(&attr);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+#endif
+
+static void enqueue(struct queue *q, struct task *t)
+{
+	t->state = T_QUEUED;
+	t->q = q;
+	t->next = NULL;
+	if ((t->prev = q->tail) != NULL) t->prev->next = t;
+	else q->head = t;
+	q->tail = t;
+#ifdef WALK_THREADS
+	if (nstarted < nthreads) start_worker();
+	else pthread_cond_signal(&walk_work);
+#endif
+}
+
+static int isdots(const char *name)
+{
+	return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+static char *join(const char *dir, const char *name)
+{
+	size_t	len = strlen(dir);
+	char	*path;
+
+	if ((path = malloc(len + strlen(name) + 2)) != NULL) {
+		memcpy(path, dir, len);
+		if (len && dir[len - 1] != '/') path[len++] = '/';
+		strcpy(path + len, name);
+	}
+	return path;
+}
+
+static void set_dflags(DIR *dirp)
+{
+#ifdef __QNXNTO__
+	int		dirflags;
+
+	/* ask for the stat data with the entries; failure just costs a stat each */
+	if ((dirflags = dircntl(dirp, D_GETFLAG)) != -1) {
+		dircntl(dirp, D_SETFLAG, dirflags | D_FLAG_STAT);
+	}
+#endif
+}
+
+/*
+ * Read the next batch of entries.  Only the task reading a batch of a
+ * directory touches its DIR, and there is never more than one.
+ */
+static void fill(struct task *t)
+{
+	struct walkdir	*wd = t->wd;
+	struct batch	*b = t->b;
+	struct dirent	*d;
+	size_t			off[WALK_BATCH];
+	size_t			used = 0, size = 0, len;
+	char			*names = NULL, *p;
+	int				n = 0, i;
+
+	while (n < WALK_BATCH) {
+		errno = 0;
+		if ((d = readdir(wd->dirp)) == NULL) {
+			wd->err = errno;
+			wd->eof = 1;
+			break;
+		}
+		if (!(wd->flags & WALKDIR_DOTS) && isdots(d->d_name)) {
+			continue;
+		}
+		len = strlen(d->d_name) + 1;
+		if (used + len > size) {
+			do {
+				size = size ? size * 2 : 2048;
+			} while (used + len > size);
+			if ((p = realloc(names, size)) == NULL) {
+				wd->err = ENOMEM;
+				wd->eof = 1;
+				break;
+			}
+			names = p;
+		}
+		memcpy(names + used, d->d_name, len);
+		off[n] = used;
+		used += len;
+		if (wd->flags & WALKDIR_FOLLOW) {
+			b->have[n] = (stat_optimize(d, &b->ent[n].st) != -1);
+		} else {
+			b->have[n] = (lstat_optimize(d, &b->ent[n].st) != -1);
+		}
+		b->ent[n].err = 0;
+		n++;
+	}
+	for (i = 0; i < n; i++) {
+		b->ent[i].name = names + off[i];
+	}
+	b->names = names;
+	b->n = n;
+}
+
+static void stat_chunk(struct task *t)
+{
+	struct walkdir		*wd = t->wd;
+	struct batch		*b = t->b;
+	struct walkdir_ent	*e;
+	size_t				dlen = strlen(wd->path), nlen, max = 0;
+	char				*path;
+	int					i, end = t->first + WALK_CHUNK;
+
+	if (end > b->n) end = b->n;
+	for (i = t->first; i < end; i++) {
+		if (!b->have[i] && (nlen = strlen(b->ent[i].name)) > max) max = nlen;
+	}
+	if ((path = malloc(dlen + max + 2)) == NULL) {
+		for (i = t->first; i < end; i++) {
+			if (!b->have[i]) b->ent[i].err = ENOMEM;
+		}
+		return;
+	}
+	memcpy(path, wd->path, dlen);
+	if (dlen && path[dlen - 1] != '/') path[dlen++] = '/';
+	for (i = t->first; i < end; i++) {
+		if (b->have[i]) continue;
+		e = &b->ent[i];
+		strcpy(path + dlen, e->name);
+		if (((wd->flags & WALKDIR_FOLLOW) ? stat(path, &e->st) : lstat(path, &e->st)) == -1) {
+			e->err = errno;
+		}
+	}
+	free(path);
+}
+
+/* After a batch is read, queue stats for the entries that still need them */
+static void fill_post(struct task *t)
+{
+	struct batch	*b = t->b;
+	struct task		*c;
+	int				i, j;
+
+	for (i = 0; i * WALK_CHUNK < b->n; i++) {
+		c = &b->chunk[i];
+		c->fn = stat_chunk;
+		c->post = NULL;
+		c->wd = t->wd;
+		c->b = b;
+		c->first = i * WALK_CHUNK;
+		c->state = T_DONE;
+		for (j = c->first; j < c->first + WALK_CHUNK && j < b->n; j++) {
+			if (!b->have[j]) {
+				enqueue(t->wd->open.fn ? &background : &urgent, c);
+				break;
+			}
+		}
+	}
+}
+
+static struct batch *new_batch(struct walkdir *wd)
+{
+	struct batch	*b;
+
+	if ((b = calloc(1, sizeof *b)) != NULL) {
+		b->fill.fn = fill;
+		b->fill.post = fill_post;
+		b->fill.wd = wd;
+		b->fill.b = b;
+	}
+	return b;
+}
+
+static void free_batch(struct batch *b)
+{
+	int		i;
+
+	cancel(&b->fill);
+	for (i = 0; i < WALK_BATCH / WALK_CHUNK; i++) {
+		cancel(&b->chunk[i]);
+	}
+	free(b->names);
+	free(b);
+}
+
+static struct walkdir *new_walkdir(char *path, unsigned flags)
+{
+	struct walkdir	*wd;
+
+	if ((wd = calloc(1, sizeof *wd)) == NULL) {
+		free(path);
+		return NULL;
+	}
+	wd->path = path;
+	wd->flags = flags;
+	if ((wd->cur = new_batch(wd)) == NULL) {
+		free(path);
+		free(wd);
+		return NULL;
+	}
+	return wd;
+}
+
+static void free_walkdir(struct walkdir *wd);
+
+/* Drop a subdirectory that was read ahead but is not wanted after all */
+static void drop_kid(struct walkdir *kid)
+{
+	cancel(&kid->open);
+	nahead--;
+	if (kid->dirp != NULL) closedir(kid->dirp);
+	free_walkdir(kid);
+}
+
+static void free_walkdir(struct walkdir *wd)
+{
+	struct walkdir	*kid;
+	struct batch	*b;
+
+	while ((kid = wd->kids) != NULL) {
+		wd->kids = kid->sibling;
+		drop_kid(kid);
+	}
+	while ((b = wd->cur) != NULL) {
+		wd->cur = b->next;
+		free_batch(b);
+	}
+	free(wd->path);
+	free(wd);
+}
+
+static void open_ahead(struct task *t)
+{
+	struct walkdir	*wd = t->wd;
+
+	if ((wd->dirp = opendir(wd->path)) == NULL) {
+		wd->err = errno;
+		wd->eof = 1;
+		return;
+	}
+	set_dflags(wd->dirp);
+	fill(&wd->cur->fill);
+}
+
+static void open_ahead_post(struct task *t)
+{
+	struct walkdir	*wd = t->wd;
+
+	if (wd->dirp != NULL) {
+		fill_post(&wd->cur->fill);
+	}
+	wd->cur->fill.state = T_DONE;
+}
+
+/*
+ * Start reading ahead the subdirectories among the entries after the one
+ * being returned, as far as their stats are in.
+ */
+static void read_ahead(struct walkdir *wd, struct batch *b, int i)
+{
+	struct walkdir		*kid, **tail;
+	struct walkdir_ent	*e;
+	char				*path;
+
+	if (wd->scan <= i) wd->scan = i + 1;
+	for (tail = &wd->kids; *tail != NULL; tail = &(*tail)->sibling) {
+		/* nothing */
+	}
+	while (wd->scan < b->n && nahead < WALK_AHEAD) {
+		if (b->chunk[wd->scan / WALK_CHUNK].state != T_DONE) break;
+		e = &b->ent[wd->scan++];
+		if (e->err || !S_ISDIR(e->st.st_mode) || isdots(e->name)) continue;
+		if (!wd->have_dev || e->st.st_dev != wd->dev) continue;
+		if ((path = join(wd->path, e->name)) == NULL) break;
+		if (skipfn != NULL && skipfn(path)) {
+			free(path);
+			continue;
+		}
+		if ((kid = new_walkdir(path, wd->flags)) == NULL) break;
+		kid->have_dev = 1;
+		kid->dev = e->st.st_dev;
+		kid->open.fn = open_ahead;
+		kid->open.post = open_ahead_post;
+		kid->open.wd = kid;
+		*tail = kid;
+		tail = &kid->sibling;
+		nahead++;
+		enqueue(&background, &kid->open);
+	}
+}
+
+/*
+ * If the directory being opened was read ahead, take it over.  Any read
+ * ahead before it were skipped by the caller, so are dropped.
+ */
+static struct walkdir *adopt(const char *path, unsigned flags)
+{
+	struct walkdir	*kid;
+
+	if (top == NULL) return NULL;
+	for (kid = top->kids; kid != NULL; kid = kid->sibling) {
+		if (kid->flags == flags && strcmp(kid->path, path) == 0) break;
+	}
+	if (kid == NULL) return NULL;
+	while (top->kids != kid) {
+		struct walkdir	*skipped = top->kids;
+
+		top->kids = skipped->sibling;
+		drop_kid(skipped);
+	}
+	top->kids = kid->sibling;
+	kid->sibling = NULL;
+	nahead--;
+	finish(&kid->open);
+	kid->open.fn = NULL;
+	return kid;
+}
+
+walkdir_t *walkdir_open(const char *path, unsigned flags)
+{
+	struct walkdir	*wd;
+	struct stat		st;
+	DIR				*dirp;
+	char			*p;
+	int				err;
+
+	LOCK();
+	if ((wd = adopt(path, flags)) != NULL) {
+		if (wd->dirp == NULL) {
+			err = wd->err;
+			free_walkdir(wd);
+			UNLOCK();
+			errno = err;
+			return NULL;
+		}
+		wd->up = top;
+		top = wd;
+		UNLOCK();
+		return wd;
+	}
+	UNLOCK();
+
+	if ((dirp = opendir(path)) == NULL) {
+		return NULL;
+	}
+	if ((p = strdup(path)) == NULL || (wd = new_walkdir(p, flags)) == NULL) {
+		closedir(dirp);
+		errno = ENOMEM;
+		return NULL;
+	}
+	wd->dirp = dirp;
+	set_dflags(dirp);
+	if ((flags & WALKDIR_PREFETCH) && nthreads > 0 &&
+			((flags & WALKDIR_FOLLOW) ? stat(path, &st) : lstat(path, &st)) == 0) {
+		wd->have_dev = 1;
+		wd->dev = st.st_dev;
+	}
+
+	LOCK();
+	run(&wd->cur->fill);
+	wd->up = top;
+	top = wd;
+	UNLOCK();
+	return wd;
+}
+
+struct walkdir_ent *walkdir_read(walkdir_t *wd)
+{
+	struct batch	*b, *next;
+	int				saved = errno, i;
+
+	LOCK();
+	for (;;) {
+		if ((b = wd->cur) == NULL) {
+			UNLOCK();
+			errno = wd->err ? wd->err : saved;
+			return NULL;
+		}
+		if (b->pos < b->n) break;
+
+		/* this batch is used up, go on to the next one */
+		if (b->next == NULL && !wd->eof) {
+			if ((b->next = new_batch(wd)) == NULL) {
+				wd->err = ENOMEM;
+				wd->eof = 1;
+			} else {
+				enqueue(&urgent, &b->next->fill);
+			}
+		}
+		next = b->next;
+		if (next != NULL) finish(&next->fill);
+		wd->cur = next;
+		wd->scan = 0;
+		b->next = NULL;
+		free_batch(b);
+	}
+
+	i = b->pos++;
+	finish(&b->chunk[i / WALK_CHUNK]);
+	if (i == 0 && b->next == NULL && !wd->eof && (b->next = new_batch(wd)) != NULL) {
+		enqueue(&urgent, &b->next->fill);
+	}
+	if (wd->have_dev) {
+		read_ahead(wd, b, i);
+	}
+	UNLOCK();
+	errno = saved;
+	return &b->ent[i];
+}
+
+int walkdir_close(walkdir_t *wd)
+{
+	struct walkdir	**wpp;
+	DIR				*dirp;
+
+	LOCK();
+	for (wpp = &top; *wpp != NULL; wpp = &(*wpp)->up) {
+		if (*wpp == wd) {
+			*wpp = wd->up;
+			break;
+		}
+	}
+	dirp = wd->dirp;
+	free_walkdir(wd);
+	UNLOCK();
+	return closedir(dirp);
+}
+
+void walkdir_threads(int n)
+{
+	LOCK();
+	nthreads = (n < 0) ? 0 : n;
+	UNLOCK();
+}
+
+void walkdir_skip(int (*skip)(const char *path))
+{
+	skipfn = skip;
+}
@@ -24,10 +24,6 @@ endef
 INSTALLDIR_qnx4=lib
 INSTALLDIR=$(firstword $(INSTALLDIR_$(OS)) usr/lib)
 
-# PR/15688 appears to be a -O1 codegen bug in GCC in "infcodes.c" line 200-201
-CCOPTS_nto_infcodes.c=-Wc,-O0
-override CCOPTS+=$(CCOPTS_$(OS)_$(<F))
-
 EXCLUDE_OBJS = example.o
 
 include $(MKFILES_ROOT)/qtargets.mk
@@ -22,10 +22,13 @@
 #include "cron.h"
 #include <syslog.h>
 #include <limits.h>
+#include <sys/stat.h>
 
 static int listed(char *file, char *user);
 static int not_authorized(char *user);
 static char * parse_ctab(char * line, unsigned long * tim);
+static time_t next_fire(cron_job * job, time_t after);
+static void heap_build(time_t now, int reschedule);
 
 /* called by sys dependant routines */
 void message(int stream, char *fmt, ...);
@@ -51,6 +54,9 @@ void trigger(cron_job * job);
 
 const int limits[NUM_TIMES] = { 59, 23, 31, 12, 6 };
 
+/* How far ahead to look for a job's next run; the calendar repeats every 28 years */
+#define LOOKAHEAD (28 * 366)
+
 /* Names for the different kinds of message() */
 #define LOG   1        /* Only with -v           */
 #define FATAL 2        /* Fatal                  */
@@ -59,8 +65,23 @@ const int limits[NUM_TIMES] = { 59, 23, 31, 12, 6 };
 
 extern char * crondir; /* Set by the sys dependant main routine */
 
-/*  Allows cron_jobs to be reloaded by a signal handler */
-static cron_job * cron_jobs;
+/*  The compiled form of one crontab.  It is read again only when
+ *  its file has changed.
+ */
+typedef struct cron_tab {
+	struct cron_tab * next;
+	cron_job *  jobs;
+	uid_t       user;
+	time_t      mtime;   /* of the file when it was read */
+	off_t       size;
+	ino_t       ino;
+	time_t      loaded;  /* when it was read, 0 if it wasn't */
+	int         seen;
+	char        name[1];
+} cron_tab;
+
+/*  Allows cron_tabs to be reloaded by a signal handler */
+static cron_tab * cron_tabs;
 
 /*  Extra parameters to the message() function, set by the main()
  *  function when parsing options.
@@ -199,33 +220,111 @@ static int not_authorized(char *user) {
     return 1;
 }
 
+/* Throw out the jobs of a crontab */
+static void ctab_free(cron_tab * tab) {
+	cron_job * job_tmp, * job_index = tab->jobs;
+
+	while(job_index != NULL) {
+		assert(job_index->command != NULL);
+		free(job_index->command);
+		job_tmp = job_index->next;
+		free(job_index);
+		job_index = job_tmp;
+	}
+	tab->jobs = NULL;
+}
+
+/*  Compiles the lines of one crontab into its job list.
+ *  Each job gets the time of its first run after 'after'.
+ */
+static void ctab_parse(cron_tab * tab, FILE * fp, time_t after) {
+	char entrybuf[TAB_BUFFER_SIZE];
+	unsigned long crtime[TIMES_ELEMENTS];
+	char * command;
+	char * comptr;
+	cron_job * job_tmp;
+	int lineno;
+
+	lineno = 0; /* loop through lines in crontab */
+	while(fgets(entrybuf, TAB_BUFFER_SIZE, fp) != NULL) {
+		++lineno;
+
+		comptr = entrybuf; /* translate '%' and truncate '\n' */
+		while(comptr = strpbrk(comptr, "\n%")) {
+			if(*comptr == '%') {
+				if(*(comptr - 1) == '\\')
+					memmove(comptr - 1, comptr, strlen(comptr) + 1);
+				else {
+					*comptr = '\n';
+					++comptr;
+				}
+			} else {
+				*comptr = '\0';
+				break; /* newline found, comptr non-null */
+			}
+		}
+
+		if(comptr == NULL && !feof(fp)) {
+			message(LOG, "line too long in crontab: %s %d", tab->name, lineno);
+			while(fgets(entrybuf, TAB_BUFFER_SIZE, fp) != NULL) {
+				if(NULL != strchr(entrybuf, '\n')) 
+					break;
+			}
+			continue; /* Couldn't use this entry */
+		}
+
+		if(entrybuf[0] == '#' || entrybuf[0] == '\0')
+			continue;
+
+		if((command = parse_ctab(entrybuf, crtime)) == NULL) {
+			message(LOG, "invalid crontab: %s line %d", tab->name, lineno);
+			continue;
+		}
+
+		if(((job_tmp = malloc(sizeof(cron_job))) == NULL)
+		 || ((job_tmp->command = strdup(command)) == NULL)) {
+			message(EVENT, "%s: %s", tab->name, strerror(errno));
+			free(job_tmp); /* may be NULL */
+			break;
+		}
+
+		job_tmp->next = tab->jobs; /* Enlist job */
+		tab->jobs = job_tmp; 
+
+		memcpy(job_tmp->time, crtime, sizeof crtime);
+
+		job_tmp->user = tab->user;
+		job_tmp->when = next_fire(job_tmp, after);
+	}
+}
+
 /* Load the crontabs */
 void ctab_load(int signo) {
     DIR *dirp;
-    cron_job * job_tmp, * job_index = cron_jobs;
+    cron_tab * tab, ** tabp;
+    struct tm tm;
+    time_t now, after;
 
     if(signo)
 		message(LOG, "crontab update" );
 
-    /* Throw out the old cron table entries */
-    while(job_index != NULL) {
-		assert(job_index->command != NULL);
-		free(job_index->command);
-		job_tmp = job_index->next;
-		free(job_index);
-		job_index = job_tmp;
-    }
-    cron_jobs = NULL;
+    for(tab = cron_tabs; tab != NULL; tab = tab->next)
+		tab->seen = 0;
+    time(&now);
+
+    /* When cron starts, the jobs for the current min are still due */
+    after = now;
+    if(!signo && localtime_r(&now, &tm) != NULL)
+		after -= tm.tm_sec + 1;
 
-    /* read all crontabs */
+    /*  Read the crontabs that are new or have changed since they were
+     *  last read, the jobs of the others keep their compiled times.
+     */
     if (dirp = opendir("crontabs/")) {
 		struct dirent *dent;
 		char entrybuf[TAB_BUFFER_SIZE];
-		unsigned long crtime[TIMES_ELEMENTS];
-		char * command;
-		char * comptr;
+		struct stat st;
 		FILE * fp;
-		int lineno;
 		struct passwd * pwinfo;
 
 		while (dent = readdir(dirp)) { /* Loop through crontabs */
@@ -242,61 +341,46 @@ void ctab_load(int signo) {
 				continue;
 			}
 			strcat(strcpy(entrybuf, "crontabs/"), dent->d_name);
-			if((fp = fopen(entrybuf, "r")) == NULL) {
+			if(stat(entrybuf, &st) == -1) {
 				message(EVENT, "%s: %s", entrybuf, strerror(errno));
 				continue;
 			}
 
-			lineno = 0; /* loop through lines in crontab */
-			while(fgets(entrybuf, TAB_BUFFER_SIZE, fp) != NULL) {
-				++lineno;
-
-				comptr = entrybuf; /* translate '%' and truncate '\n' */
-				while(comptr = strpbrk(comptr, "\n%")) {
-					if(*comptr == '%') {
-						if(*(comptr - 1) == '\\')
-							memmove(comptr - 1, comptr, strlen(comptr) + 1);
-						else {
-							*comptr = '\n';
-							++comptr;
-						}
-					} else {
-						*comptr = '\0';
-						break; /* newline found, comptr non-null */
-					}
-				}
-
-				if(comptr == NULL && !feof(fp)) {
-					message(LOG, "line too long in crontab: %s %d", dent->d_name, lineno);
-					while(fgets(entrybuf, TAB_BUFFER_SIZE, fp) != NULL) {
-						if(NULL != strchr(entrybuf, '\n')) 
-							break;
-					}
-					continue; /* Couldn't use this entry */
-				}
-
-				if(entrybuf[0] == '#' || entrybuf[0] == '\0')
-					continue;
-
-				if((command = parse_ctab(entrybuf, crtime)) == NULL) {
-					message(LOG, "invalid crontab: %s line %d", dent->d_name, lineno);
-					continue;
-				}
-
-				if(((job_tmp = malloc(sizeof(cron_job))) == NULL)
-				 || ((job_tmp->command = strdup(command)) == NULL)) {
-					message(EVENT, "%s: %s", dent->d_name, strerror(errno));
-					free(job_tmp); /* may be NULL */
+			for(tab = cron_tabs; tab != NULL; tab = tab->next) {
+				if(strcmp(tab->name, dent->d_name) == 0)
 					break;
+			}
+			if(tab == NULL) {
+				if((tab = calloc(1, sizeof *tab + strlen(dent->d_name))) == NULL) {
+					message(EVENT, "%s: %s", dent->d_name, strerror(errno));
+					continue;
 				}
+				strcpy(tab->name, dent->d_name);
+				tab->next = cron_tabs;
+				cron_tabs = tab;
+			}
+			tab->seen = 1;
+
+			/*  A file changed in the second it was read may have changed
+			 *  again without its mtime moving, so it is read once more.
+			 */
+			if(tab->loaded > st.st_mtime && st.st_mtime == tab->mtime
+			 && st.st_size == tab->size && st.st_ino == tab->ino
+			 && pwinfo->pw_uid == tab->user)
+				continue;
 
-				job_tmp->next = cron_jobs; /* Enlist job */
-				cron_jobs = job_tmp; 
-
-				memcpy(job_tmp->time, crtime, sizeof crtime);
-
-				job_tmp->user = pwinfo->pw_uid;
+			ctab_free(tab);
+			tab->loaded = 0;
+			if((fp = fopen(entrybuf, "r")) == NULL) {
+				message(EVENT, "%s: %s", entrybuf, strerror(errno));
+				continue;
 			}
+			tab->mtime = st.st_mtime;
+			tab->size = st.st_size;
+			tab->ino = st.st_ino;
+			tab->user = pwinfo->pw_uid;
+			ctab_parse(tab, fp, after);
+			tab->loaded = now;
 
 			fclose(fp);
 		}
@@ -305,125 +389,197 @@ void ctab_load(int signo) {
     } else {
 		message(FATAL, "%s/crontabs: %s", crondir, strerror(errno));
     }
+
+    /* Throw out the crontabs that have gone */
+    for(tabp = &cron_tabs; (tab = *tabp) != NULL; ) {
+		if(tab->seen) {
+			tabp = &tab->next;
+		} else {
+			*tabp = tab->next;
+			ctab_free(tab);
+			free(tab);
+		}
+    }
+
+    heap_build(now, 0);
 }
 
-#define INF INT_MAX
+static int month_days(int year, int mon) {
+	static const char days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
 
-/*  Returns INF if no bit is set at or beyond the 'time' bit in current_lo
- *  or 'time - 32' in current_hi. 
- *  Returns the 'time' for to the set bit otherwise.
+	if(mon == 1 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+		return 29;
+	return days[mon];
+}
+
+/*  Returns the first time after 'after' at which all of the job's fields
+ *  match, or -1 if there is none (e.g. 30 2 or 31 4 in the day and month).
+ *  Walks the calendar a day at a time and skips the months that are
+ *  not in the job; mktime() is only called for the matching minutes.
  */
-static int nexttime(int crtime, unsigned long current_hi, unsigned long current_lo, unsigned size) {
-	unsigned long 	index;
-	unsigned		term;
-
-	if(crtime < 32) {
-		index = 1 << crtime;
-		term = size;
-		if(term >= 32) term = 32;
-		while(crtime < term) {
-			if(current_lo & index) {
-				return crtime;
+static time_t next_fire(cron_job * job, time_t after) {
+	struct tm tm;
+	int year, mon, mday, wday, hour, min, days, n;
+	time_t t;
+
+	localtime_r(&after, &tm);
+	year = tm.tm_year + 1900;
+	mon  = tm.tm_mon;
+	mday = tm.tm_mday;
+	wday = tm.tm_wday;
+	hour = tm.tm_hour;
+	min  = tm.tm_min + 1;
+
+	for(days = 0; days < LOOKAHEAD; ) {
+		if(!(job->time[MON] & value_to_bit(mon + 1, unsigned long))) {
+			n = month_days(year, mon) - mday + 1;
+			days += n;
+			wday = (wday + n) % 7;
+			mday = 1;
+			if(++mon == 12) {
+				mon = 0;
+				++year;
 			}
-			++crtime;
-			index <<= 1;
+			hour = min = 0;
+			continue;
 		}
-		index = 1;
-	} else {
-		index = 1 << (crtime - 32);
-	}
-	while(crtime < size) {
-		if(current_hi & index) {
-			return crtime;
+
+		if((job->time[MDAY] & value_to_bit(mday, unsigned long))
+		  && (job->time[WDAY] & value_to_bit(wday, unsigned long))) {
+			for(; hour < 24; ++hour, min = 0) {
+				if(!(job->time[HOUR] & value_to_bit(hour, unsigned long)))
+					continue;
+				for(; min < 60; ++min) {
+					if(!(min < 32 ? job->time[MIN_LO] & value_to_bit(min, unsigned long)
+					  : job->time[MIN_HI] & value_to_bit(min - 32, unsigned long)))
+						continue;
+
+					/* A time skipped by a DST change comes out later */
+					memset(&tm, 0x0, sizeof tm);
+					tm.tm_year  = year - 1900;
+					tm.tm_mon   = mon;
+					tm.tm_mday  = mday;
+					tm.tm_hour  = hour;
+					tm.tm_min   = min;
+					tm.tm_isdst = -1;
+					if((t = mktime(&tm)) > after)
+						return t;
+				}
+			}
+		}
+
+		++days;
+		wday = (wday + 1) % 7;
+		hour = min = 0;
+		if(++mday > month_days(year, mon)) {
+			mday = 1;
+			if(++mon == 12) {
+				mon = 0;
+				++year;
+			}
 		}
-		++crtime;
-		index <<= 1;
 	}
 
-	return INF;
+	return -1;
 }
 
-/*  Does all jobs scheduled for the current min.
- *  Returns the number of seconds to sleep until the next job or -1
- *  to sleep till 00:00:00 am.
+/*  The jobs that can run, as a min-heap on the time of their next run */
+static cron_job ** heap;
+static int heap_num, heap_max;
+
+static void heap_down(int i) {
+	cron_job * job = heap[i];
+	int child;
+
+	while((child = 2 * i + 1) < heap_num) {
+		if(child + 1 < heap_num && heap[child + 1]->when < heap[child]->when)
+			++child;
+		if(job->when <= heap[child]->when)
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = job;
+}
+
+/*  (Re)builds the heap from all jobs.  With 'reschedule' the jobs'
+ *  next runs are computed again from 'now' first.
  */
-long do_jobs() {
-	register cron_job * job_index;
-	int nextmin, best_nextmin = 60;
-	int nexthr,  best_nexthr  = 23;
-	int tryhr;
-	int nowhr;
-	int nowmin;
-	long unsigned now_time[TIMES_ELEMENTS];
-	struct tm * now_tm; /* Used for formulating current_time */
-	time_t gmtm;
-	
-	time(&gmtm); /* place time in same array as used for jobs */
-	now_tm = localtime(&gmtm);
-	/* make a copy of these two since '*now_tm' data gets overwritten */
-	nowhr = now_tm->tm_hour; 
-	nowmin = now_tm->tm_min;
-	now_time[MDAY] = value_to_bit(now_tm->tm_mday, long unsigned); 
-	now_time[WDAY] = value_to_bit(now_tm->tm_wday, long unsigned); 
-	now_time[MON]  = value_to_bit(now_tm->tm_mon + 1, long unsigned);
-	now_time[HOUR] = value_to_bit(now_tm->tm_hour, long unsigned);
-	if(now_tm->tm_min < 32) {
-		now_time[MIN_LO] = value_to_bit(now_tm->tm_min, long unsigned);
-		now_time[MIN_HI] = 0;
-	} else {
-		now_time[MIN_LO] = 0;
-		now_time[MIN_HI] = value_to_bit(now_tm->tm_min - 32, long unsigned);
+static void heap_build(time_t now, int reschedule) {
+	cron_tab * tab;
+	cron_job * job;
+	int i, n = 0;
+
+	for(tab = cron_tabs; tab != NULL; tab = tab->next) {
+		for(job = tab->jobs; job != NULL; job = job->next)
+			++n;
 	}
+	if(n > heap_max) {
+		cron_job ** tmp;
 
-	for(job_index = cron_jobs; job_index; job_index = job_index->next) {
-		/* Is the job scheduled for today? */
-		if((job_index->time[WDAY] & now_time[WDAY])
-		  && (job_index->time[MDAY] & now_time[MDAY])
-		  && (job_index->time[MON] & now_time[MON])) {
-
-			/* Check if this job is scheduled for this min */
-			if((job_index->time[HOUR] & now_time[HOUR])
-			  && ((job_index->time[MIN_LO] & now_time[MIN_LO])
-			    || (job_index->time[MIN_HI] & now_time[MIN_HI]))) {
-				  trigger(job_index);
-			}
+		if((tmp = realloc(heap, n * sizeof *heap)) == NULL)
+			message(FATAL, "%s", strerror(errno));
+		heap = tmp;
+		heap_max = n;
+	}
 
-			/* Check if this job is the next ready */ 
-			nextmin = INF;
-			tryhr = nowhr;
-			for(;;) {
-				nexthr = nexttime(tryhr, 0, job_index->time[HOUR], 24);
-				if(nexthr == INF) break;
-				nextmin = nexttime((nexthr == nowhr) ? (nowmin+1) : 0, job_index->time[MIN_HI], job_index->time[MIN_LO], 60);
-				if(nextmin != INF) break;
-				++tryhr;
-			}
+	heap_num = 0;
+	for(tab = cron_tabs; tab != NULL; tab = tab->next) {
+		for(job = tab->jobs; job != NULL; job = job->next) {
+			if(reschedule)
+				job->when = next_fire(job, now);
+			if(job->when != -1)
+				heap[heap_num++] = job;
+		}
+	}
+	for(i = heap_num / 2 - 1; i >= 0; --i)
+		heap_down(i);
+}
 
-			if((nexthr < best_nexthr) 
-			  || ((nexthr == best_nexthr) && (nextmin < best_nextmin))) {
-				best_nexthr  = nexthr;
-				best_nextmin = nextmin;
-			}
-		} /* end if today */
+/*  Does all jobs scheduled for the current min.
+ *  Returns the number of seconds to sleep until the next job.
+ */
+long do_jobs() {
+	static time_t last;
+	cron_job * job;
+	time_t now;
+
+	time(&now);
+	if(now < last) { /* The clock was set back */
+		message(LOG, "time set back, rescheduling");
+		heap_build(now, 1);
+	}
+	last = now;
+
+	/*  Everything due is taken off the top in one pass.  A job that was
+	 *  due before this min (cron was held up, or the clock was set
+	 *  forward) is not made up, it just moves on to its next run.
+	 */
+	while(heap_num > 0 && (job = heap[0])->when <= now) {
+		if(job->when > now - 60)
+			trigger(job);
+		if((job->when = next_fire(job, now)) == -1)
+			heap[0] = heap[--heap_num];
+		if(heap_num > 0)
+			heap_down(0);
 	}
 
-	time(&gmtm); /* recalculate time in case loop above took a long time */
-	now_tm = localtime(&gmtm);
-	
-	nexthr  = best_nexthr  - now_tm->tm_hour;
-	nextmin = best_nextmin - now_tm->tm_min;
+	if(heap_num == 0)
+		return 24L * 60 * 60; /* Until a crontab update */
 
-	/* Correct for seconds to avoid all but recent drifting */
-	return nextmin * 60 + nexthr * ((long)60 * 60) - now_tm->tm_sec; 
+	time(&now); /* recalculate time in case the triggers took a long time */
+	return heap[0]->when > now ? heap[0]->when - now : 1;
 }
 
 #ifdef EXTENDED_DIAGNOSTICS /* Left as a debugging aid */
 
 void cron_ls(int signo)
 {
-	cron_job * index = cron_jobs;
+	cron_tab * tab;
+	cron_job * index;
 
-	while(index) {
+	for(tab = cron_tabs; tab; tab = tab->next)
+	for(index = tab->jobs; index; index = index->next) {
 		printf("* min:");
 		field_spew(index->time[MIN_LO], 0);
 		field_spew(index->time[MIN_HI], 32);
@@ -436,8 +592,6 @@ void cron_ls(int signo)
 		printf(" wday:");
 		field_spew(index->time[WDAY], 0);
 		printf("\n* command = \"%s\"\n# \n", index->command);
-
-		index = index->next;
 	}
 }
 
@@ -50,6 +50,7 @@ typedef struct cron_job {
 	unsigned long time[TIMES_ELEMENTS];
 	uid_t     user;
 	char *    command;
+	time_t    when;    /* next run, -1 if it can never run */
 	struct cron_job * next;
 } cron_job;
 
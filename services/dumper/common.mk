@@ -15,10 +15,12 @@ endif
 include $(QCONFIG)
 
 INSTALLDIR=usr/sbin
-LIBS=z
+LIBS=z lzo
 
 LIBPREF_z = -Bstatic
 LIBPOST_z = -Bdynamic
+LIBPREF_lzo = -Bstatic
+LIBPOST_lzo = -Bdynamic
 
 define PINFO
 PINFO DESCRIPTION=Process crash dump file creation daemon
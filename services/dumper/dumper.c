@@ -27,7 +27,6 @@
 #include <libgen.h>
 #include <pwd.h>
 #include <errno.h>
-#include <zlib.h>
 #include <sys/elf.h>
 #include <sys/elftypes.h>
 #include <sys/elf_notes.h>
@@ -41,6 +40,8 @@
 #include <sys/slog.h>
 #include <sys/slogcodes.h>
 #include <sys/resource.h>
+#include "dumpfile.h"
+#include "policy.h"
 
 static iofunc_attr_t			attr;
 static resmgr_connect_funcs_t	connect;
@@ -51,10 +52,12 @@ static int requested = 0;
 pid_t		match_pid = -1;
 char		*dump_dir, *dump_path;
 uintptr_t	pagesize;
-char		*membuf;
 pthread_t	cur_tid = 0;
 int			verbose = 0;
 int         gzlevel = -1;
+int			lzo_dumps = 0;
+int			nthreads = 1;
+int			seg_policy = 0;
 
 long	max_core_size = RLIM_INFINITY;
 int		sequential_dumps = 0;
@@ -81,16 +84,12 @@ int get_ldd_mapinfos(int fd, procfs_mapinfo **infos, int *ninfos);
 #define OFFENDING_THREAD(base, size, mapinfoptr) ((mapinfoptr)->vaddr >= base && \
 						(mapinfoptr)->vaddr < (base + size))
 
-off_t dump_tell( FILE *fp )
+off_t dump_tell( struct dumpfile *fp )
 {
-	if (gzlevel == -1) {
-		return ftell(fp);
-	} else {
-		return gztell((gzFile)fp);
-	}
+	return dumpfile_tell(fp);
 }
 
-static int dump_write(FILE *core_fp, const void *addr, int nr, long *size)
+static int dump_write(struct dumpfile *core_fp, const void *addr, int nr, long *size)
 {
 	int n; 		
 	int wsize;  /* Size to be written. */
@@ -106,11 +105,7 @@ static int dump_write(FILE *core_fp, const void *addr, int nr, long *size)
 
 	*size -= wsize;
 	
-	if (gzlevel == -1) {
-		n = fwrite(addr, 1, wsize, core_fp );
-	} else {
-		n = gzwrite((gzFile)core_fp, (void *)addr, wsize);
-	}
+	n = (dumpfile_write(core_fp, addr, wsize) == -1) ? 0 : wsize;
 
 	if ((n<wsize) && (verbose))
 	{
@@ -124,18 +119,60 @@ static int dump_write(FILE *core_fp, const void *addr, int nr, long *size)
 	}
 }
 
-static int dump_seek(FILE *core_fp, off_t off)
+static int dump_seek(struct dumpfile *core_fp, off_t off)
 {
-	if (gzlevel == -1)
-	  fseek( core_fp, off, SEEK_SET );
-	else
-	  if (gzseek((gzFile)core_fp, off, SEEK_SET) == -1) {
-		  printf("gzseek backwards. Current %d, off %d, Failed.\n", dump_tell(core_fp), off);
-		  exit(-1);
-	  }
+	if (dumpfile_seek(core_fp, off) == -1) {
+		printf("seek backwards. Current %d, off %d, Failed.\n", dump_tell(core_fp), off);
+		exit(-1);
+	}
     return 1;
 }
 
+/*
+ * Copy len bytes of the address space at fd's current offset into the
+ * core, reading straight into the output buffers as much at a time as
+ * they have room for.  After a short read the rest is filled with fill.
+ * Returns -1 once the core size limit is reached, else the number of
+ * bytes that could be read.
+ */
+static long dump_read(int fd, struct dumpfile *core_fp, long len, int fill, long *size)
+{
+	char	*buf;
+	size_t	avail;
+	long	done, got = 0;
+	int		num, want, ok = 1;
+
+	for (done = 0; done < len; done += want) {
+		if ((buf = dumpfile_buffer(core_fp, &avail)) == NULL) {
+			if (verbose)
+				perror("file write error");
+			return -1;
+		}
+		want = min(avail, len - done);
+		if (*size < want)
+			want = *size;
+
+		num = ok ? read(fd, buf, want) : 0;
+		if (num < 0)
+			num = 0;
+		if (num != want) {
+			memset(buf + num, fill, want - num);
+			ok = 0;
+		}
+		got += num;
+
+		*size -= want;
+		if (dumpfile_commit(core_fp, want) == -1) {
+			if (verbose)
+				perror("file write error");
+			return -1;
+		}
+		if (*size == 0 && done + want < len)
+			return -1;
+	}
+	return got;
+}
+
 struct memelfnote {
 	const char      *name;
 	unsigned int    datasz;
@@ -154,7 +191,7 @@ static int notesize(struct memelfnote *en)
     return sz;
 }
 
-static int writenote(struct memelfnote *men, FILE *core_fp, long *size)
+static int writenote(struct memelfnote *men, struct dumpfile *core_fp, long *size)
 {
 Elf32_Nhdr en;
 
@@ -180,108 +217,49 @@ Elf32_Nhdr en;
     return 1;
 }
 
-void dump_stack_memory( int fd, FILE *fp, procfs_mapinfo *mem, long *size )
+void dump_stack_memory( int fd, struct dumpfile *fp, procfs_mapinfo *mem, long *size )
 {
-int		num, i, max, min, base;
-off_t	here, there;
+int		min, gap;
 
 	if ( (mem->flags & PG_HWMAPPED) == 0 ) {
 		dprintf(("Ignoring non-mapped stack region: %#llx @ %#llx\n", 
 			mem->size, mem->vaddr ));
 		return;
 	}
-	base = mem->offset;
-//	base = mem->vaddr;
 
-	dprintf(("blanking %lld bytes of stack memory at %#x\n", mem->size, base ));
-//printf("vaddr=%#x, offset=%#x, size=%lld\n", mem->vaddr, mem->offset, mem->size );
+	dprintf(("blanking %lld bytes of stack memory at %#llx\n", mem->size, mem->offset ));
 
-	here = dump_tell(fp);
-	max = roundup( mem->size, pagesize );
+	/* Below the stack pointer is left as zeros (a hole, or cheap to compress) */
 	min = (mem->offset - mem->vaddr);
-	dprintf(("max=%#x, min = %#x (%#llx->%#llx)\n", max, min, mem->vaddr+min, mem->vaddr+max ));
-
-	if (gzlevel != -1) {
-		int rsize;
+	dprintf(("min = %#x (%#llx->%#llx)\n", min, mem->vaddr+min, mem->vaddr+mem->size ));
 
-		/* forward dumping from mem->offset to mem->offset + mem->size in gz mode */
-		memset(membuf, 0, pagesize);
-		for (i = 0; i < min; i += pagesize) {
-			if( dump_write( fp, membuf, min(pagesize, min - i), size) == -1)
-			  return;
-		}
+	gap = min(min, *size);
+	*size -= gap;
+	dump_seek( fp, dump_tell(fp) + gap );
+	if ( gap < min )
+		return;
 
-		for (i = min; i < mem->size; i += pagesize) {
-			if ( lseek( fd, mem->vaddr + i, SEEK_SET ) == -1 ) {
-				memset(membuf, 0, pagesize);
-				num = pagesize;
-			} else {
-				rsize = (i & ~(pagesize - 1)) + pagesize;
-				if (rsize >= mem->size) {
-					rsize = mem->size - i;
-				} else {
-					rsize -= i;
-				}
-				if ((num = read( fd, membuf, rsize)) != rsize) {
-					memset(membuf, -1, pagesize);
-				}
-			}
-			if( dump_write( fp, membuf, num, size) == -1)
-			  return;
-		}
+	if ( lseek( fd, mem->vaddr + min, SEEK_SET ) == -1 ) {
+		gap = min(mem->size - min, *size);
+		*size -= gap;
+		dump_seek( fp, dump_tell(fp) + gap );
 		return;
 	}
-	
-	memset( membuf, 0, sizeof membuf );
-	for (i = 0; i < mem->size; i+= pagesize ) {
-		if(dump_write( fp, membuf, min( pagesize, mem->size - i ), size) == -1)
-			return;
-	}
-	there = dump_tell(fp);
-
-	for ( i = max - pagesize; i >= min; i -= pagesize ) {
-		dump_seek( fp, here + i );
-		if ( lseek( fd, mem->vaddr + i, SEEK_SET ) == -1 )
-			continue;
-		/* read memory here */
-//		dprintf(("attempting to read @ %#llx\n", mem->vaddr + i ));
-		if ( (num = read( fd, membuf, pagesize )) != pagesize ) {
-			memset( membuf, -1, sizeof membuf );
-			num = pagesize;
-		}
-		if(dump_write( fp, membuf, num, size) == -1)
-			return;
-		fflush( fp );
-		if ( num != pagesize ) {
-			dprintf(("cut short at %d+%d\n", i, num ));
-			break;
-		}
-//		else
-//			dprintf(("read %d bytes ok\n", num ));
+	if ( dump_read( fd, fp, mem->size - min, 0, size ) < mem->size - min ) {
+		dprintf(("stack cut short at %#llx\n", mem->vaddr + min ));
 	}
-	dump_seek( fp, there );
 }
 
-void dump_memory( int fd, FILE *fp, procfs_mapinfo *mem, long *size )
+void dump_memory( int fd, struct dumpfile *fp, procfs_mapinfo *mem, uint64_t len, long *size )
 {
-int		num, i, ok = 1;
+long	num;
 
-	dprintf(("dumping %lld bytes of memory at %#llx\n", mem->size, mem->vaddr ));
+	dprintf(("dumping %lld of %lld bytes of memory at %#llx\n", len, mem->size, mem->vaddr ));
 
-	for (i = 0; i < mem->size; i+= pagesize ) {
-		/* read memory here */
-		if ( ok ) {
-			num = read( fd, membuf, min(pagesize, mem->size - i) );
-		} else {
-			memset( membuf, -1, sizeof membuf );
-			num = pagesize;
-		}
-		if(dump_write( fp, membuf, min(pagesize, mem->size - i), size) == -1)
-			return;
-		if ( num != pagesize ) {
-			dprintf(("cut short at %d+%d\n", i, num ));
-			ok = 0;
-		}
+	/* Anything that can't be read comes out as 0xff */
+	num = dump_read( fd, fp, len, -1, size );
+	if ( num >= 0 && num < len ) {
+		dprintf(("cut short at %ld\n", num ));
 	}
 }
 
@@ -338,7 +316,16 @@ void slog_tid( procfs_status *status, const char *path )
 	}
 }
 
-int elfcore(int fd, FILE *fp, const char *path, long coresize)
+static void free_refs(struct memelfnote *refs, int nrefs)
+{
+int i;
+
+	for ( i = 0; i < nrefs; i++ )
+		free( refs[i].data );
+	free( refs );
+}
+
+int elfcore(int fd, struct dumpfile *fp, const char *path, long coresize)
 {
 procfs_sysinfo		*sysinfo;
 int					sysinfo_len;
@@ -347,9 +334,11 @@ procfs_status		status;
 int					ret;
 procfs_mapinfo		*mem = NULL, *mapinfos = NULL, *ldd_infos = NULL;
 int					numnote=0, num, i, j, seg = 0, err, n_ldd_infos = 0;
+int					nrefs = 0;
 Elf32_Ehdr			elf;
 Elf32_Phdr 			phdr;
-struct memelfnote	notes[20], thread_note;
+struct memelfnote	notes[20], thread_note, *refs = NULL;
+uint64_t			*filesz = NULL;
 off_t				offset = 0, dataoff;
 uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 
@@ -378,9 +367,6 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 	}
 
 	pagesize = sysconf( _SC_PAGESIZE );
-	if ( membuf == NULL && ((membuf = malloc( pagesize )) == NULL) ) {
-		goto bailout;
-	}
 
 	// write elf header
 	memcpy(elf.e_ident, ELFMAG, SELFMAG);
@@ -409,7 +395,9 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 	}
 
 	mem = malloc( (n_ldd_infos + num) * sizeof(*mem) );
-	if ( mem == NULL ) {
+	filesz = malloc( (n_ldd_infos + num) * sizeof(*filesz) );
+	refs = malloc( (num + 1) * sizeof(*refs) );
+	if ( mem == NULL || filesz == NULL || refs == NULL ) {
 		goto bailout;
 	}
 
@@ -446,6 +434,26 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 			continue;
 		}
 
+		filesz[seg] = mapinfos[i].size;
+		if (seg_policy && !nodumpmem) {
+			void		*ref;
+			unsigned	refsz;
+
+			switch (policy_select(fd, &mapinfos[i], &filesz[seg], &ref, &refsz)) {
+			case SEG_SKIP:
+				dprintf(("leaving out %#llx bytes at %#llx\n", mapinfos[i].size, mapinfos[i].vaddr ));
+				continue;
+			case SEG_REF:
+				dprintf(("referencing %#llx bytes at %#llx\n", mapinfos[i].size, mapinfos[i].vaddr ));
+				refs[nrefs].name = QNX_NOTE_NAME;
+				refs[nrefs].type = QNT_CORE_MAPREF;
+				refs[nrefs].datasz = refsz;
+				refs[nrefs].data = ref;
+				nrefs++;
+				break;
+			}
+		}
+
 		memcpy(&mem[seg], &mapinfos[i], sizeof(*mem));
 		seg++;
 	}
@@ -454,6 +462,7 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 	for(i = 0; i < n_ldd_infos; i++) {
 		dprintf(("%svaddr=%#llx, offset=%#llx, size=%#llx, flags=%#x\n", ldd_infos[i].flags & PG_HWMAPPED?"*":"", ldd_infos[i].vaddr, ldd_infos[i].offset, ldd_infos[i].size, ldd_infos[i].flags ));
 		memcpy( &mem[seg], &ldd_infos[i], sizeof(*mem));;
+		filesz[seg] = ldd_infos[i].size;
 		seg++;
 	}
 	free(mapinfos);
@@ -527,6 +536,8 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 
 		for(i = 0; i < numnote; i++)
 		    sz += notesize(&notes[i]);
+		for(i = 0; i < nrefs; i++)
+		    sz += notesize(&refs[i]);
 
 		for(status.tid = 1; devctl(fd, DCMD_PROC_TIDSTATUS, &status, sizeof status, 0) == EOK; status.tid++) {
 			procfs_greg					greg;
@@ -594,7 +605,7 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 		if ( mem[i].flags & MAP_ELF )
 			phdr.p_flags |= PF_X;
 		phdr.p_align = pagesize;
-		phdr.p_filesz = phdr.p_memsz;
+		phdr.p_filesz = filesz[i];
 
 		offset += phdr.p_filesz;
 		if(dump_write( fp, &phdr, sizeof(phdr), &coresize) == -1)
@@ -605,6 +616,10 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 	    if (!writenote(&notes[i], fp, &coresize ))
 	    	goto bailout;
 	}
+	for(i = 0; i < nrefs; i++) {
+	    if (!writenote(&refs[i], fp, &coresize ))
+	    	goto bailout;
+	}
 
 	for(status.tid = 1; devctl(fd, DCMD_PROC_TIDSTATUS, &status, sizeof status, 0) == EOK; status.tid++) {
 		procfs_greg					greg;
@@ -663,12 +678,14 @@ uint64_t			cur_tid_base = 0, cur_tid_size = 0;
 		if ( mem[j].flags & MAP_STACK )
 			dump_stack_memory( fd, fp, &mem[j], &coresize );
 		else
-		  if (!nodumpmem)
-			dump_memory( fd, fp, &mem[j], &coresize );
+		  if (!nodumpmem && filesz[j] != 0)
+			dump_memory( fd, fp, &mem[j], filesz[j], &coresize );
 	}
 
 	// Return EOK when accually writing ELF files
 	free(mem);
+	free(filesz);
+	free_refs(refs, nrefs);
 	return EOK;
 bailout:
 	if ( mapinfos != NULL ) {
@@ -680,6 +697,10 @@ bailout:
 	if ( mem != NULL ) {
 		free(mem);
 	}
+	if ( filesz != NULL ) {
+		free(filesz);
+	}
+	free_refs(refs, nrefs);
 	return errno;
 }
 
@@ -690,7 +711,9 @@ static char savepath[PATH_MAX+1];
 int n;
 	char suf[20];
 	
-	if (gzlevel == -1) {
+	if (lzo_dumps) {
+		sprintf(suf, "core.lzo");
+	} else if (gzlevel == -1) {
 		sprintf(suf, "core");
 	} else {
 		sprintf(suf, "core.gz");
@@ -726,8 +749,8 @@ int n;
 
 int dump(uint32_t nd, pid_t pid, long size ) {
 	int							fd;
-	int							ret;
-	FILE						*fp;
+	int							ret, status;
+	struct dumpfile				*fp;
 	char						path[PATH_MAX + 1];
 	char						buff[PATH_MAX + 1];
 	struct _procfs_debug_info	*map = (struct _procfs_debug_info *)buff;
@@ -801,12 +824,12 @@ int dump(uint32_t nd, pid_t pid, long size ) {
 	strcat(path, basename(map->path));
 	dump_path = gen_dump_path(path);
 
-	if (gzlevel == -1) {
-		fp = fopen(dump_path, "w");
+	if (lzo_dumps) {
+		fp = dumpfile_open(dump_path, DUMPFILE_LZO, 0, nthreads);
+	} else if (gzlevel == -1) {
+		fp = dumpfile_open(dump_path, DUMPFILE_PLAIN, 0, 0);
 	} else {
-		fp = (FILE *)gzopen(dump_path, "w");
-		if (fp)
-		  gzsetparams((gzFile)fp, gzlevel, 0);
+		fp = dumpfile_open(dump_path, DUMPFILE_GZIP, gzlevel, nthreads);
 	}
 	
 	if(!fp) {
@@ -818,10 +841,11 @@ int dump(uint32_t nd, pid_t pid, long size ) {
 	chmod( dump_path, world_readable ? 0644 : S_IRUSR|S_IWUSR );
 	ret = elfcore(fd, fp, map->path, size);
 	
-	if (gzlevel == -1) {
-		fclose(fp);
-	} else {
-		gzclose((gzFile)fp);
+	if ((status = dumpfile_close(fp)) != EOK) {
+		if (verbose)
+			fprintf(stderr, "%s: %s\n", dump_path, strerror(status));
+		if (ret == EOK)
+			ret = status;
 	}
 	close(fd);
 
@@ -912,7 +936,7 @@ int main(int argc, char *argv[])
 	/* We also want some physical memory for our stack.  */
 	init_stack();
 	
-	while ( (c = getopt( argc, argv, "Dd:p:ns:vmPwtz:" )) != -1 ) {
+	while ( (c = getopt( argc, argv, "Dd:j:p:ns:vmPwtx:z:Z" )) != -1 ) {
 		switch(c) {
 		case 'd':
 			dump_dir = optarg;
@@ -957,6 +981,23 @@ int main(int argc, char *argv[])
 		case 'w':
 			world_readable = 1;
 			break;
+		case 'j':
+			nthreads = atoi(optarg);
+#ifdef _SC_NPROCESSORS_ONLN
+			if (nthreads < 1)
+				nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+			if (nthreads < 1)
+				nthreads = 1;
+			break;
+		case 'Z':
+			lzo_dumps = 1;
+			break;
+		case 'x':
+			if (policy_parse(optarg) == -1)
+				exit(EXIT_FAILURE);
+			seg_policy = 1;
+			break;
 	    case 'z':
 			gzlevel = strtol(optarg, &size_suffix, 10);
 			if (gzlevel < 1 || gzlevel > 9) {
@@ -0,0 +1,719 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <lzo1x.h>
+#include <gulliver.h>
+#include <sys/stat.h>
+
+#include "dumpfile.h"
+
+/* The file format of deflate(1), always little endian on the media */
+#define LZO_SIGNATURE	"iwlyfmbp"
+#define LZO_CMP_LZO		0
+#define LZO_BLKSIZE		(32 * 1024)
+
+struct lzo_filehdr {
+	char			signature[8];
+	int				usize;			/* Uncompressed size of the file */
+	unsigned short	blksize;		/* Size of compression blocks */
+	char			cmptype;
+	char			flags;
+};
+
+struct lzo_cmphdr {
+	unsigned short	prev;			/* Offset to previous hdr */
+	unsigned short	next;			/* Offset to next hdr */
+	unsigned short	pusize;			/* Size of prev uncompressed blk */
+	unsigned short	usize;			/* Size of this uncompressed blk */
+};
+
+/* gzip member header as gzio writes it: no name, no time, Unix */
+static const unsigned char gz_magic[10] = {
+	0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 0x03
+};
+
+/*
+ * Room for a compressed chunk: deflate grows incompressible data by
+ * a few bytes per 16K, lzo1x by 1/16 plus a block header per 32K.
+ */
+#define OUT_SIZE		(DUMPFILE_CHUNK + DUMPFILE_CHUNK / 8 + 1024)
+
+struct job {
+	struct job		*next;			/* todo/free list */
+	struct job		*order;			/* pending list, in file order */
+	int				status;
+	int				done;
+	int				zero;			/* raw is all zeros, maybe not filled in */
+	size_t			len;			/* bytes of raw used */
+	size_t			out_len;
+	unsigned char	*raw;
+	unsigned char	*out;
+};
+
+struct dumpfile {
+	int				fd;
+	int				codec;
+	int				level;
+	int				pagesize;
+	off_t			pos;			/* end of what has been given to us */
+	off_t			wpos;			/* end of what has been written out */
+	struct job		*cur;			/* chunk being filled */
+
+	pthread_mutex_t	mutex;
+	pthread_cond_t	work_cond;
+	pthread_cond_t	done_cond;
+	pthread_t		*threads;
+	int				nthreads;
+	int				njobs;
+	int				exiting;
+	int				error;
+	struct job		*todo;
+	struct job		**todo_tail;
+	struct job		*pending;
+	struct job		**pending_tail;
+	struct job		*free;
+
+	/* what a whole chunk of zeros turns into */
+	unsigned char	*zout;
+	size_t			zout_len;
+
+	/* lzo block chaining */
+	unsigned short	prev;
+	unsigned short	pusize;
+};
+
+static int iszero( const unsigned char *buf, size_t len )
+{
+const unsigned long	*p = (const unsigned long *)buf;
+size_t				i;
+
+	/* chunks and pages are long aligned, so is len except at the very end */
+	for ( i = 0; i < len / sizeof *p; i++ ) {
+		if ( p[i] != 0 )
+			return 0;
+	}
+	for ( i *= sizeof *p; i < len; i++ ) {
+		if ( buf[i] != 0 )
+			return 0;
+	}
+	return 1;
+}
+
+static void put_le32( unsigned char *p, unsigned long v )
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static int gzip_chunk( z_stream *zs, const unsigned char *in, size_t len,
+					unsigned char *out, size_t *out_len )
+{
+uLong	crc;
+
+	crc = crc32( crc32( 0L, Z_NULL, 0 ), in, len );
+	memcpy( out, gz_magic, sizeof gz_magic );
+
+	if ( deflateReset( zs ) != Z_OK )
+		return EIO;
+	zs->next_in = (Bytef *)in;
+	zs->avail_in = len;
+	zs->next_out = out + sizeof gz_magic;
+	zs->avail_out = OUT_SIZE - sizeof gz_magic - 8;
+	if ( deflate( zs, Z_FINISH ) != Z_STREAM_END )
+		return EIO;
+
+	out += sizeof gz_magic + zs->total_out;
+	put_le32( out, crc );
+	put_le32( out + 4, len );
+	*out_len = sizeof gz_magic + zs->total_out + 8;
+	return EOK;
+}
+
+/*
+ * Block headers are filled in with next and usize only, in native order;
+ * put_lzo() chains them up when it knows what came before.
+ */
+static int lzo_chunk( void *wrkmem, const unsigned char *in, size_t len,
+					unsigned char *out, size_t *out_len )
+{
+struct lzo_cmphdr	hdr;
+lzo_uint			clen;
+size_t				off, n, o = 0;
+
+	for ( off = 0; off < len; off += n ) {
+		n = len - off;
+		if ( n > LZO_BLKSIZE )
+			n = LZO_BLKSIZE;
+		/* LZO1X-1 output depends on stale dictionary entries, start each block clean */
+		memset( wrkmem, 0, LZO1X_1_MEM_COMPRESS );
+		if ( lzo1x_1_compress( in + off, n, out + o + sizeof hdr, &clen, wrkmem ) != LZO_E_OK )
+			return EIO;
+		memset( &hdr, 0, sizeof hdr );
+		hdr.next = sizeof hdr + clen;
+		hdr.usize = n;
+		memcpy( out + o, &hdr, sizeof hdr );
+		o += sizeof hdr + clen;
+	}
+	*out_len = o;
+	return EOK;
+}
+
+static int work( struct dumpfile *df, struct job *job, z_stream *zs, void *wrkmem )
+{
+	if ( !job->zero )
+		job->zero = iszero( job->raw, job->len );
+	if ( job->zero && job->len == DUMPFILE_CHUNK )
+		return EOK;				/* df->zout, or a hole */
+
+	switch ( df->codec ) {
+	case DUMPFILE_GZIP:
+		return gzip_chunk( zs, job->raw, job->len, job->out, &job->out_len );
+	case DUMPFILE_LZO:
+		return lzo_chunk( wrkmem, job->raw, job->len, job->out, &job->out_len );
+	}
+	return EOK;
+}
+
+static int write_all( int fd, const void *buf, size_t len )
+{
+const char	*p = buf;
+ssize_t		n;
+
+	while ( len > 0 ) {
+		if ( (n = write( fd, p, len )) == -1 ) {
+			if ( errno == EINTR )
+				continue;
+			return errno;
+		}
+		p += n;
+		len -= n;
+	}
+	return EOK;
+}
+
+/* Write out the non-zero pages, leaving holes for the rest */
+static int put_plain( struct dumpfile *df, struct job *job )
+{
+size_t	i, start, n;
+ssize_t	xfer;
+
+	if ( job->zero )
+		return EOK;
+
+	for ( i = 0; i < job->len; ) {
+		while ( i < job->len ) {
+			n = job->len - i;
+			if ( n > df->pagesize )
+				n = df->pagesize;
+			if ( !iszero( job->raw + i, n ) )
+				break;
+			i += n;
+		}
+		start = i;
+		while ( i < job->len ) {
+			n = job->len - i;
+			if ( n > df->pagesize )
+				n = df->pagesize;
+			if ( iszero( job->raw + i, n ) )
+				break;
+			i += n;
+		}
+		while ( start < i ) {
+			xfer = pwrite( df->fd, job->raw + start, i - start, df->wpos + start );
+			if ( xfer == -1 ) {
+				if ( errno == EINTR )
+					continue;
+				return errno;
+			}
+			start += xfer;
+		}
+	}
+	return EOK;
+}
+
+static int put_lzo( struct dumpfile *df, unsigned char *out, size_t len )
+{
+struct lzo_cmphdr	hdr;
+unsigned short		next, usize;
+size_t				o;
+
+	for ( o = 0; o < len; o += next ) {
+		memcpy( &hdr, out + o, sizeof hdr );
+		next = hdr.next;
+		usize = hdr.usize;
+		hdr.prev = ENDIAN_LE16( df->prev );
+		hdr.next = ENDIAN_LE16( next );
+		hdr.pusize = ENDIAN_LE16( df->pusize );
+		hdr.usize = ENDIAN_LE16( usize );
+		memcpy( out + o, &hdr, sizeof hdr );
+		df->prev = next;
+		df->pusize = usize;
+	}
+	return write_all( df->fd, out, len );
+}
+
+static int put( struct dumpfile *df, struct job *job )
+{
+int		error;
+
+	if ( job->zero && job->len == DUMPFILE_CHUNK && df->codec != DUMPFILE_PLAIN ) {
+		if ( df->codec == DUMPFILE_LZO ) {
+			/* put_lzo() rewrites the headers, keep zout as it was */
+			memcpy( job->out, df->zout, df->zout_len );
+			error = put_lzo( df, job->out, df->zout_len );
+		} else
+			error = write_all( df->fd, df->zout, df->zout_len );
+	} else if ( df->codec == DUMPFILE_LZO ) {
+		error = put_lzo( df, job->out, job->out_len );
+	} else if ( df->codec == DUMPFILE_GZIP ) {
+		error = write_all( df->fd, job->out, job->out_len );
+	} else {
+		error = put_plain( df, job );
+	}
+	df->wpos += job->len;
+	return error;
+}
+
+static void *worker( void *arg )
+{
+struct dumpfile	*df = arg;
+struct job		*job;
+z_stream		zs;
+void			*wrkmem = NULL;
+int				ok;
+
+	memset( &zs, 0, sizeof zs );
+	if ( df->codec == DUMPFILE_GZIP ) {
+		ok = (deflateInit2( &zs, df->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) == Z_OK);
+	} else {
+		ok = ((wrkmem = malloc( LZO1X_1_MEM_COMPRESS )) != NULL);
+	}
+
+	pthread_mutex_lock( &df->mutex );
+	for ( ;; ) {
+		while ( df->todo == NULL && !df->exiting )
+			pthread_cond_wait( &df->work_cond, &df->mutex );
+		if ( (job = df->todo) == NULL )
+			break;
+		if ( (df->todo = job->next) == NULL )
+			df->todo_tail = &df->todo;
+		pthread_mutex_unlock( &df->mutex );
+
+		job->status = ok ? work( df, job, &zs, wrkmem ) : ENOMEM;
+
+		pthread_mutex_lock( &df->mutex );
+		job->done = 1;
+		pthread_cond_broadcast( &df->done_cond );
+	}
+	pthread_mutex_unlock( &df->mutex );
+
+	if ( df->codec == DUMPFILE_GZIP && ok )
+		deflateEnd( &zs );
+	free( wrkmem );
+	return NULL;
+}
+
+/* Write out finished jobs from the front of the pending list (mutex held) */
+static void drain( struct dumpfile *df )
+{
+struct job	*job;
+int			error;
+
+	while ( (job = df->pending) != NULL && job->done ) {
+		if ( (df->pending = job->order) == NULL )
+			df->pending_tail = &df->pending;
+		pthread_mutex_unlock( &df->mutex );
+
+		if ( df->error == EOK ) {
+			error = job->status != EOK ? job->status : put( df, job );
+			if ( error != EOK )
+				df->error = error;
+		}
+
+		pthread_mutex_lock( &df->mutex );
+		job->next = df->free;
+		df->free = job;
+	}
+}
+
+static struct job *new_job( void )
+{
+struct job	*job;
+
+	if ( (job = calloc( 1, sizeof *job )) == NULL )
+		return NULL;
+	job->raw = malloc( DUMPFILE_CHUNK );
+	job->out = malloc( OUT_SIZE );
+	if ( job->raw == NULL || job->out == NULL ) {
+		free( job->raw );
+		free( job->out );
+		free( job );
+		return NULL;
+	}
+	return job;
+}
+
+/* Get an empty chunk, writing out finished ones while waiting for it */
+static struct job *get_job( struct dumpfile *df )
+{
+struct job	*job;
+
+	if ( df->nthreads == 0 ) {
+		job = df->free;
+		df->free = NULL;
+	} else {
+		pthread_mutex_lock( &df->mutex );
+		for ( ;; ) {
+			drain( df );
+			if ( df->error != EOK ) {
+				job = NULL;
+				break;
+			}
+			if ( (job = df->free) != NULL ) {
+				df->free = job->next;
+				break;
+			}
+			if ( df->njobs < 2 * df->nthreads + 1 ) {
+				if ( (job = new_job()) != NULL ) {
+					df->njobs++;
+					break;
+				}
+				if ( df->pending == NULL ) {
+					df->error = ENOMEM;
+					break;
+				}
+			}
+			pthread_cond_wait( &df->done_cond, &df->mutex );
+		}
+		pthread_mutex_unlock( &df->mutex );
+	}
+
+	if ( job == NULL ) {
+		errno = df->error;
+		return NULL;
+	}
+	job->len = 0;
+	job->zero = 0;
+	return job;
+}
+
+static int submit( struct dumpfile *df )
+{
+struct job	*job = df->cur;
+
+	df->cur = NULL;
+
+	if ( df->nthreads == 0 ) {
+		if ( df->error == EOK ) {
+			job->status = work( df, job, NULL, NULL );
+			df->error = job->status != EOK ? job->status : put( df, job );
+		}
+		job->next = NULL;
+		df->free = job;
+	} else {
+		pthread_mutex_lock( &df->mutex );
+		job->next = NULL;
+		job->order = NULL;
+		job->done = 0;
+		*df->todo_tail = job;
+		df->todo_tail = &job->next;
+		*df->pending_tail = job;
+		df->pending_tail = &job->order;
+		pthread_cond_signal( &df->work_cond );
+		pthread_mutex_unlock( &df->mutex );
+	}
+
+	if ( df->error != EOK ) {
+		errno = df->error;
+		return -1;
+	}
+	return 0;
+}
+
+/* Work out what a chunk of zeros compresses to, once */
+static int make_zout( struct dumpfile *df )
+{
+unsigned char	*zeros;
+z_stream		zs;
+void			*wrkmem;
+int				error = ENOMEM;
+
+	if ( (zeros = calloc( 1, DUMPFILE_CHUNK )) == NULL )
+		return ENOMEM;
+	if ( (df->zout = malloc( OUT_SIZE )) == NULL )
+		goto done;
+
+	if ( df->codec == DUMPFILE_GZIP ) {
+		memset( &zs, 0, sizeof zs );
+		if ( deflateInit2( &zs, df->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+			goto done;
+		error = gzip_chunk( &zs, zeros, DUMPFILE_CHUNK, df->zout, &df->zout_len );
+		deflateEnd( &zs );
+	} else {
+		if ( (wrkmem = malloc( LZO1X_1_MEM_COMPRESS )) == NULL )
+			goto done;
+		error = lzo_chunk( wrkmem, zeros, DUMPFILE_CHUNK, df->zout, &df->zout_len );
+		free( wrkmem );
+	}
+done:
+	free( zeros );
+	return error;
+}
+
+static void pool_stop( struct dumpfile *df )
+{
+struct job	*job;
+int			i;
+
+	if ( df->nthreads != 0 ) {
+		pthread_mutex_lock( &df->mutex );
+		while ( df->pending != NULL ) {
+			drain( df );
+			if ( df->pending != NULL )
+				pthread_cond_wait( &df->done_cond, &df->mutex );
+		}
+		df->exiting = 1;
+		pthread_cond_broadcast( &df->work_cond );
+		pthread_mutex_unlock( &df->mutex );
+
+		for ( i = 0; i < df->nthreads; i++ )
+			pthread_join( df->threads[i], NULL );
+	}
+
+	while ( (job = df->free) != NULL ) {
+		df->free = job->next;
+		free( job->raw );
+		free( job->out );
+		free( job );
+	}
+}
+
+struct dumpfile *dumpfile_open( const char *path, int codec, int level, int nthreads )
+{
+struct dumpfile		*df;
+struct lzo_filehdr	hdr;
+int					error;
+
+	if ( (df = calloc( 1, sizeof *df )) == NULL )
+		return NULL;
+	df->codec = codec;
+	df->level = level;
+	df->pagesize = sysconf( _SC_PAGESIZE );
+	df->todo_tail = &df->todo;
+	df->pending_tail = &df->pending;
+	pthread_mutex_init( &df->mutex, NULL );
+	pthread_cond_init( &df->work_cond, NULL );
+	pthread_cond_init( &df->done_cond, NULL );
+
+	if ( (df->fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR )) == -1 ) {
+		error = errno;
+		goto fail;
+	}
+
+	if ( codec == DUMPFILE_PLAIN ) {
+		if ( (df->free = new_job()) == NULL ) {
+			error = ENOMEM;
+			goto fail;
+		}
+		df->njobs = 1;
+		return df;
+	}
+
+	if ( codec == DUMPFILE_LZO ) {
+		if ( lzo_init() != LZO_E_OK ) {
+			error = EINVAL;
+			goto fail;
+		}
+		/* filled in by dumpfile_close() */
+		memset( &hdr, 0, sizeof hdr );
+		if ( (error = write_all( df->fd, &hdr, sizeof hdr )) != EOK )
+			goto fail;
+	}
+	if ( (error = make_zout( df )) != EOK )
+		goto fail;
+
+	if ( nthreads < 1 )
+		nthreads = 1;
+	if ( (df->threads = malloc( nthreads * sizeof *df->threads )) == NULL ) {
+		error = ENOMEM;
+		goto fail;
+	}
+	for ( ; df->nthreads < nthreads; df->nthreads++ ) {
+		if ( pthread_create( &df->threads[df->nthreads], NULL, worker, df ) != EOK )
+			break;
+	}
+	if ( df->nthreads == 0 ) {
+		error = EAGAIN;
+		goto fail;
+	}
+	return df;
+
+fail:
+	if ( df->fd != -1 ) {
+		close( df->fd );
+		unlink( path );
+	}
+	pool_stop( df );
+	free( df->threads );
+	free( df->zout );
+	pthread_cond_destroy( &df->done_cond );
+	pthread_cond_destroy( &df->work_cond );
+	pthread_mutex_destroy( &df->mutex );
+	free( df );
+	errno = error;
+	return NULL;
+}
+
+void *dumpfile_buffer( struct dumpfile *df, size_t *len )
+{
+	if ( df->cur == NULL && (df->cur = get_job( df )) == NULL )
+		return NULL;
+	*len = DUMPFILE_CHUNK - df->cur->len;
+	return df->cur->raw + df->cur->len;
+}
+
+int dumpfile_commit( struct dumpfile *df, size_t len )
+{
+	df->cur->len += len;
+	df->pos += len;
+	if ( df->cur->len == DUMPFILE_CHUNK )
+		return submit( df );
+	return 0;
+}
+
+int dumpfile_write( struct dumpfile *df, const void *buf, size_t len )
+{
+const char	*p = buf;
+void		*dst;
+size_t		n;
+
+	while ( len > 0 ) {
+		if ( (dst = dumpfile_buffer( df, &n )) == NULL )
+			return -1;
+		if ( n > len )
+			n = len;
+		memcpy( dst, p, n );
+		p += n;
+		len -= n;
+		if ( dumpfile_commit( df, n ) == -1 )
+			return -1;
+	}
+	return 0;
+}
+
+int dumpfile_seek( struct dumpfile *df, off_t off )
+{
+void	*dst;
+size_t	n;
+off_t	gap;
+
+	if ( off < df->pos ) {
+		errno = ESPIPE;
+		return -1;
+	}
+	for ( gap = off - df->pos; gap > 0; gap -= n ) {
+		if ( (df->cur == NULL || df->cur->len == 0) && gap >= DUMPFILE_CHUNK ) {
+			/* a whole chunk of zeros, no need to fill it in */
+			if ( df->cur == NULL && (df->cur = get_job( df )) == NULL )
+				return -1;
+			df->cur->zero = 1;
+			n = DUMPFILE_CHUNK;
+			df->cur->len = n;
+			df->pos += n;
+			if ( submit( df ) == -1 )
+				return -1;
+			continue;
+		}
+		if ( (dst = dumpfile_buffer( df, &n )) == NULL )
+			return -1;
+		if ( n > gap )
+			n = gap;
+		memset( dst, 0, n );
+		if ( dumpfile_commit( df, n ) == -1 )
+			return -1;
+	}
+	return 0;
+}
+
+off_t dumpfile_tell( struct dumpfile *df )
+{
+	return df->pos;
+}
+
+int dumpfile_close( struct dumpfile *df )
+{
+struct lzo_filehdr	hdr;
+struct lzo_cmphdr	eof;
+int					error;
+
+	if ( df->cur != NULL ) {
+		if ( df->cur->len != 0 ) {
+			submit( df );
+		} else {
+			df->cur->next = df->free;
+			df->free = df->cur;
+		}
+	}
+	pool_stop( df );
+	error = df->error;
+
+	if ( error == EOK && df->codec == DUMPFILE_LZO ) {
+		/* end of file marker, then the real header */
+		eof.prev = ENDIAN_LE16( df->prev );
+		eof.next = 0;
+		eof.pusize = ENDIAN_LE16( df->pusize );
+		eof.usize = 0;
+		error = write_all( df->fd, &eof, sizeof eof );
+
+		memcpy( hdr.signature, LZO_SIGNATURE, sizeof hdr.signature );
+		hdr.usize = ENDIAN_LE32( df->pos );
+		hdr.blksize = ENDIAN_LE16( LZO_BLKSIZE );
+		hdr.cmptype = LZO_CMP_LZO;
+		hdr.flags = 0;
+		if ( error == EOK && pwrite( df->fd, &hdr, sizeof hdr, 0 ) != sizeof hdr )
+			error = errno;
+	}
+
+	/* the core may end in a hole */
+	if ( error == EOK && df->codec == DUMPFILE_PLAIN && ftruncate( df->fd, df->pos ) == -1 )
+		error = errno;
+
+	if ( close( df->fd ) == -1 && error == EOK )
+		error = errno;
+
+	free( df->threads );
+	free( df->zout );
+	pthread_cond_destroy( &df->done_cond );
+	pthread_cond_destroy( &df->work_cond );
+	pthread_mutex_destroy( &df->mutex );
+	free( df );
+	return error;
+}
@@ -0,0 +1,94 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+/*
+ * dumpfile.h
+ *
+ * Core file output
+ *
+ */
+
+/*
+	dumpfile_open
+		creates the file
+		codec is DUMPFILE_PLAIN, DUMPFILE_GZIP or DUMPFILE_LZO
+		nthreads is the number of compression threads (ignored
+		for DUMPFILE_PLAIN)
+
+	dumpfile_write
+		appends bytes to the core
+
+	dumpfile_buffer / dumpfile_commit
+		the same without a copy: dumpfile_buffer returns free space
+		in the current chunk, the caller fills some of it (for
+		instance by reading the process' address space straight
+		into it) and commits what it used
+
+	dumpfile_seek
+		forward only; the gap reads back as zeros
+
+	dumpfile_tell
+		offset in the uncompressed core
+
+	dumpfile_close
+		writes out what is left, returns 0 or an errno
+
+	The core is cut into DUMPFILE_CHUNK byte chunks which are
+	queued to a pool of threads and written out in order while the
+	caller carries on filling the next one.
+
+	plain (DUMPFILE_PLAIN)
+		all-zero pages are left as holes in a sparse file
+
+	gzip (DUMPFILE_GZIP)
+		each chunk is an independent gzip member, so they can be
+		compressed in parallel; gzip -d and gzread() read
+		concatenated members as one file
+
+	lzo (DUMPFILE_LZO)
+		lzo1x-1 in the format of deflate(1), 32K blocks; much
+		faster than gzip -1 but compresses less.  Read it back with
+		"deflate -d"
+
+	All-zero chunks (unused heap, stack below the stack pointer,
+	seeks) are not compressed again, their output is made once
+	when the file is opened.
+*/
+
+#ifndef __DUMPFILE_H__
+#define __DUMPFILE_H__
+
+#include <sys/types.h>
+
+#define DUMPFILE_PLAIN		0
+#define DUMPFILE_GZIP		1
+#define DUMPFILE_LZO		2
+
+#define DUMPFILE_CHUNK		(128 * 1024)
+
+struct dumpfile;
+
+struct dumpfile *dumpfile_open( const char *path, int codec, int level, int nthreads );
+int dumpfile_write( struct dumpfile *df, const void *buf, size_t len );
+void *dumpfile_buffer( struct dumpfile *df, size_t *len );
+int dumpfile_commit( struct dumpfile *df, size_t len );
+int dumpfile_seek( struct dumpfile *df, off_t off );
+off_t dumpfile_tell( struct dumpfile *df );
+int dumpfile_close( struct dumpfile *df );
+
+#endif
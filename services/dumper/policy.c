@@ -0,0 +1,295 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <devctl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/elf.h>
+#include <sys/elf_notes.h>
+
+#include "policy.h"
+
+#define TYPE_STACK	0x01
+#define TYPE_HEAP	0x02
+#define TYPE_DATA	0x04
+#define TYPE_TEXT	0x08
+#define TYPE_SHARED	0x10
+#define TYPE_FILE	0x20
+#define TYPE_ALL	0x3f
+
+#define NT_GNU_BUILD_ID	3
+#define BUILD_ID_MAX	64
+
+#define roundup(x, y)  ((((x)+((y)-1))/(y))*(y))
+
+static const struct {
+	const char	*name;
+	unsigned	type;
+} types[] = {
+	{ "stack",	TYPE_STACK },
+	{ "heap",	TYPE_HEAP },
+	{ "data",	TYPE_DATA },
+	{ "text",	TYPE_TEXT },
+	{ "shared",	TYPE_SHARED },
+	{ "file",	TYPE_FILE },
+	{ "all",	TYPE_ALL },
+};
+
+struct rule {
+	struct rule	*next;
+	int			include;
+	unsigned	types;
+	char		*pattern;
+};
+
+static struct rule	*rules, **rules_tail = &rules;
+static int			have_names;
+static int			text_refs;
+static uint64_t		max_seg;
+
+static unsigned seg_type( procfs_mapinfo *mem )
+{
+	if ( mem->flags & MAP_STACK )
+		return TYPE_STACK;
+	if ( mem->flags & MAP_ELF )
+		return (mem->flags & PROT_WRITE) ? TYPE_DATA : TYPE_TEXT;
+	if ( (mem->flags & MAP_TYPE) == MAP_SHARED )
+		return TYPE_SHARED;
+	if ( mem->flags & MAP_ANON )
+		return TYPE_HEAP;
+	return TYPE_FILE;
+}
+
+static int parse_rule( char *s )
+{
+	struct rule	*r;
+	char		*end;
+	int			i;
+
+	if ( strcmp( s, "ref" ) == 0 ) {
+		text_refs = 1;
+		return 0;
+	}
+	if ( strncmp( s, "max=", 4 ) == 0 ) {
+		max_seg = strtoull( s + 4, &end, 10 );
+		switch ( *end ) {
+		case 'g':
+		case 'G':
+			max_seg *= 1024;
+		case 'm':
+		case 'M':
+			max_seg *= 1024;
+		case 'k':
+		case 'K':
+			max_seg *= 1024;
+			end++;
+			break;
+		}
+		return (end == s + 4 || *end != '\0') ? -1 : 0;
+	}
+	if ( *s != '+' && *s != '-' )
+		return -1;
+
+	if ( (r = calloc( 1, sizeof *r )) == NULL )
+		return -1;
+	r->include = (*s++ == '+');
+	if ( strncmp( s, "name=", 5 ) == 0 && s[5] != '\0' ) {
+		if ( (r->pattern = strdup( s + 5 )) == NULL ) {
+			free( r );
+			return -1;
+		}
+		have_names = 1;
+	} else {
+		for ( i = 0; i < sizeof types / sizeof *types; i++ ) {
+			if ( strcmp( s, types[i].name ) == 0 ) {
+				r->types = types[i].type;
+				break;
+			}
+		}
+		if ( r->types == 0 ) {
+			free( r );
+			return -1;
+		}
+	}
+	*rules_tail = r;
+	rules_tail = &r->next;
+	return 0;
+}
+
+int policy_parse( const char *spec )
+{
+	char	*buf, *s, *next;
+
+	if ( (buf = strdup( spec )) == NULL ) {
+		perror( "dumper" );
+		return -1;
+	}
+	for ( s = buf; s != NULL; s = next ) {
+		if ( (next = strchr( s, ',' )) != NULL )
+			*next++ = '\0';
+		if ( *s != '\0' && parse_rule( s ) == -1 ) {
+			fprintf( stderr, "dumper: bad segment rule '%s'\n", s );
+			free( buf );
+			return -1;
+		}
+	}
+	free( buf );
+	return 0;
+}
+
+static int read_as( int fd, uint64_t addr, void *buf, size_t len )
+{
+	if ( lseek( fd, addr, SEEK_SET ) == -1 )
+		return -1;
+	return (read( fd, buf, len ) == len) ? 0 : -1;
+}
+
+/*
+ * Look for an NT_GNU_BUILD_ID note in the ELF object whose first byte
+ * is mapped at base.  Returns the length of the id, 0 if there isn't one.
+ */
+static int read_build_id( int fd, uint64_t base, unsigned char *id )
+{
+	Elf32_Ehdr	ehdr;
+	Elf32_Phdr	phdr;
+	Elf32_Nhdr	nhdr;
+	char		notes[512];
+	unsigned	off, len, step;
+	int			i;
+
+	if ( read_as( fd, base, &ehdr, sizeof ehdr ) == -1 ||
+			memcmp( ehdr.e_ident, ELFMAG, SELFMAG ) != 0 ||
+			ehdr.e_phentsize != sizeof phdr ) {
+		return 0;
+	}
+	for ( i = 0; i < ehdr.e_phnum; i++ ) {
+		if ( read_as( fd, base + ehdr.e_phoff + i * sizeof phdr, &phdr, sizeof phdr ) == -1 )
+			return 0;
+		if ( phdr.p_type != PT_NOTE )
+			continue;
+		len = min( phdr.p_filesz, sizeof notes );
+		if ( read_as( fd, base + phdr.p_offset, notes, len ) == -1 )
+			continue;
+		for ( off = 0; off + sizeof nhdr <= len; ) {
+			memcpy( &nhdr, notes + off, sizeof nhdr );
+			off += sizeof nhdr;
+			/* the sizes come from the process, don't let them wrap off */
+			if ( nhdr.n_namesz > len - off || nhdr.n_descsz > len - off )
+				break;
+			if ( nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4 &&
+					nhdr.n_descsz <= BUILD_ID_MAX &&
+					off + 4 + nhdr.n_descsz <= len &&
+					memcmp( notes + off, "GNU", 4 ) == 0 ) {
+				memcpy( id, notes + off + 4, nhdr.n_descsz );
+				return nhdr.n_descsz;
+			}
+			step = roundup( nhdr.n_namesz, 4 ) + roundup( nhdr.n_descsz, 4 );
+			if ( step > len - off || off + step < off )
+				break;
+			off += step;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Build the QNT_CORE_MAPREF descriptor for a text segment.
+ * mem->offset is the offset of mem->vaddr in the object.
+ */
+static void *make_ref( int fd, procfs_mapinfo *mem, procfs_debuginfo *dbg, unsigned *refsz )
+{
+	core_mapref		*ref;
+	unsigned char	id[BUILD_ID_MAX];
+	struct stat		st;
+	int				idsz, pathsz;
+
+	idsz = read_build_id( fd, mem->vaddr - mem->offset, id );
+	pathsz = strlen( dbg->path ) + 1;
+	if ( (ref = calloc( 1, sizeof *ref + idsz + pathsz )) == NULL )
+		return NULL;
+
+	ref->vaddr = mem->vaddr;
+	ref->size = mem->size;
+	ref->offset = mem->offset;
+	ref->link_vaddr = dbg->vaddr;
+	if ( stat( dbg->path, &st ) == 0 ) {
+		ref->fsize = st.st_size;
+		ref->mtime = st.st_mtime;
+	}
+	ref->idsz = idsz;
+	ref->pathsz = pathsz;
+	memcpy( ref + 1, id, idsz );
+	memcpy( (char *)(ref + 1) + idsz, dbg->path, pathsz );
+
+	*refsz = sizeof *ref + idsz + pathsz;
+	return ref;
+}
+
+int policy_select( int fd, procfs_mapinfo *mem, uint64_t *filesz, void **ref, unsigned *refsz )
+{
+	union {
+		procfs_debuginfo	i;
+		char				path[sizeof(procfs_debuginfo) + PATH_MAX];
+	}				dbg;
+	struct rule		*r;
+	unsigned		type = seg_type( mem );
+	int				include = 1;
+
+	dbg.i.path[0] = '\0';
+	if ( have_names || (text_refs && type == TYPE_TEXT) ) {
+		dbg.i.vaddr = mem->vaddr;
+		if ( devctl( fd, DCMD_PROC_MAPDEBUG, &dbg, sizeof dbg, 0 ) != EOK )
+			dbg.i.path[0] = '\0';
+	}
+
+	for ( r = rules; r != NULL; r = r->next ) {
+		if ( r->pattern != NULL ) {
+			if ( dbg.i.path[0] != '\0' && fnmatch( r->pattern, dbg.i.path, 0 ) == 0 )
+				include = r->include;
+		} else if ( r->types & type ) {
+			include = r->include;
+		}
+	}
+	if ( !include )
+		return SEG_SKIP;
+
+	/*
+	 * Text that is still mapped shared is the object's own pages, so the
+	 * file holds what was in memory.  Privatised text (relocated, or with
+	 * breakpoints in it) is dumped like anything else.
+	 */
+	if ( text_refs && type == TYPE_TEXT && (mem->flags & MAP_TYPE) == MAP_SHARED &&
+			dbg.i.path[0] == '/' ) {
+		if ( (*ref = make_ref( fd, mem, &dbg.i, refsz )) != NULL ) {
+			*filesz = 0;
+			return SEG_REF;
+		}
+	}
+
+	*filesz = mem->size;
+	if ( max_seg != 0 && type != TYPE_STACK && *filesz > max_seg )
+		*filesz = max_seg;
+	return SEG_DUMP;
+}
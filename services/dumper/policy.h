@@ -0,0 +1,72 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+/*
+ * policy.h
+ *
+ * Selection of the segments that go into a core (the -x option)
+ *
+ */
+
+/*
+	policy_parse
+		adds a comma separated list of rules; returns -1 after
+		printing a message if one of them is bad
+
+	policy_select
+		decides what to do with a segment.  SEG_DUMP: *filesz
+		bytes of it go in the core.  SEG_REF: it goes in with no
+		contents, *ref is a malloc'd QNT_CORE_MAPREF descriptor of
+		*refsz bytes saying where to find them.  SEG_SKIP: leave
+		it out.
+
+	Rules are applied in order and the last one that matches a
+	segment decides whether it is dumped.  Segments no rule
+	matches are dumped.
+
+		+type, -type
+			stack, heap (private anonymous memory), data and
+			text (of executables and shared objects), shared
+			(shared memory and shared file mappings), file
+			(other file mappings) or all
+		+name=pattern, -name=pattern
+			segments of objects whose path matches the
+			fnmatch() pattern
+		max=size[k|m|g]
+			dump at most size bytes of each segment other
+			than stacks
+		ref
+			text that is still shared with the object it was
+			loaded from is not copied, a QNT_CORE_MAPREF note
+			gives the path, build id and offset instead
+*/
+
+#ifndef __POLICY_H__
+#define __POLICY_H__
+
+#include <inttypes.h>
+#include <sys/procfs.h>
+
+#define SEG_SKIP	0
+#define SEG_DUMP	1
+#define SEG_REF		2
+
+int policy_parse( const char *spec );
+int policy_select( int fd, procfs_mapinfo *mem, uint64_t *filesz, void **ref, unsigned *refsz );
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+
+
+
+/*
+	chacha.c
+
+	ChaCha20 (D. J. Bernstein, "ChaCha, a variant of Salsa20", 2008)
+	keystream for the bulk of /dev/random reads.  The key comes from
+	Yarrow; the keystream is not XORed with anything, it is the output.
+
+	The state has a 64 bit block counter in words 12 and 13 and a zero
+	nonce in words 14 and 15.  Keys are never reused across a counter
+	wrap: chacha_output() replaces the key after every call.
+*/
+
+#include <string.h>
+#include <inttypes.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "chacha.h"
+
+#define ROTL32(v,n)  ( ( (v) << (n) ) | ( (v) >> ( 32 - (n) ) ) )
+
+#define LOAD32(p)    ( (uint32_t)(p)[0] | ( (uint32_t)(p)[1] << 8 ) | \
+                       ( (uint32_t)(p)[2] << 16 ) | ( (uint32_t)(p)[3] << 24 ) )
+
+#define STORE32(p,v) ( (p)[0] = (uint8_t)(v), (p)[1] = (uint8_t)( (v) >> 8 ), \
+                       (p)[2] = (uint8_t)( (v) >> 16 ), (p)[3] = (uint8_t)( (v) >> 24 ) )
+
+#define QR(a,b,c,d) \
+	a += b; d = ROTL32( d ^ a, 16 ); \
+	c += d; b = ROTL32( b ^ c, 12 ); \
+	a += b; d = ROTL32( d ^ a, 8 ); \
+	c += d; b = ROTL32( b ^ c, 7 );
+
+static const uint8_t sigma[16] = "expand 32-byte k";
+
+
+void chacha_keysetup( chacha_ctx_t *x, const uint8_t *key )
+{
+	int i;
+
+	for( i=0; i<4; i++ )
+		x->input[i] = LOAD32( sigma + 4 * i );
+	for( i=0; i<8; i++ )
+		x->input[4 + i] = LOAD32( key + 4 * i );
+	for( i=12; i<16; i++ )
+		x->input[i] = 0;
+}
+
+
+/* One block at a time */
+static void chacha_blocks1( chacha_ctx_t *ctx, uint8_t *out, uint32_t nblocks )
+{
+	uint32_t *in = ctx->input;
+	uint32_t x[16];
+	uint32_t v;
+	int i;
+
+	for( ; nblocks > 0; nblocks--, out += CHACHA_BLOCKLEN )
+	{
+		memcpy( x, in, sizeof( x ) );
+
+		for( i=0; i<10; i++ )
+		{
+			QR( x[0], x[4], x[8], x[12] )
+			QR( x[1], x[5], x[9], x[13] )
+			QR( x[2], x[6], x[10], x[14] )
+			QR( x[3], x[7], x[11], x[15] )
+			QR( x[0], x[5], x[10], x[15] )
+			QR( x[1], x[6], x[11], x[12] )
+			QR( x[2], x[7], x[8], x[13] )
+			QR( x[3], x[4], x[9], x[14] )
+		}
+
+		for( i=0; i<16; i++ )
+		{
+			v = x[i] + in[i];
+			STORE32( out + 4 * i, v );
+		}
+
+		if( ++in[12] == 0 )
+			in[13]++;
+	}
+}
+
+
+#if defined(__SSE2__)
+
+#define VROTL32(v,n) _mm_or_si128( _mm_slli_epi32( v, n ), _mm_srli_epi32( v, 32 - (n) ) )
+
+#define VQR(a,b,c,d) \
+	a = _mm_add_epi32( a, b ); d = VROTL32( _mm_xor_si128( d, a ), 16 ); \
+	c = _mm_add_epi32( c, d ); b = VROTL32( _mm_xor_si128( b, c ), 12 ); \
+	a = _mm_add_epi32( a, b ); d = VROTL32( _mm_xor_si128( d, a ), 8 ); \
+	c = _mm_add_epi32( c, d ); b = VROTL32( _mm_xor_si128( b, c ), 7 );
+
+/*
+ * CHACHA_LANES blocks at once, lane n of each register holding a word
+ * of block n.  The blocks are transposed back into order on the way out.
+ */
+static void chacha_blocks4( chacha_ctx_t *ctx, uint8_t *out, uint32_t nblocks )
+{
+	uint32_t *in = ctx->input;
+	__m128i  x[16], s[16];
+	__m128i  a, b, c, d, t0, t1, t2, t3;
+	__m128i  bias;
+	int      i;
+
+	bias = _mm_set1_epi32( 0x80000000 );
+
+	for( ; nblocks >= CHACHA_LANES; nblocks -= CHACHA_LANES )
+	{
+		for( i=0; i<16; i++ )
+			s[i] = _mm_set1_epi32( in[i] );
+
+		/* Counters n..n+3, carrying into word 13 in the lanes that wrap */
+		s[12] = _mm_add_epi32( s[12], _mm_set_epi32( 3, 2, 1, 0 ) );
+		s[13] = _mm_sub_epi32( s[13],
+		            _mm_cmplt_epi32( _mm_xor_si128( s[12], bias ),
+		                             _mm_set1_epi32( in[12] ^ 0x80000000 ) ) );
+
+		for( i=0; i<16; i++ )
+			x[i] = s[i];
+
+		for( i=0; i<10; i++ )
+		{
+			VQR( x[0], x[4], x[8], x[12] )
+			VQR( x[1], x[5], x[9], x[13] )
+			VQR( x[2], x[6], x[10], x[14] )
+			VQR( x[3], x[7], x[11], x[15] )
+			VQR( x[0], x[5], x[10], x[15] )
+			VQR( x[1], x[6], x[11], x[12] )
+			VQR( x[2], x[7], x[8], x[13] )
+			VQR( x[3], x[4], x[9], x[14] )
+		}
+
+		for( i=0; i<16; i+=4 )
+		{
+			a = _mm_add_epi32( x[i], s[i] );
+			b = _mm_add_epi32( x[i + 1], s[i + 1] );
+			c = _mm_add_epi32( x[i + 2], s[i + 2] );
+			d = _mm_add_epi32( x[i + 3], s[i + 3] );
+
+			t0 = _mm_unpacklo_epi32( a, b );
+			t1 = _mm_unpacklo_epi32( c, d );
+			t2 = _mm_unpackhi_epi32( a, b );
+			t3 = _mm_unpackhi_epi32( c, d );
+
+			_mm_storeu_si128( (__m128i *)( out + 4 * i ), _mm_unpacklo_epi64( t0, t1 ) );
+			_mm_storeu_si128( (__m128i *)( out + 64 + 4 * i ), _mm_unpackhi_epi64( t0, t1 ) );
+			_mm_storeu_si128( (__m128i *)( out + 128 + 4 * i ), _mm_unpacklo_epi64( t2, t3 ) );
+			_mm_storeu_si128( (__m128i *)( out + 192 + 4 * i ), _mm_unpackhi_epi64( t2, t3 ) );
+		}
+
+		in[12] += CHACHA_LANES;
+		if( in[12] < CHACHA_LANES )
+			in[13]++;
+		out += CHACHA_LANES * CHACHA_BLOCKLEN;
+	}
+
+	chacha_blocks1( ctx, out, nblocks );
+}
+
+#endif
+
+
+/* nblocks blocks of keystream, advancing the counter */
+void chacha_blocks( chacha_ctx_t *x, uint8_t *out, uint32_t nblocks )
+{
+#if defined(__SSE2__)
+	chacha_blocks4( x, out, nblocks );
+#else
+	chacha_blocks1( x, out, nblocks );
+#endif
+}
+
+
+/*
+ * len bytes of keystream into out, then rekey from the keystream that
+ * follows (fast key erasure).  Once this returns, the state says nothing
+ * about what was just handed out.
+ */
+void chacha_output( chacha_ctx_t *x, uint8_t *out, uint32_t len )
+{
+	uint8_t  tail[2 * CHACHA_BLOCKLEN];
+	uint32_t full;
+	uint32_t left;
+
+	full = len / CHACHA_BLOCKLEN;
+	left = len % CHACHA_BLOCKLEN;
+
+	chacha_blocks( x, out, full );
+	chacha_blocks( x, tail, ( left + CHACHA_KEYLEN + CHACHA_BLOCKLEN - 1 ) / CHACHA_BLOCKLEN );
+
+	memcpy( out + full * CHACHA_BLOCKLEN, tail, left );
+	chacha_keysetup( x, tail + left );
+
+	memset( tail, 0, sizeof( tail ) );
+}
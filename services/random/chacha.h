@@ -0,0 +1,47 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+
+
+
+/* chacha.h
+
+   ChaCha20 keystream generator used to expand Yarrow output for
+   /dev/random readers.
+*/
+
+#ifndef __CHACHA_H__
+#define __CHACHA_H__
+
+#include <inttypes.h>
+
+#define CHACHA_KEYLEN     32
+#define CHACHA_BLOCKLEN   64
+#define CHACHA_LANES      4     /* blocks computed side by side */
+
+typedef struct
+{
+	uint32_t input[16];
+} chacha_ctx_t;
+
+void chacha_keysetup( chacha_ctx_t *x, const uint8_t *key );
+void chacha_blocks( chacha_ctx_t *x, uint8_t *out, uint32_t nblocks );
+void chacha_output( chacha_ctx_t *x, uint8_t *out, uint32_t len );
+
+#endif
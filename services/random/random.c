@@ -37,10 +37,11 @@
 #include "sources.h"
 
 #define MAX_INTR  32
+#define MAX_THREADS_DEFAULT  4
 
 yarrow_t *Yarrow;
 
-int start_resmgr( void );
+int start_resmgr( int max_threads );
 
 
 static void handle_signals( void )
@@ -83,13 +84,15 @@ int main( int argc, char **argv )
     int  intr_count;
     int  system_poll;
     int  hp_timer;
+    int  max_threads;
     char path[256];
 
     intr_count = 0;
     system_poll = 0;
     hp_timer = 0;
+    max_threads = MAX_THREADS_DEFAULT;
 
-    while( ( c = getopt( argc, argv, "hi:tp" ) ) != -1 )
+    while( ( c = getopt( argc, argv, "hi:tpT:" ) ) != -1 )
     {
         switch( c )
         {
@@ -119,6 +122,12 @@ int main( int argc, char **argv )
             case 't':
                 hp_timer = 1;
                 break;
+
+            case 'T':
+                max_threads = strtol( optarg, 0, 0 );
+                if( max_threads < 1 )
+                    max_threads = 1;
+                break;
         }
     }
 
@@ -128,7 +137,7 @@ int main( int argc, char **argv )
                  "no source of random data given.\n" );
     }
 
-    ret = start_resmgr();
+    ret = start_resmgr( max_threads );
     if( ret != 0 )
     {
         fprintf( stderr, "random: Unable to start resmgr: %s\n", 
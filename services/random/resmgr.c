@@ -28,20 +28,95 @@
 #include <sys/dispatch.h>
 #include <sys/iofunc.h>
 #include <errno.h>
+#include <string.h>
 #include <strings.h>
+#include <pthread.h>
 #include <sys/slog.h>
 #include <sys/slogcodes.h>
 
 #include "yarrow.h"
+#include "chacha.h"
+
+#define RANDOM_BUFSIZE    ( 16 * 1024 )     /* generated per MsgWrite() */
+#define RANDOM_MAX_READ   ( 1024 * 1024 )   /* larger reads come up short */
+#define RANDOM_REKEY      ( 1024 * 1024 )   /* bytes between Yarrow keys */
+
+/*
+ * Each pool thread has its own ChaCha20 generator keyed from Yarrow, so
+ * readers only touch the Yarrow mutex to take a new key: when Yarrow
+ * reseeds or after RANDOM_REKEY bytes.  The generator rekeys itself after
+ * every chunk, so its state never reveals output already handed out.
+ */
+typedef struct
+{
+    chacha_ctx_t  gen;
+    int           keyed;
+    uint32_t      generation;
+    uint32_t      since_key;
+    uint8_t       buf[RANDOM_BUFSIZE];
+} worker_t;
 
 extern yarrow_t *Yarrow;
 
+static pthread_key_t       worker_key;
+static thread_pool_attr_t  pool_attr;
+static pthread_attr_t      thread_attr;
+
+
+static void worker_free( void *p )
+{
+    memset( p, 0, sizeof( worker_t ) );
+    free( p );
+}
+
+
+static worker_t *worker_get( void )
+{
+    worker_t *w;
+
+    w = pthread_getspecific( worker_key );
+    if( w == NULL )
+    {
+        w = calloc( 1, sizeof( *w ) );
+        if( w == NULL )
+            return NULL;
+        pthread_setspecific( worker_key, w );
+    }
+
+    return w;
+}
+
+
+static void worker_generate( worker_t *w, uint32_t len )
+{
+    uint8_t  key[CHACHA_KEYLEN];
+    uint32_t generation;
+
+    generation = Yarrow->generation;
+    if( !w->keyed || w->generation != generation || w->since_key >= RANDOM_REKEY )
+    {
+        yarrow_output( Yarrow, key, sizeof( key ) );
+        chacha_keysetup( &w->gen, key );
+        memset( key, 0, sizeof( key ) );
+
+        w->keyed = 1;
+        w->generation = generation;
+        w->since_key = 0;
+    }
+
+    chacha_output( &w->gen, w->buf, len );
+    w->since_key += len;
+}
+
+
 static int dev_random_read( resmgr_context_t *ctp, io_read_t *msg, 
                             RESMGR_OCB_T *ocb )
 {
-    int status;
-    int bytes_used;
-    uint8_t local_data[1024];
+    int       status;
+    worker_t  *w;
+    uint32_t  nbytes;
+    uint32_t  off;
+    uint32_t  len;
 
     status = iofunc_read_verify( ctp, msg, ocb, NULL );
     if( status != EOK ) {
@@ -56,30 +131,54 @@ static int dev_random_read( resmgr_context_t *ctp, io_read_t *msg,
         return EAGAIN;
     }
 
-    bytes_used = min( sizeof( local_data ), msg->i.nbytes );
-
-    memset( local_data, 0, sizeof( local_data ) );
+    w = worker_get();
+    if( w == NULL ) {
+        return ENOMEM;
+    }
 
-    if( Yarrow && bytes_used > 0 ) {
-        yarrow_output( Yarrow, local_data, bytes_used );
+    nbytes = min( RANDOM_MAX_READ, msg->i.nbytes );
+
+    /* Nothing here needs the attribute; let other readers in */
+    iofunc_attr_unlock( ocb->attr );
+
+    if( nbytes <= sizeof( w->buf ) ) {
+        worker_generate( w, nbytes );
+        MsgReply( ctp->rcvid, nbytes, w->buf, nbytes );
+    } else {
+        for( off = 0; off < nbytes; off += len ) {
+            len = min( sizeof( w->buf ), nbytes - off );
+            worker_generate( w, len );
+            if( MsgWrite( ctp->rcvid, w->buf, len, off ) == -1 ) {
+                break;
+            }
+        }
+        if( off < nbytes ) {
+            MsgError( ctp->rcvid, errno );
+        } else {
+            MsgReply( ctp->rcvid, nbytes, NULL, 0 );
+        }
     }
 
-    MsgReply( ctp->rcvid, bytes_used, local_data, bytes_used );
+    iofunc_attr_lock( ocb->attr );
 
     return  _RESMGR_NOREPLY;
 }
 
 
-static void * resmgr_thread( void *p )
+int start_resmgr( int max_threads )
 {
-    resmgr_context_t         *ctp;
-    resmgr_connect_funcs_t   connect_funcs;
-    resmgr_io_funcs_t        io_funcs;
-    iofunc_attr_t            io_attr;
-    resmgr_attr_t            res_attr;
-    int                      id1;
-    int                      id2;
-    dispatch_t               *dispatch;
+    static resmgr_connect_funcs_t connect_funcs;
+    static resmgr_io_funcs_t      io_funcs;
+    static iofunc_attr_t          io_attr;
+    resmgr_attr_t                 res_attr;
+    int                           id1;
+    int                           id2;
+    dispatch_t                    *dispatch;
+    thread_pool_t                 *pool;
+
+    errno = pthread_key_create( &worker_key, worker_free );
+    if( errno != EOK )
+        return -1;
 
     dispatch = dispatch_create();
     if( dispatch == NULL )
@@ -87,7 +186,7 @@ static void * resmgr_thread( void *p )
         slogf( _SLOGC_CHAR, _SLOG_CRITICAL, 
                "random: Unable to create dispatch context: %s.", 
                strerror( errno ) );
-        return NULL;
+        return -1;
     }
 
     memset( &res_attr, 0, sizeof( res_attr ) );
@@ -109,38 +208,40 @@ static void * resmgr_thread( void *p )
     {
         slogf( _SLOGC_CHAR, _SLOG_CRITICAL, 
                "random: Unable to attach resmgr: %s.", strerror( errno ) );
-        return NULL;
+        return -1;
     }
 
-    
-    ctp = resmgr_context_alloc( dispatch );
-    if( ctp == NULL )
+    memset( &pool_attr, 0, sizeof( pool_attr ) );
+    pthread_attr_init( &thread_attr );
+    pthread_attr_setdetachstate( &thread_attr, PTHREAD_CREATE_DETACHED );
+    pool_attr.attr = &thread_attr;
+    pool_attr.handle = dispatch;
+    pool_attr.context_alloc = resmgr_context_alloc;
+    pool_attr.context_free = resmgr_context_free;
+    pool_attr.block_func = resmgr_block;
+    pool_attr.unblock_func = resmgr_unblock;
+    pool_attr.handler_func = resmgr_handler;
+    pool_attr.lo_water = 1;
+    pool_attr.hi_water = min( 2, max_threads );
+    pool_attr.increment = 1;
+    pool_attr.maximum = max_threads;
+
+    pool = thread_pool_create( &pool_attr, 0 );
+    if( pool == NULL )
     {
         slogf( _SLOGC_CHAR, _SLOG_CRITICAL, 
-               "random: Unable to allocate resmgr context: %s.", 
+               "random: Unable to create thread pool: %s.", 
                strerror( errno ) );
-        return NULL;
+        return -1;
     }
 
-    while( 1 )
+    if( thread_pool_start( pool ) == -1 )
     {
-        ctp = resmgr_block( ctp );
-        if( ctp == NULL )
-        {
-            slogf( _SLOGC_CHAR, _SLOG_CRITICAL, 
-                   "random: resmgr_block() failed: %s.", strerror( errno ) );
-            return NULL;
-        }
-
-        resmgr_handler( ctp );
+        slogf( _SLOGC_CHAR, _SLOG_CRITICAL, 
+               "random: Unable to start thread pool: %s.", 
+               strerror( errno ) );
+        return -1;
     }
 
-    return NULL;
+    return 0;
 }
-
-
-int start_resmgr( void )
-{
-    return pthread_create( NULL, NULL, resmgr_thread, NULL );
-}
-
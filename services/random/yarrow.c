@@ -151,7 +151,8 @@ yarrow_t * yarrow_create( void )
     /* Create our mutex and lock it */
     pthread_mutexattr_init( &mutex_attr );
     pthread_mutexattr_setrecursive( &mutex_attr, PTHREAD_RECURSIVE_ENABLE );
-    pthread_mutex_init( &p->mutex, NULL );
+    pthread_mutex_init( &p->mutex, &mutex_attr );
+    pthread_mutexattr_destroy( &mutex_attr );
     pthread_mutex_lock( &p->mutex );
 
     /* Does a slow poll and then calls yarrow_make_state(...) */
@@ -228,10 +229,12 @@ int yarrow_add_source( yarrow_t *p, uint32_t *pool_no )
 int yarrow_output( yarrow_t *p, uint8_t *outbuf, uint32_t outbuflen ) 
 {
 	uint32_t i;
+	uint32_t n;
 
     pthread_mutex_lock( &p->mutex );
 
-	for( i=0; i<outbuflen; i++,p->index++,p->numout++ ) 
+	/* Same stream as one byte at a time, copied out a run at a time */
+	for( i=0; i<outbuflen; i+=n ) 
 	{
 		/* Check backtracklimit */
 		if(p->numout > BACKTRACKLIMIT) 
@@ -247,7 +250,11 @@ int yarrow_output( yarrow_t *p, uint8_t *outbuf, uint32_t outbuflen )
 		}
 
 		/* Output data */
-		outbuf[i] = (p->outstate.out)[p->index];
+		n = _MIN( outbuflen - i, 20 - p->index );
+		n = _MIN( n, BACKTRACKLIMIT + 1 - p->numout );
+		memcpy( outbuf + i, p->outstate.out + p->index, n );
+		p->index += n;
+		p->numout += n;
 	}
 
     pthread_mutex_unlock( &p->mutex );
@@ -363,6 +370,7 @@ int yarrow_force_reseed( yarrow_t *p, uint64_t ticks )
 	/* Reset secret state */
 	SHA1Init(&p->pool);
 	yarrow_make_new_state( p, &p->outstate, dig );
+	p->generation++;
 
 	/* Clear counter variables */
 	for( i=0; i<p->pool_count; i++) 
@@ -396,7 +404,11 @@ int yarrow_allow_reseed( yarrow_t *p, uint64_t ticks )
 	{
 		/* Make sure that compression-based entropy estimates are current */
 		resp = comp_get_ratio((p->comp_state)+i,&ratio);
-		if(resp!=COMP_SUCCESS) {return YARROW_ERR_COMPRESSION;}
+		if(resp!=COMP_SUCCESS)
+		{
+			pthread_mutex_unlock( &p->mutex );
+			return YARROW_ERR_COMPRESSION;
+		}
 
 		/* Use 4 instead of 8 to half compression estimate */
 		temp[i] = _MIN( (int)( ratio*p->poolSize[i]*4), (int)p->poolEstBits[i] ); 
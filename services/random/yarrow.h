@@ -62,6 +62,7 @@ typedef struct
 	yarrow_gen_ctx_t  outstate;
 	uint32_t          index;
 	uint32_t          numout;
+	uint32_t          generation;   /* bumped on every reseed */
 
 	/* Entropy Pools (somewhat unlike a gene pool) */
 	sha1_ctx_t        pool;
@@ -43,12 +43,14 @@
 #include <sys/time.h>
 #include <sys/dcmd_chr.h>
 #include <sys/slog.h>
+#include <sys/mman.h>
 #include "struct.h"
 #include "proto.h"
 
 
 EXT int						 Verbose;		// Be noisy
 EXT int						 NumInts;		// Number ints in a buffer
+EXT int						 RingInts;		// Number ints in the shared ring
 EXT int                      LogFflags;     // Logfile flags
 EXT int						 LogFsize;		// Maxsize of logfile
 EXT char					*LogFname;		// Name of logfile
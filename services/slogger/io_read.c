@@ -49,6 +49,10 @@ io_read(resmgr_context_t *ctp, io_read_t *msg, iofunc_ocb_t *ocb) {
 
 	trp = (struct slogdev *) ocb->attr;
 
+	// Pick up what clients have put in the ring.
+	if(trp->ring)
+		ring_drain(trp);
+
 	// First time in after an open ptr will be NULL.
 	ptr = OCBGET(ocb);
 	if(ptr == NULL)
@@ -60,10 +64,16 @@ io_read(resmgr_context_t *ctp, io_read_t *msg, iofunc_ocb_t *ocb) {
 		if(nonblock)
 			return(EAGAIN);
 
-		if(wait_add(trp, ctp->rcvid, ctp->info.priority) != 0)
-			return(EAGAIN);
+		// Have the next client to finish an event in the ring pulse us.
+		if(ring_arm(trp) == 0) {
+			if(wait_add(trp, ctp->rcvid, ctp->info.priority) != 0)
+				return(EAGAIN);
 			
-		return(_RESMGR_NOREPLY);
+			return(_RESMGR_NOREPLY);
+		}
+
+		// Events turned up; appending them may have moved us.
+		ptr = OCBGET(ocb);
 	}
 
 	// Calculate the number of ints we can transfer.
@@ -22,28 +22,15 @@
 
 #define _SLOG_MINSIZE (3 * sizeof(int))
 
-static int
-_io_write_log(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb, unsigned cnt, int txt) {
+//
+// Add an event of cnt ints (header included) to the buffer. The time in
+// the header has already been filled in.
+//
+void slog_append(struct slogdev *trp, int *ptr, int *ptr2, unsigned cnt) {
 	unsigned			 n;
-	int					*ptr;
-	int					*ptr2;
-	struct slogdev		*trp;
-	struct waiting		*wap;
-	struct timeval    tval;
-	int msecs;
-	int txt_hdr[_SLOG_HDRINTS] = {_SLOG_TEXTBIT, 0,0};
-
-	/*
-	 * The /dev/console entrypoint doesn't add the HDRINTS, so if this
-	 * is a /dev/console entry, we'll have to add the space for the headers
-	 * here.
-	 */
-  	if (txt)
-		cnt += _SLOG_HDRINTS;
 
 	// If no room we remove events to make room. This is the normal case
 	// after we have been running for awhile.
-	trp = (struct slogdev *) ocb->attr;
 	while((NumInts - trp->cnt) < cnt) {
 		n = _SLOG_GETCOUNT(*trp->get) + _SLOG_HDRINTS;
 		check_overrun(trp, trp->get, n);
@@ -54,19 +41,8 @@ _io_write_log(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb, unsigne
 		}
 	}
 
-	// Patch in the size of the event and the time.
-	if(txt){
-		ptr = txt_hdr;
-		ptr2 = (int *)(sizeof(msg->i) + (char *)&msg->i);
-	}
-	else{
-		ptr = (int *)(sizeof(msg->i) + (char *)&msg->i);
-		ptr2 = ptr + _SLOG_HDRINTS;
-	}
-  gettimeofday(&tval, NULL);
-  msecs = tval.tv_usec/1000;
-  ptr[0] = ((*ptr & (~0x00fffff0)) | (msecs << 4)) | ((cnt - _SLOG_HDRINTS) << 16);
-  ptr[2] = tval.tv_sec;
+	// Patch in the size of the event.
+	ptr[0] = (ptr[0] & ~0x00ff0000) | ((cnt - _SLOG_HDRINTS) << 16);
 	// Really used for debugging
 	if(Verbose >= 3) printf("Add %5d %5d Put: %p, beg : %p end: %p\n", trp->put-trp->beg, cnt, trp->put,trp->beg,trp->end);
 
@@ -118,7 +94,12 @@ _io_write_log(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb, unsigne
 			trp->get = trp->beg + (trp->get-trp->end);
 		}
 	}
-	
+}
+
+
+void slog_wakeup(resmgr_context_t *ctp, struct slogdev *trp) {
+	struct waiting		*wap;
+
 	/*
 	PR 26878
 	To avoid priority inversion 'readers' waiting list has to be in order of decreased priority.
@@ -135,6 +116,51 @@ _io_write_log(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb, unsigne
 				printf("resmgr_msg_again failed\n");
 		}
 	}
+}
+
+
+//
+// rpos is where the ring had got to when the message came in.
+//
+static int
+_io_write_log(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb, unsigned cnt, int txt, unsigned rpos) {
+	int					*ptr;
+	int					*ptr2;
+	struct slogdev		*trp;
+	struct timeval    tval;
+	int msecs;
+	int txt_hdr[_SLOG_HDRINTS] = {_SLOG_TEXTBIT, 0,0};
+
+	/*
+	 * The /dev/console entrypoint doesn't add the HDRINTS, so if this
+	 * is a /dev/console entry, we'll have to add the space for the headers
+	 * here.
+	 */
+  	if (txt)
+		cnt += _SLOG_HDRINTS;
+
+	// Events clients have put in the ring go first.
+	trp = (struct slogdev *) ocb->attr;
+	if(trp->ring)
+		ring_drain(trp);
+
+	// Patch in the time.
+	if(txt){
+		ptr = txt_hdr;
+		ptr2 = (int *)(sizeof(msg->i) + (char *)&msg->i);
+	}
+	else{
+		ptr = (int *)(sizeof(msg->i) + (char *)&msg->i);
+		ptr2 = ptr + _SLOG_HDRINTS;
+	}
+  gettimeofday(&tval, NULL);
+  msecs = tval.tv_usec/1000;
+  ptr[0] = (*ptr & (~0x00fffff0)) | (msecs << 4);
+  ptr[2] = tval.tv_sec;
+
+	if(trp->ring == NULL || ring_defer(trp, rpos, ptr, ptr2, cnt) == -1)
+		slog_append(trp, ptr, ptr2, cnt);
+	slog_wakeup(ctp, trp);
 
 	return(EOK);
 }
@@ -146,6 +172,8 @@ io_write(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb) {
 	int					 status;
 	int					 nonblock;
 	unsigned			 cnt;
+	unsigned			 rpos;
+	struct slogdev		*trp;
 
 	// Is device open for write?
 	if((status = iofunc_write_verify(ctp, msg, ocb, &nonblock)) != EOK)
@@ -162,13 +190,17 @@ io_write(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb) {
 
 	cnt = msg->i.nbytes/sizeof(int);
 
+	// Once we reply the client can add more to the ring.
+	trp = (struct slogdev *) ocb->attr;
+	rpos = trp->ring ? trp->ring->reserve : 0;
+
 	/*
 	PR 26878
 	To avoid priority inversion reply to 'writer' immediately.
 	*/
 	MsgReply(ctp->rcvid,  msg->i.nbytes, NULL, 0);
 
-	_io_write_log(ctp, msg, ocb, cnt, 0);
+	_io_write_log(ctp, msg, ocb, cnt, 0, rpos);
 
 
 	return(_RESMGR_NOREPLY);
@@ -216,6 +248,8 @@ io_console_write(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb) {
 	int		status;
 	int		nonblock;
 	char	*cptr;
+	unsigned	rpos;
+	struct slogdev	*trp;
 
 	ret = EOK;
 	cptr = (char *) (sizeof(msg->i) + (char *)&msg->i);
@@ -229,6 +263,9 @@ io_console_write(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb) {
 	// No special xtypes
 	if((msg->i.xtype & _IO_XTYPE_MASK) != _IO_XTYPE_NONE)
 		return(EINVAL);
+
+	trp = (struct slogdev *) ocb->attr;
+	rpos = trp->ring ? trp->ring->reserve : 0;
 	
 	while(off < len) {
 		
@@ -240,7 +277,7 @@ io_console_write(resmgr_context_t *ctp, io_write_t *msg, iofunc_ocb_t *ocb) {
 		cnt = n/sizeof(int) +1;
 
 		/* put it in the log */
-		ret = _io_write_log(ctp, msg, ocb, cnt, 1);
+		ret = _io_write_log(ctp, msg, ocb, cnt, 1, rpos);
 		if(ret != EOK)
 			break;
 	
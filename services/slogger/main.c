@@ -112,6 +112,12 @@ int main(int argc, char *argv[]) {
 		fprintf(stderr, "%s: Couldn't become daemon.\n", argv[0]);
 	}
 
+	// Let clients add events through shared memory. Without it they
+	// still get to us with messages.
+	if(RingInts && ring_init(trp, dpp, RING_PULSE_CODE) == -1) {
+		fprintf(stderr, "%s: Unable to create ring %s (%s)\n", __progname, _SLOG_RING_NAME, strerror(errno));
+	}
+
 	// Slogger is single-threaded
 	ctp = resmgr_context_alloc(dpp);
 
@@ -119,6 +125,15 @@ int main(int argc, char *argv[]) {
 		if((ctp = resmgr_block(ctp)) == NULL)
 			exit(EXIT_FAILURE);
 
+		// A client added to the ring and found readers waiting
+		if(ctp->rcvid == 0 && ctp->msg->pulse.code == RING_PULSE_CODE) {
+			if(trp->ring) {
+				ring_drain(trp);
+				slog_wakeup(ctp, trp);
+			}
+			continue;
+		}
+
 		resmgr_handler(ctp);
 	}
 
@@ -27,11 +27,12 @@ void options(int argc, char *argv[]) {
 
 	// Setup defaults
 	NumInts = 4096;		// Works out to a 16K buffer
+	RingInts = 4096;	// 16K shared ring
 	LogFsize = 0;		// Default is to grow and grow...
 	FilterLog = _SLOG_DEBUG1;	// Log everything
 	LogFflags = 0;		// Default no flags set
 
-	while((opt = getopt(argc, argv, "cf:l:s:v")) != -1) {
+	while((opt = getopt(argc, argv, "cf:l:r:s:v")) != -1) {
 	switch(opt) {
 			case 'c':             /* Commit modifications as per O_SYNC */
 			LogFflags |= LOGF_FLAG_OSYNC;
@@ -48,6 +49,10 @@ void options(int argc, char *argv[]) {
 			}
 			break;
 
+		case 'r':
+			RingInts = atoi(optarg)*(1024/4);
+			break;
+
 		case 's':
 			NumInts = atoi(optarg)*(1024/4);
 			if(NumInts < 1024)
@@ -25,6 +25,12 @@ void slogger_init(struct slogdev *trp);
 void *logger(void *dummy);
 void check_overrun(struct slogdev *trp, int *ptr, int cnt);
 int wait_add(struct slogdev *trp, int rcvid, int priority);
+void slog_append(struct slogdev *trp, int *ptr, int *ptr2, unsigned cnt);
+void slog_wakeup(resmgr_context_t *ctp, struct slogdev *trp);
+int ring_init(struct slogdev *trp, dispatch_t *dpp, int code);
+int ring_drain(struct slogdev *trp);
+int ring_defer(struct slogdev *trp, unsigned pos, int *ptr, int *ptr2, unsigned cnt);
+int ring_arm(struct slogdev *trp);
 
 extern resmgr_io_funcs_t io_funcs;
 extern resmgr_connect_funcs_t connect_funcs;
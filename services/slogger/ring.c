@@ -0,0 +1,243 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+ 
+#include "externs.h"
+
+// A reserved event that hasn't been finished after this many seconds
+// belongs to a producer that has died; it is thrown away.
+#define RING_STALL		2
+
+
+//
+// Create the shared memory ring that the slog functions in libc append
+// events to directly. They pulse us when they find ring->wakeup set.
+//
+int ring_init(struct slogdev *trp, dispatch_t *dpp, int code) {
+	struct _slog_ring	*ring;
+	struct _server_info	 info;
+	unsigned			 n;
+	size_t				 size;
+	int					 fd, coid;
+
+	// The ring size must be a power of 2
+	for(n = 1024 ; n * 2 <= RingInts ; n *= 2)
+		;
+	size = offsetof(struct _slog_ring, data) + n * sizeof(ring->data[0]);
+
+	if((coid = message_connect(dpp, MSG_FLAG_SIDE_CHANNEL)) == -1)
+		return(-1);
+	if(ConnectServerInfo(0, coid, &info) != coid) {
+		ConnectDetach(coid);
+		return(-1);
+	}
+	ConnectDetach(coid);
+
+	// Clients still holding a ring from an earlier slogger get errors when
+	// they pulse it and look for this one.
+	shm_unlink(_SLOG_RING_NAME);
+	if((fd = shm_open(_SLOG_RING_NAME, O_RDWR | O_CREAT | O_EXCL, 0666)) == -1)
+		return(-1);
+	fchmod(fd, 0666);
+	if(ftruncate(fd, size) == -1 ||
+	   (ring = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		shm_unlink(_SLOG_RING_NAME);
+		return(-1);
+	}
+	close(fd);
+
+	memset(ring, 0, size);
+	ring->size = n;
+	ring->pid = getpid();
+	ring->chid = info.chid;
+	ring->code = code;
+	__cpu_membarrier();
+	ring->magic = _SLOG_RING_MAGIC;
+
+	trp->ring = ring;
+	trp->ring_mask = n - 1;
+	trp->ring_consume = 0;
+	return(0);
+}
+
+
+//
+// True if the event at pos has been unfinished for RING_STALL seconds.
+//
+static int ring_stalled(struct slogdev *trp, unsigned pos) {
+	time_t		now;
+
+	now = time(NULL);
+	if(trp->stall_time == 0 || trp->stall_pos != pos) {
+		trp->stall_pos = pos;
+		trp->stall_time = now;
+		return(0);
+	}
+	return(now - trp->stall_time >= RING_STALL);
+}
+
+
+//
+// Append the held back events whose place in the ring has been reached.
+//
+static int ring_flush(struct slogdev *trp) {
+	struct deferred		*dp;
+	int					 cnt;
+
+	for(cnt = 0 ; (dp = trp->deferred) && (int)(dp->pos - trp->ring_consume) <= 0 ; cnt++) {
+		trp->deferred = dp->next;
+		trp->deferred_ints -= dp->cnt;
+		slog_append(trp, dp->ev, dp->ev + _SLOG_HDRINTS, dp->cnt);
+		free(dp);
+	}
+	return(cnt);
+}
+
+
+//
+// An event came as a message when the ring had reached pos. Events that
+// were reserved in the ring before that (perhaps by the same client, which
+// found it full) have to go in first, so if they haven't yet the event is
+// held back. More than the buffer holds would only overwrite each other
+// once they go in, so the oldest are dropped. Returns -1 if it can be
+// appended now.
+//
+int ring_defer(struct slogdev *trp, unsigned pos, int *ptr, int *ptr2, unsigned cnt) {
+	struct deferred		*dp;
+
+	if(trp->deferred == NULL && (int)(pos - trp->ring_consume) <= 0)
+		return(-1);
+	if((dp = malloc(offsetof(struct deferred, ev) + cnt * sizeof(int))) == NULL)
+		return(-1);
+
+	dp->next = NULL;
+	dp->pos = pos;
+	dp->cnt = cnt;
+	memcpy(dp->ev, ptr, _SLOG_HDRINTS * sizeof(int));
+	memcpy(dp->ev + _SLOG_HDRINTS, ptr2, (cnt - _SLOG_HDRINTS) * sizeof(int));
+	if(trp->deferred == NULL)
+		trp->deferred = dp;
+	else
+		trp->deferred_last->next = dp;
+	trp->deferred_last = dp;
+	trp->deferred_ints += cnt;
+
+	while(trp->deferred_ints > NumInts) {
+		dp = trp->deferred;
+		trp->deferred = dp->next;
+		trp->deferred_ints -= dp->cnt;
+		free(dp);
+	}
+	return(0);
+}
+
+
+//
+// Move the finished events at the front of the ring into the buffer.
+// Events are taken in the order they were reserved, so one that is still
+// being written holds up the ones behind it, and the message events
+// held back behind them. The ring is written by
+// every client, so nothing in it is trusted: its size and our place in it
+// are our own copies, and a reserve more than a ring ahead throws it all away.
+// Returns the number of events moved; the caller wakes the readers.
+//
+int ring_drain(struct slogdev *trp) {
+	struct _slog_ring	*ring = trp->ring;
+	volatile _Uint32t	*data = ring->data;
+	unsigned			 mask = trp->ring_mask;
+	unsigned			 pos, end, ctl, n, i;
+	int					 cnt;
+	int					 ev[_SLOG_MAXSIZE / sizeof(int)];
+
+	cnt = ring_flush(trp);
+	for(pos = trp->ring_consume ; pos != (end = ring->reserve) ; ) {
+		// Reserved more than the ring holds; it has been scribbled on.
+		if(end - pos > mask + 1) {
+			if(Verbose >= 1) printf("Ring reset %u %u\n", pos, end);
+			for(i = 0 ; i <= mask ; i++)
+				data[i] = 0;
+			pos = end;
+			__cpu_membarrier();
+			trp->ring_consume = pos;
+			ring->consume = pos;
+			trp->stall_time = 0;
+			continue;
+		}
+
+		ctl = data[pos & mask];
+		n = _SLOG_RING_LEN(ctl);
+
+		if(!(ctl & _SLOG_RING_DONE)) {
+			if(!ring_stalled(trp, pos))
+				break;
+			if(Verbose >= 1) printf("Ring stalled %u %x\n", pos & mask, ctl);
+			ctl = 0;
+		}
+
+		// A bad or abandoned event whose length we can't trust loses us
+		// our place, so everything reserved so far is dropped.
+		if(n < _SLOG_HDRINTS || n > _SLOG_MAXSIZE / sizeof(int) || n >= end - pos) {
+			if(Verbose >= 1) printf("Ring reset %u %x\n", pos & mask, ctl);
+			n = end - pos - 1;
+			ctl = 0;
+		}
+
+		if(ctl) {
+			__cpu_membarrier();
+			for(i = 0 ; i < n ; i++)
+				ev[i] = data[(pos + 1 + i) & mask];
+		}
+
+		// Empty slots must read as 0 when producers come round again.
+		for(i = 0 ; i <= n ; i++)
+			data[(pos + i) & mask] = 0;
+		pos += n + 1;
+		__cpu_membarrier();
+		trp->ring_consume = pos;
+		ring->consume = pos;
+		trp->stall_time = 0;
+
+		if(ctl) {
+			slog_append(trp, ev, ev + _SLOG_HDRINTS, n);
+			cnt++;
+		}
+		cnt += ring_flush(trp);
+	}
+
+	return(cnt);
+}
+
+
+//
+// A reader is about to block. Ask producers for a pulse, then look once
+// more in case an event was finished before they could see the request.
+// Returns the number of events that turned up.
+//
+int ring_arm(struct slogdev *trp) {
+
+	if(trp->ring == NULL)
+		return(0);
+
+	trp->ring->wakeup = 1;
+	__cpu_membarrier();
+	return(ring_drain(trp));
+}
+
+__SRCVERSION("ring.c $Rev: 153052 $");
@@ -17,6 +17,8 @@
 
 
 #define LOGF_FLAG_OSYNC 0x00000001
+
+#define RING_PULSE_CODE	_PULSE_CODE_MINAVAIL	// Events in the ring, readers waiting
  
 
 struct waiting {
@@ -25,6 +27,15 @@ struct waiting {
 	int				 priority;
 } ;
 
+// An event that came as a message while the ring still had events
+// reserved ahead of it.
+struct deferred {
+	struct deferred	*next;
+	unsigned		 pos;		// Ring position it goes after
+	unsigned		 cnt;
+	int				 ev[1];
+} ;
+
 struct ocbs {
 	struct ocbs		*next;
 	IOFUNC_OCB_T	*ocb;
@@ -41,6 +52,14 @@ struct slogdev {
 	int					*beg;		// Pointer to begining of buf
 	int					*end;		// Pointer to end of buf + 1
 	int					 id;		// Contains id of /dev/slog
+	struct _slog_ring	*ring;		// Shared ring clients append to
+	unsigned			 ring_mask;	// Its size - 1, and how far we have
+	unsigned			 ring_consume;	// taken, kept away from clients
+	unsigned			 stall_pos;	// Ring event that isn't finished
+	time_t				 stall_time;	// and when it was first seen
+	struct deferred		*deferred;	// Waiting for the ring to catch up
+	struct deferred		*deferred_last;
+	int					 deferred_ints;	// Their total size
 } ;
 
 
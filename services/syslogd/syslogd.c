@@ -141,8 +141,11 @@ static char sccsid[] = "@(#)syslogd.c	5.45 (Berkeley) 3/2/91";
 #include <unix.h>
 
 #ifdef __QNXNTO__
-#define	fsync(x)
 #include <sys/resmgr.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
 pthread_mutex_t	synch_lock;
 #endif
 
@@ -195,8 +198,54 @@ struct filed {
 	int	f_prevlen;			/* length of f_prevline */
 	int	f_prevcount;			/* repetition cnt of prevline */
 	int	f_repeatcount;			/* number of "repeated" msgs */
+#ifdef __QNXNTO__
+	struct	fqueue *f_queue;		/* F_FILE write queue */
+#endif
+};
+
+#ifdef __QNXNTO__
+/*
+ * Messages for a log file are copied into a queue and written out by a
+ * thread of its own, as many at a time as have arrived, so a slow disk
+ * holds up the writer rather than the threads receiving messages.  When
+ * the queue is full senders wait for it with synch_lock released (or,
+ * with -D, the message is dropped and a count of the dropped messages
+ * goes in the file later).  If a write fails the writer stops, and the
+ * next message for the file reports the error and retires it.
+ */
+struct fqueue {
+	pthread_mutex_t	q_lock;
+	pthread_cond_t	q_work;		/* writer waits for messages */
+	pthread_cond_t	q_space;	/* senders wait for room */
+	pthread_t	q_tid;
+	int	q_fd;
+	char	*q_buf;			/* being filled */
+	char	*q_out;			/* being written */
+	int	q_len;			/* bytes in q_buf */
+	int	q_nmsgs;		/* messages in q_buf */
+	int	q_sync;			/* a SYNC_FILE message is in q_buf */
+	int	q_exit;
+	int	q_error;		/* errno of a failed write, writer gone */
+	time_t	q_synctime;		/* next group fsync, 0 if none due */
+	unsigned q_dropped;		/* not reported in the file yet */
+	unsigned q_msgs;		/* totals */
+	unsigned q_writes;
+	unsigned q_waits;
+	unsigned q_drops;
 };
 
+int	QueueSize = 64 * 1024;	/* bytes queued per log file, 0 for none */
+int	SyncInterval = 0;	/* seconds between fsyncs of a log file */
+int	QueueDrop = 0;		/* drop messages when a queue is full */
+int	QueueWaiters = 0;	/* senders waiting for room, under synch_lock */
+pthread_cond_t	QueueIdle = PTHREAD_COND_INITIALIZER;
+
+struct fqueue *fq_create(int fd);
+int fq_put(struct fqueue *q, struct iovec *iov, int iovcnt, int flags);
+void fq_quiesce(void);
+void fq_destroy(struct fqueue *q);
+#endif
+
 /*
  * Intervals at which we flush out "message repeated" messages,
  * in seconds after previous message is logged.  After each flush,
@@ -248,6 +297,27 @@ void sighup( int signo){
 S++;
 }
 
+#ifdef __QNXNTO__
+/*
+ * SIGTERM (and SIGQUIT when debugging) are blocked in every thread and
+ * taken here instead, so that die() runs as an ordinary thread and can
+ * lock the queues and join their writers.
+ */
+sigset_t	DieSigs;
+
+static void *
+die_catcher(void *arg)
+{
+	void	die();
+	int	sig;
+
+	while (sigwait(&DieSigs, &sig) != EOK)
+		;
+	die(sig);
+	return NULL;
+}
+#endif
+
 #ifndef __QNXNTO__
 int write_messages(nid_t node, struct filed *f, char *msg, int msg_len);
 int daemon(int, int);
@@ -281,7 +351,7 @@ main(argc, argv)
 	void die(), domark(), init(), reapchild();
 
 #ifdef __QNXNTO__
-	while ((ch = getopt(argc, argv, "df:m:t:")) != EOF)
+	while ((ch = getopt(argc, argv, "Ddf:m:q:S:t:")) != EOF)
 #else
 	while ((ch = getopt(argc, argv, "df:m:")) != EOF)
 #endif
@@ -299,6 +369,17 @@ main(argc, argv)
 		case 't':
 			threads = atoi(optarg);
 			break;
+		case 'D':		/* drop when a file's queue is full */
+			QueueDrop = 1;
+			break;
+		case 'q':		/* per file queue, kbytes */
+			QueueSize = atoi(optarg) * 1024;
+			if (QueueSize > 0 && QueueSize < 2 * MAXLINE)
+				QueueSize = 2 * MAXLINE;
+			break;
+		case 'S':		/* group fsync interval */
+			SyncInterval = atoi(optarg);
+			break;
 #endif
 		case '?':
 		default:
@@ -312,13 +393,23 @@ main(argc, argv)
 	else
 		setvbuf(stdout, 0, _IOLBF, 0);
 
+#ifdef __QNXNTO__
+	/* blocked before omask is saved, since the main loop restores it */
+	sigemptyset(&DieSigs);
+	sigaddset(&DieSigs, SIGTERM);
+	if (Debug)
+		sigaddset(&DieSigs, SIGQUIT);
+	else
+		(void) signal(SIGQUIT, SIG_IGN);
+	pthread_sigmask(SIG_BLOCK, &DieSigs, NULL);
+#endif
 	omask = sigblock(sigmask(SIGHUP)|sigmask(SIGALRM));
 
-	(void) signal(SIGTERM, die);
 #ifndef __QNXNTO__
+	(void) signal(SIGTERM, die);
 	(void) signal(SIGINT, Debug ? die : SIG_IGN);
-#endif
 	(void) signal(SIGQUIT, Debug ? die : SIG_IGN);
+#endif
 	(void) signal(SIGCHLD, reapchild);
 	(void) signal(SIGALRM, domark);
 	(void) alarm(TIMERINTVL);
@@ -331,6 +422,7 @@ main(argc, argv)
 		}
 #else
 	pthread_mutex_init( &synch_lock, NULL );
+	pthread_create(NULL,NULL, die_catcher, NULL);
 	pthread_create(NULL,NULL, nto_main, NULL);
 #endif
 
@@ -460,7 +552,7 @@ usage(void)
 	(void) fprintf(stderr,
 #ifdef __QNXNTO__
 
-	    "usage: syslogd [-f conffile] [-m markinterval] [-t threads]\n");
+	    "usage: syslogd [-D] [-f conffile] [-m markinterval] [-q kbytes] [-S seconds] [-t threads]\n");
 #else
 	    "usage: syslogd [-f conffile] [-m markinterval] \n");
 #endif
@@ -787,6 +879,20 @@ fprintlog(f, flags, msg)
 			v->iov_base = "\n";
 			v->iov_len = 1;
 		}
+#ifdef __QNXNTO__
+		if (f->f_type == F_FILE && f->f_queue) {
+			/* another sender may have retired it while we waited */
+			if (fq_put(f->f_queue, iov, 6, flags) == -1 &&
+			    f->f_type == F_FILE) {
+				int e = errno;
+				(void) close(f->f_file);
+				f->f_type = F_UNUSED;
+				errno = e;
+				logerror(f->f_un.f_fname);
+			}
+			break;
+		}
+#endif
 		reopencnt= 0;
 		sigrepcnt= 0;
 	again:
@@ -836,6 +942,237 @@ fprintlog(f, flags, msg)
 	return 0;
 }
 
+#ifdef __QNXNTO__
+/*
+ * Queue a formatted message for a log file, called with synch_lock held.
+ * If the queue is full the message is copied and synch_lock is released
+ * while waiting for room, so other files are still written meanwhile;
+ * init() and die() wait for fq_quiesce() before closing anything.
+ * Returns -1 with errno set if the file can no longer be written.
+ */
+int
+fq_put(struct fqueue *q, struct iovec *iov, int iovcnt, int flags)
+{
+	char	note[MAXHOSTNAMELEN + 80], tbuf[26], *msg = NULL;
+	int	i, len, notelen;
+
+	for (len = 0, i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	pthread_mutex_lock(&q->q_lock);
+	/* leave room to say how many were dropped */
+	while (q->q_error == 0 &&
+	    q->q_len + len + (q->q_dropped ? sizeof(note) : 0) > QueueSize) {
+		if (msg == NULL) {
+			/* iov points at buffers others may reuse meanwhile */
+			if (QueueDrop || (msg = malloc(len)) == NULL) {
+				q->q_dropped++;
+				q->q_drops++;
+				pthread_mutex_unlock(&q->q_lock);
+				return 0;
+			}
+			for (notelen = 0, i = 0; i < iovcnt; i++) {
+				memcpy(msg + notelen, iov[i].iov_base, iov[i].iov_len);
+				notelen += iov[i].iov_len;
+			}
+			q->q_waits++;
+		}
+		QueueWaiters++;
+		pthread_mutex_unlock(&synch_lock);
+		pthread_cond_wait(&q->q_space, &q->q_lock);
+		pthread_mutex_unlock(&q->q_lock);
+		pthread_mutex_lock(&synch_lock);
+		pthread_mutex_lock(&q->q_lock);
+		if (--QueueWaiters == 0)
+			pthread_cond_broadcast(&QueueIdle);
+	}
+	if (q->q_error) {
+		errno = q->q_error;
+		pthread_mutex_unlock(&q->q_lock);
+		free(msg);
+		return -1;
+	}
+
+	if (q->q_len == 0)
+		pthread_cond_signal(&q->q_work);
+	if (q->q_dropped) {
+		notelen = sprintf(note,
+		    "%.15s %s syslogd: %u messages dropped\n",
+		    ctime_r(&now, tbuf) + 4, LocalHostName, q->q_dropped);
+		memcpy(q->q_buf + q->q_len, note, notelen);
+		q->q_len += notelen;
+		q->q_dropped = 0;
+	}
+	if (msg != NULL) {
+		memcpy(q->q_buf + q->q_len, msg, len);
+		q->q_len += len;
+		free(msg);
+	} else {
+		for (i = 0; i < iovcnt; i++) {
+			memcpy(q->q_buf + q->q_len, iov[i].iov_base, iov[i].iov_len);
+			q->q_len += iov[i].iov_len;
+		}
+	}
+	q->q_nmsgs++;
+	q->q_msgs++;
+	if (flags & SYNC_FILE)
+		q->q_sync = 1;
+	pthread_mutex_unlock(&q->q_lock);
+	return 0;
+}
+
+/*
+ * Wait, with synch_lock held, for any sender fq_put() has let go of
+ * synch_lock to come back, so the files and queues can be torn down.
+ */
+void
+fq_quiesce(void)
+{
+	while (QueueWaiters > 0)
+		pthread_cond_wait(&QueueIdle, &synch_lock);
+}
+
+/*
+ * Write out whatever has been queued in one go, then fsync if a
+ * SYNC_FILE message was in it or SyncInterval has run out since the
+ * first unsynced write.  A failed write is left in q_error for fq_put()
+ * to report, since logging it here would need synch_lock, and the
+ * writer stops.
+ */
+static void *
+fq_writer(void *arg)
+{
+	struct fqueue	*q = arg;
+	struct timespec	ts;
+	sigset_t	set;
+	char	*p;
+	int	len, n, nmsgs, sync, err;
+
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	pthread_mutex_lock(&q->q_lock);
+	for (;;) {
+		if (q->q_len == 0) {
+			if (q->q_exit)
+				break;
+			if (q->q_synctime == 0) {
+				pthread_cond_wait(&q->q_work, &q->q_lock);
+				continue;
+			}
+			ts.tv_sec = q->q_synctime;
+			ts.tv_nsec = 0;
+			if (pthread_cond_timedwait(&q->q_work, &q->q_lock, &ts) == ETIMEDOUT &&
+			    q->q_len == 0) {
+				q->q_synctime = 0;
+				pthread_mutex_unlock(&q->q_lock);
+				fsync(q->q_fd);
+				pthread_mutex_lock(&q->q_lock);
+			}
+			continue;
+		}
+
+		p = q->q_buf;
+		q->q_buf = q->q_out;
+		q->q_out = p;
+		len = q->q_len;
+		nmsgs = q->q_nmsgs;
+		sync = q->q_sync;
+		q->q_len = q->q_nmsgs = q->q_sync = 0;
+		q->q_writes++;
+		pthread_cond_broadcast(&q->q_space);
+		pthread_mutex_unlock(&q->q_lock);
+
+		while (len > 0) {
+			if ((n = write(q->q_fd, p, len)) < 0) {
+				if (errno == EINTR)
+					continue;
+				err = errno;
+				break;
+			}
+			p += n;
+			len -= n;
+		}
+		if (sync)
+			fsync(q->q_fd);
+
+		pthread_mutex_lock(&q->q_lock);
+		if (len > 0) {
+			q->q_error = err;
+			q->q_drops += nmsgs + q->q_nmsgs;
+			q->q_len = q->q_nmsgs = q->q_synctime = 0;
+			pthread_cond_broadcast(&q->q_space);
+			break;
+		}
+		if (sync)
+			q->q_synctime = 0;
+		else if (SyncInterval > 0 && q->q_synctime == 0)
+			q->q_synctime = time(NULL) + SyncInterval;
+	}
+	sync = (q->q_synctime != 0);
+	pthread_mutex_unlock(&q->q_lock);
+
+	if (sync)
+		fsync(q->q_fd);
+	return NULL;
+}
+
+/*
+ * Start a writer for fd.  NULL if there isn't the memory, the file is
+ * then written synchronously.
+ */
+struct fqueue *
+fq_create(int fd)
+{
+	struct fqueue	*q;
+
+	if ((q = calloc(1, sizeof(*q))) == NULL)
+		return NULL;
+	q->q_fd = fd;
+	q->q_buf = malloc(QueueSize);
+	q->q_out = malloc(QueueSize);
+	if (q->q_buf == NULL || q->q_out == NULL)
+		goto fail;
+	pthread_mutex_init(&q->q_lock, NULL);
+	pthread_cond_init(&q->q_work, NULL);
+	pthread_cond_init(&q->q_space, NULL);
+	if ((errno = pthread_create(&q->q_tid, NULL, fq_writer, q)) != EOK) {
+		logerror("pthread_create");
+		pthread_cond_destroy(&q->q_space);
+		pthread_cond_destroy(&q->q_work);
+		pthread_mutex_destroy(&q->q_lock);
+		goto fail;
+	}
+	return q;
+
+fail:
+	free(q->q_buf);
+	free(q->q_out);
+	free(q);
+	return NULL;
+}
+
+/*
+ * Write out what is queued and stop the writer.  The file stays open.
+ */
+void
+fq_destroy(struct fqueue *q)
+{
+	pthread_mutex_lock(&q->q_lock);
+	q->q_exit = 1;
+	pthread_cond_signal(&q->q_work);
+	pthread_mutex_unlock(&q->q_lock);
+	pthread_join(q->q_tid, NULL);
+
+	pthread_cond_destroy(&q->q_space);
+	pthread_cond_destroy(&q->q_work);
+	pthread_mutex_destroy(&q->q_lock);
+	free(q->q_buf);
+	free(q->q_out);
+	free(q);
+}
+#endif
+
 /*
  *  WALLMSG -- Write a message to the world at large
  *
@@ -1072,6 +1409,10 @@ domark()
 	register struct filed *f;
 	time_t time();
 
+#ifdef __QNXNTO__
+	/* only ever taken in the main thread while it waits in select() */
+	pthread_mutex_lock( &synch_lock );
+#endif
 	now = time((time_t *)NULL);
 	MarkSeq += TIMERINTVL;
 	if (MarkSeq >= MarkInterval) {
@@ -1088,6 +1429,9 @@ domark()
 			BACKOFF(f);
 		}
 	}
+#ifdef __QNXNTO__
+	pthread_mutex_unlock( &synch_lock );
+#endif
 	(void) alarm(TIMERINTVL);
 }
 
@@ -1116,6 +1460,10 @@ die(sig)
 	register struct filed *f;
 	char buf[100];
 
+#ifdef __QNXNTO__
+	/* keep everyone else out of the files and queues until we exit */
+	pthread_mutex_lock( &synch_lock );
+#endif
 	for (f = Files; f != NULL; f = f->f_next) {
 		/* flush any pending output */
 		if (f->f_prevcount)
@@ -1127,6 +1475,16 @@ die(sig)
 		errno = 0;
 		logerror(buf);
 	}
+#ifdef __QNXNTO__
+	/* let the writers finish */
+	fq_quiesce();
+	for (f = Files; f != NULL; f = f->f_next) {
+		if (f->f_queue) {
+			fq_destroy(f->f_queue);
+			f->f_queue = NULL;
+		}
+	}
+#endif
 	//(void) unlink(LogName);
 	exit(0);
 }
@@ -1150,11 +1508,30 @@ init()
 	 *  Close all open log files.
 	 */
 	Initialized = 0;
+#ifdef __QNXNTO__
+	/* flushing may let go of synch_lock, so not while freeing entries */
+	for (f = Files; f != NULL; f = f->f_next) {
+		if (f->f_prevcount)
+			fprintlog(f, 0, (char *)NULL);
+	}
+	fq_quiesce();
+#endif
 	for (f = Files; f != NULL; f = next) {
+#ifndef __QNXNTO__
 		/* flush any pending output */
 		if (f->f_prevcount)
 			fprintlog(f, 0, (char *)NULL);
+#endif
 
+#ifdef __QNXNTO__
+		if (f->f_queue) {
+			dprintf("%s: %u messages, %u writes, %u waits, %u dropped\n",
+			    f->f_un.f_fname, f->f_queue->q_msgs,
+			    f->f_queue->q_writes, f->f_queue->q_waits,
+			    f->f_queue->q_drops);
+			fq_destroy(f->f_queue);
+		}
+#endif
 		switch (f->f_type) {
 		  case F_FILE:
 		  case F_TTY:
@@ -1356,6 +1733,10 @@ cfline(line, f)
 			f->f_type = F_FILE;
 		if (strcmp(p, ctty) == 0)
 			f->f_type = F_CONSOLE;
+#ifdef __QNXNTO__
+		if (f->f_type == F_FILE && QueueSize > 0)
+			f->f_queue = fq_create(f->f_file);
+#endif
 		break;
 
 	case '*':
@@ -321,6 +321,14 @@ extern const int ker_call_entry_num;
 
 #if defined(VARIANT_instr)
 
+// A predicate program (_NTO_TRACE_SETFILTER). users counts the cpus
+// evaluating it, so that it isn't rewritten under them.
+typedef struct trace_filter_prog {
+	volatile unsigned users;
+	uint32_t          num;
+	trace_filter_t    filter[_NTO_TRACE_FILTER_MAX];
+} trace_filter_prog_t;
+
 EXT struct trace_masks {
 	// Mask declarations/definitions
 	uint32_t ring_mode;
@@ -394,6 +402,18 @@ EXT struct trace_masks {
 	uint32_t          send_buff_num;
 	uint32_t          skip_buff;
 	uint32_t          max_events;
+
+	// Predicate program, NULL when there is none. A new one is built in
+	// the slot not published and swapped in under state_spin, so it can
+	// be evaluated without holding the lock.
+	trace_filter_prog_t* volatile filter_p;
+	trace_filter_prog_t  filter_prog[2];
+
+	// Per-cpu buffer rings (_NTO_TRACE_SETCPUBUFFERS), a ring is only
+	// ever appended to by its own cpu, so no lock is taken to do so
+	uint32_t          per_cpu;
+	tracebuf_t*       cpu_buf  [_TRACE_MAX_SMP_CPU_NUM];
+	uint8_t           cpu_flush[_TRACE_MAX_SMP_CPU_NUM];
 } trace_masks;
 EXT uint32_t trace_force_flush;
 
@@ -2059,7 +2059,7 @@ void _trace_ker_exit(THREAD* act)
 		}
 	}
  	if ( trace_force_flush ) {
- 		(void) trace_flushbuffer();
+ 		(void) trace_flushpending();
  	}
 
 	return;
@@ -188,6 +188,7 @@ if(!(chp->flags & _NTO_CHF_GLOBAL)) {
 	if(chp->flags & _NTO_CHF_ASYNC) {
 		cop->cd = kap->cd;
 		cop->sendq_size = cop->cd->sendq_size;
+		cop->sendq_head = 0;
 	}
 } else {
 	// link the connection to the global channel queue
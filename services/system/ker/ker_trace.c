@@ -214,6 +214,17 @@ ker_trace_event(THREAD *act,struct kerargs_trace_event *kap) {
 			RD_VERIFY_PTR(actives[RUNCPU], s2, l);
 			break;
 		}
+		case _TRACE_GET_FLAG(_NTO_TRACE_SETFILTER):
+		{
+			if (*(c_p+2) > _NTO_TRACE_FILTER_MAX) {
+				return (EINVAL);
+			}
+			if (*(c_p+2) > 0) {
+				RD_VERIFY_PTR(actives[RUNCPU], (void*)*(c_p+1), (*(c_p+2))*sizeof(trace_filter_t));
+				RD_PROBE_INT(actives[RUNCPU], (uint32_t*)*(c_p+1), (*(c_p+2))*sizeof(trace_filter_t)/sizeof(int));
+			}
+			break;
+		}
 		default:
 			;
 	}
@@ -2345,37 +2356,110 @@ ker_trace_event(THREAD *act,struct kerargs_trace_event *kap) {
 		}
 		case _TRACE_GET_FLAG(_NTO_TRACE_SETRINGMODE): // Setting ring mode of the kernel
 		{
-			tracebuf_t* l_b_p  =privateptr->tracebuf;
-			tracebuf_t* b_p    =l_b_p;
+			tracebuf_t* b_p    =trace_masks.buff_0_ptr;
+			unsigned    i;
 
-			if(trace_masks.main_flags||l_b_p==NULL) return (ECANCELED);
+			if(trace_masks.main_flags||privateptr->tracebuf==NULL) return (ECANCELED);
 			trace_masks.ring_mode = 1;
-			do {
+			// By index, the h.next links may form one ring per cpu
+			for(i=0;i<trace_masks.buff_num;++i,++b_p) {
 				InterruptLock(&b_p->h.spin);
 				b_p->h.tail_ptr = b_p->h.begin_ptr;
 				b_p->h.num_events = 0;
 				b_p->h.flags      = _TRACE_FLAGS_RING;
 				InterruptUnlock(&b_p->h.spin);
-				b_p               = b_p->h.next;
-			} while(l_b_p!=b_p);
+			}
 
 			return (EOK);
 		}
 		case _TRACE_GET_FLAG(_NTO_TRACE_SETLINEARMODE): // Setting linear mode of the kernel
 		{
-			tracebuf_t* l_b_p=privateptr->tracebuf;
-			tracebuf_t* b_p  =l_b_p;
+			tracebuf_t* b_p  =trace_masks.buff_0_ptr;
+			unsigned    i;
 
-			if(trace_masks.main_flags||l_b_p==NULL) return (ECANCELED);
+			if(trace_masks.main_flags||privateptr->tracebuf==NULL) return (ECANCELED);
 			trace_masks.ring_mode = 0;
-			do {
+			for(i=0;i<trace_masks.buff_num;++i,++b_p) {
 				InterruptLock(&b_p->h.spin);
 				b_p->h.tail_ptr = b_p->h.begin_ptr;
 				b_p->h.num_events = 0;
 				b_p->h.flags      = 0;
 				InterruptUnlock(&b_p->h.spin);
-				b_p               = b_p->h.next;
-			} while(l_b_p!=b_p);
+			}
+
+			return (EOK);
+		}
+		case _TRACE_GET_FLAG(_NTO_TRACE_SETCPUBUFFERS): // Splitting the buffers into per-cpu rings
+		{
+			tracebuf_t* b_0_p=trace_masks.buff_0_ptr;
+			unsigned    n, i, cpu;
+
+			if(trace_masks.main_flags||privateptr->tracebuf==NULL) return (ECANCELED);
+			n = trace_masks.buff_num/num_processors;
+			if(n<2 || num_processors>_TRACE_MAX_SMP_CPU_NUM) return (EINVAL);
+			for(cpu=0;cpu<num_processors;++cpu) {
+				tracebuf_t* b_p=b_0_p+cpu*n;
+
+				for(i=0;i<n;++i) {
+					b_p[i].h.next = &b_p[(i+1)%n];
+				}
+				trace_masks.cpu_buf[cpu]   = b_p;
+				trace_masks.cpu_flush[cpu] = 0;
+			}
+			trace_masks.per_cpu = 1;
+
+			return (EOK);
+		}
+		case _TRACE_GET_FLAG(_NTO_TRACE_SETSHAREDBUFFERS): // Back to one shared ring
+		{
+			tracebuf_t* b_0_p=trace_masks.buff_0_ptr;
+			unsigned    i;
+
+			if(trace_masks.main_flags||privateptr->tracebuf==NULL) return (ECANCELED);
+			trace_masks.per_cpu = 0;
+			for(i=0;i<trace_masks.buff_num;++i) {
+				b_0_p[i].h.next = &b_0_p[(i+1)%trace_masks.buff_num];
+			}
+			privateptr->tracebuf = b_0_p;
+
+			return (EOK);
+		}
+		case _TRACE_GET_FLAG(_NTO_TRACE_SETFILTER): // Installing the predicate program
+		{
+			trace_filter_t       filter[_NTO_TRACE_FILTER_MAX];
+			trace_filter_prog_t* p_p;
+			unsigned             n=*(c_p+2);
+			unsigned             i;
+
+			(void) memcpy(filter, (void*)*(c_p+1), n*sizeof(trace_filter_t));
+			for(i=0;i<n;++i) {
+				if(filter[i].field>=_NTO_TRACE_FILTER_NUM) return (EINVAL);
+			}
+			InterruptLock(&trace_masks.state_spin);
+			if(n==0) {
+				trace_masks.filter_p = NULL;
+			} else {
+				// Fill in the slot not published, once the last cpu that
+				// picked it up before the previous swap is done with it
+				p_p = &trace_masks.filter_prog[trace_masks.filter_p==&trace_masks.filter_prog[0]];
+				__cpu_membarrier();
+				while(p_p->users) {
+					__cpu_membarrier();
+				}
+				(void) memcpy(p_p->filter, filter, n*sizeof(trace_filter_t));
+				p_p->num = n;
+				__cpu_membarrier();
+				trace_masks.filter_p = p_p;
+			}
+			InterruptUnlock(&trace_masks.state_spin);
+
+			return (EOK);
+		}
+		case _TRACE_GET_FLAG(_NTO_TRACE_CLRFILTER): // Removing the predicate program
+		{
+			InterruptLock(&trace_masks.state_spin);
+			trace_masks.filter_p = NULL;
+			InterruptUnlock(&trace_masks.state_spin);
 
 			return (EOK);
 		}
@@ -2443,6 +2527,7 @@ case _TRACE_GET_FLAG(_NTO_TRACE_ALLOCBUFFER): // Allocating kernel trace buffer
 			}
 			trace_masks.buff_0_ptr = (void*)ptbuf;
 			trace_masks.buff_num   = b_n;
+			trace_masks.per_cpu    = 0;
 			trace_masks.max_events = (_TRACELEMENTS - _TRACEBUFEMPTY);
 			InterruptUnlock(&trace_masks.state_spin);
 			privateptr->tracebuf   = ptbuf;
@@ -2486,6 +2571,7 @@ case _TRACE_GET_FLAG(_NTO_TRACE_ALLOCBUFFER): // Allocating kernel trace buffer
 				}
 				trace_masks.buff_0_ptr = NULL;
 				privateptr->tracebuf   = NULL;
+				trace_masks.per_cpu    = 0;
 				InterruptUnlock(&trace_masks.state_spin);
 
 				/////////////////////////////////////////////////////
@@ -211,6 +211,7 @@ void                add_ktrace_int_enter(INTRLEVEL*);
 void                add_ktrace_int_exit(INTRLEVEL*);
 void                time_em(uint32_t, uint32_t);
 int                 trace_flushbuffer(void);
+int                 trace_flushpending(void);
 void                destroy_eh(PROCESS*);
 void                add_trace_string(uint32_t header, const char *fmt, ...);
 void				add_trace_d1_string(uint32_t header, uint32_t d_1, const char *fmt, ...);
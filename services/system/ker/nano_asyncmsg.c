@@ -278,6 +278,77 @@ msgsend_async(THREAD *act, CONNECT *cop) {
 
 #define CHECKBOUND(prp, p, size)      (((uintptr_t)(p) + (size) >= (uintptr_t)(p)) && WITHIN_BOUNDRY((uintptr_t)(p),(uintptr_t)(p)+(size),(prp)->boundry_addr))
 
+/*
+ * The kernel keeps the head of a send queue in the connection, the one
+ * in the descriptor is only a copy for the sender, so a sender can't
+ * point us outside its queue.
+ */
+#define SENDQ_ADVANCE(cop, cd) { \
+	atomic_sub(&(cd)->num_curmsg, 1); \
+	if((cop)->sendq_head + 1 < (cop)->sendq_size) { \
+		(cop)->sendq_head ++; \
+	} else { \
+		(cop)->sendq_head = 0; \
+	} \
+	(cd)->sendq_head = (cop)->sendq_head; \
+}
+
+/*
+ * Get at the sender's connection descriptor and the send queue entries
+ * at the head and just after it.  Only those are mapped, not the whole
+ * queue, so the cost doesn't depend on how big the sender made it.
+ */
+static int
+sendq_map(THREAD *act, CONNECT *cop, struct _asyncmsg_connection_descriptor *lcd,
+		  struct _asyncmsg_connection_descriptor **pcd, struct _asyncmsg_put_header **php) {
+	struct _asyncmsg_put_header *sendq;
+	unsigned next;
+	IOV     dstiov[3], srciov[3], *srcp;
+	int     dparts, sparts, soff, nbytes;
+
+	sendq = (struct _asyncmsg_put_header *)((char *)lcd + sizeof(*lcd));
+	if(cop->sendq_head + 1 < cop->sendq_size) {
+		next = cop->sendq_head + 1;
+	} else {
+		next = 0;
+	}
+
+	if(act->process == cop->process) {
+		*pcd = lcd;
+		php[0] = &sendq[cop->sendq_head];
+		php[1] = &sendq[next];
+		return EOK;
+	}
+
+	if(!CHECKBOUND(cop->process, lcd, sizeof(*lcd) + sizeof(*sendq) * cop->sendq_size)) {
+		return EFAULT;
+	}
+	SETIOV(&srciov[0], lcd, sizeof(*lcd));
+	SETIOV(&srciov[1], &sendq[cop->sendq_head], sizeof(*sendq));
+	SETIOV(&srciov[2], &sendq[next], sizeof(*sendq));
+	srcp = srciov;
+	sparts = 3;
+	soff = 0;
+	dparts = 3;
+	SETIOV(dstiov, 0, 0);
+	nbytes = memmgr.map_xfer(act->process,
+							 cop->process, 
+							 (IOV **)&srcp,
+							 &sparts,
+							 &soff,
+							 dstiov,
+							 &dparts,
+							 MAPADDR_FLAGS_IOVKERNEL);
+	/* every piece must have come back in one part */
+	if(nbytes != sizeof(*lcd) + 2 * sizeof(*sendq) || dparts != 3) {
+		return EFAULT;
+	}
+	*pcd = dstiov[0].iov_base;
+	php[0] = dstiov[1].iov_base;
+	php[1] = dstiov[2].iov_base;
+	return EOK;
+}
+
 int rdecl
 msgreceive_async(THREAD *act, CHANNELASYNC *chp, iov_t *iov, unsigned parts) {
 
@@ -285,10 +356,8 @@ msgreceive_async(THREAD *act, CHANNELASYNC *chp, iov_t *iov, unsigned parts) {
 	int status;
 	struct _asyncmsg_connection_descriptor *cd, *lcd;
 	struct _asyncmsg_get_header *ghp;
-	struct _asyncmsg_put_header *php, *sendq;
+	struct _asyncmsg_put_header *php[2];
 	CONNECT **q;
-	IOV     dstiov[1], srciov[1], *srcp;
-	int     dparts, sparts, soff, nbytes;
 	
 
 	/* scan iov list to find out memory errors in header */
@@ -312,32 +381,9 @@ restart:
 		}
 #endif
 
-		if (act->process == cop->process) {
-			cd = lcd;
-		} else {
-			SETIOV(srciov, lcd, sizeof(*lcd) + sizeof(struct _asyncmsg_put_header) * cop->sendq_size);
-			if(!CHECKBOUND(cop->process, lcd, GETIOVLEN(srciov))) {
-				return EFAULT;
-			} 
-			srcp = srciov;
-			sparts = 1;
-			soff = 0;
-			dparts = 1;
-			SETIOV(dstiov, 0, 0);
-			nbytes = memmgr.map_xfer(act->process,
-									 cop->process, 
-									 (IOV **)&srcp,
-									 &sparts,
-									 &soff,
-									 dstiov,
-									 &dparts,
-									 MAPADDR_FLAGS_IOVKERNEL);
-			if(nbytes < 0) {
-				return EFAULT;			
-			}
-			cd = dstiov[0].iov_base;
+		if((status = sendq_map(act, cop, lcd, &cd, php)) != EOK) {
+			return status;
 		}
-		sendq = (struct _asyncmsg_put_header *)((char *)cd + sizeof(*cd));
 		
 		/*
 		 * Check make sure *cd is read/writeable
@@ -359,9 +405,8 @@ restart:
 		
 		q = (CONNECT **)&chp->ch.reply_queue;
 		iov += act->args.ms.sparts;
-		while((cd->sendq_head != cd->sendq_tail) && (act->args.ms.sparts < parts)) {
+		while((cop->sendq_head != cd->sendq_tail) && (act->args.ms.sparts < parts)) {
 			ghp = (struct _asyncmsg_get_header *)GETIOVBASE(iov);
-			php = &sendq[cd->sendq_head];
 
 			if (!WITHIN_BOUNDRY((uintptr_t)(ghp),(uintptr_t)(ghp)+(sizeof(*ghp)),act->process->boundry_addr))
 			{
@@ -393,51 +438,26 @@ restart:
 			//BUG? what if we are prempted at this point. will cop->cd ever have it's value restored? Could explain loss of 
 			//messages in SMP. 
 #endif
-			status = rcvmsg(act, cop->process, ghp->iov, ghp->parts, php->iov, php->parts);
+			status = rcvmsg(act, cop->process, ghp->iov, ghp->parts, php[0]->iov, php[0]->parts);
 #if defined(VARIANT_smp) && defined(SMP_MSGOPT)
 			cop->cd = lcd;
 			*(volatile int_fl_t*) &(act->internal_flags) &= ~_NTO_ITF_MSG_DELIVERY;
 #endif
-			/* restore cd mapping in case it is invalid */
+			/* restore cd mapping in case it is invalid, and get the entry after
+			   the head for the advance below (in our own process this is
+			   just pointer arithmetic) */
 			/* FUTURE: can check the address range to see if it is in one to one mapping area. 
 				   Later will get a permanent mapping area for it */
-			if (act->process != cop->process) {
-				SETIOV(srciov, lcd, sizeof(*lcd) + sizeof(struct _asyncmsg_put_header) * cop->sendq_size);
-				if(!CHECKBOUND(cop->process, lcd, GETIOVLEN(srciov))) {
-					return EFAULT;
-				} 
-				srcp = srciov;
-				sparts = 1;
-				soff = 0;
-				dparts = 1;
-				SETIOV(dstiov, 0, 0);
-				nbytes = memmgr.map_xfer(act->process,
-									 cop->process, 
-									 (IOV **)&srcp,
-									 &sparts,
-									 &soff,
-									 dstiov,
-									 &dparts,
-									 MAPADDR_FLAGS_IOVKERNEL);
-				if(nbytes < 0) {
-					return EFAULT;			
-				}
-				cd = dstiov[0].iov_base;
-				sendq = (struct _asyncmsg_put_header *)((char *)cd + sizeof(*cd));
+			if(sendq_map(act, cop, lcd, &cd, php) != EOK) {
+				return EFAULT;
 			}
 		
 			if(status) {
 				if(status & XFER_SRC_FAULT) {
 					/* sender address fault */
-					php->err = EFAULT;
+					php[0]->err = EFAULT;
 					lock_kernel();
-					/* adjust header: put into a macro later */
-					cd->num_curmsg --;
-					if(cd->sendq_head + 1 < cd->sendq_size) {
-						cd->sendq_head ++;
-					} else {
-						cd->sendq_head = 0;
-					}
+					SENDQ_ADVANCE(cop, cd);
 					/* sender is wrong, take the connection off, let send know */
 					LINK1_REM(*q, cop, CONNECT);
 					act->restart = NULL;
@@ -495,13 +515,9 @@ restart:
 			act->args.ms.msglen = 0;
 			act->args.ms.sparts++;
 			iov++;
-			/* adjust header */
-			cd->num_curmsg --;
-			if(cd->sendq_head + 1 < cd->sendq_size) {
-				cd->sendq_head ++;
-			} else {
-				cd->sendq_head = 0;
-			}
+			/* adjust header, the next entry is already mapped */
+			SENDQ_ADVANCE(cop, cd);
+			php[0] = php[1];
 			/* check preemption */
 			if(NEED_PREEMPT(act)) {
 				if (cop->process->valid_thp) {
@@ -516,7 +532,7 @@ restart:
 		}
 
 		lock_kernel();
-		if(cd->sendq_head == cd->sendq_tail) {
+		if(cop->sendq_head == cd->sendq_tail) {
 			/* done with this cop */
 			LINK1_REM(*q, cop, CONNECT);
 			cop->restart = NULL;
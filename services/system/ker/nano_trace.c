@@ -108,6 +108,72 @@
 static int dropped_events;
 static int dropped_buffers;
 
+// Verdict of the predicate program for the combine event in progress on each cpu
+static uint8_t filter_pass[_TRACE_MAX_SMP_CPU_NUM];
+
+// Evaluates the _NTO_TRACE_SETFILTER program, interrupts disabled
+static int trace_filter(uint32_t header, uint32_t d_1, uint32_t d_2)
+{
+	trace_filter_prog_t*  p_p;
+	const trace_filter_t* f_p;
+	const trace_filter_t* e_p;
+	unsigned              cpu=_NTO_TRACE_GETCPU(header);
+	THREAD*               thp=actives[RUNCPU];
+	uint32_t              v;
+	int                   match=1;
+
+	// Continuations follow the verdict of their begin event
+	switch(_TRACE_GET_STRUCT(header)) {
+		case _TRACE_STRUCT_CC:
+		case _TRACE_STRUCT_CE:
+			return (filter_pass[cpu]);
+		default:
+			break;
+	}
+	if(_NTO_TRACE_GETEVENT_C(header)==_TRACE_CONTROL_C) {
+		return (1);
+	}
+	// Hold on to the published program, it may be swapped meanwhile
+	for(;;) {
+		if((p_p=trace_masks.filter_p)==NULL) {
+			return (1);
+		}
+		atomic_add(&p_p->users, 1);
+		__cpu_membarrier();
+		if(p_p==trace_masks.filter_p) {
+			break;
+		}
+		atomic_sub(&p_p->users, 1);
+	}
+	f_p = p_p->filter;
+	e_p = f_p+p_p->num;
+	for(;f_p<e_p;++f_p) {
+		if(match) {
+			switch(f_p->field) {
+				case _NTO_TRACE_FILTER_PID:   v=thp->process->pid;                    break;
+				case _NTO_TRACE_FILTER_TID:   v=thp->tid+1;                           break;
+				case _NTO_TRACE_FILTER_CLASS: v=_NTO_TRACE_GETEVENT_C(header)>>10;    break;
+				case _NTO_TRACE_FILTER_EVENT: v=_NTO_TRACE_GETEVENT(header);          break;
+				case _NTO_TRACE_FILTER_ARG1:  v=d_1;                                  break;
+				default:                      v=d_2;                                  break;
+			}
+			v &= f_p->mask;
+			match = (v>=f_p->lo && v<=f_p->hi) ^ ((f_p->flags&_NTO_TRACE_FILTER_NOT)!=0);
+		}
+		if((f_p->flags&_NTO_TRACE_FILTER_OR) || f_p+1==e_p) {
+			if(match) break;
+			match = 1;
+		}
+	}
+	match = (f_p<e_p);
+	atomic_sub(&p_p->users, 1);
+	if(_TRACE_GET_STRUCT(header)==_TRACE_STRUCT_CB) {
+		filter_pass[cpu] = match;
+	}
+
+	return (match);
+}
+
 // Triggers pseudo-interrupt handler
 int em_event(tracebuf_t* t_b_p)
 {
@@ -128,7 +194,10 @@ int em_event(tracebuf_t* t_b_p)
 		THREAD*  thp =itp->thread;
 		uint32_t locked=_TRACE_GET_LOCK();
 
-		trace_force_flush = 0;
+		// Per-cpu buffers keep their own flags, see flush_cpu_buffers()
+		if(!trace_masks.per_cpu) {
+			trace_force_flush = 0;
+		}
 
 		lock_kernel();
 
@@ -601,10 +670,46 @@ static uint32_t get_time_off(int init)
 	return (ts[cpu].bits[_TRACE_CLOCK_LSB]);
 }
 
+static void flush_cpu_buffer(unsigned cpu);
+
+// Flushes every cpu's buffer, or only those that asked to be on kernel exit
+static int flush_cpu_buffers(int all)
+{
+	unsigned cpu;
+
+	if(trace_masks.ring_mode && trace_masks.main_flags) {
+		return (ECANCELED);
+	}
+	// A cpu asking after this sets the flag again
+	trace_force_flush = 0;
+	__cpu_membarrier();
+	InterruptDisable();
+	for(cpu=0;cpu<num_processors;++cpu) {
+		if(all || trace_masks.cpu_flush[cpu]) {
+			flush_cpu_buffer(cpu);
+		}
+	}
+	InterruptEnable();
+
+	return (EOK);
+}
+
+// Called on kernel exit when a buffer filled up in an interrupt
+int trace_flushpending(void)
+{
+	if(privateptr->tracebuf && trace_masks.per_cpu) {
+		return (flush_cpu_buffers(0));
+	}
+	return (trace_flushbuffer());
+}
+
 int trace_flushbuffer(void)
 {
 	tracebuf_t* tracebuf= privateptr->tracebuf;
 
+	if(tracebuf && trace_masks.per_cpu) {
+		return (flush_cpu_buffers(1));
+	}
 	if(tracebuf) {
 		if(trace_masks.ring_mode) {
 			if(!trace_masks.main_flags) {
@@ -1350,7 +1455,118 @@ void add_ktrace_int_exit(INTRLEVEL* lp)
 	return;
 }
 
-/* Yuck - we should really have a per-cpu buffer system, but hey... */
+// Hands the current buffer of a cpu over to the logger, interrupts disabled.
+// Any cpu may do this, so the buffer is moved on under its spinlock.
+static void flush_cpu_buffer(unsigned cpu)
+{
+	tracebuf_t* t_b_p=trace_masks.cpu_buf[cpu];
+
+	trace_masks.cpu_flush[cpu] = 0;
+	if(t_b_p==NULL) {
+		return;
+	}
+	SPINLOCK(&t_b_p->h.spin);
+	if(trace_masks.cpu_buf[cpu]!=t_b_p || t_b_p->h.num_events==0 || (t_b_p->h.flags&_TRACE_FLAGS_FLUSH)) {
+		SPINUNLOCK(&t_b_p->h.spin);
+		return;
+	}
+	if(trace_masks.ring_mode) {
+		tracebuf_t* b_p=t_b_p->h.next;
+
+		b_p->h.tail_ptr   = b_p->h.begin_ptr;
+		b_p->h.num_events = 0;
+		trace_masks.cpu_buf[cpu] = b_p;
+		SPINUNLOCK(&t_b_p->h.spin);
+		return;
+	}
+	atomic_set(&t_b_p->h.flags, _TRACE_FLAGS_FLUSH);
+	trace_masks.cpu_buf[cpu] = t_b_p->h.next;
+	SPINUNLOCK(&t_b_p->h.spin);
+	force_emit[cpu] = 1;
+	(void) em_event(t_b_p);
+}
+
+// add_trace_event() for per-cpu buffers.  Only the running cpu appends to
+// its ring, so the spinlock of its current buffer is normally uncontended;
+// it is there for another cpu flushing this one, and for taking back a
+// buffer the logger has not picked up yet.
+static int add_trace_event_cpu(uint32_t header, uint32_t d_0, uint32_t d_1, uint32_t d_2)
+{
+	tracebuf_t*   t_b_p;
+	traceevent_t* e_p;
+	unsigned      cpu;
+	int           flush;
+
+	InterruptDisable();
+	cpu   = RUNCPU;
+	t_b_p = trace_masks.cpu_buf[cpu];
+	if(trace_masks.main_flags==0 || t_b_p==NULL) {
+		InterruptEnable();
+		return (t_b_p==NULL ? ECANCELED : EOK);
+	}
+	if(trace_masks.filter_p && !trace_filter(header, d_1, d_2)) {
+		InterruptEnable();
+		return (EOK);
+	}
+	SPINLOCK(&t_b_p->h.spin);
+	while(trace_masks.cpu_buf[cpu]!=t_b_p) {
+		// Another cpu flushed us onto the next buffer
+		SPINUNLOCK(&t_b_p->h.spin);
+		t_b_p = trace_masks.cpu_buf[cpu];
+		SPINLOCK(&t_b_p->h.spin);
+	}
+	if(t_b_p->h.flags&_TRACE_FLAGS_FLUSH) {
+		// The ring is full of buffers the logger hasn't written yet
+		if(t_b_p->h.flags&_TRACE_FLAGS_WRITING) {
+			SPINUNLOCK(&t_b_p->h.spin);
+			dropped_events++;
+			InterruptEnable();
+			return (EOK);
+		}
+		_TRACE_CLR_BUFF(t_b_p);
+	}
+
+	if(t_b_p->h.num_events == 0) {
+		t_b_p->h.num_events++;
+		e_p = (traceevent_t *)t_b_p->h.tail_ptr;
+		t_b_p->h.seq_buff_num = atomic_add_value(&trace_masks.send_buff_num, 1) + 1;
+		t_b_p->h.tail_ptr++;
+		e_p->header  = _TRACE_MAKE_CODE(cpu, _TRACE_STRUCT_S, _TRACE_CONTROL_C, _TRACE_CONTROL_BUFFER);
+		e_p->data[0] = d_0;
+		e_p->data[1] = t_b_p->h.seq_buff_num;
+		e_p->data[2] = 0;
+	}
+	if(t_b_p->h.num_events < _TRACELEMENTS) {
+		t_b_p->h.num_events++;
+		e_p = (traceevent_t *)t_b_p->h.tail_ptr;
+		t_b_p->h.tail_ptr++;
+		e_p->header  = header;
+		e_p->data[0] = d_0;
+		e_p->data[1] = d_1;
+		e_p->data[2] = d_2;
+	} else {
+		dropped_events++;
+	}
+	flush = t_b_p->h.num_events >= trace_masks.max_events || trace_masks.cpu_flush[cpu];
+	SPINUNLOCK(&t_b_p->h.spin);
+
+	if(flush) {
+		if(trace_masks.ring_mode || (get_inkernel() & INKERNEL_INTRMASK) == 0) {
+			flush_cpu_buffer(cpu);
+		} else {
+			// Can't emit from an interrupt, leave it to the kernel exit
+			trace_masks.cpu_flush[cpu] = 1;
+			__cpu_membarrier();
+			trace_force_flush = 1;
+			ker_exit_enable_mask = 0xffffffffUL;
+		}
+	}
+	InterruptEnable();
+
+	return (EOK);
+}
+
+/* Shared buffer ring, see add_trace_event_cpu() for the per-cpu one */
 int add_trace_event(uint32_t header, uint32_t d_0, uint32_t d_1, uint32_t d_2)
 {
 	tracebuf_t		*t_b_p;
@@ -1364,6 +1580,9 @@ int add_trace_event(uint32_t header, uint32_t d_0, uint32_t d_1, uint32_t d_2)
 	if(!_TRACE_GET_STRUCT(header)) {
 		d_0 = get_time_off(0);
 	}
+	if(trace_masks.per_cpu) {
+		return (add_trace_event_cpu(header, d_0, d_1, d_2));
+	}
 
    	//InterruptDisable();
 begin:
@@ -1381,6 +1600,12 @@ begin:
 		InterruptEnable();
 		return EOK;
 	}
+	if(trace_masks.filter_p && !trace_filter(header, d_1, d_2)) {
+		/* Rejected by the predicate program */
+		SPINUNLOCK(&trace_masks.state_spin);
+		InterruptEnable();
+		return EOK;
+	}
 	t_b_p=privateptr->tracebuf;
 	if(t_b_p==NULL) {
 		/* No Trace Buffer allocated */
@@ -1714,7 +1939,20 @@ int trace_event(uint32_t* a_p)
 				tracebuf_t* t_b_p=privateptr->tracebuf;
 
 				if(trace_masks.main_flags&&t_b_p!=NULL) {
-					(void) em_event(t_b_p);
+					if(trace_masks.per_cpu) {
+						unsigned cpu;
+
+						// Every cpu has its own ring to hand over
+						trace_masks.main_flags = 0;
+						for(cpu=0;cpu<num_processors;++cpu) {
+							t_b_p = trace_masks.cpu_buf[cpu];
+							if(t_b_p!=NULL && t_b_p->h.num_events) {
+								(void) em_event(t_b_p);
+							}
+						}
+					} else {
+						(void) em_event(t_b_p);
+					}
 				} else {
 					return (ECANCELED);
 				}
@@ -1742,6 +1980,10 @@ int trace_event(uint32_t* a_p)
 			if(trace_masks.main_flags) return (EOK);
 			trace_masks.main_flags = 1;
 			(void) get_time_off(1);
+			if(trace_masks.per_cpu) {
+				// Every cpu's stream has to start out with the full time
+				memset(&force_emit, 0xff, sizeof(force_emit));
+			}
 			sched_trace_initial_parms();
 			for (i_1=1;i_1<process_vector.nentries;++i_1) { // Dump sys. state including
 				if(VECP(prp, &process_vector, i_1)) {         // process names and task IDs
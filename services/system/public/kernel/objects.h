@@ -317,6 +317,7 @@ struct connect_entry {
 	THREAD			*restart; /* restart pointer, used by async messaging */
 	struct _asyncmsg_connection_descriptor *cd; /* for async messaging */
 	uint32_t         sendq_size;
+	uint32_t         sendq_head; /* kernel's copy, cd->sendq_head is only told */
 };
 
 
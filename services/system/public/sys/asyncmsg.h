@@ -110,6 +110,9 @@ struct _asyncmsg_connection_descriptor {
 
 #define ASYNCMSG_FLUSH_NONBLOCK 1
 
+/* asyncmsg_connect_attach() flag: only one thread puts on this connection */
+#define ASYNCMSG_CONNECT_SPSC   0x80000000
+
 #define ASYNCMSG_RECVBUF_ALLOC  1
 #define ASYNCMSG_RECVBUF_FREE   2
 
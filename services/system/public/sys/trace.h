@@ -74,6 +74,10 @@
 #define _NTO_TRACE_QUERYSUPPORT      ((0x00000001<<28)|41)
 #define _NTO_TRACE_INSERTSCLASSEVENT ((0x00000005<<28)|42)
 #define _NTO_TRACE_INSERTCCLASSEVENT ((0x00000005<<28)|43)
+#define _NTO_TRACE_SETFILTER         ((0x00000003<<28)|44)
+#define _NTO_TRACE_CLRFILTER         ((0x00000001<<28)|45)
+#define _NTO_TRACE_SETCPUBUFFERS     ((0x00000001<<28)|46)
+#define _NTO_TRACE_SETSHAREDBUFFERS  ((0x00000001<<28)|47)
 
 /* TraceEvent() - external classes */
 enum {
@@ -202,6 +206,44 @@ enum {
 #define _NTO_TRACE_GETEVENT(c)      ((c)&0x3ff)
 #define _NTO_TRACE_GETCPU(h)        (((h)&0x3f000000)>>24)
 
+/*
+ * _NTO_TRACE_SETFILTER predicate program.
+ *
+ * TraceEvent(_NTO_TRACE_SETFILTER, trace_filter_t *prog, unsigned num)
+ * installs a program that the kernel evaluates for every event that
+ * passed the class/event masks, before it is put into a buffer.  The
+ * terms are grouped into conjunctions, each group ending with a term
+ * that has _NTO_TRACE_FILTER_OR set (or with the last term); an event
+ * is logged when every term of at least one group holds.  A term holds
+ * when (field & mask) lies within [lo, hi], inverted by
+ * _NTO_TRACE_FILTER_NOT.  PID/TID are those of the thread running when
+ * the event is emitted, CLASS is the internal class (_TRACE_*_C >> 10),
+ * ARG1/ARG2 are the first two data words of the event.  Control events
+ * are never filtered out.  _NTO_TRACE_CLRFILTER (or num 0) removes the
+ * program.
+ */
+enum {
+	_NTO_TRACE_FILTER_PID,
+	_NTO_TRACE_FILTER_TID,
+	_NTO_TRACE_FILTER_CLASS,
+	_NTO_TRACE_FILTER_EVENT,
+	_NTO_TRACE_FILTER_ARG1,
+	_NTO_TRACE_FILTER_ARG2,
+	_NTO_TRACE_FILTER_NUM
+};
+
+#define _NTO_TRACE_FILTER_NOT       (0x0001)
+#define _NTO_TRACE_FILTER_OR        (0x0002)
+#define _NTO_TRACE_FILTER_MAX       (32)
+
+typedef struct {
+	_Uint16t	field;
+	_Uint16t	flags;
+	_Uint32t	mask;
+	_Uint32t	lo;
+	_Uint32t	hi;
+} trace_filter_t;
+
 /* Query support flags */
 #define _NTO_TRACE_NOINSTRSUPP      (0x00000000)
 #define _NTO_TRACE_SUPPINSTR        (0x00000001<<0)
@@ -259,6 +301,43 @@ typedef struct traceevent {
 	_TRACE_MK_HK(SYSPAGE_LEN),   \
 	_TRACE_MK_HK(HEADER_END)
 
+/*
+ * Compressed tracefile body, announced by a COMPRESSION::lzo1x header
+ * attribute. Instead of raw events, the body following the syspage is
+ * a sequence of blocks (one per kernel buffer) terminated by a block
+ * with usize 0, whose csize gives the number of index entries following
+ * it. A trailer ends the file. Everything is in the byte order of the
+ * logging target.
+ */
+#define _TRACE_COMPRESSION_KEY      "COMPRESSION"
+#define _TRACE_COMPRESSION_LZO1X    "lzo1x"
+
+/*
+ * Present (value is the number of cpus) when the kernel buffers were split
+ * into per-cpu rings with _NTO_TRACE_SETCPUBUFFERS.  Each buffer then holds
+ * the events of one cpu only and buffers reach the file in the order they
+ * filled up, so readers have to merge the cpus' streams by timestamp.
+ */
+#define _TRACE_PERCPU_KEY           "PERCPU_BUFFERS"
+#define _TRACE_BLOCK_MAGIC          (0x5a56454bUL) /* "KEVZ" */
+
+typedef struct traceblock {
+	_Uint32t usize;               /* uncompressed size, 0 ends blocks  */
+	_Uint32t csize;               /* bytes following, usize if stored  */
+} traceblock_t;
+
+typedef struct traceblock_index {
+	_Uint64t offset;              /* file offset of the traceblock_t   */
+	_Uint32t usize;
+	_Uint32t csize;
+} traceblock_index_t;
+
+typedef struct traceblock_trailer {
+	_Uint64t index_offset;        /* file offset of the first entry    */
+	_Uint32t num_blocks;
+	_Uint32t magic;               /* _TRACE_BLOCK_MAGIC                */
+} traceblock_trailer_t;
+
 /* buffer/sequence extraction macros */
 #define _TRACE_GET_BUFFNUM(b)       (b>>13)
 #define _TRACE_GET_BUFFSEQ(b)       (b&0x000007FF)
@@ -20,6 +20,8 @@ define PINFO
 PINFO DESCRIPTION=Trace logger utility
 endef
 
+LIBS += lzo
+
 USEFILE=$(PROJECT_ROOT)/tracelogger.use
 
 include $(MKFILES_ROOT)/qtargets.mk
@@ -42,6 +42,7 @@
 #include <time.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <lzo1x.h>
  
 #include "kevfile.h"
 #include "utils.h"
@@ -67,8 +68,13 @@ static const char* const head_keywords[] = {
 	_TRACE_HEADER_KEYWORDS()
 };
 
+/* worst case lzo1x expansion of a kernel buffer */
+#define ZBUF_SIZE	(sizeof(tracebuf_t) + sizeof(tracebuf_t)/16 + 64 + 3)
+
 static size_t kwrite( kevfile_t *kev, const char *data, size_t n );
 static int write_header( kevfile_t *kev, time_t  t_n );
+static int write_block( kevfile_t *kev, const void *data, unsigned nbytes );
+static int write_block_index( kevfile_t *kev );
 
 kevfile_t *kevfile_open( const char *path, unsigned flags, size_t max_size, unsigned initial_buffers )
 {
@@ -107,12 +113,35 @@ kevfile_t *kevfile_open( const char *path, unsigned flags, size_t max_size, unsi
 	new_kevfile->flags = flags;
 	new_kevfile->max_size = max_size;
 	new_kevfile->num_buffers = 0;
-	new_kevfile->buffers_logged = 0;
-	new_kevfile->buffers_dropped = 0;
+	memset( &new_kevfile->local_stats, 0, sizeof(new_kevfile->local_stats) );
+	new_kevfile->local_stats.version = KEVFILE_STATS_VERSION;
+	new_kevfile->local_stats.zero_copy = (flags & KEVFILE_ZEROCOPY) ? 1 : 0;
+	new_kevfile->stats = &new_kevfile->local_stats;
+	new_kevfile->stats_name = NULL;
 	new_kevfile->last_buffers_dropped = 0;
+	new_kevfile->release = NULL;
 	new_kevfile->free_buffers = 0;
-	new_kevfile->write_depth = 0;
-	new_kevfile->write_depth = 0;
+	new_kevfile->write_buffers = NULL;
+	new_kevfile->write_tail = NULL;
+	new_kevfile->zbuf = NULL;
+	new_kevfile->zwork = NULL;
+	new_kevfile->zindex = NULL;
+	new_kevfile->zindex_num = 0;
+	new_kevfile->zindex_max = 0;
+	new_kevfile->zcycles = 0;
+
+	if ( flags & KEVFILE_COMPRESS ) {
+		if ( lzo_init() != LZO_E_OK ||
+				(new_kevfile->zbuf = malloc( ZBUF_SIZE )) == NULL ||
+				(new_kevfile->zwork = malloc( LZO1X_1_MEM_COMPRESS )) == NULL ) {
+			free( new_kevfile->zbuf );
+			free( (void *)new_kevfile->path );
+			close( new_kevfile->fd );
+			free( new_kevfile );
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
 	
 	if ( flags & KEVFILE_MAP ) {
 		if ( -1 == ftruncate( new_kevfile->fd, new_kevfile->max_size ) ) {
@@ -133,6 +162,7 @@ kevfile_t *kevfile_open( const char *path, unsigned flags, size_t max_size, unsi
 	new_kevfile->current_offset = 0;
 	
 	write_header( new_kevfile, time(NULL) );	
+	new_kevfile->file_offset = new_kevfile->current_offset;
 
 	for ( i = 0; i < initial_buffers; i++ ) {
 		kbuf = malloc( sizeof(kevfile_buf_t) );
@@ -140,7 +170,7 @@ kevfile_t *kevfile_open( const char *path, unsigned flags, size_t max_size, unsi
 			break;
 		}	
 		kbuf->next = new_kevfile->free_buffers;
-		if ( !(new_kevfile->flags & KEVFILE_MAP) ) {
+		if ( kevfile_owns_data( new_kevfile ) ) {
 			kbuf->data = malloc( sizeof(tracebuf_t) );
 			if ( kbuf->data == NULL ) {
 				free(kbuf);
@@ -154,8 +184,6 @@ kevfile_t *kevfile_open( const char *path, unsigned flags, size_t max_size, unsi
 		kevfile_close( new_kevfile );
 		return NULL;
 	}
-	new_kevfile->write_buffers = NULL;
-	new_kevfile->write_tail = NULL;
 	
 	return new_kevfile;
 }
@@ -170,66 +198,133 @@ void kevfile_close( kevfile_t *kev )
 	else {
 		for ( kbuf = kev->write_buffers; kbuf != NULL; kbuf = kev->write_buffers ) {
 			kev->write_buffers = kbuf->next;
-			free( kbuf->data );
+			if ( kev->release != NULL ) {
+				kev->release( kbuf );
+			}
+			if ( kevfile_owns_data( kev ) ) {
+				free( kbuf->data );
+			}
 			free( kbuf );
 		}
 	}
 	for ( kbuf = kev->free_buffers; kbuf != NULL; kbuf = kev->free_buffers ) {
 		kev->free_buffers = kbuf->next;
-		if ( !(kev->flags & KEVFILE_MAP) ) {
+		if ( kevfile_owns_data( kev ) ) {
 			free( kbuf->data );
 		}
 		free( kbuf );
 	}
+	if ( kev->zbuf != NULL ) {
+		if ( write_block_index( kev ) == -1 ) {
+			fprintf( stderr, "%s: could not write the block index\n", kev->path );
+		}
+		if ( kev->file_offset > 0 ) {
+			info("compressed %lld bytes of events to %lld (%d%%), %lld cycles\n",
+				(long long)kev->current_offset, (long long)kev->file_offset,
+				(int)(kev->file_offset * 100 / (kev->current_offset ? kev->current_offset : 1)),
+				(long long)kev->zcycles );
+		}
+		free( kev->zbuf );
+		free( kev->zwork );
+		free( kev->zindex );
+	}
+	if ( kev->stats_name != NULL ) {
+		munmap( kev->stats, sizeof(*kev->stats) );
+		shm_unlink( kev->stats_name );
+		free( (void *)kev->stats_name );
+	}
 	close( kev->fd );
 	free( (void *)kev->path );
 	free( kev );
 }
 
+/* Give a buffer back to the kernel (if it is one of its) and to the free list */
+static void recycle_buffer( kevfile_t *kev, kevfile_buf_t *kbuf )
+{
+	if ( kev->release != NULL ) {
+		kev->release( kbuf );
+	}
+	InterruptLock( &kev->buf_spin );
+	kbuf->next = kev->free_buffers;
+	kev->free_buffers = kbuf;
+	InterruptUnlock( &kev->buf_spin );
+}
+
+/* The buffers couldn't be written, recycle them all and count them as dropped */
+static void drop_buffers( kevfile_t *kev, kevfile_buf_t *gather_list )
+{
+	kevfile_buf_t *next;
+	int	dropped = 0;
+
+	for ( ; gather_list != NULL; gather_list = next ) {
+		next = gather_list->next;
+		recycle_buffer( kev, gather_list );
+		dropped++;
+	}
+	InterruptLock( &kev->buf_spin );
+	kev->stats->buffers_dropped += dropped;
+	InterruptUnlock( &kev->buf_spin );
+}
+
 #define FLUSH_IOVS 10
 int kevfile_flush( kevfile_t *kev )
 {
 	kevfile_buf_t *kbuf, *next, *gather_list = NULL;
 	iov_t	iovs[FLUSH_IOVS]; /* RUSH */
 	int n = 0, niovs, write_depth, buffers_dropped, last_buffers_dropped, nbytes;
+	ssize_t	r;
 	
 	InterruptLock( &kev->buf_spin );
-	write_depth = kev->write_depth;
+	write_depth = kev->stats->write_depth;
 	gather_list = kev->write_buffers;
 	if ( gather_list != NULL ) {
 		kev->write_buffers = kev->write_tail = NULL;
-		kev->write_depth = 0;
+		kev->stats->write_depth = 0;
 	}
 	InterruptUnlock( &kev->buf_spin );
 	
 	debug("start flush, write_depth is %d\n", write_depth );
 	do {
-		for ( nbytes = 0, niovs = 0, kbuf = gather_list; niovs < FLUSH_IOVS && kbuf != NULL; kbuf = kbuf->next ) {
-			hack("doing buffer index %d sequence %d!!\n", _TRACE_GET_BUFFNUM(kbuf->off), _TRACE_GET_BUFFSEQ(kbuf->off) );
-			SETIOV(&iovs[niovs], kbuf->data, kbuf->nbytes );
-			niovs++;
-			n++;
-			nbytes += kbuf->nbytes;
-		}
-		if ( writev( kev->fd, iovs, niovs ) < nbytes ) {
-			return -1;
+		if ( kev->flags & KEVFILE_COMPRESS ) {
+			/* one block per buffer, so that each can be decompressed on its own */
+			if ( (kbuf = gather_list) != NULL ) {
+				hack("compressing buffer index %d sequence %d!!\n", _TRACE_GET_BUFFNUM(kbuf->off), _TRACE_GET_BUFFSEQ(kbuf->off) );
+				if ( write_block( kev, kbuf->data, kbuf->nbytes ) == -1 ) {
+					drop_buffers( kev, gather_list );
+					return -1;
+				}
+				kbuf = kbuf->next;
+				n++;
+			}
+		} else {
+			for ( nbytes = 0, niovs = 0, kbuf = gather_list; niovs < FLUSH_IOVS && kbuf != NULL; kbuf = kbuf->next ) {
+				hack("doing buffer index %d sequence %d!!\n", _TRACE_GET_BUFFNUM(kbuf->off), _TRACE_GET_BUFFSEQ(kbuf->off) );
+				SETIOV(&iovs[niovs], kbuf->data, kbuf->nbytes );
+				niovs++;
+				n++;
+				nbytes += kbuf->nbytes;
+			}
+			r = writev( kev->fd, iovs, niovs );
+			if ( r == -1 || r < nbytes ) {
+				drop_buffers( kev, gather_list );
+				return -1;
+			}
+			kev->stats->bytes_written += nbytes;
 		}
 		/* TODO - maybe it would be better not to lock/unlock so often */
 		for ( ; gather_list != kbuf; gather_list = next ) {
 			hack("done with buffer index %d sequence %d!!\n", _TRACE_GET_BUFFNUM(gather_list->off), _TRACE_GET_BUFFSEQ(gather_list->off) );
-			InterruptLock( &kev->buf_spin );
+			/* the data has hit the file, the kernel can have its buffer back */
 			next = gather_list->next;
-			gather_list->next = kev->free_buffers;
-			kev->free_buffers = gather_list;
-			InterruptUnlock( &kev->buf_spin );
+			recycle_buffer( kev, gather_list );
 		}
 	} while( gather_list != NULL );
 	
 	InterruptLock( &kev->buf_spin );
-	write_depth = kev->write_depth;
-	buffers_dropped = kev->buffers_dropped;
+	write_depth = kev->stats->write_depth;
+	buffers_dropped = kev->stats->buffers_dropped;
 	last_buffers_dropped = kev->last_buffers_dropped;
-	kev->last_buffers_dropped = kev->buffers_dropped;
+	kev->last_buffers_dropped = kev->stats->buffers_dropped;
 	InterruptUnlock( &kev->buf_spin );
 	
 	if ( buffers_dropped > last_buffers_dropped ) {
@@ -277,9 +372,9 @@ int kevfile_buffer_put( kevfile_t *kev, kevfile_buf_t *buf )
 			kev->write_tail->next = buf;
 			kev->write_tail = buf;
 		}
-		kev->write_depth++;
-		if ( kev->write_depth > kev->max_write_depth ) {
-			kev->max_write_depth = kev->write_depth;
+		kev->stats->write_depth++;
+		if ( kev->stats->write_depth > kev->stats->max_write_depth ) {
+			kev->stats->max_write_depth = kev->stats->write_depth;
 		}
 	}
 	InterruptUnlock( &kev->buf_spin );
@@ -296,6 +391,44 @@ unsigned kevfile_space_left( kevfile_t *kev )
 	return n < 0 ? 0 : (unsigned)n;
 }
 
+/*
+ * Move the counters into a shared memory object so that they can be
+ * watched while we are logging.  Called before logging starts.
+ */
+int kevfile_export_stats( kevfile_t *kev, const char *name )
+{
+	kevfile_stats_t	*stats;
+	int				fd;
+
+	fd = shm_open( name, O_RDWR|O_CREAT|O_TRUNC, 0644 );
+	if ( fd == -1 ) {
+		return -1;
+	}
+	if ( ftruncate( fd, sizeof(*stats) ) == -1 ) {
+		close( fd );
+		shm_unlink( name );
+		return -1;
+	}
+	stats = mmap( 0, sizeof(*stats), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( stats == MAP_FAILED ) {
+		shm_unlink( name );
+		return -1;
+	}
+	kev->stats_name = strdup( name );
+	if ( kev->stats_name == NULL ) {
+		munmap( stats, sizeof(*stats) );
+		shm_unlink( name );
+		return -1;
+	}
+	InterruptLock( &kev->buf_spin );
+	*stats = *kev->stats;
+	kev->stats = stats;
+	InterruptUnlock( &kev->buf_spin );
+	info("Exporting live counters in %s\n", name );
+	return 0;
+}
+
 /* static functions */
 static int write_header_keyvalue( kevfile_t *kev, const char *k, const char *v )
 {
@@ -401,6 +534,9 @@ char	*syspage_p;
 			write_header_keyvalue( kev, attr->key, attr->value);
 		}
 	}
+	if ( kev->flags & KEVFILE_COMPRESS ) {
+		write_header_keyvalue( kev, _TRACE_COMPRESSION_KEY, _TRACE_COMPRESSION_LZO1X );
+	}
 	write_header_str( kev, HEADER_END,     "");
 		
 	/* this may look weird, but you can't do a write directly from the syspage_ptr */
@@ -411,6 +547,81 @@ char	*syspage_p;
 	return 0;
 }
 
+/*
+ * Compress one buffer and write it out as a block, remembering where
+ * it went for the index.  Incompressible data is stored as is.
+ */
+static int write_block( kevfile_t *kev, const void *data, unsigned nbytes )
+{
+	traceblock_t		blk;
+	traceblock_index_t	*idx;
+	lzo_uint			csize;
+	uint64_t			start;
+	ssize_t				r;
+	iov_t				iovs[2];
+
+	if ( kev->zindex_num == kev->zindex_max ) {
+		unsigned	max = kev->zindex_max ? kev->zindex_max * 2 : 256;
+
+		idx = realloc( kev->zindex, max * sizeof(*idx) );
+		if ( idx == NULL ) {
+			return -1;
+		}
+		kev->zindex = idx;
+		kev->zindex_max = max;
+	}
+
+	start = ClockCycles();
+	if ( lzo1x_1_compress( data, nbytes, kev->zbuf, &csize, kev->zwork ) != LZO_E_OK || csize >= nbytes ) {
+		csize = nbytes;
+	}
+	kev->zcycles += ClockCycles() - start;
+
+	blk.usize = nbytes;
+	blk.csize = csize;
+	SETIOV( &iovs[0], &blk, sizeof(blk) );
+	SETIOV( &iovs[1], csize == nbytes ? data : kev->zbuf, csize );
+	r = writev( kev->fd, iovs, 2 );
+	if ( r == -1 || r != sizeof(blk) + csize ) {
+		return -1;
+	}
+
+	idx = &kev->zindex[kev->zindex_num++];
+	idx->offset = kev->file_offset;
+	idx->usize = nbytes;
+	idx->csize = csize;
+	kev->file_offset += sizeof(blk) + csize;
+	kev->stats->bytes_written += sizeof(blk) + csize;
+	return 0;
+}
+
+/* Terminate the block stream and append the index and trailer */
+static int write_block_index( kevfile_t *kev )
+{
+	traceblock_t			blk;
+	traceblock_trailer_t	trailer;
+	size_t					len;
+	ssize_t					r;
+	iov_t					iovs[3];
+
+	blk.usize = 0;
+	blk.csize = kev->zindex_num;
+	trailer.index_offset = kev->file_offset + sizeof(blk);
+	trailer.num_blocks = kev->zindex_num;
+	trailer.magic = _TRACE_BLOCK_MAGIC;
+
+	SETIOV( &iovs[0], &blk, sizeof(blk) );
+	SETIOV( &iovs[1], kev->zindex, kev->zindex_num * sizeof(*kev->zindex) );
+	SETIOV( &iovs[2], &trailer, sizeof(trailer) );
+	len = sizeof(blk) + kev->zindex_num * sizeof(*kev->zindex) + sizeof(trailer);
+	r = writev( kev->fd, iovs, 3 );
+	if ( r == -1 || r != len ) {
+		return -1;
+	}
+	kev->file_offset += len;
+	return 0;
+}
+
 static size_t kwrite( kevfile_t *kev, const char *data, size_t n )
 {
 	int r, l = min( kevfile_space_left(kev), n ); /* need to expand space left outside of macro */
@@ -55,6 +55,21 @@
 	kevfile_write
 		writes buffers from writelist to kevfile
 		nop for direct mapped case
+
+	zero copy (KEVFILE_ZEROCOPY)
+		buffers carry no storage of their own, data points straight
+		into a kernel trace buffer; once written, the release callback
+		hands the kernel buffer back before the buffer goes on the
+		free list
+
+	compression (KEVFILE_COMPRESS)
+		each buffer is lzo1x compressed on the writer thread and written
+		as a traceblock_t; kevfile_close appends the block index (see
+		<sys/trace.h>)
+
+	kevfile_export_stats
+		moves the live counters into a shared memory object so they
+		can be watched while logging
 */	
 
 #ifndef __KEVFILE_H__
@@ -62,6 +77,7 @@
 #include <sys/types.h>
 #include <sys/neutrino.h>
 #include <inttypes.h>
+#include <sys/trace.h>
 
 #define _TRACE_MAKE_CODE(c,f,cl,e)  (((c)<<24)|(f)|(cl)|(e))
 #if defined(__MIPS__) || defined(__SH__)
@@ -71,6 +87,8 @@
 #endif
 
 #define KEVFILE_MAP 0x00000001
+#define KEVFILE_ZEROCOPY 0x00000002
+#define KEVFILE_COMPRESS 0x00000004
 
 typedef struct kevfile_buf kevfile_buf_t;
 struct kevfile_buf {
@@ -79,6 +97,19 @@ struct kevfile_buf {
 	unsigned char	*data;
 	unsigned		off;
 };
+/* Live counters; the layout is visible to anything mapping the exported object */
+#define KEVFILE_STATS_VERSION	1
+typedef struct kevfile_stats kevfile_stats_t;
+struct kevfile_stats {
+	uint32_t	version;
+	uint32_t	buffers_logged;
+	uint32_t	buffers_dropped;
+	uint32_t	write_depth;		/* buffers waiting to be written (backlog) */
+	uint32_t	max_write_depth;
+	uint32_t	zero_copy;
+	uint64_t	bytes_written;
+};
+
 typedef struct kevfile kevfile_t;
 struct kevfile {
 	const char	*path;
@@ -88,17 +119,26 @@ struct kevfile {
 	unsigned	flags;
 	size_t		max_size;
 	
-	unsigned	buffers_logged;
-	unsigned	buffers_dropped;
+	kevfile_stats_t	*stats;
+	kevfile_stats_t	local_stats;
+	const char	*stats_name;
 	unsigned	last_buffers_dropped;
+	void		(*release)( kevfile_buf_t *buf );
 	
 	unsigned	num_buffers;
 	intrspin_t		buf_spin;
 	kevfile_buf_t	*free_buffers;
 	kevfile_buf_t	*write_buffers;
 	kevfile_buf_t	*write_tail;
-	unsigned		write_depth;
-	unsigned		max_write_depth;
+
+	/* KEVFILE_COMPRESS */
+	off_t		file_offset;
+	uint8_t		*zbuf;
+	void		*zwork;
+	traceblock_index_t	*zindex;
+	unsigned	zindex_num;
+	unsigned	zindex_max;
+	uint64_t	zcycles;
 };
 
 __BEGIN_DECLS
@@ -109,9 +149,11 @@ extern kevfile_buf_t	*kevfile_buffer_get( kevfile_t *kevfile );
 extern int				kevfile_buffer_put( kevfile_t *kevfile, kevfile_buf_t *buf );	
 extern int				kevfile_flush( kevfile_t *kevfile );
 extern unsigned			kevfile_space_left( kevfile_t *kevfile );
+extern int				kevfile_export_stats( kevfile_t *kevfile, const char *name );
 
 #define KEVFILE_FLUSH_NBUFS	1
-#define kevfile_needs_flush( kev ) ( !((kev)->flags & KEVFILE_MAP) && (kev)->write_depth > KEVFILE_FLUSH_NBUFS )
+#define kevfile_needs_flush( kev ) ( !((kev)->flags & KEVFILE_MAP) && (kev)->stats->write_depth > KEVFILE_FLUSH_NBUFS )
+#define kevfile_owns_data( kev ) ( !((kev)->flags & (KEVFILE_MAP|KEVFILE_ZEROCOPY)) )
 	
 __END_DECLS
 
@@ -64,6 +64,8 @@ static struct sigevent finished_ev;
 static struct sigevent filled_ev;
 static int coid;
 static kevfile_t *kev;
+static trace_filter_t filter[_NTO_TRACE_FILTER_MAX];
+static unsigned filter_num = 0;
 unsigned	verify = 0;	/* PDB */
 pid_t		pdb_pid = 3;	/* PDB */
 
@@ -136,7 +138,7 @@ const struct sigevent *dump_buf( int off, tracebuf_t *bufp, int force )
 
 	InterruptLock( &kev->buf_spin );
 	nbytes = kevfile_space_left(kev);
-	iterations_left = max_iterations - kev->buffers_logged;
+	iterations_left = max_iterations - kev->stats->buffers_logged;
 	InterruptUnlock( &kev->buf_spin );
 
 	index = _TRACE_GET_BUFFNUM(off);
@@ -160,7 +162,7 @@ const struct sigevent *dump_buf( int off, tracebuf_t *bufp, int force )
 			bufp->h.flags = 0;
 			InterruptUnlock( &bufp->h.spin );
 
-			kev->buffers_dropped++;
+			kev->stats->buffers_dropped++;
 			return NULL;
 		}
 
@@ -168,17 +170,26 @@ const struct sigevent *dump_buf( int off, tracebuf_t *bufp, int force )
 		bufp->h.flags |= _TRACE_FLAGS_WRITING;
 		InterruptUnlock( &bufp->h.spin );
 
-		tracecpy( &kbuf->data[0], bufp->data, nbytes );
+		if ( kev->flags & KEVFILE_ZEROCOPY ) {
+			/* The writer thread writes straight out of the kernel buffer, it
+			 * stays marked as being written until release_kbuf() recycles it.
+			 */
+			kbuf->data = (unsigned char *)bufp->data;
+		} else {
+			tracecpy( &kbuf->data[0], bufp->data, nbytes );
+		}
 
 		kbuf->nbytes = nbytes;
 		kbuf->off = off;
-		kev->buffers_logged++;
+		kev->stats->buffers_logged++;
 
-		InterruptLock( &bufp->h.spin );
-		bufp->h.tail_ptr = bufp->h.begin_ptr;
-		bufp->h.num_events = 0;
-		bufp->h.flags = 0;
-		InterruptUnlock( &bufp->h.spin );
+		if ( !(kev->flags & KEVFILE_ZEROCOPY) ) {
+			InterruptLock( &bufp->h.spin );
+			bufp->h.tail_ptr = bufp->h.begin_ptr;
+			bufp->h.num_events = 0;
+			bufp->h.flags = 0;
+			InterruptUnlock( &bufp->h.spin );
+		}
 
 		kevfile_buffer_put( kev, kbuf );
 
@@ -199,6 +210,27 @@ const struct sigevent *dump_buf( int off, tracebuf_t *bufp, int force )
 	return NULL;
 }
 
+/* Called by kevfile_flush() once a zero copy buffer has been written */
+static void release_kbuf( kevfile_buf_t *kbuf )
+{
+	tracebuf_t		*bufp;
+
+	bufp = &kernel_buffers_vaddr[_TRACE_GET_BUFFNUM(kbuf->off)];
+	InterruptLock( &bufp->h.spin );
+	bufp->h.tail_ptr = bufp->h.begin_ptr;
+	bufp->h.num_events = 0;
+	bufp->h.flags = 0;
+	InterruptUnlock( &bufp->h.spin );
+}
+
+static void report_stats( kevfile_t *kev )
+{
+	fprintf( stderr, "%u buffers logged, %u dropped, %u waiting (max %u), %llu bytes written\n",
+		kev->stats->buffers_logged, kev->stats->buffers_dropped,
+		kev->stats->write_depth, kev->stats->max_write_depth,
+		(unsigned long long)kev->stats->bytes_written );
+}
+
 const struct sigevent *hookfunc( int off )
 {
 	tracebuf_t		*bufp;
@@ -229,9 +261,14 @@ void *signal_catcher_thread( void *arg )
 	sigaddset( &set, SIGTERM );
 	sigaddset( &set, SIGHUP );
 	sigaddset( &set, SIGABRT );
+	sigaddset( &set, SIGUSR1 );
 
 	while( 1 ) {
 		if ( sigwaitinfo( &set, &sinfo ) != -1 ) {
+			if ( sinfo.si_signo == SIGUSR1 ) {
+				report_stats( kev );
+				continue;
+			}
 			info( "Caught signal %d\n", sinfo.si_signo );
 			TraceEvent( _NTO_TRACE_STOP );
 			MsgSendPulse( coid, priority, TRACE_PULSE_FINISHED, 0 );
@@ -276,6 +313,117 @@ static void add_argument_attribute(int argc, char **argv) {
 	add_user_attribute(buffer);
 }
 
+static const struct {
+	const char	*name;
+	unsigned	value;
+} filter_names[] = {
+	{ "pid",		_NTO_TRACE_FILTER_PID },
+	{ "tid",		_NTO_TRACE_FILTER_TID },
+	{ "class",		_NTO_TRACE_FILTER_CLASS },
+	{ "event",		_NTO_TRACE_FILTER_EVENT },
+	{ "arg1",		_NTO_TRACE_FILTER_ARG1 },
+	{ "arg2",		_NTO_TRACE_FILTER_ARG2 },
+}, class_names[] = {
+	{ "control",	_TRACE_CONTROL_C >> 10 },
+	{ "kercall",	_TRACE_KER_CALL_C >> 10 },
+	{ "int",		_TRACE_INT_C >> 10 },
+	{ "process",	_TRACE_PR_TH_C >> 10 },
+	{ "thread",		_TRACE_PR_TH_C >> 10 },
+	{ "system",		_TRACE_SYSTEM_C >> 10 },
+	{ "user",		_TRACE_USER_C >> 10 },
+	{ "comm",		_TRACE_COMM_C >> 10 },
+};
+
+static int parse_value( unsigned field, const char *str, char **end, uint32_t *v ) {
+	int i;
+
+	if ( field == _NTO_TRACE_FILTER_CLASS ) {
+		for ( i = 0; i < sizeof(class_names)/sizeof(class_names[0]); i++ ) {
+			int len = strlen( class_names[i].name );
+			if ( strncmp( str, class_names[i].name, len ) == 0 ) {
+				*v = class_names[i].value;
+				*end = (char *)str + len;
+				return 0;
+			}
+		}
+	}
+	*v = strtoul( str, end, 0 );
+	return ( *end == str ) ? -1 : 0;
+}
+
+/*
+ * Parse a -X predicate into the kernel filter program:
+ *   term[,term...][;term[,term...]...]
+ *   term is [!]field[&mask]=value[-value]
+ * terms separated by ',' must all hold, groups separated by ';' are
+ * alternatives.  A class value may be given by name.
+ */
+static int add_filter( const char *spec ) {
+	const char	*p = spec;
+	char		*end;
+	int			i;
+
+	while ( *p != '\0' ) {
+		trace_filter_t	*f;
+
+		if ( filter_num == _NTO_TRACE_FILTER_MAX ) {
+			fprintf( stderr, "too many filter terms (max %d)\n", _NTO_TRACE_FILTER_MAX );
+			return -1;
+		}
+		f = &filter[filter_num];
+		memset( f, 0, sizeof(*f) );
+		f->mask = 0xffffffff;
+		if ( *p == '!' ) {
+			f->flags |= _NTO_TRACE_FILTER_NOT;
+			p++;
+		}
+		for ( i = 0; i < sizeof(filter_names)/sizeof(filter_names[0]); i++ ) {
+			int len = strlen( filter_names[i].name );
+			if ( strncmp( p, filter_names[i].name, len ) == 0 && (p[len] == '&' || p[len] == '=') ) {
+				break;
+			}
+		}
+		if ( i == sizeof(filter_names)/sizeof(filter_names[0]) ) {
+			fprintf( stderr, "unknown filter field in '%s'\n", p );
+			return -1;
+		}
+		f->field = filter_names[i].value;
+		p += strlen( filter_names[i].name );
+		if ( *p == '&' ) {
+			f->mask = strtoul( p + 1, &end, 0 );
+			p = end;
+		}
+		if ( *p++ != '=' || parse_value( f->field, p, &end, &f->lo ) == -1 ) {
+			fprintf( stderr, "bad filter term in '%s'\n", spec );
+			return -1;
+		}
+		p = end;
+		f->hi = f->lo;
+		if ( *p == '-' ) {
+			if ( parse_value( f->field, p + 1, &end, &f->hi ) == -1 || f->hi < f->lo ) {
+				fprintf( stderr, "bad filter range in '%s'\n", spec );
+				return -1;
+			}
+			p = end;
+		}
+		filter_num++;
+		if ( *p == ';' ) {
+			f->flags |= _NTO_TRACE_FILTER_OR;
+			p++;
+		} else if ( *p == ',' ) {
+			p++;
+		} else if ( *p != '\0' ) {
+			fprintf( stderr, "bad filter term in '%s'\n", spec );
+			return -1;
+		}
+	}
+	/* separate groups from multiple -X options */
+	if ( filter_num > 0 ) {
+		filter[filter_num - 1].flags |= _NTO_TRACE_FILTER_OR;
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	int timer_id, interrupt_id;
@@ -297,6 +445,10 @@ int main(int argc, char *argv[])
 	unsigned num_buffers = DEFAULT_USER_BUFS;
 	unsigned num_kbuffers = DEFAULT_KERNEL_BUFS;
 	int direct_map = 0;
+	int zero_copy = 0;
+	int compress = 0;
+	int per_cpu = 0;
+	char *stats_name = NULL;
 	int c;
 	pthread_attr_t pattr;
 	struct sched_param param;
@@ -306,8 +458,25 @@ int main(int argc, char *argv[])
 	add_argument_attribute(argc, argv);
 
 	/* option processing */
-	while ( (c = getopt(argc, argv, "wd:rvk:b:f:S:F:s:n:McA:EPR")) != -1) {
+	while ( (c = getopt(argc, argv, "wd:rvk:b:f:S:F:s:n:McCA:EPRZzL:X:")) != -1) {
 		switch(c) {
+		case 'Z':
+			zero_copy = 1;
+			break;
+		case 'z':
+			compress = 1;
+			break;
+		case 'C':
+			per_cpu = 1;
+			break;
+		case 'L':
+			stats_name = optarg;
+			break;
+		case 'X':
+			if ( add_filter( optarg ) == -1 ) {
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'E':
 			add_events = 1;
 			break;
@@ -413,6 +582,14 @@ int main(int argc, char *argv[])
 		fprintf( stderr, "%s: direct_mapping needs max size specified\n", argv[0] );
 		return -1;
 	}
+	if ( direct_map && zero_copy ) {
+		fprintf( stderr, "%s: zero copy can't be used with direct mapping\n", argv[0] );
+		return -1;
+	}
+	if ( direct_map && compress ) {
+		fprintf( stderr, "%s: compression can't be used with direct mapping\n", argv[0] );
+		return -1;
+	}
 
 	/* request I/O privity  */
 	if ( ThreadCtl( _NTO_TCTL_IO, 0 ) == -1 ) {
@@ -420,13 +597,30 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	/* tell the readers to merge the cpus' event streams */
+	if ( per_cpu ) {
+		char attr[64];
+
+		snprintf( attr, sizeof(attr), "%s=%d", _TRACE_PERCPU_KEY, _syspage_ptr->num_cpu );
+		add_user_attribute( attr );
+	}
+
 	/* create logfile */
 	/* QUESTION - this will currently happily create a shmem file anywhere.  This could be confusing! */
-	kev = kevfile_open( output_filename, direct_map ? KEVFILE_MAP:0, max_filesize, num_buffers );
+	kev = kevfile_open( output_filename, direct_map ? KEVFILE_MAP :
+				((zero_copy ? KEVFILE_ZEROCOPY : 0) | (compress ? KEVFILE_COMPRESS : 0)), max_filesize, num_buffers );
 	if ( kev == NULL ) {
 		perror( output_filename );
 		return -1;
 	}
+	if ( zero_copy ) {
+		kev->release = release_kbuf;
+	}
+	if ( stats_name != NULL && kevfile_export_stats( kev, stats_name ) == -1 ) {
+		perror( stats_name );
+		kevfile_close( kev );
+		return -1;
+	}
 
 	/* create channel, connection */
 	chid = ChannelCreate(0);
@@ -465,6 +659,12 @@ int main(int argc, char *argv[])
 		kevfile_close( kev );
 		return -1;
 	}
+	if ( TraceEvent( per_cpu ? _NTO_TRACE_SETCPUBUFFERS : _NTO_TRACE_SETSHAREDBUFFERS ) == -1 && per_cpu ) {
+		fprintf( stderr, "%s: per cpu buffers need at least 2 kernel buffers per cpu (-k)\n", argv[0] );
+		kernel_detach( kernel_buffers_paddr, persist_kbuffers );
+		kevfile_close( kev );
+		return -1;
+	}
 
 	/* attach appropriate interrupt handler */
 	if ( (interrupt_id = InterruptHookTrace( hookfunc, 0 )) == -1 ) {
@@ -514,6 +714,16 @@ int main(int argc, char *argv[])
 			TraceEvent( _NTO_TRACE_SETALLCLASSESFAST );
 		}
 	}
+	if ( filter_num > 0 ) {
+		info("Installing %d term kernel event filter\n", filter_num );
+		if ( TraceEvent( _NTO_TRACE_SETFILTER, filter, filter_num ) == -1 ) {
+			perror("Setting event filter");
+			InterruptDetach( interrupt_id );
+			kernel_detach( kernel_buffers_paddr, persist_kbuffers );
+			kevfile_close( kev );
+			return -1;
+		}
+	}
 	if ( ring_mode ) {
 		TraceEvent( _NTO_TRACE_SETRINGMODE );
 	} else {
@@ -615,12 +825,12 @@ int main(int argc, char *argv[])
 
 	kevfile_flush( kev );
 	info("logged %d bytes\n", kev->current_offset );
-	info("logged %d buffers\n", kev->buffers_logged );
-	if ( kev->buffers_dropped ) {
-		info("warning, dropped %d kernel buffers, -b %d wasn't enough\n", kev->buffers_dropped, kev->num_buffers );
+	info("logged %d buffers\n", kev->stats->buffers_logged );
+	if ( kev->stats->buffers_dropped ) {
+		info("warning, dropped %d kernel buffers, -b %d wasn't enough\n", kev->stats->buffers_dropped, kev->num_buffers );
 	}
-	else if ( kev->max_write_depth > 0 ) {
-		info("maximum write depth of tracelogger buffers was %d (ie minimum -b option value)\n", kev->max_write_depth );
+	else if ( kev->stats->max_write_depth > 0 ) {
+		info("maximum write depth of tracelogger buffers was %d (ie minimum -b option value)\n", kev->stats->max_write_depth );
 	}
 	kevfile_close( kev );
 
@@ -629,6 +839,9 @@ int main(int argc, char *argv[])
 		info("Disabling events\n");
 		TraceEvent( _NTO_TRACE_DELALLCLASSES );
 	}
+	if ( filter_num > 0 ) {
+		TraceEvent( _NTO_TRACE_CLRFILTER );
+	}
 	/* release kernel buffers */
 	kernel_detach( kernel_buffers_paddr, persist_kbuffers );
 	printf("PDB: pid = %u\n", pdb_pid);	/* PDB */
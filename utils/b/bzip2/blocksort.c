@@ -667,15 +667,28 @@ static void randomiseBlock ( EState* s )
 
 
 /*---------------------------------------------*/
+/*--
+   On ordinary data sortMain() finishes with workDone well
+   under nblock and is a little quicker than saisSort().
+   Once it has used this much, the block is repetitive
+   enough that saisSort() is the faster way to finish it,
+   and it never needs to randomise.
+--*/
+#define SAIS_WORK_FACTOR 2
+
 void blockSort ( EState* s )
 {
    Int32 i;
+   Bool  suffixSorted = False;
 
    s->workLimit       = s->workFactor * (s->nblock - 1);
    s->workDone        = 0;
    s->blockRandomised = False;
    s->firstAttempt    = True;
 
+   if (s->workFactor > SAIS_WORK_FACTOR)
+      s->workLimit = SAIS_WORK_FACTOR * (s->nblock - 1);
+
    sortMain ( s );
 
    if (s->verbosity >= 3)
@@ -684,6 +697,19 @@ void blockSort ( EState* s )
                 (float)(s->workDone) / (float)(s->nblock-1) );
 
    if (s->workDone > s->workLimit && s->firstAttempt) {
+      if (saisSort ( s )) {
+         if (s->verbosity >= 2)
+            VPrintf0( "    sorting slow; suffix sorting block\n" );
+         suffixSorted = True;
+      } else {
+         /*-- no memory for it; carry on the old way --*/
+         s->workLimit = s->workFactor * (s->nblock - 1);
+         s->workDone  = 0;
+         sortMain ( s );
+      }
+   }
+
+   if (!suffixSorted && s->workDone > s->workLimit && s->firstAttempt) {
       if (s->verbosity >= 2)
          VPrintf0( "    sorting aborted; randomising block\n" );
       randomiseBlock ( s );
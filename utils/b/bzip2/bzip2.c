@@ -141,6 +141,7 @@
 #include <signal.h>
 #include <math.h>
 #include "bzlib.h"
+#include "bzthreads.h"
 
 #define ERROR_IF_EOF(i)       { if ((i) == EOF)  ioError(); }
 #define ERROR_IF_NOT_ZERO(i)  { if ((i) != 0)    ioError(); }
@@ -257,6 +258,7 @@ Int32   verbosity;
 Bool    keepInputFiles, smallMode;
 Bool    forceOverwrite, testFailsExist;
 Int32   numFileNames, numFilesProcessed, blockSize100k;
+Int32   numThreads;
 
 
 /*-- source modes; F==file, I==stdin, O==stdout --*/
@@ -327,6 +329,15 @@ void compressStream ( FILE *stream, FILE *zStream )
    if (ferror(stream)) goto errhandler_io;
    if (ferror(zStream)) goto errhandler_io;
 
+   if (numThreads > 1) {
+      if (verbosity >= 2) fprintf ( stderr, "\n" );
+      bzerr = compressStreamMT ( stream, zStream, blockSize100k, 
+                                 verbosity, workFactor, numThreads,
+                                 &nbytes_in, &nbytes_out );
+      if (bzerr != BZ_OK) goto errhandler;
+      goto closeup;
+   }
+
    bzf = bzWriteOpen ( &bzerr, zStream, 
                        blockSize100k, verbosity, workFactor );   
    if (bzerr != BZ_OK) goto errhandler;
@@ -346,6 +357,7 @@ void compressStream ( FILE *stream, FILE *zStream )
    bzWriteClose ( &bzerr, bzf, 0, &nbytes_in, &nbytes_out );
    if (bzerr != BZ_OK) goto errhandler;
 
+   closeup:
    if (ferror(zStream)) goto errhandler_io;
    ret = fflush ( zStream );
    if (ret == EOF) goto errhandler_io;
@@ -408,6 +420,13 @@ Bool uncompressStream ( FILE *zStream, FILE *stream )
    if (ferror(stream)) goto errhandler_io;
    if (ferror(zStream)) goto errhandler_io;
 
+   if (numThreads > 1 && !smallMode) {
+      bzerr = uncompressStreamMT ( zStream, stream, verbosity, 
+                                   numThreads, &streamNo );
+      if (bzerr != BZ_OK) goto errhandler;
+      goto closeup;
+   }
+
    while (True) {
 
       bzf = bzReadOpen ( 
@@ -438,6 +457,7 @@ Bool uncompressStream ( FILE *zStream, FILE *stream )
 
    }
 
+   closeup:
    if (ferror(zStream)) goto errhandler_io;
    ret = fclose ( zStream );
    if (ret == EOF) goto errhandler_io;
@@ -498,6 +518,13 @@ Bool testStream ( FILE *zStream )
    SET_BINARY_MODE(zStream);
    if (ferror(zStream)) goto errhandler_io;
 
+   if (numThreads > 1 && !smallMode) {
+      bzerr = uncompressStreamMT ( zStream, NULL, verbosity, 
+                                   numThreads, &streamNo );
+      if (bzerr != BZ_OK) goto errhandler;
+      goto closeup;
+   }
+
    while (True) {
 
       bzf = bzReadOpen ( 
@@ -524,6 +551,7 @@ Bool testStream ( FILE *zStream )
 
    }
 
+   closeup:
    if (ferror(zStream)) goto errhandler_io;
    ret = fclose ( zStream );
    if (ret == EOF) goto errhandler_io;
@@ -1227,6 +1255,7 @@ void usage ( Char *fullProgName )
       "   -1 .. -9            set block size to 100k .. 900k\n"
       "   --repetitive-fast   compress repetitive blocks faster\n"
       "   --repetitive-best   compress repetitive blocks better\n"
+      "   --threads=N         use N threads (0 = one per cpu)\n"
       "\n"
       "   If invoked as `bzip2', default action is to compress.\n"
       "              as `bunzip2',  default action is to decompress.\n"
@@ -1310,6 +1339,7 @@ Cell *snocString ( Cell *root, Char *name )
 
 /*---------------------------------------------*/
 #define ISFLAG(s) (strcmp(aa->name, (s))==0)
+#define ISPREFIX(s) (strncmp(aa->name, (s), strlen(s))==0)
 
 
 IntNative main ( IntNative argc, Char *argv[] )
@@ -1354,6 +1384,7 @@ IntNative main ( IntNative argc, Char *argv[] )
    numFileNames            = 0;
    numFilesProcessed       = 0;
    workFactor              = 30;
+   numThreads              = 1;
 
    copyFileName ( inName,  "(none)" );
    copyFileName ( outName, "(none)" );
@@ -1451,6 +1482,7 @@ IntNative main ( IntNative argc, Char *argv[] )
       if (ISFLAG("--repetitive-fast"))   workFactor = 5;             else
       if (ISFLAG("--repetitive-best"))   workFactor = 150;           else
       if (ISFLAG("--verbose"))           verbosity++;                else
+      if (ISPREFIX("--threads="))        numThreads = atoi(aa->name+10); else
       if (ISFLAG("--help"))              { usage ( progName ); exit ( 1 ); }
          else
          if (strncmp ( aa->name, "--", 2) == 0) {
@@ -1461,6 +1493,11 @@ IntNative main ( IntNative argc, Char *argv[] )
    }
 
    if (verbosity > 4) verbosity = 4;
+#ifdef _SC_NPROCESSORS_ONLN
+   if (numThreads <= 0) numThreads = sysconf ( _SC_NPROCESSORS_ONLN );
+#endif
+   if (numThreads <= 0) numThreads = 1;
+   if (numThreads > BZ_MAX_THREADS) numThreads = BZ_MAX_THREADS;
    if (opMode == OM_Z && smallMode) blockSize100k = 2;
 
    if (srcMode == SM_F2O && numFileNames == 0) {
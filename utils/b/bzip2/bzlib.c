@@ -103,7 +103,6 @@ void default_bzfree ( void* opaque, void* addr )
 
 
 /*---------------------------------------------------*/
-static
 void prepare_new_block ( EState* s )
 {
    Int32 i;
@@ -235,7 +234,6 @@ void add_pair_to_block ( EState* s )
 
 
 /*---------------------------------------------------*/
-static
 void flush_RL ( EState* s )
 {
    if (s->state_in_ch < 256) add_pair_to_block ( s );
@@ -314,6 +312,24 @@ Bool copy_input_until_stop ( EState* s )
 }
 
 
+/*---------------------------------------------------*/
+/*-- Run-length code buf[0 .. n-1] into the current  --*/
+/*-- block, stopping early if the block fills up,    --*/
+/*-- exactly as copy_input_until_stop does.  Returns --*/
+/*-- the number of bytes taken.  For bzthreads.c.    --*/
+Int32 copy_buffer_to_block ( EState* s, UChar* buf, Int32 n )
+{
+   Int32 i;
+
+   for (i = 0; i < n; i++) {
+      /*-- block full? --*/
+      if (s->nblock >= s->nblockMAX) break;
+      ADD_CHAR_TO_BLOCK ( s, (UInt32)(buf[i]) );
+   }
+   return i;
+}
+
+
 /*---------------------------------------------------*/
 static
 Bool copy_output_until_stop ( EState* s )
@@ -505,8 +521,10 @@ int BZ_API(bzDecompressInit)
 
 
 /*---------------------------------------------------*/
+/*-- Return  True iff data corruption is discovered. --*/
+/*-- Returns False if there is no problem.           --*/
 static
-void unRLE_obuf_to_output_FAST ( DState* s )
+Bool unRLE_obuf_to_output_FAST ( DState* s )
 {
    UChar k1;
 
@@ -515,7 +533,7 @@ void unRLE_obuf_to_output_FAST ( DState* s )
       while (True) {
          /* try to finish existing run */
          while (True) {
-            if (s->strm->avail_out == 0) return;
+            if (s->strm->avail_out == 0) return False;
             if (s->state_out_len == 0) break;
             *( (UChar*)(s->strm->next_out) ) = s->state_out_ch;
             BZ_UPDATE_CRC ( s->calculatedBlockCRC, s->state_out_ch );
@@ -526,7 +544,11 @@ void unRLE_obuf_to_output_FAST ( DState* s )
          }
    
          /* can a new run be started? */
-         if (s->nblock_used == s->save_nblock+1) return;
+         if (s->nblock_used == s->save_nblock+1) return False;
+
+         /* Only caused by corrupt data stream? */
+         if (s->nblock_used > s->save_nblock+1)
+            return True;
                
    
          s->state_out_len = 1;
@@ -596,6 +618,10 @@ void unRLE_obuf_to_output_FAST ( DState* s )
                cs_avail_out--;
             }
          }   
+         /* Only caused by corrupt data stream? */
+         if (c_nblock_used > s_save_nblockPP)
+            return True;
+
          /* can a new run be started? */
          if (c_nblock_used == s_save_nblockPP) {
             c_state_out_len = 0; goto return_notr;
@@ -638,6 +664,7 @@ void unRLE_obuf_to_output_FAST ( DState* s )
       s->strm->avail_out    = cs_avail_out;
       /* end save */
    }
+   return False;
 }
 
 
@@ -658,8 +685,10 @@ __inline__ Int32 indexIntoF ( Int32 indx, Int32 *cftab )
 
 
 /*---------------------------------------------------*/
+/*-- Return  True iff data corruption is discovered. --*/
+/*-- Returns False if there is no problem.           --*/
 static
-void unRLE_obuf_to_output_SMALL ( DState* s )
+Bool unRLE_obuf_to_output_SMALL ( DState* s )
 {
    UChar k1;
 
@@ -668,7 +697,7 @@ void unRLE_obuf_to_output_SMALL ( DState* s )
       while (True) {
          /* try to finish existing run */
          while (True) {
-            if (s->strm->avail_out == 0) return;
+            if (s->strm->avail_out == 0) return False;
             if (s->state_out_len == 0) break;
             *( (UChar*)(s->strm->next_out) ) = s->state_out_ch;
             BZ_UPDATE_CRC ( s->calculatedBlockCRC, s->state_out_ch );
@@ -679,7 +708,11 @@ void unRLE_obuf_to_output_SMALL ( DState* s )
          }
    
          /* can a new run be started? */
-         if (s->nblock_used == s->save_nblock+1) return;
+         if (s->nblock_used == s->save_nblock+1) return False;
+
+         /* Only caused by corrupt data stream? */
+         if (s->nblock_used > s->save_nblock+1)
+            return True;
                
    
          s->state_out_len = 1;
@@ -713,7 +746,7 @@ void unRLE_obuf_to_output_SMALL ( DState* s )
       while (True) {
          /* try to finish existing run */
          while (True) {
-            if (s->strm->avail_out == 0) return;
+            if (s->strm->avail_out == 0) return False;
             if (s->state_out_len == 0) break;
             *( (UChar*)(s->strm->next_out) ) = s->state_out_ch;
             BZ_UPDATE_CRC ( s->calculatedBlockCRC, s->state_out_ch );
@@ -724,7 +757,11 @@ void unRLE_obuf_to_output_SMALL ( DState* s )
          }
    
          /* can a new run be started? */
-         if (s->nblock_used == s->save_nblock+1) return;
+         if (s->nblock_used == s->save_nblock+1) return False;
+
+         /* Only caused by corrupt data stream? */
+         if (s->nblock_used > s->save_nblock+1)
+            return True;
    
          s->state_out_len = 1;
          s->state_out_ch = s->k0;
@@ -748,6 +785,7 @@ void unRLE_obuf_to_output_SMALL ( DState* s )
       }
 
    }
+   return False;
 }
 
 
@@ -763,9 +801,11 @@ int BZ_API(bzDecompress) ( bz_stream *strm )
    while (True) {
       if (s->state == BZ_X_IDLE) return BZ_SEQUENCE_ERROR;
       if (s->state == BZ_X_OUTPUT) {
+         Bool corrupt;
          if (s->smallDecompress)
-            unRLE_obuf_to_output_SMALL ( s ); else
-            unRLE_obuf_to_output_FAST  ( s );
+            corrupt = unRLE_obuf_to_output_SMALL ( s ); else
+            corrupt = unRLE_obuf_to_output_FAST  ( s );
+         if (corrupt) return BZ_DATA_ERROR;
          if (s->nblock_used == s->save_nblock+1 && s->state_out_len == 0) {
             BZ_FINALISE_CRC ( s->calculatedBlockCRC );
             if (s->verbosity >= 3) 
@@ -293,6 +293,9 @@ typedef
 extern void 
 blockSort ( EState* );
 
+extern Bool 
+saisSort ( EState* );
+
 extern void 
 compressBlock ( EState*, Bool );
 
@@ -305,6 +308,18 @@ hbAssignCodes ( Int32*, UChar*, Int32, Int32, Int32 );
 extern void 
 hbMakeCodeLengths ( UChar*, Int32*, Int32, Int32 );
 
+extern void 
+compressBlockAlone ( EState* );
+
+extern void 
+prepare_new_block ( EState* );
+
+extern void 
+flush_RL ( EState* );
+
+extern Int32 
+copy_buffer_to_block ( EState*, UChar*, Int32 );
+
 
 
 /*-- states for decompression. --*/
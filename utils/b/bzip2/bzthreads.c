@@ -0,0 +1,1026 @@
+/*-------------------------------------------------------------*/
+/*--- Multi-threaded stream compression and decompression   ---*/
+/*---                                           bzthreads.c ---*/
+/*-------------------------------------------------------------*/
+
+/*--
+  This file is a part of the QNX modified version of bzip2; it is
+  not part of Julian Seward's bzip2-0.9.0 distribution.  It is
+  distributed under the same terms as the rest of bzip2, see the
+  LICENSE file.
+
+  Blocks are independent once they have been cut, so both
+  directions hand whole blocks to a pool of worker threads and
+  put the results back together in order on the calling thread.
+
+  Compression: the calling thread does the initial run-length
+  coding into a block (the same code bzWrite uses, so the block
+  boundaries are the same), and a worker does the sorting and
+  the MTF/Huffman coding with compressBlockAlone.  Blocks are
+  not byte aligned in a .bz2 stream, so the calling thread
+  splices each block's bits onto the end of the previous one.
+  The output is identical to the serial path.
+
+  Decompression: block boundaries are only known once the
+  previous block has been decoded, so the input is scanned for
+  the 48-bit block magic at every bit offset and each hit is
+  decoded speculatively.  A hit that turns out not to be where
+  the previous block ended is some block's data that happens to
+  look like a header, and its result is thrown away.  Blocks
+  that really are blocks still have their CRCs checked, and the
+  stream CRC is checked at the end as usual.
+--*/
+
+
+#include "bzlib_private.h"
+#include "bzthreads.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+
+typedef unsigned long long UInt64;
+
+
+/*---------------------------------------------------*/
+/*--- The worker pool                             ---*/
+/*---------------------------------------------------*/
+
+typedef
+   struct job {
+      struct job* next;       /* todo/free list              */
+      struct job* order;      /* pending list, stream order  */
+      struct job* all;        /* every job, for cleanup      */
+      Bool        done;
+
+      bz_stream   strm;
+
+      /* decompression only */
+      UChar*      zbuf;       /* input, starting at the byte */
+      Int32       nzbuf;      /* holding the block magic     */
+      Int32       zbufSize;
+      UInt64      start;      /* bit offsets in the file of  */
+      UInt64      end;        /* the magic and of the end    */
+      UChar*      obuf;
+      Int32       nobuf;
+      Int32       obufSize;
+      UInt32      blockCRC;
+      Int32       nblock;
+      Int32       ret;
+   }
+   Job;
+
+typedef
+   struct {
+      pthread_mutex_t mutex;
+      pthread_cond_t  work_cond;
+      pthread_cond_t  done_cond;
+      pthread_t*      threads;
+      Int32           nthreads;
+      Int32           njobs;
+      Int32           maxjobs;
+      Bool            stop;
+
+      /* todo is shared with the workers; everything */
+      /* else belongs to the calling thread          */
+      Job*            todo;
+      Job**           todo_tail;
+      Job*            pending;
+      Job**           pending_tail;
+      Job*            free;
+      Job*            all;
+
+      void            (*work) ( Job* );
+      void            (*fini) ( Job* );
+   }
+   Pool;
+
+
+/*---------------------------------------------------*/
+static
+void* worker ( void* arg )
+{
+   Pool* pool = arg;
+   Job*  j;
+
+   pthread_mutex_lock ( &pool->mutex );
+   while (!pool->stop) {
+      j = pool->todo;
+      if (j == NULL) {
+         pthread_cond_wait ( &pool->work_cond, &pool->mutex );
+         continue;
+      }
+      pool->todo = j->next;
+      if (pool->todo == NULL) pool->todo_tail = &pool->todo;
+      pthread_mutex_unlock ( &pool->mutex );
+
+      pool->work ( j );
+
+      pthread_mutex_lock ( &pool->mutex );
+      j->done = True;
+      pthread_cond_broadcast ( &pool->done_cond );
+   }
+   pthread_mutex_unlock ( &pool->mutex );
+   return NULL;
+}
+
+
+static void pool_stop ( Pool* pool );
+
+
+/*---------------------------------------------------*/
+static
+Int32 pool_start ( Pool* pool, Int32 nthreads, Int32 maxjobs,
+                   void (*work)(Job*), void (*fini)(Job*) )
+{
+   memset ( pool, 0, sizeof(*pool) );
+   pool->todo_tail    = &pool->todo;
+   pool->pending_tail = &pool->pending;
+   pool->maxjobs      = maxjobs;
+   pool->work         = work;
+   pool->fini         = fini;
+
+   pool->threads = malloc ( nthreads * sizeof(pthread_t) );
+   if (pool->threads == NULL) return BZ_MEM_ERROR;
+
+   pthread_mutex_init ( &pool->mutex, NULL );
+   pthread_cond_init ( &pool->work_cond, NULL );
+   pthread_cond_init ( &pool->done_cond, NULL );
+
+   while (pool->nthreads < nthreads) {
+      if (pthread_create ( &pool->threads[pool->nthreads], NULL,
+                           worker, pool ) != 0) break;
+      pool->nthreads++;
+   }
+   if (pool->nthreads == 0) {
+      pool_stop ( pool );
+      return BZ_MEM_ERROR;
+   }
+   return BZ_OK;
+}
+
+
+/*---------------------------------------------------*/
+/*-- Jobs still queued are dropped; ones already    --*/
+/*-- running are finished before the threads exit. --*/
+static
+void pool_stop ( Pool* pool )
+{
+   Int32 i;
+   Job*  j;
+
+   pthread_mutex_lock ( &pool->mutex );
+   pool->stop = True;
+   pthread_cond_broadcast ( &pool->work_cond );
+   pthread_mutex_unlock ( &pool->mutex );
+
+   for (i = 0; i < pool->nthreads; i++)
+      pthread_join ( pool->threads[i], NULL );
+
+   while ((j = pool->all) != NULL) {
+      pool->all = j->all;
+      if (j->strm.state != NULL) pool->fini ( j );
+      if (j->zbuf != NULL) free ( j->zbuf );
+      if (j->obuf != NULL) free ( j->obuf );
+      free ( j );
+   }
+
+   free ( pool->threads );
+   pthread_cond_destroy ( &pool->done_cond );
+   pthread_cond_destroy ( &pool->work_cond );
+   pthread_mutex_destroy ( &pool->mutex );
+}
+
+
+/*---------------------------------------------------*/
+/*-- A free job, or a new one while under the       --*/
+/*-- limit, or NULL if they are all in use.         --*/
+static
+Job* pool_take ( Pool* pool )
+{
+   Job* j = pool->free;
+
+   if (j != NULL) {
+      pool->free = j->next;
+      return j;
+   }
+   if (pool->njobs >= pool->maxjobs) return NULL;
+   j = calloc ( 1, sizeof(Job) );
+   if (j == NULL) return NULL;
+   j->all = pool->all;
+   pool->all = j;
+   pool->njobs++;
+   return j;
+}
+
+
+/*---------------------------------------------------*/
+static
+void pool_give ( Pool* pool, Job* j )
+{
+   j->next = pool->free;
+   pool->free = j;
+}
+
+
+/*---------------------------------------------------*/
+static
+void pool_submit ( Pool* pool, Job* j )
+{
+   j->done  = False;
+   j->next  = NULL;
+   j->order = NULL;
+   *pool->pending_tail = j;
+   pool->pending_tail = &j->order;
+
+   pthread_mutex_lock ( &pool->mutex );
+   *pool->todo_tail = j;
+   pool->todo_tail = &j->next;
+   pthread_cond_signal ( &pool->work_cond );
+   pthread_mutex_unlock ( &pool->mutex );
+}
+
+
+/*---------------------------------------------------*/
+/*-- Take the oldest pending job off the list once  --*/
+/*-- it has finished.  Returns NULL if nothing is   --*/
+/*-- pending, or if wait is False and the oldest    --*/
+/*-- job is still running.                          --*/
+static
+Job* pool_head ( Pool* pool, Bool wait )
+{
+   Job* j = pool->pending;
+
+   if (j == NULL) return NULL;
+   pthread_mutex_lock ( &pool->mutex );
+   while (!j->done && wait)
+      pthread_cond_wait ( &pool->done_cond, &pool->mutex );
+   pthread_mutex_unlock ( &pool->mutex );
+   if (!j->done) return NULL;
+
+   pool->pending = j->order;
+   if (pool->pending == NULL) pool->pending_tail = &pool->pending;
+   return j;
+}
+
+
+/*---------------------------------------------------*/
+/*--- Compression                                 ---*/
+/*---------------------------------------------------*/
+
+#define BZ_MT_IBUF 65536
+#define BZ_MT_OBUF 65536
+
+typedef
+   struct {
+      FILE*  f;
+      UChar  buf[BZ_MT_OBUF];
+      Int32  nbuf;
+      UInt32 bsBuff;
+      Int32  bsLive;
+      UInt32 total;
+      Bool   err;
+   }
+   BitOut;
+
+
+/*---------------------------------------------------*/
+static
+void bo_flush ( BitOut* bo )
+{
+   if (bo->nbuf > 0 &&
+       fwrite ( bo->buf, 1, bo->nbuf, bo->f ) != (size_t)bo->nbuf)
+      bo->err = True;
+   bo->total += bo->nbuf;
+   bo->nbuf = 0;
+}
+
+
+/*---------------------------------------------------*/
+/*-- Move whole bytes out of bsBuff, like bsNEEDW.  --*/
+static
+void bo_drain ( BitOut* bo )
+{
+   while (bo->bsLive >= 8) {
+      if (bo->nbuf == BZ_MT_OBUF) bo_flush ( bo );
+      bo->buf[bo->nbuf++] = (UChar)(bo->bsBuff >> 24);
+      bo->bsBuff <<= 8;
+      bo->bsLive -= 8;
+   }
+}
+
+
+/*---------------------------------------------------*/
+/*-- Same as bsW in compress.c; n <= 24.            --*/
+static
+void bo_bits ( BitOut* bo, Int32 n, UInt32 v )
+{
+   bo_drain ( bo );
+   bo->bsBuff |= (v << (32 - bo->bsLive - n));
+   bo->bsLive += n;
+}
+
+
+/*---------------------------------------------------*/
+static
+void bo_bytes ( BitOut* bo, UChar* p, Int32 n )
+{
+   Int32 k;
+
+   bo_drain ( bo );
+   if (bo->bsLive == 0) {
+      while (n > 0) {
+         if (bo->nbuf == BZ_MT_OBUF) bo_flush ( bo );
+         k = BZ_MT_OBUF - bo->nbuf;
+         if (k > n) k = n;
+         memcpy ( bo->buf + bo->nbuf, p, k );
+         bo->nbuf += k;
+         p += k;
+         n -= k;
+      }
+   } else {
+      while (n-- > 0) bo_bits ( bo, 8, *p++ );
+   }
+}
+
+
+/*---------------------------------------------------*/
+static
+void bo_uint32 ( BitOut* bo, UInt32 u )
+{
+   bo_bits ( bo, 8, (u >> 24) & 0xff );
+   bo_bits ( bo, 8, (u >> 16) & 0xff );
+   bo_bits ( bo, 8, (u >>  8) & 0xff );
+   bo_bits ( bo, 8,  u        & 0xff );
+}
+
+
+/*---------------------------------------------------*/
+/*-- Add a coded block to the output: the whole     --*/
+/*-- bytes compressBlockAlone left at quadrant, and --*/
+/*-- then the odd bits still in bsBuff.             --*/
+static
+void bo_block ( BitOut* bo, EState* s )
+{
+   UInt32 buff = s->bsBuff;
+   Int32  live = s->bsLive;
+   Int32  k;
+
+   bo_bytes ( bo, (UChar*)(s->quadrant), s->numZ );
+   while (live > 0) {
+      k = live < 8 ? live : 8;
+      bo_bits ( bo, k, buff >> (32 - k) );
+      buff <<= k;
+      live -= k;
+   }
+}
+
+
+/*---------------------------------------------------*/
+/*-- Flush the last partial byte, as bsFinishWrite --*/
+/*-- does in compress.c.                            --*/
+static
+void bo_finish ( BitOut* bo )
+{
+   bo->bsLive = (bo->bsLive + 7) & ~7;
+   bo_drain ( bo );
+   bo_flush ( bo );
+}
+
+
+/*---------------------------------------------------*/
+typedef
+   struct {
+      BitOut* bo;
+      Int32   verbosity;
+      Int32   blockNo;
+      Int32   nBlocksRandomised;
+      UInt32  combinedCRC;
+   }
+   CState;
+
+
+/*---------------------------------------------------*/
+/*-- Write out a finished block.  This is the part  --*/
+/*-- of compressBlock that depends on the blocks    --*/
+/*-- before it.                                     --*/
+static
+Int32 putBlock ( CState* cs, Job* j )
+{
+   EState* s = j->strm.state;
+
+   cs->blockNo++;
+   cs->combinedCRC = (cs->combinedCRC << 1) | (cs->combinedCRC >> 31);
+   cs->combinedCRC ^= s->blockCRC;
+   if (cs->verbosity >= 2)
+      fprintf ( stderr, "    block %d: crc = 0x%8x, "
+                "combined CRC = 0x%8x, size = %d\n",
+                cs->blockNo, s->blockCRC, cs->combinedCRC, s->nblock );
+   if (s->blockRandomised) cs->nBlocksRandomised++;
+   bo_block ( cs->bo, s );
+   return cs->bo->err ? BZ_IO_ERROR : BZ_OK;
+}
+
+
+/*---------------------------------------------------*/
+static
+void compressJob ( Job* j )
+{
+   compressBlockAlone ( j->strm.state );
+}
+
+
+/*---------------------------------------------------*/
+static
+void compressFini ( Job* j )
+{
+   bzCompressEnd ( &j->strm );
+}
+
+
+/*---------------------------------------------------*/
+int compressStreamMT ( FILE* stream, FILE* zStream,
+                       int blockSize100k, int verbosity,
+                       int workFactor, int nThreads,
+                       unsigned int* nbytes_in,
+                       unsigned int* nbytes_out )
+{
+   Pool     pool;
+   CState   cs;
+   BitOut*  bo;
+   UChar*   ibuf;
+   Int32    nibuf, ipos, ret;
+   UInt32   total_in, in_ch;
+   Int32    in_len;
+   Job*     cur;
+   Job*     j;
+   EState*  s;
+   Bool     eof;
+
+   *nbytes_in  = 0;
+   *nbytes_out = 0;
+
+   bo   = malloc ( sizeof(BitOut) );
+   ibuf = malloc ( BZ_MT_IBUF );
+   if (bo == NULL || ibuf == NULL) {
+      if (bo != NULL) free ( bo );
+      if (ibuf != NULL) free ( ibuf );
+      return BZ_MEM_ERROR;
+   }
+   bo->f      = zStream;
+   bo->nbuf   = 0;
+   bo->bsBuff = 0;
+   bo->bsLive = 0;
+   bo->total  = 0;
+   bo->err    = False;
+
+   ret = pool_start ( &pool, nThreads, 2 * nThreads,
+                      compressJob, compressFini );
+   if (ret != BZ_OK) {
+      free ( ibuf );
+      free ( bo );
+      return ret;
+   }
+
+   cs.bo                = bo;
+   cs.verbosity         = verbosity;
+   cs.blockNo           = 0;
+   cs.nBlocksRandomised = 0;
+   cs.combinedCRC       = 0;
+
+   bo_bits ( bo, 8, 'B' );
+   bo_bits ( bo, 8, 'Z' );
+   bo_bits ( bo, 8, 'h' );
+   bo_bits ( bo, 8, '0' + blockSize100k );
+
+   total_in = 0;
+   in_ch    = 256;
+   in_len   = 0;
+   nibuf    = 0;
+   ipos     = 0;
+   eof      = False;
+   cur      = NULL;
+
+   while (True) {
+
+      /*-- Get a block to fill, writing out finished --*/
+      /*-- ones if every block is in use.            --*/
+      while (cur == NULL) {
+         cur = pool_take ( &pool );
+         if (cur != NULL) break;
+         j = pool_head ( &pool, True );
+         if (j == NULL) { ret = BZ_MEM_ERROR; goto out; }
+         ret = putBlock ( &cs, j );
+         pool_give ( &pool, j );
+         if (ret != BZ_OK) goto out;
+      }
+      if (cur->strm.state == NULL) {
+         ret = bzCompressInit ( &cur->strm, blockSize100k,
+                                0, workFactor );
+         if (ret != BZ_OK) {
+            cur->strm.state = NULL;
+            goto out;
+         }
+      } else {
+         prepare_new_block ( cur->strm.state );
+      }
+
+      /*-- the run in progress carries over --*/
+      s = cur->strm.state;
+      s->state_in_ch  = in_ch;
+      s->state_in_len = in_len;
+
+      /*-- Fill it.  bzWrite sends a block off as    --*/
+      /*-- soon as it is full, so do the same here.  --*/
+      while (s->nblock < s->nblockMAX) {
+         if (ipos == nibuf) {
+            nibuf = fread ( ibuf, 1, BZ_MT_IBUF, stream );
+            ipos = 0;
+            if (ferror(stream)) { ret = BZ_IO_ERROR; goto out; }
+            if (nibuf == 0) { eof = True; break; }
+            total_in += nibuf;
+         }
+         ipos += copy_buffer_to_block ( s, ibuf + ipos, nibuf - ipos );
+      }
+      if (eof) flush_RL ( s );
+
+      if (s->nblock > 0) {
+         BZ_FINALISE_CRC ( s->blockCRC );
+         in_ch  = s->state_in_ch;
+         in_len = s->state_in_len;
+         pool_submit ( &pool, cur );
+         cur = NULL;
+      }
+      if (eof) break;
+
+      /*-- write whatever is ready --*/
+      while ((j = pool_head ( &pool, False )) != NULL) {
+         ret = putBlock ( &cs, j );
+         pool_give ( &pool, j );
+         if (ret != BZ_OK) goto out;
+      }
+   }
+
+   while ((j = pool_head ( &pool, True )) != NULL) {
+      ret = putBlock ( &cs, j );
+      pool_give ( &pool, j );
+      if (ret != BZ_OK) goto out;
+   }
+
+   if (verbosity >= 2 && cs.nBlocksRandomised > 0)
+      fprintf ( stderr, "    %d block%s needed randomisation\n",
+                cs.nBlocksRandomised,
+                cs.nBlocksRandomised == 1 ? "" : "s" );
+
+   bo_bits ( bo, 8, 0x17 ); bo_bits ( bo, 8, 0x72 );
+   bo_bits ( bo, 8, 0x45 ); bo_bits ( bo, 8, 0x38 );
+   bo_bits ( bo, 8, 0x50 ); bo_bits ( bo, 8, 0x90 );
+   bo_uint32 ( bo, cs.combinedCRC );
+   if (verbosity >= 2)
+      fprintf ( stderr, "    final combined CRC = 0x%x\n   ",
+                cs.combinedCRC );
+   bo_finish ( bo );
+   if (bo->err) { ret = BZ_IO_ERROR; goto out; }
+
+   *nbytes_in  = total_in;
+   *nbytes_out = bo->total;
+   ret = BZ_OK;
+
+   out:
+   pool_stop ( &pool );
+   free ( ibuf );
+   free ( bo );
+   return ret;
+}
+
+
+/*---------------------------------------------------*/
+/*--- Decompression                               ---*/
+/*---------------------------------------------------*/
+
+#define BZ_BLOCK_MAGIC 0x314159265359ULL
+
+/*-- The most input one block can take: every MTF  --*/
+/*-- value at the longest code length, plus room   --*/
+/*-- for the header, selectors and coding tables.   --*/
+#define BZ_MT_ZBUF_MAX (((900000 + 2) * 20) / 8 + 65536)
+
+#define BZ_MT_READ 1048576
+
+static UChar eosMagic[6] = { 0x17, 0x72, 0x45, 0x38, 0x50, 0x90 };
+
+
+/*---------------------------------------------------*/
+/*-- A window on the compressed input.  Positions   --*/
+/*-- are absolute byte offsets from the start of    --*/
+/*-- the file.                                      --*/
+typedef
+   struct {
+      FILE*  f;
+      UChar* buf;
+      Int32  size;
+      Int32  len;
+      UInt64 base;
+      Bool   eof;
+      Bool   err;
+   }
+   Window;
+
+
+/*---------------------------------------------------*/
+/*-- Make sure bytes up to upto are in the window,  --*/
+/*-- dropping any before keep.  False if the file   --*/
+/*-- ends first.                                    --*/
+static
+Bool win_fill ( Window* w, UInt64 upto, UInt64 keep )
+{
+   Int32  n;
+   UChar* nbuf;
+
+   while (w->base + w->len < upto) {
+      if (w->eof) return False;
+      if (keep > w->base) {
+         n = (keep - w->base > (UInt64)w->len) ? w->len 
+                                              : (Int32)(keep - w->base);
+         memmove ( w->buf, w->buf + n, w->len - n );
+         w->len -= n;
+         w->base += n;
+      }
+      if (w->size - w->len < BZ_MT_READ) {
+         nbuf = realloc ( w->buf, w->len + BZ_MT_READ );
+         if (nbuf == NULL) { w->err = True; w->eof = True; return False; }
+         w->buf  = nbuf;
+         w->size = w->len + BZ_MT_READ;
+      }
+      n = fread ( w->buf + w->len, 1, w->size - w->len, w->f );
+      if (n <= 0) {
+         if (ferror(w->f)) w->err = True;
+         w->eof = True;
+      }
+      else
+         w->len += n;
+   }
+   return True;
+}
+
+
+/*---------------------------------------------------*/
+/*-- The byte starting at bit position b; both      --*/
+/*-- bytes it straddles must be in the window.      --*/
+static
+UChar win_byte ( Window* w, UInt64 b )
+{
+   UChar* p = w->buf + (b / 8 - w->base);
+   Int32  k = b & 7;
+   if (k == 0) return p[0];
+   return (UChar)((p[0] << k) | (p[1] >> (8 - k)));
+}
+
+
+/*---------------------------------------------------*/
+/*-- Finds the block magic at any bit position.     --*/
+/*-- Every start position below done has been       --*/
+/*-- checked.                                       --*/
+typedef
+   struct {
+      UInt64 reg;
+      Int32  regBits;
+      UInt64 next;            /* next byte to shift in     */
+      Int32  k;               /* next shift to try, or -1 */
+      UInt64 done;
+      Bool   eof;
+   }
+   Scan;
+
+
+/*---------------------------------------------------*/
+/*-- Skip forward to bit position b.                --*/
+static
+void scan_seek ( Scan* sc, UInt64 b )
+{
+   if (sc->done >= b) return;
+   sc->reg     = 0;
+   sc->regBits = 0;
+   sc->next    = b / 8;
+   sc->k       = -1;
+   sc->done    = b;
+   sc->eof     = False;
+}
+
+
+/*---------------------------------------------------*/
+/*-- 1 and the position of the next hit, 0 if there --*/
+/*-- are none before the end of the file or before  --*/
+/*-- byte limit, -1 on a read error.                --*/
+static
+Int32 scan_next ( Scan* sc, Window* w, UInt64 limit, UInt64 keep,
+                  UInt64* start )
+{
+   UInt64 st;
+   Int32  k;
+
+   while (True) {
+      while (sc->k >= 0) {
+         k = sc->k--;
+         if (sc->regBits < 48 + k) continue;
+         st = sc->next * 8 - 48 - k;
+         if (st < sc->done) continue;
+         sc->done = st + 1;
+         if (((sc->reg >> k) & 0xffffffffffffULL) == BZ_BLOCK_MAGIC) {
+            *start = st;
+            return 1;
+         }
+      }
+      if (sc->next >= limit) return 0;
+      if (!win_fill ( w, sc->next + 1, keep )) {
+         if (w->err) return -1;
+         sc->eof = True;
+         return 0;
+      }
+      sc->reg = (sc->reg << 8) | w->buf[sc->next - w->base];
+      sc->next++;
+      sc->regBits = (sc->regBits >= 56) ? 64 : sc->regBits + 8;
+      sc->k = 7;
+   }
+}
+
+
+/*---------------------------------------------------*/
+static
+Int32 growBuf ( UChar** buf, Int32* size, Int32 need )
+{
+   UChar* nbuf;
+   Int32  n = *size;
+
+   if (need <= n) return BZ_OK;
+   if (n < 65536) n = 65536;
+   while (n < need) n *= 2;
+   nbuf = realloc ( *buf, n );
+   if (nbuf == NULL) return BZ_MEM_ERROR;
+   *buf  = nbuf;
+   *size = n;
+   return BZ_OK;
+}
+
+
+/*---------------------------------------------------*/
+/*-- Decode the block whose magic starts at bit     --*/
+/*-- j->start.  The DState is set up once per job   --*/
+/*-- by feeding it a 900k stream header, then put   --*/
+/*-- back to the block header state for each block; --*/
+/*-- the size limit for the real stream is checked  --*/
+/*-- when the block is used.                        --*/
+static
+void decompressJob ( Job* j )
+{
+   bz_stream* strm = &j->strm;
+   DState*    s;
+   Int32      zbit = j->start & 7;
+   Int32      ret;
+
+   if (strm->state == NULL) {
+      ret = bzDecompressInit ( strm, 0, 0 );
+      if (ret != BZ_OK) { strm->state = NULL; j->ret = ret; return; }
+      strm->next_in  = "BZh9";
+      strm->avail_in = 4;
+      ret = decompress ( strm->state );
+      s = strm->state;
+      if (s->state != BZ_X_BLKHDR_1) {
+         bzDecompressEnd ( strm );
+         strm->state = NULL;
+         j->ret = (ret == BZ_OK) ? BZ_MEM_ERROR : ret;
+         return;
+      }
+   }
+
+   s = strm->state;
+   s->state  = BZ_X_BLKHDR_1;
+   s->bsBuff = 0;
+   s->bsLive = 0;
+   strm->next_in  = (char*)j->zbuf;
+   strm->avail_in = j->nzbuf;
+   if (zbit != 0) {
+      s->bsBuff = j->zbuf[0];
+      s->bsLive = 8 - zbit;
+      strm->next_in++;
+      strm->avail_in--;
+   }
+
+   ret = decompress ( s );
+   if (s->state != BZ_X_OUTPUT) {
+      j->ret = (ret == BZ_OK) ? BZ_UNEXPECTED_EOF : ret;
+      return;
+   }
+   j->end = j->start - zbit
+            + (UInt64)((UChar*)strm->next_in - j->zbuf) * 8 - s->bsLive;
+   j->blockCRC = s->storedBlockCRC;
+   j->nblock   = s->save_nblock;
+
+   /*-- Nothing more to read; don't let bzDecompress --*/
+   /*-- start on the next block header.             --*/
+   s->bsLive = 0;
+   strm->avail_in = 0;
+
+   j->nobuf = 0;
+   while (True) {
+      if (j->nobuf == j->obufSize) {
+         ret = growBuf ( &j->obuf, &j->obufSize, j->nobuf + 1 );
+         if (ret != BZ_OK) { j->ret = ret; return; }
+      }
+      strm->next_out  = (char*)(j->obuf + j->nobuf);
+      strm->avail_out = j->obufSize - j->nobuf;
+      ret = bzDecompress ( strm );
+      j->nobuf = j->obufSize - strm->avail_out;
+      if (ret != BZ_OK) { j->ret = ret; return; }
+      if (s->state == BZ_X_BLKHDR_1) break;
+   }
+   j->ret = BZ_OK;
+}
+
+
+/*---------------------------------------------------*/
+static
+void decompressFini ( Job* j )
+{
+   bzDecompressEnd ( &j->strm );
+}
+
+
+/*---------------------------------------------------*/
+int uncompressStreamMT ( FILE* zStream, FILE* stream,
+                         int verbosity, int nThreads,
+                         int* streamNo )
+{
+   Pool    pool;
+   Window  w;
+   Scan    sc;
+   Job*    j;
+   UInt64  pos, expected, start, keep, limit;
+   UInt32  combinedCRC, storedCRC;
+   Int32   ret, r, i, n, blockSize100k, blockNo;
+   UChar   uc;
+
+   *streamNo = 0;
+
+   ret = pool_start ( &pool, nThreads, 2 * nThreads,
+                      decompressJob, decompressFini );
+   if (ret != BZ_OK) return ret;
+
+   w.f    = zStream;
+   w.buf  = NULL;
+   w.size = 0;
+   w.len  = 0;
+   w.base = 0;
+   w.eof  = False;
+   w.err  = False;
+
+   sc.reg     = 0;
+   sc.regBits = 0;
+   sc.next    = 0;
+   sc.k       = -1;
+   sc.done    = 0;
+   sc.eof     = False;
+
+   pos      = 0;
+   expected = 0;
+
+   while (True) {
+
+      /*-- The stream header; stop at the first byte --*/
+      /*-- that is wrong, as decompress does.        --*/
+      (*streamNo)++;
+      keep = pos;
+      for (i = 0; i < 4; i++) {
+         if (!win_fill ( &w, pos + i + 1, keep )) {
+            ret = w.err ? BZ_IO_ERROR : BZ_UNEXPECTED_EOF;
+            goto out;
+         }
+         uc = w.buf[pos + i - w.base];
+         if ((i == 0 && uc != 'B') ||
+             (i == 1 && uc != 'Z') ||
+             (i == 2 && uc != 'h') ||
+             (i == 3 && (uc < '1' || uc > '9'))) {
+            ret = BZ_DATA_ERROR_MAGIC;
+            goto out;
+         }
+      }
+      blockSize100k = uc - '0';
+      expected      = (pos + 4) * 8;
+      combinedCRC   = 0;
+      blockNo       = 0;
+      scan_seek ( &sc, expected );
+
+      /*-- The blocks --*/
+      while (True) {
+         keep  = expected / 8;
+         if (sc.next < keep + 8) keep = (sc.next > 8) ? sc.next - 8 : 0;
+         limit = expected / 8 + (UInt64)(pool.maxjobs + 1) * BZ_MT_ZBUF_MAX;
+
+         /*-- start on as many hits as there is room for --*/
+         while ((j = pool_take ( &pool )) != NULL) {
+            r = scan_next ( &sc, &w, limit, keep, &start );
+            if (r <= 0) {
+               pool_give ( &pool, j );
+               if (r < 0) { ret = BZ_IO_ERROR; goto out; }
+               break;
+            }
+            win_fill ( &w, start / 8 + BZ_MT_ZBUF_MAX, keep );
+            if (w.err) { pool_give ( &pool, j ); ret = BZ_IO_ERROR; goto out; }
+            n = (Int32)(w.base + w.len - start / 8);
+            if (n > BZ_MT_ZBUF_MAX) n = BZ_MT_ZBUF_MAX;
+            ret = growBuf ( &j->zbuf, &j->zbufSize, n );
+            if (ret != BZ_OK) { pool_give ( &pool, j ); goto out; }
+            memcpy ( j->zbuf, w.buf + (start / 8 - w.base), n );
+            j->nzbuf = n;
+            j->start = start;
+            pool_submit ( &pool, j );
+         }
+
+         j = pool.pending;
+         if (j != NULL && j->start < expected) {
+            /*-- inside a block already done --*/
+            j = pool_head ( &pool, True );
+            pool_give ( &pool, j );
+            continue;
+         }
+         if (j == NULL && sc.done <= expected && !sc.eof) {
+            /*-- couldn't get a job to look any further --*/
+            ret = BZ_MEM_ERROR;
+            goto out;
+         }
+         if (j == NULL || j->start > expected) {
+            /*-- Nothing was found where the last block --*/
+            /*-- ended, so it should be the trailer.     --*/
+            break;
+         }
+
+         j = pool_head ( &pool, True );
+         ret = j->ret;
+         if (ret == BZ_OK && j->nblock > 100000 * blockSize100k)
+            ret = BZ_DATA_ERROR;
+         if (ret != BZ_OK) { pool_give ( &pool, j ); goto out; }
+
+         blockNo++;
+         if (verbosity >= 2)
+            fprintf ( stderr, "\n    [%d: huff+mtf rt+rld", blockNo );
+         if (verbosity >= 3)
+            fprintf ( stderr, " {0x%x, 0x%x}", j->blockCRC, j->blockCRC );
+         if (verbosity >= 2) fprintf ( stderr, "]" );
+
+         combinedCRC = (combinedCRC << 1) | (combinedCRC >> 31);
+         combinedCRC ^= j->blockCRC;
+
+         if (stream != NULL && j->nobuf > 0 &&
+             fwrite ( j->obuf, 1, j->nobuf, stream ) != (size_t)j->nobuf) {
+            pool_give ( &pool, j );
+            ret = BZ_IO_ERROR;
+            goto out;
+         }
+         expected = j->end;
+         scan_seek ( &sc, expected );
+         pool_give ( &pool, j );
+      }
+
+      /*-- The trailer: magic and combined CRC. --*/
+      keep = expected / 8;
+      storedCRC = 0;
+      for (i = 0; i < 10; i++) {
+         if (!win_fill ( &w, (expected + 8 * i + 15) / 8, keep )) {
+            ret = w.err ? BZ_IO_ERROR : BZ_UNEXPECTED_EOF;
+            goto out;
+         }
+         uc = win_byte ( &w, expected + 8 * i );
+         if (i < 6) {
+            if (uc != eosMagic[i]) {
+               ret = BZ_DATA_ERROR;
+               goto out;
+            }
+         } else
+            storedCRC = (storedCRC << 8) | uc;
+      }
+      if (verbosity >= 3)
+         fprintf ( stderr, 
+                   "\n    combined CRCs: stored = 0x%x, computed = 0x%x", 
+                   storedCRC, combinedCRC );
+      if (storedCRC != combinedCRC) { ret = BZ_DATA_ERROR; goto out; }
+
+      /*-- Streams end on a byte boundary.  Another   --*/
+      /*-- one may follow.                            --*/
+      pos = (expected + 80 + 7) / 8;
+      if (!win_fill ( &w, pos + 1, pos )) {
+         ret = w.err ? BZ_IO_ERROR : BZ_OK;
+         goto out;
+      }
+   }
+
+   out:
+   pool_stop ( &pool );
+   if (w.buf != NULL) free ( w.buf );
+   return ret;
+}
+
+
+/*-------------------------------------------------------------*/
+/*--- end                                       bzthreads.c ---*/
+/*-------------------------------------------------------------*/
@@ -0,0 +1,48 @@
+/*-------------------------------------------------------------*/
+/*--- Multi-threaded stream compression and decompression   ---*/
+/*---                                           bzthreads.h ---*/
+/*-------------------------------------------------------------*/
+
+/*--
+  This file is a part of the QNX modified version of bzip2; it is
+  not part of Julian Seward's bzip2-0.9.0 distribution.  It is
+  distributed under the same terms as the rest of bzip2, see the
+  LICENSE file.
+--*/
+
+#ifndef _BZTHREADS_H
+#define _BZTHREADS_H
+
+#include <stdio.h>
+
+/*-- Upper limit on --threads. --*/
+#define BZ_MAX_THREADS 64
+
+/*--
+   Both return one of the BZ_ codes from bzlib.h.
+
+   compressStreamMT writes exactly the same bytes as the
+   serial bzWrite path would for the same block size and
+   work factor.
+
+   uncompressStreamMT handles concatenated streams the way
+   uncompressStream does; *streamNo is the number of the
+   stream being read when it returned, so a bad magic number
+   on a stream after the first means trailing garbage.  If
+   stream is NULL the data is checked and thrown away.
+--*/
+extern int compressStreamMT   ( FILE* stream, FILE* zStream,
+                                int blockSize100k, int verbosity,
+                                int workFactor, int nThreads,
+                                unsigned int* nbytes_in,
+                                unsigned int* nbytes_out );
+
+extern int uncompressStreamMT ( FILE* zStream, FILE* stream,
+                                int verbosity, int nThreads,
+                                int* streamNo );
+
+#endif
+
+/*-------------------------------------------------------------*/
+/*--- end                                       bzthreads.h ---*/
+/*-------------------------------------------------------------*/
@@ -504,6 +504,46 @@ void sendMTFValues ( EState* s )
 }
 
 
+/*---------------------------------------------------*/
+static
+void writeBlock ( EState* s )
+{
+   bsPutUChar ( s, 0x31 ); bsPutUChar ( s, 0x41 );
+   bsPutUChar ( s, 0x59 ); bsPutUChar ( s, 0x26 );
+   bsPutUChar ( s, 0x53 ); bsPutUChar ( s, 0x59 );
+
+   /*-- Now the block's CRC, so it is in a known place. --*/
+   bsPutUInt32 ( s, s->blockCRC );
+
+   /*-- Now a single bit indicating randomisation. --*/
+   if (s->blockRandomised) {
+      bsW(s,1,1); s->nBlocksRandomised++;
+   } else
+      bsW(s,1,0);
+
+   bsW ( s, 24, s->origPtr );
+   generateMTFValues ( s );
+   sendMTFValues ( s );
+}
+
+
+/*---------------------------------------------------*/
+/*-- Sort and code one non-empty block on its own,  --*/
+/*-- starting at bit 0 of the output and with no    --*/
+/*-- stream header or trailer.  blockCRC must have  --*/
+/*-- been finalised already.  The caller (the       --*/
+/*-- threaded compressor in bzthreads.c) takes the  --*/
+/*-- numZ bytes at quadrant plus the bsLive bits    --*/
+/*-- left in bsBuff, and chains them to the stream. --*/
+void compressBlockAlone ( EState* s )
+{
+   blockSort ( s );
+   bsInitWrite ( s );
+   s->numZ = 0;
+   writeBlock ( s );
+}
+
+
 /*---------------------------------------------------*/
 void compressBlock ( EState* s, Bool is_last_block )
 {
@@ -531,25 +571,7 @@ void compressBlock ( EState* s, Bool is_last_block )
       bsPutUChar ( s, '0' + s->blockSize100k );
    }
 
-   if (s->nblock > 0) {
-
-      bsPutUChar ( s, 0x31 ); bsPutUChar ( s, 0x41 );
-      bsPutUChar ( s, 0x59 ); bsPutUChar ( s, 0x26 );
-      bsPutUChar ( s, 0x53 ); bsPutUChar ( s, 0x59 );
-
-      /*-- Now the block's CRC, so it is in a known place. --*/
-      bsPutUInt32 ( s, s->blockCRC );
-
-      /*-- Now a single bit indicating randomisation. --*/
-      if (s->blockRandomised) {
-         bsW(s,1,1); s->nBlocksRandomised++;
-      } else
-         bsW(s,1,0);
-
-      bsW ( s, 24, s->origPtr );
-      generateMTFValues ( s );
-      sendMTFValues ( s );
-   }
+   if (s->nblock > 0) writeBlock ( s );
 
 
    /*-- If this is the last block, add the stream trailer. --*/
@@ -0,0 +1,319 @@
+/*-------------------------------------------------------------*/
+/*--- Block sorting by suffix array construction            ---*/
+/*---                                                sais.c ---*/
+/*-------------------------------------------------------------*/
+
+/*--
+  This file is a part of the QNX modified version of bzip2; it is
+  not part of Julian Seward's bzip2-0.9.0 distribution.  It is
+  distributed under the same terms as the rest of bzip2, see the
+  LICENSE file.
+
+  sortMain() in blocksort.c compares rotations character by
+  character, so its cost grows with the length of the common
+  prefixes in the block.  On very repetitive blocks it gives up
+  after workFactor * nblock steps and the block is randomised
+  and sorted again, which is slow and compresses worse.
+
+  saisSort() produces the same sorted rotations in time linear
+  in nblock whatever the data, using induced sorting (SA-IS,
+  Nong, Zhang and Chan, "Two Efficient Algorithms for Linear
+  Time Suffix Array Construction", 2009).
+
+  A suffix array orders suffixes, not rotations, but the two
+  orders agree for a Lyndon word: a string that is strictly
+  smaller than all of its other rotations.  So the block is
+  first rotated to start at its least rotation.  If the block
+  is a power of a shorter string (period p), only that root is
+  sorted; the rotations at i, i+p, i+2p, ... are identical, so
+  they are given consecutive places in ascending order.  sortMain
+  breaks such ties some other way, but identical rotations
+  produce the same output symbol, so only origPtr can differ,
+  and the block decodes the same either way.
+
+  Memory: the suffix array is built in zptr (nblock+1 entries
+  fit since nblock <= nblockMAX) and the rotated text, shifted
+  up by one to make room for a sentinel of 0, goes in quadrant.
+  The only allocations are a bit vector of nblock/8 bytes and a
+  few bucket tables.
+--*/
+
+
+#include "bzlib_private.h"
+
+
+/*---------------------------------------------*/
+/*--
+   The text at level 0 is UInt16, in the reduced problems
+   it is Int32 names.  t holds one bit per position,
+   1 for S-type (smaller than the suffix after it).
+--*/
+#define CHR(i)    (cs == sizeof(Int32) ? ((Int32*)txt)[i] \
+                                       : (Int32)(((UInt16*)txt)[i]))
+#define TGET(i)   ((t[(i) >> 3] >> ((i) & 7)) & 1)
+#define TSET(i)   (t[(i) >> 3] |= (UChar)(1 << ((i) & 7)))
+#define ISLMS(i)  ((i) > 0 && TGET(i) && !TGET((i)-1))
+
+
+static void getBuckets ( void* txt, Int32* bkt, Int32 n, Int32 K,
+                         Int32 cs, Bool end )
+{
+   Int32 i, sum = 0;
+
+   for (i = 0; i <= K; i++) bkt[i] = 0;
+   for (i = 0; i < n; i++) bkt[CHR(i)]++;
+   for (i = 0; i <= K; i++) {
+      sum += bkt[i];
+      bkt[i] = end ? sum : sum - bkt[i];
+   }
+}
+
+
+static void induceL ( UChar* t, Int32* SA, void* txt, Int32* bkt,
+                      Int32 n, Int32 K, Int32 cs )
+{
+   Int32 i, j;
+
+   getBuckets ( txt, bkt, n, K, cs, False );
+   for (i = 0; i < n; i++) {
+      j = SA[i] - 1;
+      if (j >= 0 && !TGET(j)) SA[bkt[CHR(j)]++] = j;
+   }
+}
+
+
+static void induceS ( UChar* t, Int32* SA, void* txt, Int32* bkt,
+                      Int32 n, Int32 K, Int32 cs )
+{
+   Int32 i, j;
+
+   getBuckets ( txt, bkt, n, K, cs, True );
+   for (i = n-1; i >= 0; i--) {
+      j = SA[i] - 1;
+      if (j >= 0 && TGET(j)) SA[--bkt[CHR(j)]] = j;
+   }
+}
+
+
+/*--
+   Suffix array of txt[0 .. n-1] into SA[0 .. n-1].  The last
+   character must be a unique 0 and the others in 1 .. K.
+   Returns False if it runs out of memory.
+--*/
+static Bool sais ( bz_stream* strm, void* txt, Int32* SA,
+                   Int32 n, Int32 K, Int32 cs )
+{
+   Int32  i, j, d, n1, name, prev, pos;
+   Int32* bkt;
+   Int32* s1;
+   UChar* t;
+   Bool   diff;
+
+   t = BZALLOC( n / 8 + 1 );
+   if (t == NULL) return False;
+   bkt = BZALLOC( (K + 1) * sizeof(Int32) );
+   if (bkt == NULL) { BZFREE(t); return False; }
+
+   /*-- classify; the sentinel is S, the char before it L --*/
+   for (i = 0; i < n / 8 + 1; i++) t[i] = 0;
+   TSET(n-1);
+   for (i = n-3; i >= 0; i--)
+      if (CHR(i) < CHR(i+1) || (CHR(i) == CHR(i+1) && TGET(i+1)))
+         TSET(i);
+
+   /*-- stage 1: sort the LMS substrings --*/
+   getBuckets ( txt, bkt, n, K, cs, True );
+   for (i = 0; i < n; i++) SA[i] = -1;
+   for (i = 1; i < n; i++)
+      if (ISLMS(i)) SA[--bkt[CHR(i)]] = i;
+   induceL ( t, SA, txt, bkt, n, K, cs );
+   induceS ( t, SA, txt, bkt, n, K, cs );
+   BZFREE(bkt);
+
+   /*-- compact the sorted LMS substrings into SA[0 .. n1-1] --*/
+   n1 = 0;
+   for (i = 0; i < n; i++)
+      if (ISLMS(SA[i])) SA[n1++] = SA[i];
+
+   /*-- name them; equal substrings get equal names --*/
+   for (i = n1; i < n; i++) SA[i] = -1;
+   name = 0;
+   prev = -1;
+   for (i = 0; i < n1; i++) {
+      pos  = SA[i];
+      diff = False;
+      for (d = 0; d < n; d++) {
+         if (prev == -1 || CHR(pos+d) != CHR(prev+d) ||
+             TGET(pos+d) != TGET(prev+d)) {
+            diff = True;
+            break;
+         }
+         if (d > 0 && (ISLMS(pos+d) || ISLMS(prev+d))) break;
+      }
+      if (diff) { name++; prev = pos; }
+      SA[n1 + (pos >> 1)] = name - 1;
+   }
+   for (i = n-1, j = n-1; i >= n1; i--)
+      if (SA[i] >= 0) SA[j--] = SA[i];
+
+   /*-- stage 2: sort the reduced problem, recursing if needed --*/
+   s1 = SA + n - n1;
+   if (name < n1) {
+      if (!sais ( strm, s1, SA, n1, name-1, sizeof(Int32) )) {
+         BZFREE(t);
+         return False;
+      }
+   } else {
+      for (i = 0; i < n1; i++) SA[s1[i]] = i;
+   }
+
+   /*-- stage 3: induce the full order from the sorted LMS suffixes --*/
+   bkt = BZALLOC( (K + 1) * sizeof(Int32) );
+   if (bkt == NULL) { BZFREE(t); return False; }
+   getBuckets ( txt, bkt, n, K, cs, True );
+   for (i = 1, j = 0; i < n; i++)
+      if (ISLMS(i)) s1[j++] = i;
+   for (i = 0; i < n1; i++) SA[i] = s1[SA[i]];
+   for (i = n1; i < n; i++) SA[i] = -1;
+   for (i = n1-1; i >= 0; i--) {
+      j = SA[i];
+      SA[i] = -1;
+      SA[--bkt[CHR(j)]] = j;
+   }
+   induceL ( t, SA, txt, bkt, n, K, cs );
+   induceS ( t, SA, txt, bkt, n, K, cs );
+
+   BZFREE(bkt);
+   BZFREE(t);
+   return True;
+}
+
+#undef CHR
+#undef TGET
+#undef TSET
+#undef ISLMS
+
+
+/*---------------------------------------------*/
+/*--
+   True if shifting block[0 .. n-1] round by q leaves it
+   unchanged.
+--*/
+static Bool isPeriod ( UChar* block, Int32 n, Int32 q )
+{
+   Int32 i;
+
+   for (i = 0; i + q < n; i++)
+      if (block[i] != block[i+q]) return False;
+   return True;
+}
+
+
+/*--
+   Rotating the block by d leaves it unchanged, so rotating
+   by gcd(d, n) does too, and the shortest such rotation
+   divides that.  Strip prime factors while what is left is
+   still a period.
+--*/
+static Int32 shortestPeriod ( UChar* block, Int32 n, Int32 d )
+{
+   Int32 f, q, a, b;
+
+   a = n; b = d;
+   while (b != 0) { f = a % b; a = b; b = f; }
+   d = q = a;
+
+   for (f = 2; f <= d; f++) {
+      if (d % f != 0) continue;
+      while (q % f == 0 && isPeriod ( block, n, q / f )) q /= f;
+      while (d % f == 0) d /= f;
+   }
+   return q;
+}
+
+
+/*--
+   Start of the least rotation of block[0 .. n-1], and its
+   period: n if the block is primitive, else the length of
+   the shortest root it is a power of.
+--*/
+static Int32 leastRotation ( UChar* block, Int32 n, Int32* period )
+{
+   Int32 i = 0, j = 1, k = 0, a, b;
+
+   while (i < n && j < n && k < n) {
+      a = i + k; if (a >= n) a -= n;
+      b = j + k; if (b >= n) b -= n;
+      if (block[a] == block[b]) { k++; continue; }
+      if (block[a] > block[b]) i += k + 1; else j += k + 1;
+      if (i == j) j++;
+      k = 0;
+   }
+
+   if (k >= n) {
+      *period = shortestPeriod ( block, n, (i < j) ? j - i : i - j );
+      return ((i < j) ? i : j) % *period;
+   }
+   *period = n;
+   return (i < j) ? i : j;
+}
+
+
+/*---------------------------------------------*/
+/*--
+   Fill zptr[0 .. nblock-1] with the sorted rotations of
+   block[0 .. nblock-1].  Returns False, leaving the block
+   as it was, if there isn't enough memory.
+--*/
+Bool saisSort ( EState* s )
+{
+   Int32   i, k, r, p, m, x;
+   UChar*  block   = s->block;
+   UInt16* txt     = s->quadrant;
+   Int32*  SA      = (Int32*)(s->zptr);
+   Int32   nblock  = s->nblock;
+
+   if (s->verbosity >= 4)
+      VPrintf0( "        suffix sorting ...\n" );
+
+   r = leastRotation ( block, nblock, &p );
+   m = nblock / p;
+
+   x = r;
+   for (i = 0; i < p; i++) {
+      txt[i] = (UInt16)block[x] + 1;
+      x++; if (x >= nblock) x -= nblock;
+   }
+   txt[p] = 0;
+
+   if (!sais ( s->strm, txt, SA, p + 1, 256, sizeof(UInt16) ))
+      return False;
+
+   /*--
+      SA[0] is the sentinel.  Map each root suffix back to
+      its m positions in the block.  The output overlaps the
+      suffix array, so it must never overtake the entries not
+      yet read: work up if each entry moves down by one, and
+      down if each one spreads over m >= 2 places.
+   --*/
+   if (m == 1) {
+      for (k = 1; k <= p; k++) {
+         x = SA[k] + r; if (x >= p) x -= p;
+         s->zptr[k-1] = x;
+      }
+   } else {
+      for (k = p; k >= 1; k--) {
+         x = SA[k] + r; if (x >= p) x -= p;
+         for (i = m-1; i >= 0; i--)
+            s->zptr[(k-1) * m + i] = x + i * p;
+      }
+   }
+
+   if (s->verbosity >= 4)
+      VPrintf2( "        %d rotations, period %d\n", nblock, p );
+   return True;
+}
+
+/*-------------------------------------------------------------*/
+/*--- end                                            sais.c ---*/
+/*-------------------------------------------------------------*/
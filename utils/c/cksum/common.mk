@@ -9,7 +9,7 @@ define PINFO
 PINFO DESCRIPTION=calculate checksum on file
 endef
 
-LIBS = compat
+LIBS = compat util
 
 USEFILE=$(PROJECT_ROOT)/$(NAME).c
 
@@ -262,6 +262,17 @@ static void swap_procfs_status(procfs_status *status) {
 	swap_64(&status->sutime);			 
 }
 
+static void swap_core_mapref(core_mapref *ref) {
+	swap_64(&ref->vaddr);
+	swap_64(&ref->size);
+	swap_64(&ref->offset);
+	swap_64(&ref->link_vaddr);
+	swap_64(&ref->fsize);
+	swap_32(&ref->mtime);
+	swap_16(&ref->idsz);
+	swap_16(&ref->pathsz);
+}
+
 static void swap_procfs_greg(procfs_greg *greg, int cpu) {
 	fprintf(stderr, "byteswapping of gpregs not supported yet\n");
 }
@@ -673,6 +684,25 @@ dsp_adr:
 	}
 }
 
+static void print_mapref(core_mapref *p, unsigned size) {
+	unsigned char			*id = (unsigned char *)(p + 1);
+	int						i;
+
+	if(sizeof *p + p->idsz + p->pathsz > size || p->pathsz == 0) {
+		return;
+	}
+	printf(" Reference %#.8llx-%#.8llx offset %#llx in %s\n",
+		p->vaddr, p->vaddr + p->size, p->offset, (char *)id + p->idsz);
+	printf("  link_vaddr=%#llx size=%lld mtime=%u", p->link_vaddr, p->fsize, p->mtime);
+	if(p->idsz) {
+		printf(" build-id=");
+		for(i = 0; i < p->idsz; i++) {
+			printf("%02x", id[i]);
+		}
+	}
+	printf("\n");
+}
+
 #endif
 
 static void print_pt_load(FILE *fp, Elf32_Phdr *phdr) {
@@ -799,6 +829,7 @@ static void dsp_file(FILE *fp, char *name) {
 									procfs_status			status;
 									procfs_greg				greg;
 									procfs_fpreg			fpreg;
+									core_mapref				mapref;
 								}						*p = (void *)(nhdr + 1) + nhdr->n_namesz;
 
 								switch(nhdr->n_type) {
@@ -839,6 +870,13 @@ static void dsp_file(FILE *fp, char *name) {
 									}
 									break;
 
+								case QNT_CORE_MAPREF:
+									if(xlat) {
+										swap_core_mapref(&p->mapref);
+									}
+									print_mapref(&p->mapref, nhdr->n_descsz);
+									break;
+
 								default:
 									break;
 								}
@@ -181,7 +181,7 @@ POSIX UTILITY: CP
 #endif
 
 #include <util/stdutil.h>
-#include <util/stat_optimiz.h>
+#include <util/walkdir.h>
 
 #ifndef __QNXNTO__
 
@@ -659,13 +659,14 @@ char __far *_qnx_fullpath(char *fullpath, char *path, size_t pathsize) {
 #endif
 }
 
-DIR *_opendir(const char *dirname) {
+/* the entries come back with their lstat info, stat'ed a batch at a time */
+walkdir_t *_opendir(const char *dirname) {
 	if (wildly_verbose) fprintf(stderr,"cp: OPENDIR(%s)\n",dirname);
-	return(opendir(dirname));
+	return(walkdir_open(dirname,0));
 }
-int _closedir(DIR *dirp) {
+int _closedir(walkdir_t *dirp) {
 	if (wildly_verbose) fprintf(stderr,"cp: CLOSEDIR(dirp)\n");
-	return(closedir(dirp));
+	return(walkdir_close(dirp));
 }
 int _close(int fildes) {
 	if (fildes != fileno(stdin)) {
@@ -1740,8 +1741,8 @@ void copy_directory_recursive(src,dst,dstsize)
 char *src,*dst;
 size_t dstsize;
 {
-	DIR *dirp;
-	struct dirent *entry;
+	walkdir_t *dirp;
+	struct walkdir_ent *entry;
 	static int16_t slashesadded = 0;
 	struct utimbuf dirtimes;
 
@@ -1763,16 +1764,14 @@ size_t dstsize;
 		return;
 	}
 
-	while ((errno=0,entry=readdir(dirp)) && !abort_flag) {
+	while ((errno=0,entry=walkdir_read(dirp)) && !abort_flag) {
 		statbufsrc_valid = statbufdst_valid = FALSE;
 		lstatbufsrc_valid = lstatbufdst_valid = FALSE;
 
-		if (entry->d_name[0] == '.') {	/* skip . and .. */
-			if (!entry->d_name[1]) continue;
-			if ((entry->d_name[1]=='.') && (!entry->d_name[2])) continue;
+		if (entry->name[0] == '.') {	/* . and .. don't come back */
 			/* abc do I need this any more? */
-			if (equal(entry->d_name,".bitmap") || equal(entry->d_name,".inodes")) {
-				if (super_verbose) fprintf(stdout,TXT(T_SKIPPING2),purty(src),entry->d_name);
+			if (equal(entry->name,".bitmap") || equal(entry->name,".inodes")) {
+				if (super_verbose) fprintf(stdout,TXT(T_SKIPPING2),purty(src),entry->name);
 				continue;
 			}
 		}
@@ -1782,10 +1781,13 @@ size_t dstsize;
 			slashesadded++;
 		}
 
-		strcat(src,entry->d_name);
+		strcat(src,entry->name);
 
-		if (-1!=lstat_optimize(entry, &lstatbufsrc)) lstatbufsrc_valid = TRUE;
-		else lstatbufsrc_valid = FALSE;
+		/* if the lstat failed, _statsrc() will try again */
+		if (entry->err == 0) {
+			lstatbufsrc = entry->st;
+			lstatbufsrc_valid = TRUE;
+		} else lstatbufsrc_valid = FALSE;
 
 		if (_statsrc(src)==-1) {
 			prerror(twostrpar,TXT(T_STAT_FAILED),src);
@@ -1818,10 +1820,10 @@ size_t dstsize;
 
 		if (S_ISDIR(lstatbufsrc.st_mode)) {
 			#ifdef DIAG
-			fprintf(stderr,"GOT A DIRECTORY! (%s)\n",entry->d_name);
+			fprintf(stderr,"GOT A DIRECTORY! (%s)\n",entry->name);
 			#endif
 			/*
-			fprintf(stderr,"entry->d_name \ %s\n",entry->d_name);
+			fprintf(stderr,"entry->name \ %s\n",entry->name);
 			fprintf(stderr,"statbufsrc.st_dev = %ld\n",statbufsrc.st_dev);
 			fprintf(stderr,"         dest_dev = %ld\n",dest_dev);
 			fprintf(stderr,"statbufsrc.st_ino = %ld\n",statbufsrc.st_ino);
@@ -1837,7 +1839,7 @@ size_t dstsize;
 
 					/* make a directory under destination of same name */
 					strcat(dst,"/");
-					strcat(dst,entry->d_name);
+					strcat(dst,entry->name);
 		   			if (!dir_exists(dst)) {	/* corrupts statbufdst */
 						/* may have come back false because file existed
                            _but_ was not a directory */
@@ -1866,11 +1868,11 @@ size_t dstsize;
 			}
 		} else if (special_recursive || S_ISREG(statbufsrc.st_mode) || S_ISBLK(statbufsrc.st_mode)) {
 #ifdef SUPPORT_OLD_OPTIONS
-			if (patmodule_check(entry->d_name,&statbufsrc))	
+			if (patmodule_check(entry->name,&statbufsrc))	
 #endif
 			{
 				strcat(dst,"/");
-				strcat(dst,entry->d_name);
+				strcat(dst,entry->name);
 				while (copy_guy(src,dst,dstsize)==RETRY);
 				*(strrchr(dst,'/')) = (char) 0x00;
 			}
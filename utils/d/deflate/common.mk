@@ -20,7 +20,9 @@ endef
 INSTALLDIR=usr/bin
 
 USEFILE=$(PROJECT_ROOT)/$(NAME).c
-LIBS=compat lzo ucl
+LIBS=compat lzo ucl $(LIBS_$(OS))
+LIBS_linux=pthread
+LIBS_solaris=pthread
 
 include $(MKFILES_ROOT)/qtargets.mk
 include $(MKFILES_ROOT)/ntoxdev.mk
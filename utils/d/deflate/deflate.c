@@ -23,6 +23,8 @@
 
 Options:
  -b size    Compression block size may be 4K, 8K, 16K or 32K (default: 8K).
+ -j num     Number of threads used to compress or decompress blocks
+            (default: 1).
  -o fname   Output file name. A fname of - means stdout (default: inplace).
  -i         Inflate files (default: deflate).
  -d         Decompress (same as -i so it can be used as a filter by tar).
@@ -56,6 +58,11 @@ filename    Files to compress. If no files are given or file is '-' then
 #include <minilzo.h>
 #include <ucl/ucl.h>
 
+#if defined(__QNXNTO__) || defined(__linux__) || defined(__SOLARIS__)
+#define DEFLATE_THREADS
+#include <pthread.h>
+#endif
+
 
 #define SIGNATURE	"iwlyfmbp"
 #define CMP_LZO		0
@@ -82,15 +89,18 @@ struct cmphdr {
 	short unsigned	usize;			// Size of this uncompressed blk
 };
 
+// Big enough for an expanded 32K block and for any block that
+// cmphdr.next can describe.
 struct cmpblk {
 	struct cmphdr	hdr;
-	uint8_t			buf[32*1024];
+	uint8_t			buf[64*1024];
 } cmpblk;
 
 uint8_t workbuf[32*1024];
 uint8_t wrkmem[LZO1X_MEM_COMPRESS];
 uint8_t pathbuf[PATH_MAX];
 int verbose;
+int nthreads = 1;
 
 int process_file(const char *infile, const char *outfile, int inflate, int type, int blksize);
 
@@ -98,6 +108,11 @@ int compress  (const char *file, int infd, int outfd, int type, int blksize, con
 int decompress(                  int infd, int outfd, int type);
 int copy      (                  int infd, int outfd,                        const void *buf, int buf_size);
 
+#ifdef DEFLATE_THREADS
+int compress_mt  (const char *file, int infd, int outfd, int type, int blksize, const void *buf, int buf_size);
+int decompress_mt(                  int infd, int outfd, int type);
+#endif
+
 #ifndef __MINGW32__
 extern char	* __progname;
 #else
@@ -125,7 +140,7 @@ int main(int argc, char *argv[])
 	inflate    = 0;
 	type       = CMP_UCL;
 
-	while ((opt = getopt(argc, argv, "db:io:p:t:v")) != -1) {
+	while ((opt = getopt(argc, argv, "db:ij:o:p:t:v")) != -1) {
 		switch (opt) {
 			case 'o':
 				outfile = optarg;
@@ -156,6 +171,14 @@ int main(int argc, char *argv[])
 				inflate = 1;
 				break;
 
+			case 'j':
+				nthreads = atoi(optarg);
+				if (nthreads < 1) {
+					fprintf(stderr, "Invalid number of threads %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
 			case 'p':
 				break;
 
@@ -343,11 +366,21 @@ int process_file(const char *infile, const char *outfile, int inflate, int type,
 			error = copy(infd, outfd, &hdr, xfer);
 
 		} else {
+#ifdef DEFLATE_THREADS
+			if (nthreads > 1) {
+				error = decompress_mt(infd, outfd, type);
+			} else
+#endif
 			error = decompress(infd, outfd, type);
 		}
 
 	} else {
 		if (raw) {
+#ifdef DEFLATE_THREADS
+			if (nthreads > 1) {
+				error = compress_mt(file, infd, outfd, type, blksize, &hdr, xfer);
+			} else
+#endif
 			error = compress(file, infd, outfd, type, blksize, &hdr, xfer);
 		} else {
 			if (verbose) fprintf(stderr, "%s: File already compressed, copying instead\n", __progname); 
@@ -432,6 +465,8 @@ int compress(const char *file, int infd, int outfd, int type, int blksize, const
 	intotal = pusize;
 
 	if (type == CMP_LZO) {
+		/* LZO1X-1 output depends on stale dictionary entries, start each block clean */
+		memset(wrkmem, 0, sizeof(wrkmem));
 		error = lzo1x_1_compress(workbuf, pusize, cmpblk.buf, (lzo_uint *)&temp, wrkmem);
 		if (error) return (EIO);
 
@@ -466,6 +501,7 @@ int compress(const char *file, int infd, int outfd, int type, int blksize, const
 		intotal += xfer;
 
 		if (type == CMP_LZO) {
+			memset(wrkmem, 0, sizeof(wrkmem));
 			error = lzo1x_1_compress(workbuf, pusize, cmpblk.buf, (lzo_uint *)&temp, wrkmem);
 			if (error) return (EIO);
 
@@ -521,30 +557,40 @@ int compress(const char *file, int infd, int outfd, int type, int blksize, const
 
 int decompress(int infd, int outfd, int type)
 {
-	int		blksize;
-	int		xfer;
-	int		temp;
-	int		error;
+	int			blksize;
+	int			xfer;
+	int			temp;
+	int			error;
+	lzo_uint	lzo_len;
+	ucl_uint	ucl_len;
 
 	while (1) {
 		xfer = read(infd, &cmpblk.hdr, sizeof(cmpblk.hdr));
 		if      (xfer < 0)  return (errno);
 		else if (xfer == 0) break;
+		else if (xfer != sizeof(cmpblk.hdr)) return (EIO);
 
 		if (cmpblk.hdr.next == 0) break;
+		if (ENDIAN_LE16(cmpblk.hdr.next) < sizeof(cmpblk.hdr)) return (EIO);
 
 		blksize = ENDIAN_LE16(cmpblk.hdr.next) - sizeof(cmpblk.hdr);
 		xfer = read(infd, cmpblk.buf, blksize);
 		if      (xfer < 0)        return (errno);
 		else if (xfer != blksize) return (EIO);
 
+		// The input isn't trusted, so the decompressors are told how
+		// much room there is.
 		if (type == CMP_LZO) {
-			error = lzo1x_decompress(cmpblk.buf, blksize, workbuf, (lzo_uint *)&temp, NULL);
+			lzo_len = sizeof(workbuf);
+			error = lzo1x_decompress_safe(cmpblk.buf, blksize, workbuf, &lzo_len, NULL);
 			if (error) return (EIO);
+			temp = lzo_len;
 
 		} else if (type == CMP_UCL) {
-			error = ucl_nrv2b_decompress_8(cmpblk.buf, blksize, workbuf, (ucl_uintp)&temp, NULL);
+			ucl_len = sizeof(workbuf);
+			error = ucl_nrv2b_decompress_safe_8(cmpblk.buf, blksize, workbuf, &ucl_len, NULL);
 			if (error) return (EIO);
+			temp = ucl_len;
 
 		} else {
 			return (EINVAL);
@@ -579,3 +625,394 @@ int copy(int infd, int outfd, const void *buf, int buf_size)
 
 	return (EOK);
 }
+
+#ifdef DEFLATE_THREADS
+/*
+ * Blocks are independent, so with -j the main thread reads blocks and
+ * queues them to a pool of worker threads, and writes the results out in
+ * their original order as they complete.  Reading, (de)compressing and
+ * writing overlap, and since the block boundaries are decided by the
+ * same reads as in compress()/decompress() the output is identical.
+ */
+struct job {
+	struct job		*next;			// todo/free list
+	struct job		*order;			// pending list, in file order
+	int				status;
+	int				done;
+	int				in_len;
+	int				out_len;
+	uint8_t			raw[32*1024];	// uncompressed data
+	struct cmpblk	blk;			// header and compressed data
+};
+
+struct pool {
+	pthread_mutex_t	mutex;
+	pthread_cond_t	work_cond;
+	pthread_cond_t	done_cond;
+	pthread_t		*threads;
+	int				nthreads;
+	int				njobs;
+	int				exiting;
+	int				inflate;
+	int				type;
+	int				outfd;
+	int				error;
+	struct job		*todo;
+	struct job		**todo_tail;
+	struct job		*pending;
+	struct job		**pending_tail;
+	struct job		*free;
+	int				(*put)(struct pool *pool, struct job *job);
+
+	// compress_mt() block chaining
+	uint32_t		outtotal;
+	uint16_t		prev;
+	uint16_t		pusize;
+};
+
+static int work(struct pool *pool, struct job *job, void *wrkmem)
+{
+	lzo_uint	lzo_len;
+	ucl_uint	ucl_len;
+	int			error;
+
+	if (pool->type == CMP_LZO) {
+		if (pool->inflate) {
+			lzo_len = sizeof(job->raw);
+			error = lzo1x_decompress_safe(job->blk.buf, job->in_len, job->raw, &lzo_len, NULL);
+		} else {
+			memset(wrkmem, 0, LZO1X_MEM_COMPRESS);
+			error = lzo1x_1_compress(job->raw, job->in_len, job->blk.buf, &lzo_len, wrkmem);
+		}
+		job->out_len = lzo_len;
+
+	} else if (pool->type == CMP_UCL) {
+		if (pool->inflate) {
+			ucl_len = sizeof(job->raw);
+			error = ucl_nrv2b_decompress_safe_8(job->blk.buf, job->in_len, job->raw, &ucl_len, NULL);
+		} else {
+			error = ucl_nrv2b_99_compress(job->raw, job->in_len, job->blk.buf, &ucl_len, NULL, 9, NULL, NULL);
+		}
+		job->out_len = ucl_len;
+
+	} else {
+		return (EINVAL);
+	}
+
+	return (error ? EIO : EOK);
+}
+
+static void *worker(void *arg)
+{
+	struct pool	*pool = arg;
+	struct job	*job;
+	void		*wrkmem;
+
+	wrkmem = malloc(LZO1X_MEM_COMPRESS);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1) {
+		while ((pool->todo == NULL) && !pool->exiting) {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		}
+		if ((job = pool->todo) == NULL) break;
+		if ((pool->todo = job->next) == NULL) pool->todo_tail = &pool->todo;
+		pthread_mutex_unlock(&pool->mutex);
+
+		job->status = (wrkmem == NULL) ? ENOMEM : work(pool, job, wrkmem);
+
+		pthread_mutex_lock(&pool->mutex);
+		job->done = 1;
+		pthread_cond_broadcast(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	free(wrkmem);
+	return (NULL);
+}
+
+/* Write out finished jobs from the front of the pending list (mutex held) */
+static void pool_drain(struct pool *pool)
+{
+	struct job	*job;
+	int			error;
+
+	while (((job = pool->pending) != NULL) && job->done) {
+		if ((pool->pending = job->order) == NULL) pool->pending_tail = &pool->pending;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (pool->error == EOK) {
+			error = (job->status != EOK) ? job->status : pool->put(pool, job);
+			if (error) pool->error = error;
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		job->next  = pool->free;
+		pool->free = job;
+	}
+}
+
+/* Get a job to fill, writing out finished ones while waiting for it */
+static struct job *pool_get(struct pool *pool)
+{
+	struct job	*job;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1) {
+		pool_drain(pool);
+		if (pool->error != EOK) {
+			job = NULL;
+			break;
+		}
+		if ((job = pool->free) != NULL) {
+			pool->free = job->next;
+			break;
+		}
+		if (pool->njobs < 2 * pool->nthreads + 1) {
+			if ((job = malloc(sizeof(*job))) != NULL) {
+				pool->njobs++;
+				break;
+			}
+			if (pool->pending == NULL) {
+				pool->error = ENOMEM;
+				break;
+			}
+		}
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return (job);
+}
+
+static void pool_submit(struct pool *pool, struct job *job)
+{
+	pthread_mutex_lock(&pool->mutex);
+	job->next  = NULL;
+	job->order = NULL;
+	job->done  = 0;
+	*pool->todo_tail    = job;
+	pool->todo_tail     = &job->next;
+	*pool->pending_tail = job;
+	pool->pending_tail  = &job->order;
+	pthread_cond_signal(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void pool_release(struct pool *pool, struct job *job)
+{
+	pthread_mutex_lock(&pool->mutex);
+	job->next  = pool->free;
+	pool->free = job;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static int pool_start(struct pool *pool, int inflate, int type, int outfd,
+                      int (*put)(struct pool *pool, struct job *job))
+{
+	memset(pool, 0, sizeof(*pool));
+	pool->inflate      = inflate;
+	pool->type         = type;
+	pool->outfd        = outfd;
+	pool->put          = put;
+	pool->todo_tail    = &pool->todo;
+	pool->pending_tail = &pool->pending;
+
+	pool->threads = malloc(nthreads * sizeof(*pool->threads));
+	if (pool->threads == NULL) return (ENOMEM);
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	for ( ; pool->nthreads < nthreads ; pool->nthreads++) {
+		if (pthread_create(&pool->threads[pool->nthreads], NULL, worker, pool) != EOK) break;
+	}
+	return (pool->nthreads ? EOK : EAGAIN);
+}
+
+/* Wait for everything queued to be written and tear down the pool */
+static int pool_stop(struct pool *pool)
+{
+	struct job	*job;
+	int			i;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending != NULL) {
+		pool_drain(pool);
+		if (pool->pending != NULL) pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+	pool->exiting = 1;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0 ; i < pool->nthreads ; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	while ((job = pool->free) != NULL) {
+		pool->free = job->next;
+		free(job);
+	}
+	free(pool->threads);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+
+	return (pool->error);
+}
+
+static int put_compressed(struct pool *pool, struct job *job)
+{
+	int		xfer;
+	int		size;
+
+	job->blk.hdr.prev   = ENDIAN_LE16(pool->prev);
+	job->blk.hdr.pusize = ENDIAN_LE16(pool->pusize);
+
+	size                = sizeof(job->blk.hdr) + job->out_len;
+	pool->prev          = size;
+	pool->pusize        = job->in_len;
+	job->blk.hdr.next   = ENDIAN_LE16(pool->prev);
+	job->blk.hdr.usize  = ENDIAN_LE16(pool->pusize);
+
+	xfer = write(pool->outfd, &job->blk, size);
+	if      (xfer < 0)     return (errno);
+	else if (xfer != size) return (EIO);
+
+	pool->outtotal += size;
+	return (EOK);
+}
+
+static int put_decompressed(struct pool *pool, struct job *job)
+{
+	int		xfer;
+
+	xfer = write(pool->outfd, job->raw, job->out_len);
+	if      (xfer < 0)             return (errno);
+	else if (xfer != job->out_len) return (EIO);
+
+	return (EOK);
+}
+
+int compress_mt(const char *file, int infd, int outfd, int type, int blksize, const void *buf, int buf_size)
+{
+	struct pool		pool;
+	struct filehdr	hdr;
+	struct job *	job;
+	uint32_t		intotal  = 0;
+	int				xfer;
+	int				error;
+
+	if ((type != CMP_LZO) && (type != CMP_UCL)) return (EINVAL);
+
+	/* Seek past the header */
+	lseek(outfd, sizeof(hdr), SEEK_SET);
+
+	error = pool_start(&pool, 0, type, outfd, put_compressed);
+	if (error) return (error);
+	pool.outtotal = sizeof(hdr);
+
+	/* The first block starts with the stuff we've already read */
+	job = pool_get(&pool);
+	if (job == NULL) goto done;
+
+	memcpy(job->raw, buf, buf_size);
+	xfer = read(infd, job->raw + buf_size, blksize - buf_size);
+	if (xfer < 0) {
+		pool_release(&pool, job);
+		pool.error = errno;
+		goto done;
+	}
+	job->in_len = xfer + buf_size;
+	intotal     = job->in_len;
+	pool_submit(&pool, job);
+
+	/* Do the rest of the file */
+	while ((job = pool_get(&pool)) != NULL) {
+		xfer = read(infd, job->raw, blksize);
+		if (xfer <= 0) {
+			pool_release(&pool, job);
+			if (xfer < 0) pool.error = errno;
+			break;
+		}
+		job->in_len = xfer;
+		intotal    += xfer;
+		pool_submit(&pool, job);
+	}
+
+done:
+	error = pool_stop(&pool);
+	if (error) return (error);
+
+	/* Write out the end-of-file marker */
+	cmpblk.hdr.prev   = ENDIAN_LE16(pool.prev);
+	cmpblk.hdr.next   = 0;
+	cmpblk.hdr.pusize = ENDIAN_LE16(pool.pusize);
+	cmpblk.hdr.usize  = 0;
+
+	xfer = write(outfd, &cmpblk, sizeof(cmpblk.hdr));
+	if      (xfer < 0)                   return (errno);
+	else if (xfer != sizeof(cmpblk.hdr)) return (EIO);
+
+	pool.outtotal += sizeof(cmpblk.hdr);
+
+	/* Write the header */
+	memcpy(hdr.signature, SIGNATURE, sizeof(hdr.signature));
+	hdr.usize   = ENDIAN_LE32(intotal);
+	hdr.blksize = ENDIAN_LE16(blksize);
+	hdr.cmptype = type;
+	hdr.flags   = 0;
+
+	lseek(outfd, 0, SEEK_SET);
+	write(outfd, &hdr, sizeof(hdr));
+
+	if (verbose) {
+		if(intotal == 0) intotal = 1; // avoid divide by zero below
+		fprintf(stderr, "Compressed %s %d%% (%d threads)\n",
+	                     file, 100 - ((100 * pool.outtotal) / intotal), pool.nthreads);
+	}
+
+	return (EOK);
+}
+
+int decompress_mt(int infd, int outfd, int type)
+{
+	struct pool		pool;
+	struct job *	job;
+	int				blksize;
+	int				xfer;
+	int				error;
+
+	if ((type != CMP_LZO) && (type != CMP_UCL)) return (EINVAL);
+
+	error = pool_start(&pool, 1, type, outfd, put_decompressed);
+	if (error) return (error);
+
+	while ((job = pool_get(&pool)) != NULL) {
+		xfer = read(infd, &job->blk.hdr, sizeof(job->blk.hdr));
+		if ((xfer <= 0) || (job->blk.hdr.next == 0)) {
+			pool_release(&pool, job);
+			if (xfer < 0) pool.error = errno;
+			break;
+		}
+		if ((xfer != sizeof(job->blk.hdr)) ||
+		    (ENDIAN_LE16(job->blk.hdr.next) < sizeof(job->blk.hdr))) {
+			pool_release(&pool, job);
+			pool.error = EIO;
+			break;
+		}
+
+		blksize = ENDIAN_LE16(job->blk.hdr.next) - sizeof(job->blk.hdr);
+		xfer = read(infd, job->blk.buf, blksize);
+		if (xfer != blksize) {
+			pool_release(&pool, job);
+			pool.error = (xfer < 0) ? errno : EIO;
+			break;
+		}
+		job->in_len = blksize;
+		pool_submit(&pool, job);
+	}
+
+	return (pool_stop(&pool));
+}
+#endif
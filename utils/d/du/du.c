@@ -190,7 +190,7 @@ in the total sum.
 #include <sys/types.h>
 #include <util/defns.h>
 #include <util/util_limits.h>
-#include <util/stat_optimiz.h>
+#include <util/walkdir.h>
 
 unsigned long process( char *, int ); /* returns number of 512byte blocks */
 
@@ -215,7 +215,7 @@ int		span_devices=TRUE;
 uchar_t	aflag, kflag, pflag, qflag, sflag;
 char	dir[UTIL_PATH_MAX+1];
 char	fname[UTIL_PATH_MAX];
-struct	dirent	*Dirent;
+struct	walkdir_ent	*Dirent;
 
 
 int main( int argc, char *argv[] )
@@ -294,7 +294,7 @@ unsigned long process(char *name, int root )
 	unsigned long dirtotal = 0L;
     long thissize = 0L;
 	uchar_t	isdir = FALSE, islnk = FALSE;
-	DIR		*fd;
+	walkdir_t	*fd;
 
 	Stat = &statbuf;
 #ifndef __QNXNTO__
@@ -332,18 +332,20 @@ unsigned long process(char *name, int root )
 	if ( S_ISDIR( Stat->st_mode ) ) {
 		isdir = TRUE;
 
-		if ( ( fd = opendir( name ) ) == NULL ) {
+		/* the entries come with their lstat data, which the subdirectories
+		   ahead are read with while we go through this one */
+		if ( ( fd = walkdir_open( name, WALKDIR_DOTS | WALKDIR_PREFETCH ) ) == NULL ) {
 			if ( !qflag ) fprintf(stderr,"du:  Unable to open directory '%s' (%s)\n", name, strerror(errno) );
 			return( ERRR );
 		}
 
 	/* loop reading dir entries */
 		errno=0;
-		while (NULL!=(Dirent=readdir(fd))) {
+		while (NULL!=(Dirent=walkdir_read(fd))) {
 			islnk = FALSE;
 
 			/* avoid backing up to parent directory!! */
-			if ( strcmp( Dirent->d_name, ".." ) == 0 ) continue;
+			if ( strcmp( Dirent->name, ".." ) == 0 ) continue;
 
 			/* '.' is still making it through here. Is that right? 
 			   Yes. We need to count the size allocated for the directory itself. (EJ) */
@@ -352,15 +354,15 @@ unsigned long process(char *name, int root )
 			if ( name[strlen(name)-1] == '/' ) name[strlen(name)-1] = '\0';
 
 			/* create file name (dir name being scanned / name in dir entry) */
-			sprintf( fname, "%s/%s", name, Dirent->d_name );
+			sprintf( fname, "%s/%s", name, Dirent->name );
 
-			Stat=&statbuf;
-			if (-1==lstat_optimize(Dirent, Stat)) {
-				if ( ( lstat( fname, Stat ) ) == -1 ) {
-					if ( !qflag ) fprintf(stderr, "du:  Unable to lstat '%s' (%s)\n", fname, strerror(errno) );
-					continue;
-				}
+			if (Dirent->err) {
+				if ( !qflag ) fprintf(stderr, "du:  Unable to lstat '%s' (%s)\n", fname, strerror(Dirent->err) );
+				errno=0;
+				continue;
 			}
+			Stat=&statbuf;
+			*Stat=Dirent->st;
 
 			if (!S_ISNAM(Stat->st_mode) && Stat->st_size<0L) {
 #if _FILE_OFFSET_BITS - 0 == 64
@@ -422,7 +424,7 @@ unsigned long process(char *name, int root )
 
 			if ( S_ISDIR( Stat->st_mode ) ) {
 				/* don't recurse into ourself! */
-				if (strcmp(Dirent->d_name, ".")) {
+				if (strcmp(Dirent->name, ".")) {
 					strcpy( dir, fname );
 					dirtotal += process( &dir[0], FALSE );
 					do {
@@ -481,7 +483,7 @@ unsigned long process(char *name, int root )
 			fprintf(stderr,"du: readdir of %s failed (%s)\n",name,strerror(errno));
 		}
 
-		closedir( fd );
+		walkdir_close( fd );
 
 		/* we used islnk when processing the items within the directory,
            but it is FALSE for the directory itself, so we must reset it here
@@ -263,12 +263,10 @@ int phdr_diff( Elf *elf[2], int verbose ) {
 	}
 
 	for (i=0;i<2;i++) {
-		for (k[i]=0;k[i]<elf[i]->e_ehdrp->e_shnum;k[i]++) {
-	        	if (!strcmp(elf_strptr(elf[i],elf[i]->e_ehdrp->e_shstrndx, elf[i]->e_shdrp[k[i]].sh_name),".rel.dyn")) {
-			  reldynseg[i].offset=elf[i]->e_shdrp[k[i]].sh_offset;
-			  reldynseg[i].size=elf[i]->e_shdrp[k[i]].sh_size;
-		          break;
-	        	}
+		if ((scn[i] = elf_findscn(elf[i], ".rel.dyn")) != NULL) {
+			k[i] = elf_ndxscn(scn[i]);
+			reldynseg[i].offset=elf[i]->e_shdrp[k[i]].sh_offset;
+			reldynseg[i].size=elf[i]->e_shdrp[k[i]].sh_size;
 		}
 	}
 	k[0]=0; k[1]=0;
@@ -421,14 +419,11 @@ int shdr_diff(Elf *elf[2], char *sections, int verbose) {
   while (!retval && (tok != NULL)) {
 
     for (i=0;i<2;i++) {
-      for (k[i]=0;k[i]<elf[i]->e_ehdrp->e_shnum;k[i]++) {
-        if (!strcmp(elf_strptr(elf[i],elf[i]->e_ehdrp->e_shstrndx, elf[i]->e_shdrp[k[i]].sh_name),tok)) {
-          offset[i]=elf[i]->e_shdrp[k[i]].sh_offset + elf[i]->e_offset;
-          k[i]++;
-          break;
-        }
-      }
-      if (k[i] >= elf[i]->e_ehdrp->e_shnum) {
+      if ((scn[i] = elf_findscn(elf[i], tok)) != NULL) {
+        k[i] = elf_ndxscn(scn[i]);
+        offset[i]=elf[i]->e_shdrp[k[i]].sh_offset + elf[i]->e_offset;
+        k[i]++;
+      } else {
         if ((strcmp (tok, "QNX_usage") != 0) && (strcmp(tok, "QNX_PhAB") != 0)) {
           if (verbose) fprintf(stderr, "elfdiff: Input file does not contain named section '%s'\n", tok);
           return ED_HDRFAIL;
@@ -191,6 +191,7 @@ static bool     DaystartFlag  = FALSE, /* -Xtime based on 24hr period */
                 PruneFlag     = FALSE, /* recurse into subdirectories */
                 Statbuf_Valid = FALSE, /* stat buffer currently has no data */
                 Trap_SIGINT   = FALSE, /* no need to trap SIGINT */
+                Changes_Tree  = FALSE, /* primaries only look at the files */
                 Verbose       = FALSE, /* not verbose */
                 XdevFlag      = FALSE; /* freely descend past device boundaries */
 
@@ -296,6 +297,7 @@ void                          check_argavail         (int16_t);
 exprn *                       parse_expression       (int, char **);
 exprn *                       _parse_expression      (int);
 int16_t                         cmd_match              (char *);
+int                           skip_dir               (const char *);
 void                          recurse_dir            (char *);
 int                           check_devinos          (int, dev_t, ino_t);
 void                          process_file           (char *);
@@ -1739,11 +1741,13 @@ timesin=0; /* reset code which prepends -false -or to subexpression */
                 check_argavail(tok);
                 cur_expr->subexpr = (struct expression*) Glob_Argv[Glob_Index++];
                 Print_On_Match=FALSE;
+                Changes_Tree=TRUE;
                 break;
 
 
             case CHMOD:
                 Print_On_Match=FALSE;
+                Changes_Tree=TRUE;
                 check_argavail(tok);
                 {
                     mode_t *temp;
@@ -2209,6 +2213,7 @@ timesin=0; /* reset code which prepends -false -or to subexpression */
             case CHOWN:
             case CHGRP:
                 Print_On_Match=FALSE;
+                Changes_Tree=TRUE;
                 check_argavail(tok);
                 {
                     ownership_t  *temp;
@@ -2344,11 +2349,12 @@ timesin=0; /* reset code which prepends -false -or to subexpression */
                 cur_expr->builtin_fn = ALWAYS_TRUE;
                 break;
     
+            case UNLINK:
+                Changes_Tree = TRUE;
             case ALWAYS_TRUE_NOP:
             case PRINT:
             case PRINT0:
             case LS:
-            case UNLINK:
                 Print_On_Match = FALSE;
             case ALWAYS_TRUE:
             case ALWAYS_FALSE:
@@ -2367,6 +2373,7 @@ timesin=0; /* reset code which prepends -false -or to subexpression */
             case EXEC:
             case DASHOK:
                 Trap_SIGINT=TRUE;
+                Changes_Tree=TRUE;
 
             case ECHOSPAM:
             case ERRMSG:
@@ -2402,6 +2409,7 @@ timesin=0; /* reset code which prepends -false -or to subexpression */
             case SPAWN:
                 check_argavail(tok);
                 Trap_SIGINT=TRUE;
+                Changes_Tree=TRUE;
                 /*  golly, but these sure do! subexpr will point midway
                     into an array of ptrs, ending with a NULL pointer.
                     Pointers to '{}' are changed to point to Current_Path
@@ -2470,49 +2478,60 @@ int16_t cmd_match (char *string)
     return(HEY_DUDE_THAT_IS_BOGUS_HELLO);
 }
 
-/*-------------------------------------------------- recurse_dir(char*) ------*/
+/*-------------------------------------------------- skip_dir(char*) ---------*/
 
-void recurse_dir (char *path)
+/* directories never to descend into below the starting points. Also
+   used to keep the directory reader from reading ahead into them */
+int skip_dir (const char *path)
 {
-    DIR *dirp;              
-    struct dirent *entry;
-
 //#ifdef __QNXNTO__
-	if(Levels != 0) {
-		static char netpath[UTIL_PATH_MAX];
-		static int netpathlen;
-		char buf[UTIL_PATH_MAX], *cp;
+	static char netpath[UTIL_PATH_MAX];
+	static int netpathlen;
+	char buf[UTIL_PATH_MAX], *cp;
 
-		if(netpath[0] == '\0') {
+	if(netpath[0] == '\0') {
 //			netmgr_ndtostr(ND2S_DIR_SHOW|ND2S_NAME_HIDE|ND2S_DOMAIN_HIDE|ND2S_QOS_HIDE, ND_LOCAL_NODE, netpath, sizeof(netpath));
 strcpy(netpath, "/tmp/net");
-			netpathlen = strlen(netpath);
-		}
+		netpathlen = strlen(netpath);
+	}
 
-		// We use strstr to trim the number of fullpaths we may need to do.
-		if(strstr(path, "proc/mount") || strstr(path, netpath)) {
+	// We use strstr to trim the number of fullpaths we may need to do.
+	if(strstr(path, "proc/mount") || strstr(path, netpath)) {
 //			if(_fullpath(buf, path, sizeof(buf)) != -1) {
 if(strcpy(buf, path)) {
 
-				// Check for /proc/mount or the net dir
-				if(strcmp(buf, "/proc/mount") == 0 || strcmp(buf, netpath) == 0)
-					return;
+			// Check for /proc/mount or the net dir
+			if(strcmp(buf, "/proc/mount") == 0 || strcmp(buf, netpath) == 0)
+				return TRUE;
 
-				//Check for /proc/mount on a remote node through net dir
-				if(strncmp(buf, netpath, netpathlen) == 0 && buf[netpathlen] == '/') {
-					cp = strchr(buf + netpathlen + 1, '/');
-					if(cp && strcmp(cp, "/proc/mount") == 0)
-						return;
-				}
+			//Check for /proc/mount on a remote node through net dir
+			if(strncmp(buf, netpath, netpathlen) == 0 && buf[netpathlen] == '/') {
+				cp = strchr(buf + netpathlen + 1, '/');
+				if(cp && strcmp(cp, "/proc/mount") == 0)
+					return TRUE;
 			}
 		}
 	}
 //#endif
+	return FALSE;
+}
+
+/*-------------------------------------------------- recurse_dir(char*) ------*/
+
+void recurse_dir (char *path)
+{
+    walkdir_t *dirp;
+    struct walkdir_ent *entry;
+
+	if(Levels != 0 && skip_dir(path))
+		return;
 
     /* already know that this is a directory, so I won't stat it here */
     Levels++;
 
-    if ((dirp=opendir(path))==NULL) {
+    /* the entries come back with their stat info; unless the expression
+       changes the tree, the subdirectories coming up are read ahead */
+    if ((dirp=walkdir_open(path,(LogicalFlag?WALKDIR_FOLLOW:0)|(Changes_Tree?0:WALKDIR_PREFETCH)))==NULL) {
         if ((errno!=EACCES)||Verbose) 
 			fprintf(stderr,"%s (%s): %s\n","find: Can't open directory.",path,sys_errlist[errno]);
         Levels--;
@@ -2520,37 +2539,19 @@ if(strcpy(buf, path)) {
         return;
     }
 
-#ifdef __QNXNTO__
-	{
-    int dirflags;
-    /* attempt to set performance flags on dirp */
-    if( (dirflags = dircntl(dirp, D_GETFLAG)) != -1){
-    	dirflags |= D_FLAG_STAT;
-    	dircntl(dirp, D_SETFLAG, dirflags);
-    	/* ignore failure since it won't hurt anything */
-    }
-	}
-#endif
-
-    while (errno=0,(entry=readdir(dirp)) || errno) {
+    while (errno=0,(entry=walkdir_read(dirp)) || errno) {
         if (errno) {
 			fprintf(stderr,"%s (%s): %s\n","find: Can't read directory entry.",path,sys_errlist[errno]);
             Error++;
             break;
         }
 
-        if (entry->d_name[0] == '.') {
-            if (!entry->d_name[1]) continue;
-            if ((entry->d_name[1]=='.') && (!entry->d_name[2])) continue;
+        /* if the stat failed, process_file() will try again and complain */
+        if (entry->err) Statbuf_Valid=FALSE;
+        else {
+            *Statbufp=entry->st;
+            Statbuf_Valid=TRUE;
         }
-
-		if (LogicalFlag) {
-			if (stat_optimize(entry, Statbufp)==-1) Statbuf_Valid=FALSE;
-			else Statbuf_Valid=TRUE;
-		} else {
-			if (lstat_optimize(entry, Statbufp)==-1) Statbuf_Valid=FALSE;
-			else Statbuf_Valid=TRUE;
-		}
 			
         /* add filename to end of path */
         {
@@ -2558,13 +2559,13 @@ if(strcpy(buf, path)) {
             if (path[strlen(path)-1] != '/') {
                 endp=path+strlen(path);
                 strcat(path,"/");
-                strcat(path,entry->d_name);
+                strcat(path,entry->name);
                 process_file(path);
                 *(endp) = (char) 0x00;
                 /* *(strrchr(path,'/')) = (char) 0x00; */
             } else {
                 endp=path+strlen(path);
-                strcat(path,entry->d_name);
+                strcat(path,entry->name);
                 process_file(path);
                 *(endp) = (char) 0x00;
                 /* *(strrchr(path,'/')+1) = (char) 0x00; */
@@ -2573,7 +2574,7 @@ if(strcpy(buf, path)) {
         errno = 0;  /* zzx */
     }
 
-    if (closedir(dirp)==-1) {
+    if (walkdir_close(dirp)==-1) {
 		fprintf(stderr,"%s (%s): %s\n","find: Error closing directory.",path,sys_errlist[errno]);
         Error++;
     }
@@ -2823,6 +2824,11 @@ int main (int argc,char **argv)
        if there are any -exec, -ok, or -spawn primaries in the expression */
     if (Trap_SIGINT) signal(SIGINT,sigint_handler);
 
+    /* -exec and friends may change what has been read ahead, and are
+       better off spawned from a single threaded process */
+    if (Changes_Tree) walkdir_threads(0);
+    walkdir_skip(skip_dir);
+
     Start_Time = time(NULL);
 
     /* calculate daystart time. Time as of the start of the current day. */
@@ -37,7 +37,7 @@
 #include <stdlib.h>
 #include <util/stdutil.h>
 #include <util/defns.h>
-#include <util/stat_optimiz.h>
+#include <util/walkdir.h>
 #include <string.h>
 #include <time.h>
 #include <signal.h>
@@ -14,7 +14,7 @@ USEFILE=$(PROJECT_ROOT)/$(NAME).c
 LINKS=fgrep egrep
 
 LIBS_win32=regex compat
-LIBS+=$(LIBS_$(OS))
+LIBS+=util $(LIBS_$(OS))
 
 include $(MKFILES_ROOT)/qtargets.mk
 
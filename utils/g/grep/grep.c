@@ -166,6 +166,8 @@ Where:
 #include <string.h>
 #include <limits.h>
 #include <dirent.h>
+#include <sys/stat.h>
+#include <util/walkdir.h>
 #ifdef __QNXNTO__
 #include <libgen.h>
 #endif
@@ -440,49 +442,55 @@ char	*umsg = OPT_LIST0;
 int grep(FILE*, char*);
 
 
+static int
+grep_file(const char *name, const char *path)
+{
+	int	ecode = EXIT_NO_MATCHES;
+	FILE *fp;
+
+	if((fp = fopen(path, "r")) == NULL) {
+		if (!no_file_error) {
+			fprintf(stderr,"%s: cannot open file '%s' (%s)\n",
+				name,path,strerror(errno));
+		}
+		ecode |= EXIT_ERROR;
+	} else {
+		if (!grep(fp,path)) ecode&=~EXIT_NO_MATCHES; 
+		fclose(fp);
+	}
+	return ecode;
+}
+
 static int
 recurse(const char *name, const char *path)
 {
 	int	ecode = EXIT_NO_MATCHES;
-	DIR *pdir;
-	struct dirent *pent;
-	pdir = opendir(path);
+	walkdir_t *pdir;
+	struct walkdir_ent *pent;
+	/* "." and ".." are left out; the subdirectories are read ahead */
+	pdir = walkdir_open(path, WALKDIR_FOLLOW | WALKDIR_PREFETCH);
 	//fprintf(stderr, "recurse(%s, %s)\n", name, path);
 	if (pdir == NULL){
-		FILE *fp;
-		if((fp = fopen(path, "r")) == NULL) {
-			if (!no_file_error) {
-				fprintf(stderr,"%s: cannot open file '%s' (%s)\n",
-					name,path,strerror(errno));
-			}
-			ecode |= EXIT_ERROR;
-		} else {
-			if (!grep(fp,path)) ecode&=~EXIT_NO_MATCHES; 
-			fclose(fp);
-		}
-		
+		ecode = grep_file(name, path);
 	}else{
- 		while (pent = readdir(pdir)){
+ 		while (pent = walkdir_read(pdir)){
 			char *pathBuffer = NULL;
-			int len = strlen(pent->d_name);
-			/* Avoid acending and spinning in the current directory */
-			if (len == 0)
-				continue;
-			if (len == 1 && pent->d_name[0] == '.')
-				continue;
-			if (len == 2 && pent->d_name[0] == '.' && pent->d_name[1] == '.')
-				continue;
-			pathBuffer = malloc(strlen(path) + strlen(pent->d_name) + 2);
+			pathBuffer = malloc(strlen(path) + strlen(pent->name) + 2);
 			if (path[strlen(path) - 1] == '/'){
-				sprintf(pathBuffer, "%s%s", path, pent->d_name);
+				sprintf(pathBuffer, "%s%s", path, pent->name);
+			}else{
+				sprintf(pathBuffer, "%s/%s", path, pent->name);
+			}
+			/* Only a directory is worth trying to open as one */
+			if (pent->err == 0 && !S_ISDIR(pent->st.st_mode)){
+				ecode &= grep_file(name, pathBuffer);
 			}else{
-				sprintf(pathBuffer, "%s/%s", path, pent->d_name);
+				ecode &= recurse(name, pathBuffer);
 			}
-			ecode &= recurse(name, pathBuffer);
 			free(pathBuffer);
 			
 		}
-		closedir (pdir);
+		walkdir_close(pdir);
 	}
 	return ecode;
 }
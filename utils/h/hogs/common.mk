@@ -23,6 +23,7 @@ endef
 
 CCFLAGS += -D_FILE_OFFSET_BITS=64 -D_IOFUNC_OFFSET_BITS=64 -D_LARGEFILE64_SOURCE=1
 
+LIBS+=util
 USEFILE=$(PROJECT_ROOT)/$(NAME).c
 
 include $(MKFILES_ROOT)/qtargets.mk
@@ -0,0 +1,59 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2007, QNX Software Systems. All Rights Reserved.
+ * 
+ * You must obtain a written license from and pay applicable license fees to QNX 
+ * Software Systems before you may reproduce, modify or distribute this software, 
+ * or any work that includes all or part of this software.   Free development 
+ * licenses are available for evaluation and non-commercial purposes.  For more 
+ * information visit http://licensing.qnx.com or email licensing@qnx.com.
+ *  
+ * This file may contain contributions from others.  Please review this entire 
+ * file for other proprietary rights or license notices, as well as the QNX 
+ * Development Suite License Guide at http://licensing.qnx.com/license-guide/ 
+ * for other information.
+ * $
+ */
+
+
+
+#ifndef __BLKINDEX_H_INCLUDED
+#define __BLKINDEX_H_INCLUDED
+
+/*
+ * Block index for random access LZO/UCL compressed images.
+ *
+ * A compressed image is a sequence of blocks, each a two byte big endian
+ * length followed by the compressed data, ending with a zero length.
+ * Images built with [+compress_index] follow the zero length with a table
+ * of blkindex_entry's (one per block, in order) and a blkindex_trailer.
+ * The trailer ends on a four byte boundary immediately before the image
+ * trailer, so a loader finds it at
+ *
+ *	startup_header + stored_size - sizeof(image_trailer) - sizeof(blkindex_trailer)
+ *
+ * and can then decompress just the blocks covering the data it needs.
+ * No block decompresses to more than block_size bytes.  All fields are in
+ * the target endian; offsets are relative to the start of the compressed
+ * data (the end of startup).  Sequential decompressors stop at the zero
+ * length and never see the index.
+ */
+
+#include <inttypes.h>
+
+#define BLKINDEX_SIGNATURE	0x78646e69	// "indx"
+
+struct blkindex_entry {
+	uint32_t	coff;			// offset of the block's length prefix
+	uint32_t	uoff;			// uncompressed offset of the block
+};
+
+struct blkindex_trailer {
+	uint32_t	index_offset;	// offset of the first blkindex_entry
+	uint32_t	num_blocks;
+	uint32_t	block_size;		// largest uncompressed block
+	uint32_t	image_size;		// total uncompressed size
+	uint32_t	signature;		// BLKINDEX_SIGNATURE
+};
+
+#endif
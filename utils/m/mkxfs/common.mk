@@ -47,6 +47,11 @@ LIB_SOCKET_nto=socket
 LIB_SOCKET_linux=pthread
 LIB_SOCKET=$(LIB_SOCKET_$(OS))
 
+# mkifs compresses images with a pool of threads
+LIB_THREAD_linux=pthread
+LIB_THREAD_solaris=pthread
+LIBS_mkxfs = util $(LIB_THREAD_$(OS))
+
 LIBS += $(LIBS_$(SECTION)) compat z lzo ucl
 
 include $(MKFILES_ROOT)/qmacros.mk
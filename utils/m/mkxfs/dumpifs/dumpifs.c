@@ -61,6 +61,7 @@
 #include <ucl/ucl.h>
 
 #include "xplatform.h"
+#include "blkindex.h"
 #include "md5.h"
 
 
@@ -76,6 +77,24 @@ char **check_files;
 char *ucompress_file;
 int zero_check_enabled = 1;
 
+/*
+ * Random access to images built with [+compress_index].  Blocks are only
+ * decompressed into the uncompressed copy when something is about to read
+ * them, and each block is decompressed at most once.
+ */
+struct blkindex {
+	FILE					*src;
+	int						type;
+	long					cpos;			// file offset of the compressed data
+	long					upos;			// offset of the uncompressed data in the copy
+	unsigned				num_blocks;
+	unsigned				block_size;
+	unsigned				image_size;
+	unsigned				num_done;
+	struct blkindex_entry	*ent;
+	unsigned char			*done;
+} *blkidx;
+
 int files_to_extract;
 int files_left_to_extract;
 int processing_done;
@@ -120,6 +139,9 @@ void compute_md5(FILE *fp, int ipos, struct image_file *ent, unsigned char md5_r
 
 int zero_ok (struct startup_header *shdr);
 
+int blkindex_open(FILE *src, long cpos, long end, int type, int cross, long upos);
+void need(FILE *fp, long pos, long len);
+
 #if defined(__QNXNTO__) || defined(__SOLARIS__)
 
 // Get basename()
@@ -330,6 +352,7 @@ void display_script(FILE *fp, int pos, int len) {
 	int								size;
 	int								ext_sched = SCRIPT_SCHED_EXT_NONE;
 
+	need(fp, pos, len);
 	for(off = 0; off < len; off += size) {
 		fseek(fp, pos + off, SEEK_SET);
 		if(fread(hdr, sizeof *hdr, 1, fp) != 1) {
@@ -530,7 +553,22 @@ void process(const char *file, FILE *fp) {
 			fflush(fp2);
 
 			// Uncompress compressed part
-			switch(shdr.flags1 & STARTUP_HDR_FLAGS1_COMPRESS_MASK) {
+			n = shdr.flags1 & STARTUP_HDR_FLAGS1_COMPRESS_MASK;
+			if(ucompress_file == NULL
+			 && (n == STARTUP_HDR_FLAGS1_COMPRESS_LZO || n == STARTUP_HDR_FLAGS1_COMPRESS_UCL)) {
+				int		cross = CROSSENDIAN(shdr.flags1 & STARTUP_HDR_FLAGS1_BIGENDIAN);
+				long	cpos = ftell(fp);
+				long	end = spos + (cross ? ENDIAN_RET32(shdr.stored_size) : shdr.stored_size);
+
+				if(blkindex_open(fp, cpos, end, n, cross, cpos)) {
+					// Decompressed on demand by need()
+					n = -1;
+				}
+				fseek(fp, cpos, SEEK_SET);
+			}
+			switch(n) {
+			case -1:
+				break;
 			case STARTUP_HDR_FLAGS1_COMPRESS_ZLIB:
 				{
 					int			fd;
@@ -599,7 +637,9 @@ void process(const char *file, FILE *fp) {
 				return;
 			}
 
-			fclose(fp);
+			if(blkidx == NULL) {
+				fclose(fp);
+			}
 			fp = fp2;
 			rewind(fp2);
 		} 
@@ -617,6 +657,7 @@ void process(const char *file, FILE *fp) {
 				}
 			}
 		}
+		need(fp, spos + shdr.startup_size, sizeof ihdr);
 		fseek(fp, spos + shdr.startup_size, SEEK_SET);
 		if((ipos = find(fp, ihdr.signature, sizeof ihdr.signature, -1)) == -1) {
 			error(1, "Unable to find image header in %s", file);
@@ -636,6 +677,7 @@ void process(const char *file, FILE *fp) {
 	}
 
 	dpos = ipos + ihdr.dir_offset;
+	need(fp, ipos, ihdr.hdr_dir_size);
 
 	if(flags & FLAG_DISPLAY) {
 		printf("   Offset     Size  Name\n");
@@ -729,6 +771,7 @@ void process(const char *file, FILE *fp) {
 		struct image_trailer	itlr;
 		struct startup_trailer	stlr;
 
+		need(fp, ipos + ihdr.image_size-sizeof(itlr), sizeof(itlr));
 		fseek(fp, ipos + ihdr.image_size-sizeof(itlr), SEEK_SET);
 		if(fread(&itlr, sizeof(itlr), 1, fp) != 1) {
 			error(1, "Early end reading image trailer");
@@ -751,6 +794,9 @@ void process(const char *file, FILE *fp) {
 				printf(" startup=%#lx", stlr.cksum);
 		}
 		printf("\n");
+		if(blkidx != NULL && verbose) {
+			printf("Block index: decompressed %u of %u blocks\n", blkidx->num_done, blkidx->num_blocks);
+		}
 	}
 }
 
@@ -921,6 +967,7 @@ void extract_file(FILE *fp, int ipos, struct image_file *ent) {
 		error(0, "Unable to open %s: %s\n", name, strerror(errno));
 	}
 
+	need(fp, ipos + ent->offset, ent->size);
 	fseek(fp, ipos + ent->offset, SEEK_SET);
 	ftruncate(fileno(dst), ent->size); /* pregrow the dst file */
 	if(copy(fp, dst, ent->size) == -1) {
@@ -1179,6 +1226,138 @@ void display_elf(FILE *fp, int pos, int size, char *name) {
 	printf("----------\n");
 }
 
+int blkindex_open(FILE *src, long cpos, long end, int type, int cross, long upos) {
+	struct blkindex_trailer	tlr;
+	struct blkindex			*bi;
+	unsigned				i;
+
+	if(fseek(src, end - sizeof(struct image_trailer) - sizeof tlr, SEEK_SET) != 0
+	 || fread(&tlr, sizeof tlr, 1, src) != 1) {
+		return 0;
+	}
+	if(cross) {
+		tlr.index_offset = ENDIAN_RET32(tlr.index_offset);
+		tlr.num_blocks = ENDIAN_RET32(tlr.num_blocks);
+		tlr.block_size = ENDIAN_RET32(tlr.block_size);
+		tlr.image_size = ENDIAN_RET32(tlr.image_size);
+		tlr.signature = ENDIAN_RET32(tlr.signature);
+	}
+	if(tlr.signature != BLKINDEX_SIGNATURE) {
+		return 0;
+	}
+	if(tlr.num_blocks == 0 || tlr.block_size > 0x10000
+	 || cpos + tlr.index_offset + tlr.num_blocks * sizeof *bi->ent > end) {
+		error(1, "Invalid block index, decompressing whole image");
+		return 0;
+	}
+	if((bi = calloc(1, sizeof *bi)) == NULL
+	 || (bi->ent = malloc(tlr.num_blocks * sizeof *bi->ent)) == NULL
+	 || (bi->done = calloc(tlr.num_blocks, 1)) == NULL) {
+		error(0, "No memory for block index");
+	}
+	fseek(src, cpos + tlr.index_offset, SEEK_SET);
+	if(fread(bi->ent, sizeof *bi->ent, tlr.num_blocks, src) != tlr.num_blocks) {
+		error(0, "Unable to read block index");
+	}
+	for(i = 0; i < tlr.num_blocks; i++) {
+		if(cross) {
+			bi->ent[i].coff = ENDIAN_RET32(bi->ent[i].coff);
+			bi->ent[i].uoff = ENDIAN_RET32(bi->ent[i].uoff);
+		}
+		if(bi->ent[i].coff >= tlr.index_offset || bi->ent[i].uoff >= tlr.image_size
+		 || (i != 0 && bi->ent[i].uoff <= bi->ent[i - 1].uoff)) {
+			error(0, "Corrupt block index entry %u", i);
+		}
+	}
+	if(type == STARTUP_HDR_FLAGS1_COMPRESS_LZO && lzo_init() != LZO_E_OK) {
+		error(0, "decompression init failure");
+	}
+	bi->src = src;
+	bi->type = type;
+	bi->cpos = cpos;
+	bi->upos = upos;
+	bi->num_blocks = tlr.num_blocks;
+	bi->block_size = tlr.block_size;
+	bi->image_size = tlr.image_size;
+	blkidx = bi;
+	if(verbose) {
+		printf("Block index: %u blocks, %u bytes uncompressed\n", bi->num_blocks, bi->image_size);
+	}
+	return 1;
+}
+
+// Make sure [pos, pos+len) of the uncompressed copy has been decompressed.
+void need(FILE *fp, long pos, long len) {
+	static unsigned char	buf[0x10000];
+	static unsigned char	out_buf[0x10000];
+	struct blkindex			*bi = blkidx;
+	unsigned				lo, hi, mid;
+	unsigned				i, n, ulen;
+	int						status;
+
+	if(bi == NULL) {
+		return;
+	}
+	pos -= bi->upos;
+	if(pos < 0) {
+		len += pos;
+		pos = 0;
+	}
+	if(len <= 0 || pos >= bi->image_size) {
+		return;
+	}
+	if(pos + len > bi->image_size) {
+		len = bi->image_size - pos;
+	}
+
+	// Last block starting at or before pos
+	lo = 0;
+	hi = bi->num_blocks;
+	while(hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if(bi->ent[mid].uoff <= pos) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	for(i = lo; i < bi->num_blocks && bi->ent[i].uoff < pos + len; i++) {
+		if(bi->done[i]) {
+			continue;
+		}
+		ulen = ((i + 1 < bi->num_blocks) ? bi->ent[i + 1].uoff : bi->image_size) - bi->ent[i].uoff;
+		fseek(bi->src, bi->cpos + bi->ent[i].coff, SEEK_SET);
+		n = getc(bi->src) << 8;
+		n += getc(bi->src);
+		if(n == 0 || fread(buf, n, 1, bi->src) != 1) {
+			error(0, "Unable to read compressed block %u", i);
+		}
+		if(bi->type == STARTUP_HDR_FLAGS1_COMPRESS_LZO) {
+			lzo_uint	out_len = sizeof out_buf;
+
+			status = lzo1x_decompress_safe(buf, n, out_buf, &out_len, NULL);
+			if(status != LZO_E_OK || out_len != ulen) {
+				error(0, "decompression failure in block %u", i);
+			}
+		} else {
+			ucl_uint	out_len = sizeof out_buf;
+
+			status = ucl_nrv2b_decompress_safe_8(buf, n, out_buf, &out_len, NULL);
+			if(status != 0 || out_len != ulen) {
+				error(0, "decompression failure in block %u", i);
+			}
+		}
+		fseek(fp, bi->upos + bi->ent[i].uoff, SEEK_SET);
+		if(fwrite(out_buf, ulen, 1, fp) != 1) {
+			error(0, "Unable to write uncompressed block %u", i);
+		}
+		bi->done[i] = 1;
+		bi->num_done++;
+	}
+	fflush(fp);
+}
+
 int zero_ok (struct startup_header *shdr) {
 	return(shdr->zero[0] == 0 &&
            shdr->zero[1] == 0 &&
@@ -1205,6 +1384,7 @@ void display_file(FILE *fp, int ipos, struct image_file *ent) {
 		display_attr(&ent->attr);
 	}
 	if(verbose > 1) {
+		need(fp, ipos + ent->offset, ent->size);
 		display_elf(fp, ipos + ent->offset, ent->size, basename(ent->path));
 	}
 }
@@ -1219,6 +1399,7 @@ void compute_md5(
 	int nbytes, n;
 	MD5_CTX md5_ctx;
 
+	need(fp, ipos + ent->offset, ent->size);
 	if (fseek(fp, ipos + ent->offset, SEEK_SET) != 0) {
 		error(0, "fseek on source file for MD5 calculation failed: %s\n", strerror(errno));
 	}
@@ -35,6 +35,12 @@
 #include <lzo1x.h>
 #include <ucl/ucl.h>
 #include "xplatform.h"
+#include "blkindex.h"
+
+#if !defined(__WIN32__) && !defined(__NT__)
+#define COMPRESS_THREADS
+#include <pthread.h>
+#endif
 
 
 struct soname_entry {
@@ -238,51 +244,91 @@ enum {
 	COMPRESS_ENUM(UCL)
 };
 
-#define BUFFSIZE_LZO	0x10000
-struct compress_lzo {
-	FILE			*fp;
-	unsigned		in_off;
-	unsigned char	work[LZO1X_999_MEM_COMPRESS];
-	unsigned char	in[BUFFSIZE_LZO];
-	unsigned char	out[BUFFSIZE_LZO+(BUFFSIZE_LZO/64 + 16 + 3)];
+/*
+ * LZO and UCL images are a sequence of blocks, each a two byte big endian
+ * length followed by the compressed data, terminated by a zero length.
+ * The input is cut into BUFFSIZE_BLOCK chunks and every chunk is
+ * compressed on its own, so the chunks are handed to a pool of worker
+ * threads and the results written back in sequence.  The output is the
+ * same as compressing the chunks one after the other.
+ */
+#define BUFFSIZE_BLOCK		0x10000
+#define BUFFSIZE_SCRATCH	(BUFFSIZE_BLOCK+(BUFFSIZE_BLOCK/8 + 256))
+#define BUFFSIZE_RECORDS	(BUFFSIZE_BLOCK+(BUFFSIZE_BLOCK/4))
+#define MAX_COMPRESS_THREADS	32
+#define MAX_BLOCK_RECORDS		32
+
+struct compress_block {
+	struct compress_block	*next;		// todo/free list
+	struct compress_block	*order;		// pending list, in file order
+	int						status;
+	int						done;
+	unsigned				in_len;
+	unsigned				out_len;
+	unsigned				num_recs;
+	unsigned				rec_len[MAX_BLOCK_RECORDS];	// uncompressed size of each record
+	unsigned char			in[BUFFSIZE_BLOCK];
+	unsigned char			out[BUFFSIZE_RECORDS];
 };
 
-static struct compress_lzo *
-lzoopen(const char *name) {
-	struct compress_lzo	*lzo;
-
-	lzo = malloc(sizeof(*lzo));
-	if(lzo == NULL) {
-		errno = ENOMEM;
-		return NULL;
-	}
-	lzo->fp = fopen(name, "wb");
-	if(lzo->fp == NULL) {
-		return NULL;
-	}
-	if(lzo_init() != LZO_E_OK) {
-		errno = EDOM; //Strange error so we know what failed.
-		return NULL;
-	}
-	lzo->in_off = 0;
-	return lzo;
-}
+struct compress_stream {
+	FILE					*fp;
+	int						type;
+	int						level;
+	struct compress_block	*cur;
+	void					*work;
+	unsigned char			*scratch;
+	struct blkindex_entry	*index;			// [+compress_index]
+	unsigned				index_num;
+	unsigned				index_max;
+	unsigned				coff;
+	unsigned				uoff;
+	unsigned				max_rec;
+#ifdef COMPRESS_THREADS
+	pthread_mutex_t			mutex;
+	pthread_cond_t			work_cond;
+	pthread_cond_t			done_cond;
+	pthread_t				threads[MAX_COMPRESS_THREADS];
+	unsigned				num_threads;
+	unsigned				num_blocks;
+	int						exiting;
+	int						error;
+	struct compress_block	*todo;
+	struct compress_block	**todo_tail;
+	struct compress_block	*pending;
+	struct compress_block	**pending_tail;
+	struct compress_block	*free;
+#endif
+};
 
 static int
-lzoflush(struct compress_lzo *lzo) {
-	int			status;
-	lzo_uint	out_len;
-	unsigned char		*buf;
-	unsigned	len;
-
-	buf = lzo->in;
-	len = lzo->in_off;
-
-	while(lzo->in_off != 0) {
-		status = lzo1x_999_compress(buf, len, lzo->out, &out_len, lzo->work);
-		if(status != LZO_E_OK) {
-			errno = EDOM;
-			return 0;
+blkcompress(struct compress_stream *cs, struct compress_block *blk, void *work, unsigned char *scratch) {
+	int				status;
+	unsigned		out_len;
+	unsigned char	*buf;
+	unsigned		len;
+	unsigned		left;
+
+	buf = blk->in;
+	left = len = blk->in_len;
+	blk->out_len = 0;
+	blk->num_recs = 0;
+
+	while(left != 0) {
+		if(cs->type == COMPRESS_LZO) {
+			lzo_uint	lzo_len;
+
+			status = lzo1x_999_compress_level(buf, len, scratch, &lzo_len, work,
+												NULL, 0, NULL, cs->level);
+			if(status != LZO_E_OK) {
+				return EDOM;
+			}
+			out_len = lzo_len;
+		} else {
+			status = ucl_nrv2b_99_compress(buf, len, scratch, &out_len, NULL, cs->level, NULL, NULL);
+			if(status != 0) {
+				return EDOM;
+			}
 		}
 		if(out_len >= 0x10000) {
 			//Didn't compress, try smaller block value so we can use
@@ -290,165 +336,397 @@ lzoflush(struct compress_lzo *lzo) {
 			len -= 0x1000;
 			continue;
 		}
-		//write out block
-		clearerr(lzo->fp);
-		putc(out_len >> 8, lzo->fp);
-		putc(out_len & 0xff, lzo->fp);
-		if((fwrite(lzo->out, 1, out_len, lzo->fp) != out_len) || ferror(lzo->fp)) {
-			return 0;
+		if(blk->out_len + 2 + out_len > sizeof(blk->out) || blk->num_recs >= MAX_BLOCK_RECORDS) {
+			return ENOSPC;
 		}
+		blk->rec_len[blk->num_recs++] = len;
+		blk->out[blk->out_len++] = out_len >> 8;
+		blk->out[blk->out_len++] = out_len & 0xff;
+		memcpy(&blk->out[blk->out_len], scratch, out_len);
+		blk->out_len += out_len;
 		buf += len;
-		lzo->in_off -= len;
-		len = lzo->in_off;
+		left -= len;
+		len = left;
 	}
-	return 1;
+	return EOK;
 }
 
 static int
-lzowrite(struct compress_lzo *lzo, const void *buf, size_t len) {
-	size_t	add;
-
-	for( ;; ) {
-		add = len;
-		if((add + lzo->in_off) < sizeof(lzo->in)) break;
-		add = sizeof(lzo->in) - lzo->in_off;
-		memcpy(&lzo->in[lzo->in_off], buf, add);
-		lzo->in_off += add;
-		len -= add;
-		buf = (unsigned char *)buf + add;
-		if(lzoflush(lzo) == 0) return 0;
+blkindex_add(struct compress_stream *cs, struct compress_block *blk) {
+	struct blkindex_entry	*ent;
+	unsigned				off;
+	unsigned				len;
+	unsigned				i;
+
+	if(cs->index_num + blk->num_recs > cs->index_max) {
+		cs->index_max += 256 + blk->num_recs;
+		if((ent = realloc(cs->index, cs->index_max * sizeof(*ent))) == NULL) {
+			errno = ENOMEM;
+			return 0;
+		}
+		cs->index = ent;
 	}
-	memcpy(&lzo->in[lzo->in_off], buf, add);
-	lzo->in_off += add;
+	off = 0;
+	for(i = 0; i < blk->num_recs; ++i) {
+		ent = &cs->index[cs->index_num++];
+		ent->coff = swap32(target_endian, cs->coff + off);
+		ent->uoff = swap32(target_endian, cs->uoff);
+		len = (blk->out[off] << 8) | blk->out[off + 1];
+		off += 2 + len;
+		cs->uoff += blk->rec_len[i];
+		if(blk->rec_len[i] > cs->max_rec) cs->max_rec = blk->rec_len[i];
+	}
+	cs->coff += off;
 	return 1;
 }
 
+// Append the block table after the end marker, padded so that the
+// trailer ends on a four byte boundary in the image (see blkindex.h).
 static int
-lzoclose(struct compress_lzo *lzo) {
-	int		status = 1;
+blkindex_write(struct compress_stream *cs) {
+	struct blkindex_trailer	tlr;
+	unsigned				pad;
+
+	pad = -(cimage_offset + cs->coff) & 3;
+	while(pad-- != 0) {
+		putc(0, cs->fp);
+		cs->coff++;
+	}
+	tlr.index_offset = swap32(target_endian, cs->coff);
+	tlr.num_blocks = swap32(target_endian, cs->index_num);
+	tlr.block_size = swap32(target_endian, cs->max_rec);
+	tlr.image_size = swap32(target_endian, cs->uoff);
+	tlr.signature = swap32(target_endian, BLKINDEX_SIGNATURE);
+	clearerr(cs->fp);
+	fwrite(cs->index, sizeof(*cs->index), cs->index_num, cs->fp);
+	fwrite(&tlr, sizeof(tlr), 1, cs->fp);
+	if(ferror(cs->fp)) {
+		return 0;
+	}
+	if(verbose >= 2) {
+		fprintf(debug_fp, "Block index: %u blocks, %u bytes.\n", cs->index_num,
+				(unsigned)(cs->index_num * sizeof(*cs->index) + sizeof(tlr)));
+	}
+	return 1;
+}
 
-	if(lzo->in_off != 0) {
-		status = lzoflush(lzo);
+static int
+blkput(struct compress_stream *cs, struct compress_block *blk) {
+	if(blk->status != EOK) {
+		errno = blk->status;
+		return 0;
 	}
-	//Mark end of compression
-	putc(0, lzo->fp);
-	putc(0, lzo->fp);
-	fclose(lzo->fp);
-	free(lzo);
-	return status;
+	if(compress_index && !blkindex_add(cs, blk)) {
+		return 0;
+	}
+	clearerr(cs->fp);
+	if((fwrite(blk->out, 1, blk->out_len, cs->fp) != blk->out_len) || ferror(cs->fp)) {
+		return 0;
+	}
+	return 1;
 }
 
-#define BUFFSIZE_UCL	0x10000
-struct compress_ucl {
-	FILE			*fp;
-	unsigned		in_off;
-	unsigned char	in[BUFFSIZE_UCL];
-	unsigned char	out[BUFFSIZE_UCL+(BUFFSIZE_UCL/8 + 256)];
-};
+static void *
+blkwork_alloc(int type) {
+	return malloc(type == COMPRESS_LZO ? LZO1X_999_MEM_COMPRESS : 1);
+}
 
-static struct compress_ucl *
-uclopen(const char *name) {
-	struct compress_ucl	*ucl;
+#ifdef COMPRESS_THREADS
+static void *
+blkworker(void *arg) {
+	struct compress_stream	*cs = arg;
+	struct compress_block	*blk;
+	void					*work;
+	unsigned char			*scratch;
 
-	ucl = malloc(sizeof(*ucl));
-	if(ucl == NULL) {
-		errno = ENOMEM;
-		return NULL;
-	}
-	ucl->fp = fopen(name, "wb");
-	if(ucl->fp == NULL) {
-		return NULL;
+	work = blkwork_alloc(cs->type);
+	scratch = malloc(BUFFSIZE_SCRATCH);
+
+	pthread_mutex_lock(&cs->mutex);
+	for( ;; ) {
+		while(cs->todo == NULL && !cs->exiting) {
+			pthread_cond_wait(&cs->work_cond, &cs->mutex);
+		}
+		if((blk = cs->todo) == NULL) break;
+		if((cs->todo = blk->next) == NULL) {
+			cs->todo_tail = &cs->todo;
+		}
+		pthread_mutex_unlock(&cs->mutex);
+
+		if(work == NULL || scratch == NULL) {
+			blk->status = ENOMEM;
+		} else {
+			blk->status = blkcompress(cs, blk, work, scratch);
+		}
+
+		pthread_mutex_lock(&cs->mutex);
+		blk->done = 1;
+		pthread_cond_broadcast(&cs->done_cond);
 	}
-	ucl->in_off = 0;
-	return ucl;
-}
+	pthread_mutex_unlock(&cs->mutex);
 
-static int
-uclflush(struct compress_ucl *ucl) {
-	int				status;
-	unsigned		out_len;
-	unsigned char	*buf;
-	unsigned		len;
+	free(scratch);
+	free(work);
+	return NULL;
+}
 
-	buf = ucl->in;
-	len = ucl->in_off;
+// Write out the finished blocks at the front of the pending list.  Only
+// this thread removes entries from the pending list, so the mutex can be
+// dropped while writing.  Called with the mutex held.
+static void
+blkdrain(struct compress_stream *cs) {
+	struct compress_block	*blk;
 
-	while(ucl->in_off != 0) {
-		status = ucl_nrv2b_99_compress(buf, len, ucl->out, &out_len, NULL, 9, NULL, NULL);
-		if(status != 0) {
-			errno = EDOM;
-			return 0;
+	while((blk = cs->pending) != NULL && blk->done) {
+		if((cs->pending = blk->order) == NULL) {
+			cs->pending_tail = &cs->pending;
 		}
-		if(out_len >= 0x10000) {
-			//Didn't compress, try smaller block value so we can use
-			//2 byte lengths in file
-			len -= 0x1000;
-			continue;
+		pthread_mutex_unlock(&cs->mutex);
+		if(cs->error == EOK && !blkput(cs, blk)) {
+			cs->error = errno;
 		}
-		//write out block
-		clearerr(ucl->fp);
-		putc(out_len >> 8, ucl->fp);
-		putc(out_len & 0xff, ucl->fp);
-		if((fwrite(ucl->out, 1, out_len, ucl->fp) != out_len) || ferror(ucl->fp)) {
-			return 0;
+		pthread_mutex_lock(&cs->mutex);
+		blk->next = cs->free;
+		cs->free = blk;
+	}
+}
+
+static int
+blksubmit(struct compress_stream *cs) {
+	struct compress_block	*blk = cs->cur;
+
+	pthread_mutex_lock(&cs->mutex);
+	blk->next = NULL;
+	blk->order = NULL;
+	blk->done = 0;
+	*cs->todo_tail = blk;
+	cs->todo_tail = &blk->next;
+	*cs->pending_tail = blk;
+	cs->pending_tail = &blk->order;
+	pthread_cond_signal(&cs->work_cond);
+
+	// Find a buffer for the next chunk, writing out finished blocks
+	// as they become available.
+	for( ;; ) {
+		blkdrain(cs);
+		if((blk = cs->free) != NULL) {
+			cs->free = blk->next;
+			break;
 		}
-		buf += len;
-		ucl->in_off -= len;
-		len = ucl->in_off;
+		if(cs->num_blocks < 2 * cs->num_threads + 1) {
+			if((blk = malloc(sizeof(*blk))) != NULL) {
+				++cs->num_blocks;
+				break;
+			}
+			if(cs->pending == NULL) {
+				cs->error = ENOMEM;
+				break;
+			}
+		}
+		pthread_cond_wait(&cs->done_cond, &cs->mutex);
+	}
+	pthread_mutex_unlock(&cs->mutex);
+
+	cs->cur = blk;
+	if(blk == NULL || cs->error != EOK) {
+		errno = cs->error;
+		return 0;
 	}
+	blk->in_len = 0;
 	return 1;
 }
 
+static void
+blkstop(struct compress_stream *cs) {
+	struct compress_block	*blk;
+	unsigned				i;
+
+	pthread_mutex_lock(&cs->mutex);
+	while(cs->pending != NULL) {
+		blkdrain(cs);
+		if(cs->pending != NULL) {
+			pthread_cond_wait(&cs->done_cond, &cs->mutex);
+		}
+	}
+	cs->exiting = 1;
+	pthread_cond_broadcast(&cs->work_cond);
+	pthread_mutex_unlock(&cs->mutex);
+	for(i = 0; i < cs->num_threads; ++i) {
+		pthread_join(cs->threads[i], NULL);
+	}
+	while((blk = cs->free) != NULL) {
+		cs->free = blk->next;
+		free(blk);
+	}
+	cs->num_threads = 0;
+	pthread_cond_destroy(&cs->done_cond);
+	pthread_cond_destroy(&cs->work_cond);
+	pthread_mutex_destroy(&cs->mutex);
+}
+static void
+blkstart(struct compress_stream *cs) {
+	long	n;
+
+	n = compress_threads;
+#ifdef _SC_NPROCESSORS_ONLN
+	if(n <= 0) n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if(n > MAX_COMPRESS_THREADS) n = MAX_COMPRESS_THREADS;
+	if(n <= 1) return;
+
+	pthread_mutex_init(&cs->mutex, NULL);
+	pthread_cond_init(&cs->work_cond, NULL);
+	pthread_cond_init(&cs->done_cond, NULL);
+	cs->todo_tail = &cs->todo;
+	cs->pending_tail = &cs->pending;
+	cs->num_blocks = 1;
+	while(cs->num_threads < n) {
+		if(pthread_create(&cs->threads[cs->num_threads], NULL, blkworker, cs) != EOK) break;
+		++cs->num_threads;
+	}
+	if(cs->num_threads < 2) {
+		// Not worth it, compress in this thread
+		blkstop(cs);
+	} else if(verbose >= 2) {
+		fprintf(debug_fp, "Compressing with %u threads.\n", cs->num_threads);
+	}
+}
+
+#endif
+
+static int
+blkflush(struct compress_stream *cs) {
+	struct compress_block	*blk = cs->cur;
+
+#ifdef COMPRESS_THREADS
+	if(cs->num_threads != 0) {
+		return blksubmit(cs);
+	}
+#endif
+	blk->status = blkcompress(cs, blk, cs->work, cs->scratch);
+	blk->in_len = 0;
+	return blkput(cs, blk);
+}
+
+static struct compress_stream *
+blkopen(const char *name, int type) {
+	struct compress_stream	*cs;
+
+	if(type == COMPRESS_LZO && lzo_init() != LZO_E_OK) {
+		errno = EDOM; //Strange error so we know what failed.
+		return NULL;
+	}
+	cs = calloc(1, sizeof(*cs));
+	if(cs == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	cs->type = type;
+	cs->level = compress_level;
+	if(cs->level == 0) {
+		// lzo1x_999_compress() is level 8
+		cs->level = (type == COMPRESS_LZO) ? 8 : 9;
+	}
+	cs->cur = malloc(sizeof(*cs->cur));
+	cs->work = blkwork_alloc(type);
+	cs->scratch = malloc(BUFFSIZE_SCRATCH);
+	if(cs->cur == NULL || cs->work == NULL || cs->scratch == NULL) {
+		free(cs->scratch);
+		free(cs->work);
+		free(cs->cur);
+		free(cs);
+		errno = ENOMEM;
+		return NULL;
+	}
+	cs->cur->in_len = 0;
+	cs->fp = fopen(name, "wb");
+	if(cs->fp == NULL) {
+		free(cs->scratch);
+		free(cs->work);
+		free(cs->cur);
+		free(cs);
+		return NULL;
+	}
+#ifdef COMPRESS_THREADS
+	blkstart(cs);
+#endif
+	return cs;
+}
+
 static int
-uclwrite(struct compress_ucl *ucl, const void *buf, size_t len) {
-	size_t	add;
+blkwrite(struct compress_stream *cs, const void *buf, size_t len) {
+	struct compress_block	*blk = cs->cur;
+	size_t					add;
 
 	for( ;; ) {
 		add = len;
-		if((add + ucl->in_off) < sizeof(ucl->in)) break;
-		add = sizeof(ucl->in) - ucl->in_off;
-		memcpy(&ucl->in[ucl->in_off], buf, add);
-		ucl->in_off += add;
+		if((add + blk->in_len) < sizeof(blk->in)) break;
+		add = sizeof(blk->in) - blk->in_len;
+		memcpy(&blk->in[blk->in_len], buf, add);
+		blk->in_len += add;
 		len -= add;
 		buf = (unsigned char *)buf + add;
-		if(uclflush(ucl) == 0) return 0;
+		if(blkflush(cs) == 0) return 0;
+		blk = cs->cur;
 	}
-	memcpy(&ucl->in[ucl->in_off], buf, add);
-	ucl->in_off += add;
+	memcpy(&blk->in[blk->in_len], buf, add);
+	blk->in_len += add;
 	return 1;
 }
 
 static int
-uclclose(struct compress_ucl *ucl) {
+blkclose(struct compress_stream *cs) {
 	int		status = 1;
 
-	if(ucl->in_off != 0) {
-		status = uclflush(ucl);
+	if(cs->cur != NULL && cs->cur->in_len != 0) {
+		status = blkflush(cs);
 	}
+#ifdef COMPRESS_THREADS
+	if(cs->num_threads != 0) {
+		blkstop(cs);
+		if(cs->error != EOK) {
+			errno = cs->error;
+			status = 0;
+		}
+	}
+#endif
 	//Mark end of compression
-	putc(0, ucl->fp);
-	putc(0, ucl->fp);
-	fclose(ucl->fp);
-	free(ucl);
+	putc(0, cs->fp);
+	putc(0, cs->fp);
+	cs->coff += 2;
+	if(status && compress_index && !blkindex_write(cs)) {
+		status = 0;
+	}
+	if(fclose(cs->fp) != 0) status = 0;
+	free(cs->index);
+	free(cs->scratch);
+	free(cs->work);
+	free(cs->cur);
+	free(cs);
 	return status;
 }
 
 static void
 compress_start(void) {
+	char	mode[8];
+
 	compress_name = mk_tmpfile();
+	if(compress_index && compressed != COMPRESS_LZO && compressed != COMPRESS_UCL) {
+		error_exit("compress_index requires LZO or UCL compression.\n");
+	}
 	switch(compressed) {
 	case COMPRESS_ZLIB:
-		if((compress_fp = gzopen(compress_name, "wb")) == NULL) {
+		strcpy(mode, "wb");
+		if(compress_level != 0) {
+			sprintf(mode, "wb%d", compress_level);
+		}
+		if((compress_fp = gzopen(compress_name, mode)) == NULL) {
 			error_exit("Error opening compression stream.\n");
 		}
 		break;
 	case COMPRESS_LZO:
-		if((compress_fp = lzoopen(compress_name)) == NULL) {
-			error_exit("Error opening compression stream: %s.\n", strerror(errno));
-		}
-		break;
 	case COMPRESS_UCL:
-		if((compress_fp = uclopen(compress_name)) == NULL) {
+		if((compress_fp = blkopen(compress_name, compressed)) == NULL) {
 			error_exit("Error opening compression stream: %s.\n", strerror(errno));
 		}
 		break;
@@ -465,10 +743,10 @@ compress_stop(void) {
 		gzclose(compress_fp);
 		break;
 	case COMPRESS_LZO:
-		lzoclose(compress_fp);
-		break;
 	case COMPRESS_UCL:
-		uclclose(compress_fp);
+		if(blkclose(compress_fp) == 0) {
+			error_exit("Error writing compression file: %s.\n", strerror(errno));
+		}
 		break;
 	default:
 		//Should never happen
@@ -490,12 +768,8 @@ iwrite(void *buf, int nbytes, FILE *dst_fp, char *fname) {
 			}
 			break;
 		case COMPRESS_LZO:
-			if(lzowrite(compress_fp, buf, nbytes) == 0) {
-				error_exit("Error writing compression file: %s.\n", strerror(errno));
-			}
-			break;
 		case COMPRESS_UCL:
-			if(uclwrite(compress_fp, buf, nbytes) == 0) {
+			if(blkwrite(compress_fp, buf, nbytes) == 0) {
 				error_exit("Error writing compression file: %s.\n", strerror(errno));
 			}
 			break;
@@ -24,10 +24,12 @@
 
 %C - make a image/flash file system
 
-%C	-t type [-r root] [-l input] [-s section] [-nv] [in-file [out-file]]
+%C	-t type [-r root] [-l input] [-s section] [-j threads] [-nv] [in-file [out-file]]
 
 Options:
  -t ffs2|ffs3|ifs|etfs Set the type of the output file system.
+ -j threads            Number of threads used to compress an IFS image
+                       (default is the number of cpus).
  -l input              Prefix a line to the input-file.
  -n                    No timestamps. Allows for binary identical images. One
                        'n' will strip timestamps from files which vary from run
@@ -72,9 +74,11 @@ Options:
 
 %C - make an image file system
 
-%C	[-r root] [-l input] [-s section] [-nv] [in-file [out-file]]
+%C	[-r root] [-l input] [-s section] [-j threads] [-nv] [in-file [out-file]]
 
 Options:
+ -j threads     Number of threads used to compress the image (default is
+                the number of cpus; 1 compresses in the main thread).
  -l input       Prefix a line to the input-file.
  -n             No timestamps. Allows for binary identical images.  One 'n'
                 will strip timestamps from files which vary from run to run.
@@ -166,6 +170,7 @@ struct attr_script_list		*attr_script_list;
 struct file_entry	 *file_list;
 
 int					 verbose;
+int					 compress_threads;
 int					 host_endian;	// 0 - little,  1 - big
 int					 target_endian = -1;// 0 - little,  1 - big,  -1 - unknown
 FILE				*debug_fp;
@@ -1983,7 +1988,7 @@ main(int argc, char *argv[]) {
 	// Get the right permissions on temp files
 	old_mask = umask(0);
 
-	while((n = getopt(argc, argv, "a:c:r:l:nNps:t:v")) != -1) {
+	while((n = getopt(argc, argv, "a:c:j:r:l:nNps:t:v")) != -1) {
 		switch(n) {
 		case 'a':
 			symfile_suffix = strdup( optarg );
@@ -1991,6 +1996,9 @@ main(int argc, char *argv[]) {
 		case 'c':
 			cache_dir = optarg;
 			break;
+		case 'j':
+			compress_threads = strtol(optarg, NULL, 10);
+			break;
 		case 'l':
 			add_data(optarg);
 			add_data("\n");
@@ -33,6 +33,8 @@
 int					block_size;
 int					chain_paddr;
 int					compressed;
+int					compress_level;
+int					compress_index;
 int 				split_image;
 struct addr_space	image;
 struct addr_space	ram;
@@ -326,6 +328,8 @@ enum ifs_attrs {
 	ATTR_KEEPSECTION,
 	ATTR_MODULE,
 	ATTR_PHYS_ALIGN,
+	ATTR_COMPRESS_LEVEL,
+	ATTR_COMPRESS_INDEX,
 };
 
 struct attr_types ifs_attr_table[] = {
@@ -348,6 +352,8 @@ struct attr_types ifs_attr_table[] = {
 	{ "keepsection=",ATTR_KEEPSECTION },
 	{ "module=",	ATTR_MODULE },
 	{ "phys_align=",	ATTR_PHYS_ALIGN },
+	{ "compress_level=",	ATTR_COMPRESS_LEVEL },
+	{ "compress_index",	ATTR_COMPRESS_INDEX },
 	{ NULL }
 };
 
@@ -523,6 +529,15 @@ ifs_parse_attr(int tokenc, char *tokenv[], struct attr_file_entry *attrp) {
 			case ATTR_COMPRESS2:
 				compressed = ival;
 				break;
+			case ATTR_COMPRESS_LEVEL:
+				if(ival < 1 || ival > 9) {
+					error_exit("Compression level must be between 1 and 9.\n");
+				}
+				compress_level = ival;
+				break;
+			case ATTR_COMPRESS_INDEX:
+				compress_index = ival;
+				break;
 			case ATTR_PAGE_ALIGN:
 				attrp->page_align = ival;
 				break;
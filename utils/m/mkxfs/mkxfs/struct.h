@@ -330,6 +330,9 @@ extern int   num_blocks;
 extern int   spare_blocks;
 extern int	 chain_paddr;
 extern int	 compressed;
+extern int	 compress_level;
+extern int	 compress_index;
+extern int	 compress_threads;
 extern int	 verbose;
 extern int	 split_image;
 extern FILE	*debug_fp;
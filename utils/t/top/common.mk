@@ -9,6 +9,7 @@ define PINFO
 PINFO DESCRIPTION=print system usage
 endef
 
+LIBS+=util
 USEFILE=$(PROJECT_ROOT)/$(NAME).use
 
 include $(MKFILES_ROOT)/qtargets.mk
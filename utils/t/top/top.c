@@ -38,6 +38,7 @@
 #include <pthread.h>
 #include <sgtty.h>
 #include <inttypes.h>
+#include <util/procsample.h>
 
 #include "ttyin.h"
 #include "procfs_util.h"
@@ -52,14 +53,6 @@ char * ho_sequence = "\033[H";
 char * ce_sequence = "\033[K";
 
 
-/* Data structures to contain the process model */
-
-typedef struct process_tree_ process_tree;
-typedef struct process_entry_ process_entry;
-typedef struct thread_entry_ thread_entry;
-
-const long MAGIC = 0x8BADF00D;
-
 // globals for telltales
 #define MAX_CPUS        32
 unsigned  min_cpu_idle[ MAX_CPUS ];
@@ -81,452 +74,40 @@ unsigned  tot_threads;
 unsigned  times_thru;
 
 
-/* The top of the process tree. It keeps the root of the process entry
- * list, as well as various statistics about the processes, such as
- * the number of processes, threads, and various times.
+/* Per interval totals, accumulated from the sampler by
+ * pick_active_threads().
  */
 
-struct process_tree_
+typedef struct
 {
-    process_tree        *next;
     int                 n_processes;
     int                 n_threads;
     uint64_t            idle_time[ MAX_CPUS ];
     uint64_t            kernel_time;
     uint64_t            user_time;
     uint64_t            total_time;
-    process_entry *     process_list_p;
-    long                magic;
-};
-
-
-/* This structure represents a process. Keeps the process info
- * structure gleaned from /proc, along with the list of threads in the
- * process, the pid of the process, and the number of threads. Also
- * keep the name here for later.
- */
-
-struct process_entry_
-{
-    process_entry *     next;
-    process_tree *      up;
-    procfs_info         info;
-    int32_t             total_memory;
-    int                 n_threads;
-    char                name[_POSIX_PATH_MAX];
-    thread_entry *      thread_list_p;
-    long                magic;
-};
-
-
-/* This structure represents a thread. Keeps the status
- * structure obtained from /proc, along with the pid, tid,
- * and total time used (as computed in pick_active_threads()
- * below).
- */
-
-struct thread_entry_
-{
-    thread_entry *      next;
-    process_entry *     up;
-    uint64_t            time_used;
-    procfs_status       status;
-    long                magic;
-};
-
-
-/* These are the heads of free lists */
-
-process_tree * free_process_trees = 0;
-process_entry * free_process_entries = 0;
-thread_entry * free_thread_entries = 0;
-
-/* Allocate and initialize a new process entry structure */
-
-process_entry * new_process_entry (pid_t pid)
-{
-    process_entry * p;
-    if (free_process_entries == NULL) {
-        p = malloc(sizeof(*p));
-    } else {
-        p = free_process_entries;
-        free_process_entries = p->next;
-    }
-
-    if (p != NULL) {
-        memset(p, 0, sizeof(*p));
-        p->info.pid = pid;
-        p->magic = MAGIC;
-    } else {
-        perror("Couldn't allocate process entry");
-        exit(1);
-    }
-
-    return p;
-}
-
-/* Allocate and init a new thread entry structure */
-
-thread_entry * new_thread_entry (pid_t pid, int tid)
-{
-    thread_entry * t;
-    if (free_thread_entries == NULL) {
-        t = malloc(sizeof(*t));
-    } else {
-        t = free_thread_entries;
-        free_thread_entries = t->next;
-    }
-
-    if (t != NULL) {
-        memset(t, 0, sizeof(*t));
-        t->status.pid = pid;
-        t->status.tid = tid;
-        t->magic = MAGIC;
-    } else {
-        perror("Couldn't allocate thread entry");
-        exit(1);
-    }
-    return t;
-}
-
-/* Allocate and init a process tree structure */
-
-process_tree * new_process_tree (void)
-{
-    process_tree * tree_p;
-
-    if (free_process_trees == NULL) {
-        tree_p = malloc(sizeof(*tree_p));
-    } else {
-        tree_p = free_process_trees;
-        free_process_trees = tree_p->next;
-    }
-
-    if (tree_p == NULL) {
-        perror("Couldn't allocate process tree");
-        exit(1);
-    }
-    memset(tree_p, 0, sizeof(*tree_p));
-    tree_p->magic = MAGIC;
-
-    return tree_p;
-}
-
-/* Free a tree entry. */
-
-void free_thread_entry (thread_entry * te_p)
-{
-    if (te_p != NULL) {
-        if (te_p->magic != MAGIC) {
-            leave_cbreak_mode();
-            abort();
-        }
-        te_p->magic = 0;
-
-        te_p->next = free_thread_entries;
-        free_thread_entries = te_p;
-    }
-}
-
-/* free a process_entry
- */
-
-void free_process_entry (process_entry * pe_p)
-{
-    if (pe_p != NULL) {
-        if (pe_p->magic != MAGIC) {
-            leave_cbreak_mode();
-            abort();
-        }
-        pe_p->magic = 0;
-
-        pe_p->next = free_process_entries;
-        free_process_entries = pe_p;
-    }
-}
-
-/* Free a process tree, freeing the process list as well */
-
-void free_process_tree (process_tree * tree_p)
-{
-    process_entry * pe_p;
-    void * tmp;
-
-    if (tree_p->magic != MAGIC) {
-        leave_cbreak_mode();
-        abort();
-    }
-
-    pe_p = tree_p->process_list_p;
-    while (pe_p != NULL) {
-        thread_entry * te_p = pe_p->thread_list_p;
-
-        while (te_p != NULL) {
-            tmp = te_p->next;
-            free_thread_entry(te_p);
-            te_p = tmp;
-        }
-
-        tmp = pe_p->next;
-        free_process_entry(pe_p);
-        pe_p = tmp;
-    }
-
-    tree_p->magic = 0;
-    tree_p->next = free_process_trees;
-    free_process_trees = tree_p;
-}
-
-/*
- * get_memory_usage_from_map ()
- */
-
-int32_t get_memory_usage_from_map (int fd, procfs_mapinfo *mem, int num)
-{
-    int32_t             total = -1;
-
-    if (num > 0) {
-        int i;
-
-        total = 0;
-
-        for (i = 0; i < num; i++) {
-            if ((mem[i].flags & MAP_TYPE) == MAP_SHARED) {
-                /* Ignore it */
-                continue;
-            }
-            switch(mem[i].dev) {
-            case 1:
-                if (mem[i].flags & MAP_ELF) {
-                    total += mem[i].size;
-                }
-                break;
-            case 2:
-                /* This is mapped memory */
-                if (mem[i].flags & MAP_FIXED) {
-                    /* This is device memory most likely. Ignore it. */
-                } else if (
-                    (mem[i].flags & (MAP_STACK|PG_HWMAPPED)) ==
-                    (MAP_STACK|PG_HWMAPPED)) {
-                    /* This is stack that has physical backing store */
-                    total += mem[i].size;
-                } else if (mem[i].flags & PG_HWMAPPED) {
-                    /* This is not device memory. and it has a
-                     * physical backing store. Count is as data
-                     */
-                    total += mem[i].size;
-                }
-                break;
-            case 3:
-                /* This is shared memory */
-                break;
-            case 4:
-                /* This is DLL text. Ignore it */
-                break;
-            }
-        }
-    }
-    return total;
-}
-
-/*
- * Collect process information from the /proc file system. Allocate and
- * return a process_entry for the process with the given pid on the given
- * node.
- *
- * In addition, get info on all the threads in the process, and allocate
- * a list of thread_entry structures with them.
- *
- * Note that this routine puts the thread structures on the list in
- * reverse order from how it discovers them.
- */
-
-process_entry * do_process(char * node, pid_t pid, int calc_mem)
-{
-    int                 fd;
-    char                buff[128];
-    static char *       e = "Unable to build the process tree";
-    process_entry *     pe_p;
-
-    pe_p = new_process_entry(pid);
-    if (pe_p == NULL) {
-        perror(e);
-        exit(-1);
-    }
-
-    if (node == 0 || node[0] == 0) {
-        sprintf(buff, "/proc/%d", pid);
-    } else {
-        sprintf(buff, "/net/%s/proc/%d", node, pid);
-    }
-
-    if ((fd = open(buff, O_RDONLY)) == -1) {
-        /* The pid may have died, just ignore it */
-        free_process_entry(pe_p);
-        return NULL;
-    }
-
-    if (devctl(fd, DCMD_PROC_INFO,
-               &pe_p->info, sizeof pe_p->info, 0) != -1) {
-        int             lasttid, tid;
-
-        if (pe_p->info.flags & _NTO_PF_ZOMBIE) {
-            free_process_entry(pe_p);
-            pe_p = NULL;
-        } else {
-            if (pe_p->info.pid == 1) {
-                strcpy(pe_p->name, "kernel");
-            } else {
-                procfs_get_process_name(fd, pe_p->name, sizeof(pe_p->name));
-         	}
-
-            if (calc_mem) {
-                procfs_mapinfo  *map;
-                int             num;
-
-				/* This can be an expensive operation if a process has
-				a large number of mappings.  It's also not currently
-				used in the displayed output.  Make it optional. */
-
-                num = procfs_get_process_mapinfo(fd, &map);
-	            pe_p->total_memory = get_memory_usage_from_map(fd, map, num);
-                free(map);
-
-            } else {
-                pe_p->total_memory = 0;
-            }
-
-            for (lasttid = tid = 1; ; lasttid = ++tid) {
-                thread_entry * te_p = new_thread_entry(pid, tid);
-                if (te_p == NULL) {
-                    perror(e);
-                    exit(-1);
-                }
-
-                te_p->status.tid = tid;
-                if (devctl(fd, DCMD_PROC_TIDSTATUS, &te_p->status,
-                       sizeof(te_p->status), 0) != EOK) {
-                    free_thread_entry(te_p);
-                    break;
-                }
-                tid = te_p->status.tid;
-                if (tid < lasttid) {
-                	free_thread_entry(te_p);
-                	break;
-                }
-                te_p->up = pe_p;
-                te_p->next = pe_p->thread_list_p;
-                pe_p->thread_list_p = te_p;
-                pe_p->n_threads++;
-            }
-        }
-    }
-    close(fd);
-    return(pe_p);
-}
+} sample_totals;
 
-
-/* Walk through /proc, and for each pid found, call do_process(). It
- * should return either NULL or a process_entry block, containing info
- * for the process. Link them up on the supplied tree.
- */
-
-process_tree * build_process_tree (char * node)
-{
-    DIR          *dir;
-    char          fname[_POSIX_PATH_MAX];
-    process_tree *tree_p;
-
-    /* allocation failure taken care of in new_process_tree */
-    tree_p = new_process_tree();
-
-    if (node == NULL) {
-        dir = opendir("/proc");
-    } else {
-        sprintf(fname, "/net/%s/proc", node);
-        dir = opendir(fname);
-    }
-
-    if (dir == NULL) {
-        leave_cbreak_mode();
-        printf(cl_sequence);
-        printf("/proc can't be opened: %s\n", strerror(errno));
-        exit(-2);
-    } else {
-        struct dirent * dirent;
-
-        while ((dirent = readdir(dir)) != NULL) {
-            if (isdigit(dirent->d_name[0])) {
-                process_entry * pe_p =
-                    do_process(node, atoi(dirent->d_name), 0);
-
-                if (pe_p != NULL) {
-                    pe_p->next = tree_p->process_list_p;
-                    pe_p->up = tree_p;
-                    tree_p->process_list_p = pe_p;
-                    tree_p->n_processes++;
-                    tree_p->n_threads += pe_p->n_threads;
-                }
-            }
-        }
-        closedir(dir);
-    }
-    return tree_p;
-}
-
-
-/* find_thread_entry() searches a process tree for a particular thread.
- * as denoted by its pid/tid pair. If found, that thread_entry is returned.
- */
-thread_entry * find_thread_entry (process_tree * tree_p, pid_t pid, int tid)
-{
-    process_entry * pe_p;
-
-    for (pe_p = tree_p->process_list_p;
-         pe_p != NULL;
-         pe_p = pe_p->next) {
-
-        thread_entry * te_p;
-
-        if (pe_p->info.pid != pid) {
-            continue;
-        }
-
-        for (te_p = pe_p->thread_list_p;
-             te_p != NULL;
-             te_p = te_p->next)
-        {
-            if (te_p->status.tid == tid) {
-                return te_p;
-            }
-        }
-    }
-    return NULL;
-}
+typedef procsample_thread_t thread_entry;
 
 
 /*
- * pick_active_threads() is the real heart of top. Given two process
- * trees, it attempts to order the threads from the newer tree into
- * decending order of first CPU usage, and then total CPU usage. It does
- * this by comparing the values of the ticks field in the tid
- * information.
+ * pick_active_threads() is the real heart of top. Given the latest
+ * sample, it attempts to order the threads into decending order of
+ * first CPU usage, and then total CPU usage.
  *
- * Every 10 ms, the ticks field is incremented for the running thread.
- * This means that the tid info returned by procfs can be compared to the
- * prior tid info, and an indication of how many ticks happened during
- * the delay between tree building can be determined for each thread.
+ * The sampler keeps the thread state from one interval to the next, and
+ * has already worked out how much of its sutime each thread consumed
+ * since the previous sample (time_used).
  *
  * One other thing of note is that pid 1, tid 1 is the idle thread. This
  * is the thread that is run when there isn't anything else to do.
  *
  * So, the algorithm is
  *
- * for each thread in the new tree
+ * for each thread in the sample
  *
- *  find the thread in the old tree.
- *  time used during this interval is (new ticks - old ticks)
- *  total ticks is incremented by this amount
+ *  total time is incremented by its time used
  *
  *  skipping the idle thread, sort the current thread into
  *  the supplied array.
@@ -538,48 +119,28 @@ int pick_active_threads (
     int nCPUs,
     int nthreads,
     thread_entry ** stat_array,
-    process_tree * prior_p,
-    process_tree * now_p
+    procsample_t * ps,
+    sample_totals * now_p
     )
 {
-    process_entry * pe_p;
+    procsample_proc_t * pe_p;
     int last_element = -1;
 
     memset(stat_array, 0, sizeof(thread_entry *) * nthreads);
+    memset(now_p, 0, sizeof(*now_p));
+    now_p->n_processes = procsample_nprocesses(ps);
+    now_p->n_threads = procsample_nthreads(ps);
 
-    for (pe_p = now_p->process_list_p;
+    for (pe_p = procsample_first(ps);
          pe_p != NULL;
          pe_p = pe_p->next) {
 
         thread_entry * te_p;
 
-        for (te_p = pe_p->thread_list_p;
+        for (te_p = pe_p->thread_list;
              te_p != NULL;
              te_p = te_p->next)
         {
-            thread_entry * prior_te_p =
-                find_thread_entry(prior_p, te_p->status.pid,
-                                  te_p->status.tid);
-
-            if (prior_te_p == NULL ||
-                te_p->status.sutime < prior_te_p->status.sutime) {
-                /* Here, prior_te_p either isn't set, or points to a
-                 * thread with the same TID, but which isn't the same
-                 * as the new one (since the elapsed_time is more than
-                 * the new thread). Consequently, the time_used field is
-                 * just the number of ticks in this one.
-                 */
-
-                te_p->time_used = te_p->status.sutime;
-            } else {
-                /* Here, we use the difference between this time
-                 * and the last time.
-                 */
-                te_p->time_used =
-                    te_p->status.sutime -
-                    prior_te_p->status.sutime;
-            }
-
             /* Count total time running */
             now_p->total_time += te_p->time_used;
 
@@ -882,19 +443,31 @@ void die (int x)
 }
 
 
+/* Take a new sample, giving up if /proc can't be read */
+
+void update_sample (procsample_t * ps)
+{
+    if (procsample_update(ps) == -1) {
+        leave_cbreak_mode();
+        printf(cl_sequence);
+        printf("/proc can't be read: %s\n", strerror(errno));
+        exit(-2);
+    }
+}
+
+
 /* Main program.
  *
  * The algorithm goes something like this:
  *
- * Create a model of the processes in the system.  Then, wait a
- * bit. After a while, create another model, and find those threads
- * which have used the most cpu time between the two models were
- * built.  sort those thread structures into an array, and then print
- * them out.
+ * Sample the processes in the system.  Then, wait a bit. After a
+ * while, sample them again, and find those threads which have used the
+ * most cpu time between the two samples.  sort those thread structures
+ * into an array, and then print them out.
  *
  * Once you've printed them out, you need to wait a bit and do it
- * again, after tossing the old model and making the new one the old
- * one. (you get it).
+ * again. The sampler keeps the model between samples and only
+ * re-reads what has changed.
  *
  * Oh, and while you are waiting, find out if the user wants to do
  * anything like quit, or kill a process, or that kind of thing.
@@ -903,8 +476,9 @@ void die (int x)
 
 void top (char * node, int iterations)
 {
-    process_tree * prior_p;
-    process_tree * now_p;
+    procsample_t * ps;
+    sample_totals now;
+    sample_totals * now_p = &now;
     thread_entry **thread_array = NULL;
     char elapsed_time_buffer[32];
     char namebuf[64];
@@ -965,7 +539,12 @@ void top (char * node, int iterations)
     printf("Computing times...");
     fflush(stdout);
 
-    prior_p = build_process_tree(node);
+    if ((ps = procsample_create(node, PROCSAMPLE_NAMES | PROCSAMPLE_THREADS)) == NULL) {
+        leave_cbreak_mode();
+        perror("Unable to create the process sampler");
+        exit(1);
+    }
+    update_sample(ps);
 
     sleep(1);
     printf(cl_sequence);
@@ -973,8 +552,8 @@ void top (char * node, int iterations)
     while (!quit) {
         int active;
 
-        /* Create a new process tree for the new model, and build it */
-        now_p = build_process_tree(node);
+        /* Take a new sample of the process model */
+        update_sample(ps);
 
         if (number_of_threads != number_of_threads_allocated) {
             /* realloc the array when it changes size */
@@ -1000,7 +579,7 @@ void top (char * node, int iterations)
             pick_active_threads(
                 number_of_CPUs,
                 number_of_threads, thread_array,
-                prior_p, now_p);
+                ps, now_p);
 
 
         {   // update cpu telltales
@@ -1125,14 +704,6 @@ void top (char * node, int iterations)
 
         printf("%s\n", ce_sequence);
 
-        /*
-         * Free the 'old' model, and make the current one the prior one
-         * for next time.
-         */
-
-        free_process_tree(prior_p);
-        prior_p = now_p;
-
 	if (iterations && (++loop_count == iterations))
 	    break;
 
@@ -1180,6 +751,7 @@ void top (char * node, int iterations)
     }
 
     /* Fix tty */
+    procsample_destroy(ps);
     leave_cbreak_mode();
     exit(0);
 }
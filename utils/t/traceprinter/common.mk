@@ -9,7 +9,7 @@ define PINFO
 PINFO DESCRIPTION=Utility to display tracelogger output
 endef
 
-LIBS=traceparser compat
+LIBS=traceparser compat lzo
 
 USEFILE=$(PROJECT_ROOT)/traceprinter.c
 
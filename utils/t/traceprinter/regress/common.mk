@@ -46,5 +46,5 @@ endif
 	$(MG_HOST) $@
 
 
-LIBS+=traceparser
+LIBS+=traceparser lzo
 